@@ -1,10 +1,20 @@
 #include "sokol_app.h"
+#include "sokol_time.h"
 #include "clock.h"
 #include <assert.h>
+#if defined(WIN32)
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <time.h>
+#endif
+
+#define CLOCK_MAX_FRAME_TIME_US (24000)
+#define CLOCK_MAX_MEASURED_FRAME_TIME_US (100000)
 
 typedef struct {
     bool valid;
     uint64_t cur_time;
+    uint64_t last_tick;     // sokol_time timestamp of the previous frame
 } clock_state_t;
 static clock_state_t state;
 
@@ -12,6 +22,7 @@ void clock_init(void) {
     state = (clock_state_t) {
         .valid = true,
         .cur_time = 0,
+        .last_tick = 0,
     };
 }
 
@@ -20,13 +31,39 @@ uint32_t clock_frame_time(void) {
     uint32_t frame_time_us = (uint32_t) (sapp_frame_duration() * 1000000.0);
     // prevent death-spiral on host systems that are too slow to emulate
     // in real time, or during long frames (e.g. debugging)
-    if (frame_time_us > 24000) {
-        frame_time_us = 24000;
+    if (frame_time_us > CLOCK_MAX_FRAME_TIME_US) {
+        frame_time_us = CLOCK_MAX_FRAME_TIME_US;
+    }
+    state.cur_time += frame_time_us;
+    state.last_tick = stm_now();
+    return frame_time_us;
+}
+
+uint32_t clock_frame_time_measured(void) {
+    assert(state.valid);
+    if (state.last_tick == 0) {
+        return clock_frame_time();
+    }
+    uint32_t frame_time_us = (uint32_t) stm_us(stm_laptime(&state.last_tick));
+    // same as above, but allow for long frames when throttling
+    if (frame_time_us > CLOCK_MAX_MEASURED_FRAME_TIME_US) {
+        frame_time_us = CLOCK_MAX_MEASURED_FRAME_TIME_US;
     }
     state.cur_time += frame_time_us;
     return frame_time_us;
 }
 
+void clock_sleep_us(uint32_t us) {
+    #if defined(WIN32)
+        Sleep(us / 1000);
+    #elif defined(__EMSCRIPTEN__)
+        (void)us;
+    #else
+        struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (long)(us % 1000000) * 1000 };
+        nanosleep(&ts, 0);
+    #endif
+}
+
 uint32_t clock_frame_count_60hz(void) {
     assert(state.valid);
     return (uint32_t) (state.cur_time / 16667);
@@ -4,3 +4,8 @@
 void clock_init(void);
 uint32_t clock_frame_time(void);
 uint32_t clock_frame_count_60hz(void);
+// like clock_frame_time(), but measures the time since the previous call instead
+// of using the averaged display frame duration, for irregular frame rates
+uint32_t clock_frame_time_measured(void);
+// sleep for a number of microseconds (no-op on the web)
+void clock_sleep_us(uint32_t us);
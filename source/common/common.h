@@ -8,6 +8,7 @@
 #include "sokol_log.h"
 #include "clock.h"
 #include "prof.h"
+#include "trace.h"
 #include "fs.h"
 #include "gfx.h"
 #include "keybuf.h"
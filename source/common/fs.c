@@ -3,6 +3,8 @@
 #include "sokol_log.h"
 #include "chips/chips_common.h"
 #include "fs.h"
+#include "thread.h"
+#include "trace.h"
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -31,6 +33,39 @@ typedef struct {
     fs_snapshot_load_callback_t callback;
 } fs_snapshot_load_context_t;
 
+typedef struct {
+    size_t snapshot_index;
+    fs_snapshot_save_callback_t callback;
+    void* data;     // copy of the data, owned by the context
+} fs_snapshot_save_context_t;
+
+// a queued file write, with a copy of the data
+typedef struct fs_write_job_t {
+    struct fs_write_job_t* next;
+    fs_path_t path;
+    size_t snapshot_index;
+    fs_snapshot_save_callback_t callback;
+    fs_result_t result;
+    size_t size;
+    uint8_t data[];
+} fs_write_job_t;
+
+typedef struct {
+    fs_write_job_t* head;
+    fs_write_job_t* tail;
+} fs_write_list_t;
+
+// file writes run on the writer thread, completed jobs wait for fs_dowork()
+typedef struct {
+    thread_t thread;
+    thread_mutex_t mutex;
+    thread_cond_t cond;
+    bool threaded;
+    bool quit;                  // guarded by mutex
+    fs_write_list_t pending;    // guarded by mutex
+    fs_write_list_t done;       // guarded by mutex
+} fs_writer_t;
+
 typedef struct {
     fs_path_t path;
     fs_result_t result;
@@ -42,9 +77,14 @@ typedef struct {
 typedef struct {
     bool valid;
     fs_channel_state_t channels[FS_CHANNEL_NUM];
+    fs_writer_t writer;
 } fs_state_t;
 static fs_state_t state;
 
+static void fs_writer_init(void);
+static void fs_writer_dowork(void);
+static void fs_writer_shutdown(void);
+
 void fs_init(void) {
     memset(&state, 0, sizeof(state));
     state.valid = true;
@@ -54,11 +94,20 @@ void fs_init(void) {
         .num_lanes = 1,
         .logger.func = slog_func,
     });
+    fs_writer_init();
 }
 
 void fs_dowork(void) {
     assert(state.valid);
     sfetch_dowork();
+    fs_writer_dowork();
+}
+
+void fs_shutdown(void) {
+    assert(state.valid);
+    fs_writer_shutdown();
+    sfetch_shutdown();
+    state.valid = false;
 }
 
 static void fs_path_reset(fs_path_t* path) {
@@ -309,7 +358,7 @@ static void fs_emsc_dropped_file_callback(const sapp_html5_fetch_response* respo
     }
 }
 
-EM_JS(void, fs_js_save_snapshot, (const char* system_name_cstr, int snapshot_index, void* bytes, int num_bytes), {
+EM_JS(void, fs_js_save_snapshot, (const char* system_name_cstr, int snapshot_index, void* bytes, int num_bytes, fs_snapshot_save_context_t* context), {
     const db_name = 'chips';
     const db_store_name = 'store';
     const system_name = UTF8ToString(system_name_cstr);
@@ -319,6 +368,7 @@ EM_JS(void, fs_js_save_snapshot, (const char* system_name_cstr, int snapshot_ind
         open_request = window.indexedDB.open(db_name, 1);
     } catch (e) {
         console.log('fs_js_save_snapshot: failed to open IndexedDB with ' + e);
+        _fs_emsc_save_snapshot_callback(context, 0);
         return;
     }
     open_request.onupgradeneeded = () => {
@@ -336,9 +386,11 @@ EM_JS(void, fs_js_save_snapshot, (const char* system_name_cstr, int snapshot_ind
         const put_request = file.put(blob, key);
         put_request.onsuccess = () => {
             console.log('fs_js_save_snapshot:', key, 'successfully stored')
+            _fs_emsc_save_snapshot_callback(context, 1);
         };
         put_request.onerror = () => {
             console.log('fs_js_save_snapshot: FAILED to store', key);
+            _fs_emsc_save_snapshot_callback(context, 0);
         };
         transaction.onerror = () => {
             console.log('fs_js_save_snapshot: transaction onerror');
@@ -346,6 +398,7 @@ EM_JS(void, fs_js_save_snapshot, (const char* system_name_cstr, int snapshot_ind
     };
     open_request.onerror = () => {
         console.log('fs_js_save_snapshot: open_request onerror');
+        _fs_emsc_save_snapshot_callback(context, 0);
     }
 });
 
@@ -399,12 +452,33 @@ EM_JS(void, fs_js_load_snapshot, (const char* system_name_cstr, int snapshot_ind
     }
 });
 
-bool fs_emsc_save_snapshot(const char* system_name, size_t snapshot_index, chips_range_t data) {
+EMSCRIPTEN_KEEPALIVE void fs_emsc_save_snapshot_callback(fs_snapshot_save_context_t* ctx, int succeeded) {
+    if (ctx->callback) {
+        ctx->callback(&(fs_snapshot_response_t){
+            .snapshot_index = ctx->snapshot_index,
+            .result = succeeded ? FS_RESULT_SUCCESS : FS_RESULT_FAILED,
+        });
+    }
+    free(ctx->data);
+    free(ctx);
+}
+
+// IndexedDB requests are asynchronous already, the data is kept alive until the request completes
+bool fs_emsc_save_snapshot_async(const char* system_name, size_t snapshot_index, chips_range_t data, fs_snapshot_save_callback_t callback) {
     assert(system_name && data.ptr && data.size > 0);
-    fs_js_save_snapshot(system_name, (int)snapshot_index, data.ptr, data.size);
+    fs_snapshot_save_context_t* context = calloc(1, sizeof(fs_snapshot_save_context_t));
+    context->snapshot_index = snapshot_index;
+    context->callback = callback;
+    context->data = malloc(data.size);
+    memcpy(context->data, data.ptr, data.size);
+    fs_js_save_snapshot(system_name, (int)snapshot_index, context->data, (int)data.size, context);
     return true;
 }
 
+static void fs_writer_init(void) { }
+static void fs_writer_dowork(void) { }
+static void fs_writer_shutdown(void) { }
+
 EMSCRIPTEN_KEEPALIVE void* fs_emsc_alloc(int size) {
     return malloc((size_t)size);
 }
@@ -490,12 +564,136 @@ static bool fs_win32_posix_write_file(fs_path_t path, chips_range_t data) {
         if (!fp) {
             return false;
         }
-        fwrite(data.ptr, data.size, 1, fp);
-        fclose(fp);
+        bool ok = (data.size == 0) || (fwrite(data.ptr, data.size, 1, fp) == 1);
+        ok = (0 == fclose(fp)) && ok;
+        if (!ok) {
+            return false;
+        }
     #endif
     return true;
 }
 
+static void fs_write_list_push(fs_write_list_t* list, fs_write_job_t* job) {
+    job->next = 0;
+    if (list->tail) {
+        list->tail->next = job;
+    }
+    else {
+        list->head = job;
+    }
+    list->tail = job;
+}
+
+static void fs_writer_thread(void* arg) {
+    fs_writer_t* writer = (fs_writer_t*)arg;
+    trace_thread_name("fs writer");
+    thread_mutex_lock(&writer->mutex);
+    while (true) {
+        fs_write_job_t* job = writer->pending.head;
+        if (job) {
+            writer->pending.head = job->next;
+            if (!writer->pending.head) {
+                writer->pending.tail = 0;
+            }
+            thread_mutex_unlock(&writer->mutex);
+            const uint64_t start = trace_begin();
+            const bool ok = fs_win32_posix_write_file(job->path, (chips_range_t){ .ptr = job->data, .size = job->size });
+            trace_end("fs write", start);
+            job->result = ok ? FS_RESULT_SUCCESS : FS_RESULT_FAILED;
+            thread_mutex_lock(&writer->mutex);
+            fs_write_list_push(&writer->done, job);
+        }
+        else if (writer->quit) {
+            break;
+        }
+        else {
+            thread_cond_wait(&writer->cond, &writer->mutex);
+        }
+    }
+    thread_mutex_unlock(&writer->mutex);
+}
+
+static void fs_writer_init(void) {
+    fs_writer_t* writer = &state.writer;
+    if (thread_mutex_init(&writer->mutex) && thread_cond_init(&writer->cond)) {
+        writer->threaded = thread_start(&writer->thread, fs_writer_thread, writer);
+    }
+}
+
+// queue a write, may be called from any thread
+static bool fs_writer_push(fs_path_t path, chips_range_t data, size_t snapshot_index, fs_snapshot_save_callback_t callback) {
+    if (path.clamped) {
+        return false;
+    }
+    fs_write_job_t* job = malloc(sizeof(fs_write_job_t) + data.size);
+    if (!job) {
+        return false;
+    }
+    job->path = path;
+    job->snapshot_index = snapshot_index;
+    job->callback = callback;
+    job->result = FS_RESULT_PENDING;
+    job->size = data.size;
+    memcpy(job->data, data.ptr, data.size);
+    fs_writer_t* writer = &state.writer;
+    if (!writer->threaded) {
+        // no thread, write right away and report in fs_dowork() like a queued write
+        job->result = fs_win32_posix_write_file(job->path, data) ? FS_RESULT_SUCCESS : FS_RESULT_FAILED;
+    }
+    thread_mutex_lock(&writer->mutex);
+    if (writer->threaded) {
+        fs_write_list_push(&writer->pending, job);
+        thread_cond_signal(&writer->cond);
+    }
+    else {
+        fs_write_list_push(&writer->done, job);
+    }
+    thread_mutex_unlock(&writer->mutex);
+    return true;
+}
+
+// call the callbacks of completed writes, on the frame thread
+static void fs_writer_dowork(void) {
+    fs_writer_t* writer = &state.writer;
+    thread_mutex_lock(&writer->mutex);
+    fs_write_job_t* job = writer->done.head;
+    writer->done = (fs_write_list_t){0};
+    thread_mutex_unlock(&writer->mutex);
+    while (job) {
+        fs_write_job_t* next = job->next;
+        if (job->callback) {
+            job->callback(&(fs_snapshot_response_t){
+                .snapshot_index = job->snapshot_index,
+                .result = job->result,
+            });
+        }
+        free(job);
+        job = next;
+    }
+}
+
+static void fs_writer_shutdown(void) {
+    fs_writer_t* writer = &state.writer;
+    if (writer->threaded) {
+        // the thread finishes the pending writes first
+        thread_mutex_lock(&writer->mutex);
+        writer->quit = true;
+        thread_cond_signal(&writer->cond);
+        thread_mutex_unlock(&writer->mutex);
+        thread_join(&writer->thread);
+        writer->threaded = false;
+    }
+    fs_write_job_t* job = writer->done.head;
+    while (job) {
+        fs_write_job_t* next = job->next;
+        free(job);
+        job = next;
+    }
+    writer->done = (fs_write_list_t){0};
+    thread_cond_discard(&writer->cond);
+    thread_mutex_discard(&writer->mutex);
+}
+
 // NOTE: free the returned range.ptr with free(ptr)
 static chips_range_t fs_win32_posix_read_file(fs_path_t path, bool null_terminated) {
     if (path.clamped) {
@@ -569,9 +767,10 @@ fs_path_t fs_win32_posix_make_ini_path(const char* key) {
     return fs_path_printf("%s/%s_imgui.ini", tmp_dir.cstr, key);
 }
 
-bool fs_win32_posix_save_snapshot(const char* system_name, size_t snapshot_index, chips_range_t data) {
+bool fs_win32_posix_save_snapshot_async(const char* system_name, size_t snapshot_index, chips_range_t data, fs_snapshot_save_callback_t callback) {
+    assert(system_name && data.ptr);
     fs_path_t path = fs_win32_posix_make_snapshot_path(system_name, snapshot_index);
-    return fs_win32_posix_write_file(path, data);
+    return fs_writer_push(path, data, snapshot_index, callback);
 }
 
 bool fs_win32_posix_load_snapshot_async(const char* system_name, size_t snapshot_index, fs_snapshot_load_callback_t callback) {
@@ -633,11 +832,11 @@ void fs_load_dropped_file_async(fs_channel_t chn) {
     #endif
 }
 
-bool fs_save_snapshot(const char* system_name, size_t snapshot_index, chips_range_t data) {
+bool fs_save_snapshot_async(const char* system_name, size_t snapshot_index, chips_range_t data, fs_snapshot_save_callback_t callback) {
     #if defined(__EMSCRIPTEN__)
-    return fs_emsc_save_snapshot(system_name, snapshot_index, data);
+    return fs_emsc_save_snapshot_async(system_name, snapshot_index, data, callback);
     #else
-    return fs_win32_posix_save_snapshot(system_name, snapshot_index, data);
+    return fs_win32_posix_save_snapshot_async(system_name, snapshot_index, data, callback);
     #endif
 }
 
@@ -656,7 +855,7 @@ void fs_save_ini(const char* key, const char* payload) {
     #else
     fs_path_t path = fs_win32_posix_make_ini_path(key);
     chips_range_t data = { .ptr = (void*)payload, .size = strlen(payload) };
-    fs_win32_posix_write_file(path, data);
+    fs_writer_push(path, data, 0, 0);
     #endif
 }
 
@@ -28,14 +28,19 @@ typedef struct {
 } fs_snapshot_response_t;
 
 typedef void (*fs_snapshot_load_callback_t)(const fs_snapshot_response_t* response);
+// the response of a save has no data
+typedef void (*fs_snapshot_save_callback_t)(const fs_snapshot_response_t* response);
 
 void fs_init(void);
 void fs_dowork(void);
+// wait for pending writes, their callbacks are not called anymore
+void fs_shutdown(void);
 void fs_reset(fs_channel_t chn);
 void fs_load_file_async(fs_channel_t chn, const char* path);
 void fs_load_dropped_file_async(fs_channel_t chn);
 bool fs_load_base64(fs_channel_t chn, const char* name, const char* payload);
-bool fs_save_snapshot(const char* system_name, size_t snapshot_index, chips_range_t data);
+// data is copied, the file is written in the background, callback (optional) is called from fs_dowork()
+bool fs_save_snapshot_async(const char* system_name, size_t snapshot_index, chips_range_t data, fs_snapshot_save_callback_t callback);
 bool fs_load_snapshot_async(const char* system_name, size_t snapshot_index, fs_snapshot_load_callback_t callback);
 fs_result_t fs_result(fs_channel_t chn);
 bool fs_success(fs_channel_t chn);
@@ -14,6 +14,7 @@
 #include <string.h>
 
 #define GFX_DEF(v,def) (v?v:def)
+#define GFX_STRIP_WIDTH (16)    // max number of columns uploaded through the strip texture
 
 typedef struct {
     bool valid;
@@ -25,7 +26,23 @@ typedef struct {
         sg_sampler smp;
         chips_dim_t dim;
         bool paletted;
+        int scroll_x;       // framebuffer column shown at the left edge
     } fb;
+    // column update mode, fb.img is a render target and only changed columns are uploaded
+    struct {
+        bool requested;
+        bool enabled;       // false if R8 isn't renderable, then fall back to full uploads
+        bool full_update;   // all columns need to be uploaded
+        int x;              // first changed column
+        int num;            // number of changed columns since last gfx_draw()
+        sg_image strip_img; // GFX_STRIP_WIDTH columns, for the common case
+        sg_image full_img;  // whole framebuffer, for large updates
+        sg_buffer vbuf;
+        sg_pipeline pip;
+        sg_attachments attachments;
+        sg_pass_action pass_action;
+        uint8_t* strip_data;
+    } columns;
     struct {
         chips_rect_t view;
         chips_dim_t pixel_aspect;
@@ -79,6 +96,14 @@ static const float gfx_verts_flipped_rot[] = {
     1.0f, 1.0f, 0.0f, 0.0f
 };
 
+// vertices for render-to-texture passes that must not flip the image vertically
+static sg_range gfx_select_copy_vertices(void) {
+    return (sg_range){
+        .ptr = sg_query_features().origin_top_left ? gfx_verts_flipped : gfx_verts,
+        .size = sizeof(gfx_verts),
+    };
+}
+
 static sg_range gfx_select_vertices(void) {
     return (sg_range){
         .ptr = sg_query_features().origin_top_left ?
@@ -215,21 +240,58 @@ static void gfx_init_images_and_pass(void) {
     sg_destroy_image(state.offscreen.img);
     sg_destroy_sampler(state.offscreen.smp);
     sg_destroy_attachments(state.offscreen.attachments);
+    sg_destroy_image(state.columns.strip_img);
+    sg_destroy_image(state.columns.full_img);
+    sg_destroy_attachments(state.columns.attachments);
+    free(state.columns.strip_data);
+    state.columns.strip_data = 0;
 
-    // a texture with the emulator's raw pixel data
     assert((state.fb.dim.width > 0) && (state.fb.dim.height > 0));
-    state.fb.img = sg_make_image(&(sg_image_desc){
-        .width = state.fb.dim.width,
-        .height = state.fb.dim.height,
-        .pixel_format = state.fb.paletted ? SG_PIXELFORMAT_R8 : SG_PIXELFORMAT_RGBA8,
-        .usage = SG_USAGE_STREAM,
-    });
+    if (state.columns.enabled) {
+        // the emulator's raw pixel data lives in a render target, changed
+        // columns are uploaded to a small strip texture and drawn into it
+        state.fb.img = sg_make_image(&(sg_image_desc){
+            .render_target = true,
+            .width = state.fb.dim.width,
+            .height = state.fb.dim.height,
+            .pixel_format = SG_PIXELFORMAT_R8,
+            .sample_count = 1,
+        });
+        state.columns.attachments = sg_make_attachments(&(sg_attachments_desc){
+            .colors[0].image = state.fb.img
+        });
+        state.columns.strip_img = sg_make_image(&(sg_image_desc){
+            .width = GFX_STRIP_WIDTH,
+            .height = state.fb.dim.height,
+            .pixel_format = SG_PIXELFORMAT_R8,
+            .usage = SG_USAGE_STREAM,
+        });
+        state.columns.full_img = sg_make_image(&(sg_image_desc){
+            .width = state.fb.dim.width,
+            .height = state.fb.dim.height,
+            .pixel_format = SG_PIXELFORMAT_R8,
+            .usage = SG_USAGE_STREAM,
+        });
+        state.columns.strip_data = malloc(GFX_STRIP_WIDTH * state.fb.dim.height);
+        assert(state.columns.strip_data);
+    }
+    else {
+        // a texture with the emulator's raw pixel data
+        state.fb.img = sg_make_image(&(sg_image_desc){
+            .width = state.fb.dim.width,
+            .height = state.fb.dim.height,
+            .pixel_format = state.fb.paletted ? SG_PIXELFORMAT_R8 : SG_PIXELFORMAT_RGBA8,
+            .usage = SG_USAGE_STREAM,
+        });
+    }
+    state.columns.full_update = true;
+    state.columns.num = 0;
 
-    // a sampler for sampling the emulators raw pixel data
+    // a sampler for sampling the emulators raw pixel data, repeats horizontally for gfx_scroll()
     state.fb.smp = sg_make_sampler(&(sg_sampler_desc){
         .min_filter = SG_FILTER_NEAREST,
         .mag_filter = SG_FILTER_NEAREST,
-        .wrap_u = SG_WRAP_CLAMP_TO_EDGE,
+        .wrap_u = SG_WRAP_REPEAT,
         .wrap_v = SG_WRAP_CLAMP_TO_EDGE
     });
 
@@ -258,7 +320,7 @@ void gfx_init(const gfx_desc_t* desc) {
         .image_pool_size = 128,
         .shader_pool_size = 16,
         .pipeline_pool_size = 16,
-        .attachments_pool_size = 2,
+        .attachments_pool_size = 4,
         .environment = sglue_environment(),
         .logger.func = slog_func,
     });
@@ -286,6 +348,8 @@ void gfx_init(const gfx_desc_t* desc) {
     state.offscreen.pixel_aspect.width = GFX_DEF(desc->pixel_aspect.width, 1);
     state.offscreen.pixel_aspect.height = GFX_DEF(desc->pixel_aspect.height, 1);
     state.offscreen.view = desc->display_info.screen;
+    state.columns.requested = desc->column_updates;
+    state.columns.enabled = desc->column_updates && state.fb.paletted && sg_query_pixelformat(SG_PIXELFORMAT_R8).render;
 
     if (state.fb.paletted) {
         static uint32_t palette_buf[256];
@@ -330,6 +394,29 @@ void gfx_init(const gfx_desc_t* desc) {
         .depth.pixel_format = SG_PIXELFORMAT_NONE
     });
 
+    // pipeline for drawing uploaded columns into the framebuffer render target
+    if (state.columns.enabled) {
+        state.columns.pass_action = (sg_pass_action) {
+            .colors[0] = { .load_action = SG_LOADACTION_LOAD }
+        };
+        state.columns.vbuf = sg_make_buffer(&(sg_buffer_desc){
+            .data = gfx_select_copy_vertices(),
+        });
+        state.columns.pip = sg_make_pipeline(&(sg_pipeline_desc){
+            .shader = sg_make_shader(offscreen_shader_desc(sg_query_backend())),
+            .layout = {
+                .attrs = {
+                    [0].format = SG_VERTEXFORMAT_FLOAT2,
+                    [1].format = SG_VERTEXFORMAT_FLOAT2
+                }
+            },
+            .primitive_type = SG_PRIMITIVETYPE_TRIANGLE_STRIP,
+            .colors[0].pixel_format = SG_PIXELFORMAT_R8,
+            .depth.pixel_format = SG_PIXELFORMAT_NONE,
+            .sample_count = 1,
+        });
+    }
+
     state.display.pass_action = (sg_pass_action) {
         .colors[0] = { .load_action = SG_LOADACTION_CLEAR, .clear_value = { 0.05f, 0.05f, 0.05f, 1.0f } }
     };
@@ -382,6 +469,104 @@ void gfx_init(const gfx_desc_t* desc) {
     gfx_init_images_and_pass();
 }
 
+void gfx_update_columns(int x, int num_columns) {
+    assert(state.valid);
+    const int w = state.fb.dim.width;
+    assert((x >= 0) && (x < w) && (num_columns >= 0));
+    if (num_columns == 0) {
+        return;
+    }
+    if (state.columns.num == 0) {
+        state.columns.x = x;
+        state.columns.num = num_columns;
+    }
+    else if (x == (state.columns.x + state.columns.num) % w) {
+        // the usual case: columns are appended to the previous ones
+        state.columns.num += num_columns;
+    }
+    else {
+        state.columns.full_update = true;
+    }
+    if (state.columns.num > GFX_STRIP_WIDTH) {
+        state.columns.full_update = true;
+    }
+}
+
+void gfx_update_all_columns(void) {
+    assert(state.valid);
+    state.columns.full_update = true;
+}
+
+void gfx_scroll(int x) {
+    assert(state.valid);
+    state.fb.scroll_x = x;
+}
+
+// upload changed columns to the strip texture and draw them into the framebuffer render target
+static void gfx_upload_columns(chips_display_info_t display_info) {
+    const int w = state.fb.dim.width;
+    const int h = state.fb.dim.height;
+    const uint8_t* pixels = display_info.frame.buffer.ptr;
+    sg_image src_img;
+    int src_width, x, num;
+    if (state.columns.full_update) {
+        sg_update_image(state.columns.full_img, &(sg_image_data){
+            .subimage[0][0] = {
+                .ptr = display_info.frame.buffer.ptr,
+                .size = display_info.frame.buffer.size,
+            }
+        });
+        src_img = state.columns.full_img;
+        src_width = w;
+        x = 0;
+        num = w;
+    }
+    else {
+        x = state.columns.x;
+        num = state.columns.num;
+        for (int y = 0; y < h; y++) {
+            uint8_t* dst = &state.columns.strip_data[y * GFX_STRIP_WIDTH];
+            const uint8_t* src = &pixels[y * w];
+            for (int i = 0; i < num; i++) {
+                dst[i] = src[(x + i) % w];
+            }
+        }
+        sg_update_image(state.columns.strip_img, &(sg_image_data){
+            .subimage[0][0] = {
+                .ptr = state.columns.strip_data,
+                .size = (size_t)(GFX_STRIP_WIDTH * h),
+            }
+        });
+        src_img = state.columns.strip_img;
+        src_width = GFX_STRIP_WIDTH;
+    }
+
+    sg_begin_pass(&(sg_pass){
+        .action = state.columns.pass_action,
+        .attachments = state.columns.attachments
+    });
+    sg_apply_pipeline(state.columns.pip);
+    sg_apply_bindings(&(sg_bindings){
+        .vertex_buffers[0] = state.columns.vbuf,
+        .images[IMG_fb_tex] = src_img,
+        .samplers[SMP_smp] = state.fb.smp,
+    });
+    // split at the right edge of the framebuffer
+    for (int done = 0; done < num;) {
+        const int dst_x = (x + done) % w;
+        const int n = (num - done < w - dst_x) ? (num - done) : (w - dst_x);
+        sg_apply_viewport(dst_x, 0, n, h, true);
+        const offscreen_vs_params_t vs_params = {
+            .uv_offset = { (float)done / (float)src_width, 0.0f },
+            .uv_scale = { (float)n / (float)src_width, 1.0f },
+        };
+        sg_apply_uniforms(UB_offscreen_vs_params, &SG_RANGE(vs_params));
+        sg_draw(0, 4, 1);
+        done += n;
+    }
+    sg_end_pass();
+}
+
 /* apply a viewport rectangle to preserve the emulator's aspect ratio,
    and for 'portrait' orientations, keep the emulator display at the
    top, to make room at the bottom for mobile virtual keyboard
@@ -451,13 +636,24 @@ void gfx_draw(chips_display_info_t display_info) {
         sgl_end();
     }
 
-    // copy emulator pixel data into emulator framebuffer texture
-    sg_update_image(state.fb.img, &(sg_image_data){
-        .subimage[0][0] = {
-            .ptr = display_info.frame.buffer.ptr,
-            .size = display_info.frame.buffer.size,
+    // copy emulator pixel data into emulator framebuffer texture,
+    // in column update mode only if something changed
+    const bool changed = state.columns.full_update || (state.columns.num > 0);
+    if (state.columns.enabled) {
+        if (changed) {
+            gfx_upload_columns(display_info);
         }
-    });
+    }
+    else if (!state.columns.requested || changed) {
+        sg_update_image(state.fb.img, &(sg_image_data){
+            .subimage[0][0] = {
+                .ptr = display_info.frame.buffer.ptr,
+                .size = display_info.frame.buffer.size,
+            }
+        });
+    }
+    state.columns.full_update = false;
+    state.columns.num = 0;
 
     // upscale the original framebuffer 2x with nearest filtering
     sg_begin_pass(&(sg_pass){
@@ -475,7 +671,7 @@ void gfx_draw(chips_display_info_t display_info) {
     });
     const offscreen_vs_params_t vs_params = {
         .uv_offset = {
-            (float)state.offscreen.view.x / (float)state.fb.dim.width,
+            (float)(state.offscreen.view.x + state.fb.scroll_x) / (float)state.fb.dim.width,
             (float)state.offscreen.view.y / (float)state.fb.dim.height,
         },
         .uv_scale = {
@@ -531,6 +727,8 @@ void gfx_draw(chips_display_info_t display_info) {
 
 void gfx_shutdown() {
     assert(state.valid);
+    free(state.columns.strip_data);
+    state.columns.strip_data = 0;
     sgl_shutdown();
     sdtx_shutdown();
     sg_shutdown();
@@ -5,6 +5,16 @@
     REMINDER: consider using this CRT shader?
 
     https://github.com/mattiasgustavsson/rebasic/blob/master/source/libs/crtemu.h
+
+    Column updates: for displays that only change a few framebuffer columns
+    per frame (like a scrolling spectrogram), set gfx_desc_t.column_updates
+    and report changed columns with gfx_update_columns(). gfx_draw() then
+    uploads just those columns through a small strip texture instead of the
+    whole framebuffer, and skips the upload entirely if nothing changed.
+    This requires a paletted (R8) framebuffer; if R8 is not renderable on
+    the backend, the whole framebuffer is uploaded whenever columns change.
+    gfx_scroll() rotates the displayed framebuffer horizontally, so it can
+    be used as a ring buffer.
 */
 #include <stdint.h>
 #include <stdbool.h>
@@ -34,6 +44,7 @@ typedef struct {
     chips_display_info_t display_info;
     chips_dim_t pixel_aspect;   // optional pixel aspect ratio, default is 1:1
     gfx_draw_extra_t draw_extra_cb;
+    bool column_updates;        // only upload columns reported via gfx_update_columns()
 } gfx_desc_t;
 
 void gfx_init(const gfx_desc_t* desc);
@@ -43,6 +54,12 @@ void gfx_flash_success(void);
 void gfx_flash_error(void);
 void gfx_disable_speaker_icon(void);
 chips_dim_t gfx_pixel_aspect(void);
+// mark framebuffer columns [x, x+num_columns) as changed, wraps around at the right edge
+void gfx_update_columns(int x, int num_columns);
+// mark the whole framebuffer as changed
+void gfx_update_all_columns(void);
+// show framebuffer column x at the left edge of the display
+void gfx_scroll(int x);
 sg_image gfx_create_icon_texture(const uint8_t* packed_pixels, int width, int height, int stride);
 
 #ifdef __cplusplus
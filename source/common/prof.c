@@ -3,8 +3,9 @@
 #include <assert.h>
 #include <string.h>
 #include <stdbool.h>
+#include <math.h>
 
-#define PROF_BUCKET_SIZE (128)
+#define PROF_BUCKET_SIZE (PROF_WINDOW_SIZE + 1)     // one slot stays free
 
 // a simple ring buffer struct
 typedef struct {
@@ -15,6 +16,7 @@ typedef struct {
 
 typedef struct {
     prof_ring_t ring;
+    int histogram[PROF_HISTOGRAM_BINS];
 } prof_bucket_t;
 
 typedef struct {
@@ -23,6 +25,18 @@ typedef struct {
 } prof_state_t;
 static prof_state_t state;
 
+static const char* prof_names[PROF_NUM_BUCKET_TYPES] = {
+    "frame",
+    "emu",
+    "sequencer",
+    "preview",
+    "sid update",
+    "sid ticks",
+    "fft",
+    "ui build",
+    "gfx draw",
+};
+
 static int prof_ring_idx(int i) {
     return (i % PROF_BUCKET_SIZE);
 }
@@ -36,18 +50,38 @@ static int prof_ring_count(const prof_ring_t* ring) {
     }
 }
 
-static void prof_ring_put(prof_ring_t* ring, float value) {
+// returns true and the dropped value if the ring was full
+static bool prof_ring_put(prof_ring_t* ring, float value, float* dropped) {
+    bool full = false;
     ring->values[ring->head] = value;
     ring->head = prof_ring_idx(ring->head + 1);
     if (ring->head == ring->tail) {
+        *dropped = ring->values[ring->tail];
         ring->tail = prof_ring_idx(ring->tail + 1);
+        full = true;
     }
+    return full;
 }
 
-static float prof_ring_get(prof_ring_t* ring, int index) {
+static float prof_ring_get(const prof_ring_t* ring, int index) {
     return ring->values[prof_ring_idx(ring->tail + index)];
 }
 
+// logarithmic bins, PROF_HISTOGRAM_BINS_PER_OCTAVE per doubling from 1 microsecond
+static int prof_histogram_bin(float ms) {
+    const float us = ms * 1000.0f;
+    if (us <= 1.0f) {
+        return 0;
+    }
+    const int bin = (int)ceilf(log2f(us) * PROF_HISTOGRAM_BINS_PER_OCTAVE);
+    return (bin < PROF_HISTOGRAM_BINS) ? bin : (PROF_HISTOGRAM_BINS - 1);
+}
+
+float prof_histogram_bin_limit(int bin) {
+    assert((bin >= 0) && (bin < PROF_HISTOGRAM_BINS));
+    return exp2f((float)bin / PROF_HISTOGRAM_BINS_PER_OCTAVE) * 0.001f;
+}
+
 void prof_init(void) {
     stm_setup();
     memset(&state, 0, sizeof(state));
@@ -57,7 +91,20 @@ void prof_init(void) {
 void prof_push(prof_bucket_type_t type, float val) {
     assert(state.valid);
     assert((type >= 0) && (type < PROF_NUM_BUCKET_TYPES));
-    prof_ring_put(&state.buckets[type].ring, val);
+    prof_bucket_t* bucket = &state.buckets[type];
+    float dropped = 0.0f;
+    if (prof_ring_put(&bucket->ring, val, &dropped)) {
+        bucket->histogram[prof_histogram_bin(dropped)]--;
+    }
+    bucket->histogram[prof_histogram_bin(val)]++;
+}
+
+uint64_t prof_begin(void) {
+    return stm_now();
+}
+
+void prof_end(prof_bucket_type_t type, uint64_t start) {
+    prof_push(type, (float)stm_ms(stm_since(start)));
 }
 
 int prof_count(prof_bucket_type_t type) {
@@ -77,10 +124,12 @@ prof_stats_t prof_stats(prof_bucket_type_t type) {
     assert((type >= 0) && (type < PROF_NUM_BUCKET_TYPES));
     prof_stats_t stats = {0};
     prof_ring_t* ring = &state.buckets[type].ring;
-    stats.count = prof_ring_count(ring);
+    const int count = prof_ring_count(ring);
+    const int first = (count > PROF_STATS_SIZE) ? (count - PROF_STATS_SIZE) : 0;
+    stats.count = count - first;
     if (stats.count > 0) {
         stats.min_val = 1000.0f;
-        for (int i = 0; i < stats.count; i++) {
+        for (int i = first; i < count; i++) {
             float val = prof_ring_get(ring, i);
             stats.avg_val += val;
             if (val < stats.min_val) {
@@ -94,3 +143,49 @@ prof_stats_t prof_stats(prof_bucket_type_t type) {
     }
     return stats;
 }
+
+prof_percentiles_t prof_percentiles(prof_bucket_type_t type) {
+    assert(state.valid);
+    assert((type >= 0) && (type < PROF_NUM_BUCKET_TYPES));
+    prof_percentiles_t res = {0};
+    const prof_bucket_t* bucket = &state.buckets[type];
+    res.count = prof_ring_count(&bucket->ring);
+    if (res.count == 0) {
+        return res;
+    }
+    for (int i = 0; i < res.count; i++) {
+        const float val = prof_ring_get(&bucket->ring, i);
+        if (val > res.max_val) {
+            res.max_val = val;
+        }
+    }
+    // the smallest bins that hold 50, 95 and 99 percent of the values,
+    // the last bin and the bin of the maximum end at the maximum
+    const int n50 = (res.count * 50 + 99) / 100;
+    const int n95 = (res.count * 95 + 99) / 100;
+    const int n99 = (res.count * 99 + 99) / 100;
+    int sum = 0;
+    for (int bin = 0; bin < PROF_HISTOGRAM_BINS; bin++) {
+        const int prev = sum;
+        sum += bucket->histogram[bin];
+        float limit = prof_histogram_bin_limit(bin);
+        if ((limit > res.max_val) || (bin == PROF_HISTOGRAM_BINS - 1)) {
+            limit = res.max_val;
+        }
+        if ((prev < n50) && (sum >= n50)) res.p50 = limit;
+        if ((prev < n95) && (sum >= n95)) res.p95 = limit;
+        if ((prev < n99) && (sum >= n99)) res.p99 = limit;
+    }
+    return res;
+}
+
+const int* prof_histogram(prof_bucket_type_t type) {
+    assert(state.valid);
+    assert((type >= 0) && (type < PROF_NUM_BUCKET_TYPES));
+    return state.buckets[type].histogram;
+}
+
+const char* prof_name(prof_bucket_type_t type) {
+    assert((type >= 0) && (type < PROF_NUM_BUCKET_TYPES));
+    return prof_names[type];
+}
@@ -1,9 +1,34 @@
+#pragma once
 /*
     A simple profiling helper module.
+
+    Every bucket keeps the last PROF_WINDOW_SIZE values (in milliseconds)
+    in a ring and a histogram of them with PROF_HISTOGRAM_BINS_PER_OCTAVE
+    logarithmic bins per doubling, starting at 1 microsecond. The histogram
+    is updated when a value enters or leaves the ring, so percentiles
+    cost the same for any window size, with a resolution of about 9%.
 */
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROF_WINDOW_SIZE (1024)             // values per bucket, about 17 seconds at 60 Hz
+#define PROF_STATS_SIZE (128)               // most recent values used by prof_stats()
+#define PROF_HISTOGRAM_BINS_PER_OCTAVE (8)
+#define PROF_HISTOGRAM_BINS (18 * PROF_HISTOGRAM_BINS_PER_OCTAVE)  // 1us .. 262ms, the last bin takes longer values
+
 typedef enum {
     PROF_FRAME,     // frame time
     PROF_EMU,       // emulator time
+    PROF_SEQUENCER, // sequencer_advance(), all steps of a frame
+    PROF_PREVIEW,   // sequencer_update_preview()
+    PROF_SID_UPDATE,// sequencer_update_sid(), all steps of a frame
+    PROF_SID_TICKS, // numbersid_exec(), all steps of a frame
+    PROF_FFT,       // spectrogram columns, all steps of a frame
+    PROF_UI,        // building the UI
+    PROF_GFX,       // gfx_draw(), including the UI
     PROF_NUM_BUCKET_TYPES,
 } prof_bucket_type_t;
 
@@ -14,13 +39,37 @@ typedef struct {
     float max_val;
 } prof_stats_t;
 
+typedef struct {
+    int count;
+    float p50;
+    float p95;
+    float p99;
+    float max_val;
+} prof_percentiles_t;
+
 // initialize profiling system
 void prof_init(void);
 // push a value into a profiler bucket
 void prof_push(prof_bucket_type_t type, float val);
+// start of a measurement, returns a sokol_time timestamp
+uint64_t prof_begin(void);
+// push the milliseconds since start into a bucket
+void prof_end(prof_bucket_type_t type, uint64_t start);
 // get number of values in profiler bucket
 int prof_count(prof_bucket_type_t type);
-// get a value from profiler bucket
+// get a value from profiler bucket, index 0 is the oldest
 float prof_value(prof_bucket_type_t type, int index);
-// get average value in bucket
+// get average, min and max of the last PROF_STATS_SIZE values
 prof_stats_t prof_stats(prof_bucket_type_t type);
+// get percentiles of all values in the bucket, upper bounds of their histogram bins
+prof_percentiles_t prof_percentiles(prof_bucket_type_t type);
+// get the histogram of a bucket, bin i counts values up to prof_histogram_bin_limit(i)
+const int* prof_histogram(prof_bucket_type_t type);
+// upper bound of a histogram bin in milliseconds
+float prof_histogram_bin_limit(int bin);
+// display name of a bucket
+const char* prof_name(prof_bucket_type_t type);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -33,7 +33,8 @@ in vec2 uv;
 out vec4 frag_color;
 void main() {
     float pix = texture(sampler2D(fb_tex, smp), uv).x;
-    frag_color = vec4(texture(sampler2D(pal_tex, smp), vec2(pix,0)).xyz, 1.0);
+    // sample the palette at texel centers, the sampler may repeat horizontally
+    frag_color = vec4(texture(sampler2D(pal_tex, smp), vec2((pix*255.0+0.5)/256.0,0)).xyz, 1.0);
 }
 @end
 
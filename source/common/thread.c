@@ -0,0 +1,367 @@
+#include "thread.h"
+#include <stdlib.h>
+#include <assert.h>
+#if defined(WIN32)
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+// the thread function and argument are tunneled through a heap allocated context
+typedef struct {
+    thread_func_t func;
+    void* arg;
+} thread_context_t;
+
+#if defined(WIN32)
+static DWORD WINAPI thread_win32_entry(LPVOID param) {
+    thread_context_t ctx = *(thread_context_t*)param;
+    free(param);
+    ctx.func(ctx.arg);
+    return 0;
+}
+#elif !defined(__EMSCRIPTEN__)
+static void* thread_posix_entry(void* param) {
+    thread_context_t ctx = *(thread_context_t*)param;
+    free(param);
+    ctx.func(ctx.arg);
+    return 0;
+}
+#endif
+
+bool thread_start(thread_t* thread, thread_func_t func, void* arg) {
+    assert(thread && func);
+    thread->handle = 0;
+    thread->valid = false;
+    #if defined(__EMSCRIPTEN__)
+        (void)arg;
+        return false;
+    #else
+        thread_context_t* ctx = calloc(1, sizeof(thread_context_t));
+        if (!ctx) {
+            return false;
+        }
+        ctx->func = func;
+        ctx->arg = arg;
+        #if defined(WIN32)
+            HANDLE h = CreateThread(NULL, 0, thread_win32_entry, ctx, 0, NULL);
+            if (h == NULL) {
+                free(ctx);
+                return false;
+            }
+            thread->handle = (uintptr_t)h;
+        #else
+            pthread_t t;
+            if (0 != pthread_create(&t, NULL, thread_posix_entry, ctx)) {
+                free(ctx);
+                return false;
+            }
+            thread->handle = (uintptr_t)t;
+        #endif
+        thread->valid = true;
+        return true;
+    #endif
+}
+
+void thread_join(thread_t* thread) {
+    assert(thread);
+    if (!thread->valid) {
+        return;
+    }
+    #if defined(WIN32)
+        WaitForSingleObject((HANDLE)thread->handle, INFINITE);
+        CloseHandle((HANDLE)thread->handle);
+    #elif !defined(__EMSCRIPTEN__)
+        pthread_join((pthread_t)thread->handle, NULL);
+    #endif
+    thread->handle = 0;
+    thread->valid = false;
+}
+
+int thread_num_cores(void) {
+    #if defined(WIN32)
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return (info.dwNumberOfProcessors > 0) ? (int)info.dwNumberOfProcessors : 1;
+    #elif defined(__EMSCRIPTEN__)
+        return 1;
+    #else
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        return (n > 0) ? (int)n : 1;
+    #endif
+}
+
+bool thread_mutex_init(thread_mutex_t* mutex) {
+    assert(mutex);
+    mutex->handle = 0;
+    #if defined(WIN32)
+        SRWLOCK* lock = calloc(1, sizeof(SRWLOCK));
+        if (!lock) {
+            return false;
+        }
+        InitializeSRWLock(lock);
+        mutex->handle = lock;
+    #elif !defined(__EMSCRIPTEN__)
+        pthread_mutex_t* m = calloc(1, sizeof(pthread_mutex_t));
+        if (!m) {
+            return false;
+        }
+        if (0 != pthread_mutex_init(m, NULL)) {
+            free(m);
+            return false;
+        }
+        mutex->handle = m;
+    #endif
+    return true;
+}
+
+void thread_mutex_discard(thread_mutex_t* mutex) {
+    assert(mutex);
+    if (!mutex->handle) {
+        return;
+    }
+    #if !defined(WIN32) && !defined(__EMSCRIPTEN__)
+        pthread_mutex_destroy((pthread_mutex_t*)mutex->handle);
+    #endif
+    free(mutex->handle);
+    mutex->handle = 0;
+}
+
+void thread_mutex_lock(thread_mutex_t* mutex) {
+    assert(mutex);
+    if (!mutex->handle) {
+        return;
+    }
+    #if defined(WIN32)
+        AcquireSRWLockExclusive((SRWLOCK*)mutex->handle);
+    #elif !defined(__EMSCRIPTEN__)
+        pthread_mutex_lock((pthread_mutex_t*)mutex->handle);
+    #endif
+}
+
+void thread_mutex_unlock(thread_mutex_t* mutex) {
+    assert(mutex);
+    if (!mutex->handle) {
+        return;
+    }
+    #if defined(WIN32)
+        ReleaseSRWLockExclusive((SRWLOCK*)mutex->handle);
+    #elif !defined(__EMSCRIPTEN__)
+        pthread_mutex_unlock((pthread_mutex_t*)mutex->handle);
+    #endif
+}
+
+bool thread_cond_init(thread_cond_t* cond) {
+    assert(cond);
+    cond->handle = 0;
+    #if defined(WIN32)
+        CONDITION_VARIABLE* c = calloc(1, sizeof(CONDITION_VARIABLE));
+        if (!c) {
+            return false;
+        }
+        InitializeConditionVariable(c);
+        cond->handle = c;
+    #elif !defined(__EMSCRIPTEN__)
+        pthread_cond_t* c = calloc(1, sizeof(pthread_cond_t));
+        if (!c) {
+            return false;
+        }
+        if (0 != pthread_cond_init(c, NULL)) {
+            free(c);
+            return false;
+        }
+        cond->handle = c;
+    #endif
+    return true;
+}
+
+void thread_cond_discard(thread_cond_t* cond) {
+    assert(cond);
+    if (!cond->handle) {
+        return;
+    }
+    #if !defined(WIN32) && !defined(__EMSCRIPTEN__)
+        pthread_cond_destroy((pthread_cond_t*)cond->handle);
+    #endif
+    free(cond->handle);
+    cond->handle = 0;
+}
+
+void thread_cond_wait(thread_cond_t* cond, thread_mutex_t* mutex) {
+    assert(cond && mutex);
+    if (!cond->handle || !mutex->handle) {
+        return;
+    }
+    #if defined(WIN32)
+        SleepConditionVariableSRW((CONDITION_VARIABLE*)cond->handle, (SRWLOCK*)mutex->handle, INFINITE, 0);
+    #elif !defined(__EMSCRIPTEN__)
+        pthread_cond_wait((pthread_cond_t*)cond->handle, (pthread_mutex_t*)mutex->handle);
+    #endif
+}
+
+void thread_cond_signal(thread_cond_t* cond) {
+    assert(cond);
+    if (!cond->handle) {
+        return;
+    }
+    #if defined(WIN32)
+        WakeConditionVariable((CONDITION_VARIABLE*)cond->handle);
+    #elif !defined(__EMSCRIPTEN__)
+        pthread_cond_signal((pthread_cond_t*)cond->handle);
+    #endif
+}
+
+uint32_t thread_atomic_load(const volatile uint32_t* ptr) {
+    assert(ptr);
+    #if defined(WIN32)
+        return (uint32_t)InterlockedCompareExchange((volatile LONG*)ptr, 0, 0);
+    #else
+        return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+    #endif
+}
+
+void thread_atomic_store(volatile uint32_t* ptr, uint32_t value) {
+    assert(ptr);
+    #if defined(WIN32)
+        InterlockedExchange((volatile LONG*)ptr, (LONG)value);
+    #else
+        __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+    #endif
+}
+
+uint32_t thread_atomic_add(volatile uint32_t* ptr, uint32_t value) {
+    assert(ptr);
+    #if defined(WIN32)
+        return (uint32_t)InterlockedExchangeAdd((volatile LONG*)ptr, (LONG)value);
+    #else
+        return __atomic_fetch_add(ptr, value, __ATOMIC_ACQ_REL);
+    #endif
+}
+
+uint32_t thread_atomic_exchange(volatile uint32_t* ptr, uint32_t value) {
+    assert(ptr);
+    #if defined(WIN32)
+        return (uint32_t)InterlockedExchange((volatile LONG*)ptr, (LONG)value);
+    #else
+        return __atomic_exchange_n(ptr, value, __ATOMIC_ACQ_REL);
+    #endif
+}
+
+void thread_atomic_fence(void) {
+    #if defined(WIN32)
+        MemoryBarrier();
+    #else
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    #endif
+}
+
+void thread_tribuf_init(thread_tribuf_t* tribuf) {
+    assert(tribuf);
+    tribuf->write_index = 0;
+    tribuf->shared = 1;
+    tribuf->read_index = 2;
+}
+
+int thread_tribuf_write_index(const thread_tribuf_t* tribuf) {
+    assert(tribuf);
+    return tribuf->write_index;
+}
+
+void thread_tribuf_publish(thread_tribuf_t* tribuf) {
+    assert(tribuf);
+    // the release orders the writes to the buffer before the swap
+    const uint32_t prev = thread_atomic_exchange(&tribuf->shared, (uint32_t)tribuf->write_index | THREAD_TRIBUF_FRESH);
+    tribuf->write_index = (int)(prev & 3);
+}
+
+bool thread_tribuf_acquire(thread_tribuf_t* tribuf) {
+    assert(tribuf);
+    if (0 == (thread_atomic_load(&tribuf->shared) & THREAD_TRIBUF_FRESH)) {
+        return false;
+    }
+    const uint32_t prev = thread_atomic_exchange(&tribuf->shared, (uint32_t)tribuf->read_index);
+    tribuf->read_index = (int)(prev & 3);
+    return true;
+}
+
+int thread_tribuf_read_index(const thread_tribuf_t* tribuf) {
+    assert(tribuf);
+    return tribuf->read_index;
+}
+
+void thread_spsc_init(thread_spsc_t* queue, uint32_t capacity) {
+    assert(queue && (capacity > 0) && (0 == (capacity & (capacity - 1))));
+    queue->head = 0;
+    queue->tail = 0;
+    queue->capacity = capacity;
+}
+
+int thread_spsc_write_index(const thread_spsc_t* queue) {
+    assert(queue);
+    // the counters wrap, their difference is the number of items
+    const uint32_t head = queue->head;
+    if ((head - thread_atomic_load(&queue->tail)) >= queue->capacity) {
+        return -1;
+    }
+    return (int)(head & (queue->capacity - 1));
+}
+
+void thread_spsc_push(thread_spsc_t* queue) {
+    assert(queue);
+    // the release orders the writes to the item before the push
+    thread_atomic_store(&queue->head, queue->head + 1);
+}
+
+int thread_spsc_read_index(const thread_spsc_t* queue) {
+    assert(queue);
+    const uint32_t tail = queue->tail;
+    if (thread_atomic_load(&queue->head) == tail) {
+        return -1;
+    }
+    return (int)(tail & (queue->capacity - 1));
+}
+
+void thread_spsc_pop(thread_spsc_t* queue) {
+    assert(queue);
+    // the release orders the reads of the item before the producer reuses it
+    thread_atomic_store(&queue->tail, queue->tail + 1);
+}
+
+bool thread_event_init(thread_event_t* event) {
+    assert(event);
+    event->signaled = false;
+    if (!thread_mutex_init(&event->mutex)) {
+        return false;
+    }
+    if (!thread_cond_init(&event->cond)) {
+        thread_mutex_discard(&event->mutex);
+        return false;
+    }
+    return true;
+}
+
+void thread_event_discard(thread_event_t* event) {
+    assert(event);
+    thread_cond_discard(&event->cond);
+    thread_mutex_discard(&event->mutex);
+}
+
+void thread_event_signal(thread_event_t* event) {
+    assert(event);
+    thread_mutex_lock(&event->mutex);
+    event->signaled = true;
+    thread_cond_signal(&event->cond);
+    thread_mutex_unlock(&event->mutex);
+}
+
+void thread_event_wait(thread_event_t* event) {
+    assert(event);
+    thread_mutex_lock(&event->mutex);
+    // without thread support the wait returns at once, don't spin
+    while (!event->signaled && event->cond.handle && event->mutex.handle) {
+        thread_cond_wait(&event->cond, &event->mutex);
+    }
+    event->signaled = false;
+    thread_mutex_unlock(&event->mutex);
+}
@@ -0,0 +1,134 @@
+#pragma once
+/*
+    Minimal portable threading helpers (pthreads or Win32 threads).
+
+    On platforms without thread support (emscripten) thread_start()
+    returns false, callers are expected to do the work inline instead.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// storage class of variables with one instance per thread
+#if defined(_MSC_VER)
+    #define THREAD_LOCAL __declspec(thread)
+#elif defined(__cplusplus)
+    #define THREAD_LOCAL thread_local
+#else
+    #define THREAD_LOCAL _Thread_local
+#endif
+
+typedef void (*thread_func_t)(void* arg);
+
+typedef struct {
+    uintptr_t handle;
+    bool valid;
+} thread_t;
+
+// mutex and condition variable, heap allocated
+typedef struct {
+    void* handle;
+} thread_mutex_t;
+
+typedef struct {
+    void* handle;
+} thread_cond_t;
+
+// start a new thread running func(arg), returns false if no thread could be started
+bool thread_start(thread_t* thread, thread_func_t func, void* arg);
+// wait for a thread started with thread_start() to finish
+void thread_join(thread_t* thread);
+// number of logical CPU cores (at least 1)
+int thread_num_cores(void);
+
+// without thread support the mutex and condition variable functions do nothing
+bool thread_mutex_init(thread_mutex_t* mutex);
+void thread_mutex_discard(thread_mutex_t* mutex);
+void thread_mutex_lock(thread_mutex_t* mutex);
+void thread_mutex_unlock(thread_mutex_t* mutex);
+bool thread_cond_init(thread_cond_t* cond);
+void thread_cond_discard(thread_cond_t* cond);
+// wait for a signal, the mutex must be locked and is locked again on return
+void thread_cond_wait(thread_cond_t* cond, thread_mutex_t* mutex);
+void thread_cond_signal(thread_cond_t* cond);
+
+// atomic access to a 32-bit value shared between threads, loads acquire and stores release
+uint32_t thread_atomic_load(const volatile uint32_t* ptr);
+void thread_atomic_store(volatile uint32_t* ptr, uint32_t value);
+// add to a value, returns the value before the addition
+uint32_t thread_atomic_add(volatile uint32_t* ptr, uint32_t value);
+// replace a value, returns the value before, with acquire and release semantics
+uint32_t thread_atomic_exchange(volatile uint32_t* ptr, uint32_t value);
+// full memory barrier, orders all loads and stores before and after it
+void thread_atomic_fence(void);
+
+/*
+    Lock-free triple buffer indices, for one writer and one reader thread.
+    The caller keeps three buffers, the writer fills the one at
+    thread_tribuf_write_index() and publishes it, the reader acquires the
+    latest published one and reads it at thread_tribuf_read_index(). Both
+    sides always own a buffer of their own, neither ever waits, and the
+    reader sees whole buffers only. Buffers published while the reader
+    didn't acquire are dropped, only the latest one is kept.
+*/
+typedef struct {
+    volatile uint32_t shared;           // index of the middle buffer, THREAD_TRIBUF_FRESH if it wasn't acquired yet
+    int write_index;                    // writer only
+    int read_index;                     // reader only
+} thread_tribuf_t;
+
+#define THREAD_TRIBUF_FRESH (4)
+
+void thread_tribuf_init(thread_tribuf_t* tribuf);
+// writer: index of the buffer to fill
+int thread_tribuf_write_index(const thread_tribuf_t* tribuf);
+// writer: publish the filled buffer, the write index moves to another buffer
+void thread_tribuf_publish(thread_tribuf_t* tribuf);
+// reader: move to the latest published buffer, returns false if nothing new was published
+bool thread_tribuf_acquire(thread_tribuf_t* tribuf);
+// reader: index of the buffer to read, initially a buffer that wasn't written
+int thread_tribuf_read_index(const thread_tribuf_t* tribuf);
+
+/*
+    Lock-free queue indices, for one producer and one consumer thread.
+    The caller keeps an array of items, the producer fills the one at
+    thread_spsc_write_index() and pushes it, the consumer reads the one
+    at thread_spsc_read_index() and pops it. Nothing is dropped, a full
+    queue refuses the next item instead, the producer decides what to do.
+*/
+typedef struct {
+    volatile uint32_t head;             // items pushed, written by the producer only
+    volatile uint32_t tail;             // items popped, written by the consumer only
+    uint32_t capacity;
+} thread_spsc_t;
+
+// the capacity must be a power of two
+void thread_spsc_init(thread_spsc_t* queue, uint32_t capacity);
+// producer: index of the item to fill, -1 if the queue is full
+int thread_spsc_write_index(const thread_spsc_t* queue);
+// producer: append the filled item
+void thread_spsc_push(thread_spsc_t* queue);
+// consumer: index of the oldest item, -1 if the queue is empty
+int thread_spsc_read_index(const thread_spsc_t* queue);
+// consumer: remove the oldest item
+void thread_spsc_pop(thread_spsc_t* queue);
+
+// wakes up a waiting thread, a signal without a waiter is kept for the next wait
+typedef struct {
+    thread_mutex_t mutex;
+    thread_cond_t cond;
+    bool signaled;                      // guarded by mutex
+} thread_event_t;
+
+bool thread_event_init(thread_event_t* event);
+void thread_event_discard(thread_event_t* event);
+void thread_event_signal(thread_event_t* event);
+// wait for a signal and clear it, returns at once without thread support
+void thread_event_wait(thread_event_t* event);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
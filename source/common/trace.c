@@ -0,0 +1,143 @@
+#include "sokol_time.h"
+#include "thread.h"
+#include "trace.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+} trace_event_t;
+
+// written by one thread only, count is published with a release store
+typedef struct {
+    volatile uint32_t count;        // events recorded, the ring holds the last TRACE_MAX_EVENTS
+    const char* name;
+    trace_event_t events[TRACE_MAX_EVENTS];
+} trace_buffer_t;
+
+typedef struct {
+    bool valid;
+    uint64_t start_time;            // time 0 of the trace
+    volatile uint32_t num_threads;  // buffers claimed, may exceed TRACE_MAX_THREADS
+    trace_buffer_t* buffers;
+} trace_state_t;
+static trace_state_t state;
+
+// buffer of this thread plus one, 0: not claimed yet
+static THREAD_LOCAL uint32_t trace_thread_slot;
+
+static trace_buffer_t* trace_thread_buffer(void) {
+    if (trace_thread_slot == 0) {
+        trace_thread_slot = thread_atomic_add(&state.num_threads, 1) + 1;
+    }
+    if (trace_thread_slot > TRACE_MAX_THREADS) {
+        return 0;
+    }
+    return &state.buffers[trace_thread_slot - 1];
+}
+
+void trace_init(bool enabled) {
+    stm_setup();
+    memset(&state, 0, sizeof(state));
+    if (!enabled) {
+        return;
+    }
+    state.buffers = calloc(TRACE_MAX_THREADS, sizeof(trace_buffer_t));
+    if (state.buffers) {
+        state.start_time = stm_now();
+        state.valid = true;
+    }
+}
+
+void trace_shutdown(void) {
+    free(state.buffers);
+    memset(&state, 0, sizeof(state));
+}
+
+bool trace_enabled(void) {
+    return state.valid;
+}
+
+void trace_thread_name(const char* name) {
+    if (state.valid) {
+        trace_buffer_t* buf = trace_thread_buffer();
+        if (buf) {
+            buf->name = name;
+        }
+    }
+}
+
+uint64_t trace_begin(void) {
+    return state.valid ? stm_now() : 0;
+}
+
+void trace_end(const char* name, uint64_t start) {
+    if (start != 0) {
+        trace_event(name, start, stm_now());
+    }
+}
+
+void trace_event(const char* name, uint64_t start, uint64_t end) {
+    if (!state.valid) {
+        return;
+    }
+    trace_buffer_t* buf = trace_thread_buffer();
+    if (!buf) {
+        return;
+    }
+    const uint32_t count = buf->count;
+    trace_event_t* ev = &buf->events[count & (TRACE_MAX_EVENTS - 1)];
+    ev->name = name;
+    ev->start = start;
+    ev->end = end;
+    thread_atomic_store(&buf->count, count + 1);
+}
+
+// microseconds since the start of the trace
+static double trace_us(uint64_t t) {
+    return (t > state.start_time) ? stm_us(t - state.start_time) : 0.0;
+}
+
+bool trace_dump(const char* path) {
+    assert(path);
+    if (!state.valid) {
+        return false;
+    }
+    FILE* fp = fopen(path, "wb");
+    if (!fp) {
+        return false;
+    }
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"numbersid\"}}");
+    uint32_t num_threads = thread_atomic_load(&state.num_threads);
+    if (num_threads > TRACE_MAX_THREADS) {
+        num_threads = TRACE_MAX_THREADS;
+    }
+    for (uint32_t tid = 0; tid < num_threads; tid++) {
+        const trace_buffer_t* buf = &state.buffers[tid];
+        if (buf->name) {
+            fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", tid, buf->name);
+        }
+        const uint32_t end = thread_atomic_load(&buf->count);
+        uint32_t begin = (end > TRACE_MAX_EVENTS) ? (end - TRACE_MAX_EVENTS) : 0;
+        for (uint32_t i = begin; i != end; i++) {
+            const trace_event_t ev = buf->events[i & (TRACE_MAX_EVENTS - 1)];
+            // the thread may have overwritten the oldest events while they were read
+            thread_atomic_fence();
+            const uint32_t count = thread_atomic_load(&buf->count);
+            if (count - i >= TRACE_MAX_EVENTS) {
+                continue;
+            }
+            const double ts = trace_us(ev.start);
+            const double dur = trace_us(ev.end) - ts;
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", ev.name, tid, ts, dur);
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    const bool ok = !ferror(fp);
+    return (0 == fclose(fp)) && ok;
+}
@@ -0,0 +1,48 @@
+#pragma once
+/*
+    Timeline tracing, written as Chrome trace-event JSON that opens in
+    Perfetto (ui.perfetto.dev) or chrome://tracing.
+
+    Every thread that records an event gets one of TRACE_MAX_THREADS
+    buffers, a ring of the last TRACE_MAX_EVENTS events. Recording is
+    lock-free: the thread writes the event and then publishes it with an
+    atomic store of its event count, trace_dump() reads the events up to
+    that count from any thread, and drops the ones overwritten meanwhile.
+
+    Tracing is off until trace_init() is called with enabled set, then
+    trace_begin() returns 0 and trace_end() returns right away, so markers
+    can stay in the code.
+
+        const uint64_t start = trace_begin();
+        ...
+        trace_end("stage", start);
+*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACE_MAX_THREADS (8)
+#define TRACE_MAX_EVENTS (32 * 1024)    // per thread, must be a power of two, about 50 seconds at 60 Hz
+
+// start tracing if enabled, allocates the buffers
+void trace_init(bool enabled);
+// free the buffers, no events may be recorded anymore
+void trace_shutdown(void);
+bool trace_enabled(void);
+// name of the calling thread in the trace
+void trace_thread_name(const char* name);
+// start of an event, a sokol_time timestamp or 0 if tracing is off
+uint64_t trace_begin(void);
+// record an event from start until now, name must be a string literal
+void trace_end(const char* name, uint64_t start);
+// record an event between two sokol_time timestamps
+void trace_event(const char* name, uint64_t start, uint64_t end);
+// write the recorded events as JSON, returns false if tracing is off or the file can't be written
+bool trace_dump(const char* path);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,527 @@
+#pragma once
+/*
+    Minimal two-pass 6502 assembler, used to build the C64 player from
+    its generated source.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    Supported syntax, one statement per line:
+
+        ; comment
+        label:                  define a label (may be followed by a statement)
+        name = expr             define a constant
+        * = expr                set the program counter
+        .byte expr, ...         emit bytes
+        .word expr, ...         emit little-endian words
+        lda #expr               all official opcodes and addressing modes:
+        lda expr                  #imm, zp/abs, zp/abs,x  zp/abs,y
+        lda (expr),y              (zp),y  (zp,x)  (abs)  relative branches
+        asl                     accumulator mode, 'asl a' also works
+
+    Expressions are built from decimal, $hex, %binary and 'c' character
+    literals, symbols and '*' (the program counter), joined by + - * and /
+    with the usual precedence. A leading < or > takes the low or high byte
+    of the whole expression. Zero page addressing is used when the operand
+    is below $100 and only refers to symbols defined on earlier lines, so
+    both passes agree on instruction sizes.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ASM6502_MAX_SYMBOLS (512)
+#define ASM6502_MAX_NAME (32)
+
+typedef struct {
+    char name[ASM6502_MAX_NAME];
+    int value;
+    int line;               // line of definition, known in pass 1 if > 0
+    bool defined;
+} asm6502_symbol_t;
+
+typedef struct {
+    uint8_t mem[0x10000];
+    int start;              // lowest assembled address
+    int end;                // one past the highest assembled address
+    const char* error;      // error message, 0 on success
+    int error_line;         // 1-based
+    // private
+    asm6502_symbol_t symbols[ASM6502_MAX_SYMBOLS];
+    int num_symbols;
+    int pass;
+    int line;
+    int pc;
+} asm6502_t;
+
+// assemble zero-terminated source text, returns false on error
+bool asm6502_assemble(asm6502_t* as, const char* source);
+// value of a symbol after assembly, -1 if undefined
+int asm6502_symbol(const asm6502_t* as, const char* name);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+
+typedef enum {
+    ASM6502_IMP, ASM6502_ACC, ASM6502_IMM, ASM6502_ZP, ASM6502_ZPX, ASM6502_ZPY,
+    ASM6502_ABS, ASM6502_ABSX, ASM6502_ABSY, ASM6502_IND, ASM6502_INDX, ASM6502_INDY,
+    ASM6502_REL, ASM6502_NUM_MODES,
+} asm6502_mode_t;
+
+typedef struct {
+    const char* name;
+    int16_t opcodes[ASM6502_NUM_MODES];
+} asm6502_opcode_t;
+
+#define __ (-1)
+static const asm6502_opcode_t asm6502_opcodes[] = {
+    //          imp  acc  imm  zp   zpx  zpy  abs  absx absy ind  indx indy rel
+    { "adc", {  __,  __,  0x69,0x65,0x75,__,  0x6D,0x7D,0x79,__,  0x61,0x71,__   } },
+    { "and", {  __,  __,  0x29,0x25,0x35,__,  0x2D,0x3D,0x39,__,  0x21,0x31,__   } },
+    { "asl", {  __,  0x0A,__,  0x06,0x16,__,  0x0E,0x1E,__,  __,  __,  __,  __   } },
+    { "bcc", {  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  0x90 } },
+    { "bcs", {  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  0xB0 } },
+    { "beq", {  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  0xF0 } },
+    { "bit", {  __,  __,  __,  0x24,__,  __,  0x2C,__,  __,  __,  __,  __,  __   } },
+    { "bmi", {  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  0x30 } },
+    { "bne", {  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  0xD0 } },
+    { "bpl", {  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  0x10 } },
+    { "brk", {  0x00,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "bvc", {  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  0x50 } },
+    { "bvs", {  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  0x70 } },
+    { "clc", {  0x18,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "cld", {  0xD8,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "cli", {  0x58,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "clv", {  0xB8,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "cmp", {  __,  __,  0xC9,0xC5,0xD5,__,  0xCD,0xDD,0xD9,__,  0xC1,0xD1,__   } },
+    { "cpx", {  __,  __,  0xE0,0xE4,__,  __,  0xEC,__,  __,  __,  __,  __,  __   } },
+    { "cpy", {  __,  __,  0xC0,0xC4,__,  __,  0xCC,__,  __,  __,  __,  __,  __   } },
+    { "dec", {  __,  __,  __,  0xC6,0xD6,__,  0xCE,0xDE,__,  __,  __,  __,  __   } },
+    { "dex", {  0xCA,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "dey", {  0x88,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "eor", {  __,  __,  0x49,0x45,0x55,__,  0x4D,0x5D,0x59,__,  0x41,0x51,__   } },
+    { "inc", {  __,  __,  __,  0xE6,0xF6,__,  0xEE,0xFE,__,  __,  __,  __,  __   } },
+    { "inx", {  0xE8,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "iny", {  0xC8,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "jmp", {  __,  __,  __,  __,  __,  __,  0x4C,__,  __,  0x6C,__,  __,  __   } },
+    { "jsr", {  __,  __,  __,  __,  __,  __,  0x20,__,  __,  __,  __,  __,  __   } },
+    { "lda", {  __,  __,  0xA9,0xA5,0xB5,__,  0xAD,0xBD,0xB9,__,  0xA1,0xB1,__   } },
+    { "ldx", {  __,  __,  0xA2,0xA6,__,  0xB6,0xAE,__,  0xBE,__,  __,  __,  __   } },
+    { "ldy", {  __,  __,  0xA0,0xA4,0xB4,__,  0xAC,0xBC,__,  __,  __,  __,  __   } },
+    { "lsr", {  __,  0x4A,__,  0x46,0x56,__,  0x4E,0x5E,__,  __,  __,  __,  __   } },
+    { "nop", {  0xEA,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "ora", {  __,  __,  0x09,0x05,0x15,__,  0x0D,0x1D,0x19,__,  0x01,0x11,__   } },
+    { "pha", {  0x48,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "php", {  0x08,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "pla", {  0x68,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "plp", {  0x28,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "rol", {  __,  0x2A,__,  0x26,0x36,__,  0x2E,0x3E,__,  __,  __,  __,  __   } },
+    { "ror", {  __,  0x6A,__,  0x66,0x76,__,  0x6E,0x7E,__,  __,  __,  __,  __   } },
+    { "rti", {  0x40,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "rts", {  0x60,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "sbc", {  __,  __,  0xE9,0xE5,0xF5,__,  0xED,0xFD,0xF9,__,  0xE1,0xF1,__   } },
+    { "sec", {  0x38,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "sed", {  0xF8,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "sei", {  0x78,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "sta", {  __,  __,  __,  0x85,0x95,__,  0x8D,0x9D,0x99,__,  0x81,0x91,__   } },
+    { "stx", {  __,  __,  __,  0x86,__,  0x96,0x8E,__,  __,  __,  __,  __,  __   } },
+    { "sty", {  __,  __,  __,  0x84,0x94,__,  0x8C,__,  __,  __,  __,  __,  __   } },
+    { "tax", {  0xAA,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "tay", {  0xA8,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "tsx", {  0xBA,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "txa", {  0x8A,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "txs", {  0x9A,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+    { "tya", {  0x98,__,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __,  __   } },
+};
+#undef __
+
+// size of the operand per addressing mode
+static const uint8_t asm6502_operand_size[ASM6502_NUM_MODES] = { 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 1, 1, 1 };
+
+static bool _asm6502_error(asm6502_t* as, const char* message) {
+    if (!as->error) {
+        as->error = message;
+        as->error_line = as->line;
+    }
+    return false;
+}
+
+static const char* _asm6502_skip_space(const char* p) {
+    while ((*p == ' ') || (*p == '\t')) p++;
+    return p;
+}
+
+static bool _asm6502_is_name_char(char c) {
+    return isalnum((unsigned char)c) || (c == '_') || (c == '.');
+}
+
+// copy an identifier, returns pointer after it or 0 if there is none
+static const char* _asm6502_name(asm6502_t* as, const char* p, char* name) {
+    if (!(isalpha((unsigned char)*p) || (*p == '_'))) return 0;
+    int n = 0;
+    while (_asm6502_is_name_char(*p)) {
+        if (n == ASM6502_MAX_NAME - 1) {
+            _asm6502_error(as, "name too long");
+            return 0;
+        }
+        name[n++] = *p++;
+    }
+    name[n] = 0;
+    return p;
+}
+
+static asm6502_symbol_t* _asm6502_find(const asm6502_t* as, const char* name) {
+    for (int i = 0; i < as->num_symbols; i++) {
+        if (0 == strcmp(as->symbols[i].name, name)) {
+            return (asm6502_symbol_t*)&as->symbols[i];
+        }
+    }
+    return 0;
+}
+
+static bool _asm6502_define(asm6502_t* as, const char* name, int value, bool known) {
+    asm6502_symbol_t* sym = _asm6502_find(as, name);
+    if (!sym) {
+        if (as->num_symbols == ASM6502_MAX_SYMBOLS) {
+            return _asm6502_error(as, "too many symbols");
+        }
+        sym = &as->symbols[as->num_symbols++];
+        strcpy(sym->name, name);
+    }
+    else if ((as->pass == 1) && sym->defined) {
+        return _asm6502_error(as, "symbol defined twice");
+    }
+    if (known) {
+        if ((as->pass == 2) && sym->defined && (sym->value != value)) {
+            return _asm6502_error(as, "symbol value changed between passes");
+        }
+        if (!sym->defined && (as->pass == 1)) {
+            sym->line = as->line;
+        }
+        sym->value = value;
+        sym->defined = true;
+    }
+    return true;
+}
+
+// parse one term, *early is cleared if a symbol is not known from an earlier line in pass 1
+static const char* _asm6502_term(asm6502_t* as, const char* p, int* value, bool* known, bool* early) {
+    p = _asm6502_skip_space(p);
+    char name[ASM6502_MAX_NAME];
+    const char* end;
+    if (*p == '$') {
+        p++;
+        if (!isxdigit((unsigned char)*p)) return 0;
+        *value = (int)strtol(p, (char**)&end, 16);
+        return end;
+    }
+    else if (*p == '%') {
+        p++;
+        if ((*p != '0') && (*p != '1')) return 0;
+        *value = (int)strtol(p, (char**)&end, 2);
+        return end;
+    }
+    else if (isdigit((unsigned char)*p)) {
+        *value = (int)strtol(p, (char**)&end, 10);
+        return end;
+    }
+    else if ((p[0] == '\'') && p[1] && (p[2] == '\'')) {
+        *value = (uint8_t)p[1];
+        return p + 3;
+    }
+    else if (*p == '*') {
+        *value = as->pc;
+        return p + 1;
+    }
+    else if ((end = _asm6502_name(as, p, name))) {
+        const asm6502_symbol_t* sym = _asm6502_find(as, name);
+        if (!sym || !sym->defined) {
+            if (as->pass == 2) {
+                _asm6502_error(as, "undefined symbol");
+                return 0;
+            }
+            *known = false;
+            *value = 0;
+        }
+        else {
+            *value = sym->value;
+        }
+        if (!sym || (sym->line == 0) || (sym->line >= as->line)) {
+            *early = false;
+        }
+        return end;
+    }
+    return 0;
+}
+
+// product of terms joined by * and /
+static const char* _asm6502_product(asm6502_t* as, const char* p, int* value, bool* known, bool* early) {
+    int result;
+    p = _asm6502_term(as, p, &result, known, early);
+    while (p) {
+        p = _asm6502_skip_space(p);
+        const char op = *p;
+        if ((op != '*') && (op != '/')) break;
+        int rhs;
+        p = _asm6502_term(as, p + 1, &rhs, known, early);
+        if (!p) break;
+        if (op == '*') {
+            result *= rhs;
+        }
+        else if (rhs != 0) {
+            result /= rhs;
+        }
+        else if (*known) {
+            _asm6502_error(as, "division by zero");
+            return 0;
+        }
+    }
+    *value = result;
+    return p;
+}
+
+static const char* _asm6502_expr(asm6502_t* as, const char* p, int* value, bool* known, bool* early) {
+    *known = true;
+    *early = true;
+    p = _asm6502_skip_space(p);
+    char byte_select = 0;
+    if ((*p == '<') || (*p == '>')) {
+        byte_select = *p++;
+    }
+    int result;
+    p = _asm6502_product(as, p, &result, known, early);
+    while (p) {
+        p = _asm6502_skip_space(p);
+        const char op = *p;
+        if ((op != '+') && (op != '-')) break;
+        int rhs;
+        p = _asm6502_product(as, p + 1, &rhs, known, early);
+        if (!p) break;
+        result = (op == '+') ? (result + rhs) : (result - rhs);
+    }
+    if (!p) {
+        _asm6502_error(as, "invalid expression");
+        return 0;
+    }
+    if (byte_select == '<') result &= 0xFF;
+    if (byte_select == '>') result = (result >> 8) & 0xFF;
+    *value = result;
+    return p;
+}
+
+static bool _asm6502_emit(asm6502_t* as, int byte) {
+    if ((as->pc < 0) || (as->pc > 0xFFFF)) {
+        return _asm6502_error(as, "program counter out of range");
+    }
+    if (as->pass == 2) {
+        as->mem[as->pc] = (uint8_t)byte;
+        if (as->pc < as->start) as->start = as->pc;
+        if (as->pc + 1 > as->end) as->end = as->pc + 1;
+    }
+    as->pc++;
+    return true;
+}
+
+static bool _asm6502_end_of_statement(asm6502_t* as, const char* p) {
+    p = _asm6502_skip_space(p);
+    if ((*p != 0) && (*p != ';') && (*p != '\n') && (*p != '\r')) {
+        return _asm6502_error(as, "unexpected characters after statement");
+    }
+    return true;
+}
+
+static bool _asm6502_data(asm6502_t* as, const char* p, int size) {
+    while (true) {
+        int value;
+        bool known, early;
+        p = _asm6502_expr(as, p, &value, &known, &early);
+        if (!p) return false;
+        if (known && ((value < -(1 << (size*8-1))) || (value >= (1 << (size*8))))) {
+            return _asm6502_error(as, "value out of range");
+        }
+        for (int i = 0; i < size; i++) {
+            if (!_asm6502_emit(as, (value >> (i*8)) & 0xFF)) return false;
+        }
+        p = _asm6502_skip_space(p);
+        if (*p != ',') break;
+        p++;
+    }
+    return _asm6502_end_of_statement(as, p);
+}
+
+static bool _asm6502_instruction(asm6502_t* as, const asm6502_opcode_t* op, const char* p) {
+    p = _asm6502_skip_space(p);
+    asm6502_mode_t mode;
+    int value = 0;
+    bool known = true;
+    bool early = true;
+    if ((*p == 0) || (*p == ';') || (*p == '\n') || (*p == '\r')) {
+        mode = (op->opcodes[ASM6502_IMP] >= 0) ? ASM6502_IMP : ASM6502_ACC;
+    }
+    else if (((*p == 'a') || (*p == 'A')) && !_asm6502_is_name_char(p[1])) {
+        mode = ASM6502_ACC;
+        p++;
+    }
+    else if (*p == '#') {
+        mode = ASM6502_IMM;
+        p = _asm6502_expr(as, p + 1, &value, &known, &early);
+    }
+    else if (*p == '(') {
+        p = _asm6502_expr(as, p + 1, &value, &known, &early);
+        if (!p) return false;
+        p = _asm6502_skip_space(p);
+        if ((p[0] == ',') && ((p[1] == 'x') || (p[1] == 'X'))) {
+            p = _asm6502_skip_space(p + 2);
+            if (*p++ != ')') return _asm6502_error(as, "')' expected");
+            mode = ASM6502_INDX;
+        }
+        else {
+            if (*p++ != ')') return _asm6502_error(as, "')' expected");
+            p = _asm6502_skip_space(p);
+            if ((p[0] == ',') && ((p[1] == 'y') || (p[1] == 'Y'))) {
+                p += 2;
+                mode = ASM6502_INDY;
+            }
+            else {
+                mode = ASM6502_IND;
+            }
+        }
+    }
+    else {
+        p = _asm6502_expr(as, p, &value, &known, &early);
+        if (!p) return false;
+        p = _asm6502_skip_space(p);
+        const bool zp = known && early && (value >= 0) && (value < 0x100);
+        if ((p[0] == ',') && ((p[1] == 'x') || (p[1] == 'X'))) {
+            p += 2;
+            mode = (zp && (op->opcodes[ASM6502_ZPX] >= 0)) ? ASM6502_ZPX : ASM6502_ABSX;
+        }
+        else if ((p[0] == ',') && ((p[1] == 'y') || (p[1] == 'Y'))) {
+            p += 2;
+            mode = (zp && (op->opcodes[ASM6502_ZPY] >= 0)) ? ASM6502_ZPY : ASM6502_ABSY;
+        }
+        else if (op->opcodes[ASM6502_REL] >= 0) {
+            mode = ASM6502_REL;
+        }
+        else {
+            mode = (zp && (op->opcodes[ASM6502_ZP] >= 0)) ? ASM6502_ZP : ASM6502_ABS;
+        }
+    }
+    if (!p) return false;
+    if (op->opcodes[mode] < 0) {
+        return _asm6502_error(as, "invalid addressing mode");
+    }
+    if (!_asm6502_end_of_statement(as, p)) return false;
+
+    if ((as->pass == 2) && (mode == ASM6502_REL)) {
+        value -= as->pc + 2;
+        if ((value < -128) || (value > 127)) {
+            return _asm6502_error(as, "branch out of range");
+        }
+    }
+    else if ((as->pass == 2) && (asm6502_operand_size[mode] == 1) && ((value < -128) || (value > 0xFF))) {
+        return _asm6502_error(as, "operand out of range");
+    }
+    if (!_asm6502_emit(as, op->opcodes[mode])) return false;
+    for (int i = 0; i < asm6502_operand_size[mode]; i++) {
+        if (!_asm6502_emit(as, (value >> (i*8)) & 0xFF)) return false;
+    }
+    return true;
+}
+
+static bool _asm6502_statement(asm6502_t* as, const char* p) {
+    p = _asm6502_skip_space(p);
+    if ((*p == 0) || (*p == ';') || (*p == '\n') || (*p == '\r')) {
+        return true;
+    }
+    int value;
+    bool known, early;
+    if (*p == '*') {
+        p = _asm6502_skip_space(p + 1);
+        if (*p != '=') return _asm6502_error(as, "'=' expected");
+        p = _asm6502_expr(as, p + 1, &value, &known, &early);
+        if (!p) return false;
+        if (!known) return _asm6502_error(as, "origin must be known in the first pass");
+        as->pc = value;
+        return _asm6502_end_of_statement(as, p);
+    }
+    if (0 == strncmp(p, ".byte", 5)) {
+        return _asm6502_data(as, p + 5, 1);
+    }
+    if (0 == strncmp(p, ".word", 5)) {
+        return _asm6502_data(as, p + 5, 2);
+    }
+    char name[ASM6502_MAX_NAME];
+    const char* q = _asm6502_name(as, p, name);
+    if (!q) {
+        return _asm6502_error(as, "statement expected");
+    }
+    q = _asm6502_skip_space(q);
+    if (*q == ':') {
+        if (!_asm6502_define(as, name, as->pc, true)) return false;
+        return _asm6502_statement(as, q + 1);
+    }
+    if (*q == '=') {
+        q = _asm6502_expr(as, q + 1, &value, &known, &early);
+        if (!q) return false;
+        if (!_asm6502_define(as, name, value, known)) return false;
+        return _asm6502_end_of_statement(as, q);
+    }
+    for (size_t i = 0; i < sizeof(asm6502_opcodes) / sizeof(asm6502_opcodes[0]); i++) {
+        const char* mnemonic = asm6502_opcodes[i].name;
+        if ((strlen(name) == 3) && (tolower((unsigned char)name[0]) == mnemonic[0]) &&
+            (tolower((unsigned char)name[1]) == mnemonic[1]) && (tolower((unsigned char)name[2]) == mnemonic[2]))
+        {
+            return _asm6502_instruction(as, &asm6502_opcodes[i], q);
+        }
+    }
+    return _asm6502_error(as, "unknown instruction");
+}
+
+bool asm6502_assemble(asm6502_t* as, const char* source) {
+    CHIPS_ASSERT(as && source);
+    memset(as, 0, sizeof(asm6502_t));
+    as->start = 0x10000;
+    as->end = 0;
+    for (as->pass = 1; as->pass <= 2; as->pass++) {
+        as->pc = 0;
+        as->line = 1;
+        const char* p = source;
+        while (*p) {
+            if (!_asm6502_statement(as, p)) {
+                return false;
+            }
+            while (*p && (*p != '\n')) p++;
+            if (*p == '\n') p++;
+            as->line++;
+        }
+    }
+    if (as->start > as->end) {
+        as->start = as->end = 0;
+    }
+    return true;
+}
+
+int asm6502_symbol(const asm6502_t* as, const char* name) {
+    CHIPS_ASSERT(as && name);
+    const asm6502_symbol_t* sym = _asm6502_find(as, name);
+    return (sym && sym->defined) ? sym->value : -1;
+}
+
+#endif
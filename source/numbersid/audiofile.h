@@ -0,0 +1,546 @@
+#pragma once
+/*
+    Audio file sink: records mono audio to a WAV or FLAC file.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    Include the following headers before including audiofile.h:
+        - chips/chips_common.h
+        - thread.h
+
+    audiofile_push() only copies the samples into large chunks, full
+    chunks are converted, encoded and written by an I/O thread, so the
+    producer (the audio path of the app) never waits for the disk. If
+    the disk falls behind by more than AUDIOFILE_NUM_CHUNKS chunks the
+    newest samples are dropped and counted, the producer still does not
+    block. Without thread support (emscripten) full chunks are written
+    inline instead.
+
+    audiofile_callback() has the signature of chips_audio_callback_t.func,
+    so a file sink can be used wherever an audio callback is expected.
+
+    Samples are clamped to -1..1 and stored as 16-bit PCM. WAV files are
+    plain RIFF/WAVE, FLAC files use a small built-in encoder: blocks of
+    4096 samples with the best of the fixed predictors (or a constant or
+    verbatim subframe) and Rice coded residuals. The sizes in the headers
+    are filled in by audiofile_close().
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIOFILE_CHUNK_SAMPLES (1 << 16)      // 1.4 seconds at 48 kHz
+#define AUDIOFILE_NUM_CHUNKS (8)
+#define AUDIOFILE_FLAC_BLOCK_SIZE (4096)
+
+typedef enum {
+    AUDIOFILE_WAV,
+    AUDIOFILE_FLAC,
+} audiofile_format_t;
+
+typedef struct {
+    const char* path;
+    audiofile_format_t format;
+    int sample_rate;
+} audiofile_desc_t;
+
+typedef struct {
+    FILE* fp;
+    audiofile_format_t format;
+    int sample_rate;
+    // chunk ring, the producer fills chunks[fill], the I/O thread writes the queued ones before it
+    float* chunks[AUDIOFILE_NUM_CHUNKS];
+    int chunk_sizes[AUDIOFILE_NUM_CHUNKS];
+    int fill;
+    int num_queued;             // full chunks not written yet, guarded by mutex
+    bool quit;                  // guarded by mutex
+    thread_t thread;
+    thread_mutex_t mutex;
+    thread_cond_t cond;
+    bool threaded;
+    // I/O thread state
+    int16_t* pcm;               // converted chunk
+    uint8_t* frame;             // encoded FLAC frame
+    int16_t block[AUDIOFILE_FLAC_BLOCK_SIZE];
+    int block_size;
+    uint32_t frame_number;
+    uint32_t min_frame_bytes;
+    uint32_t max_frame_bytes;
+    uint64_t num_written;       // samples written
+    bool io_error;
+    // producer statistics
+    uint64_t num_pushed;
+    uint64_t num_dropped;
+} audiofile_t;
+
+// audiofile_format_t for a file name, FLAC for a .flac extension
+audiofile_format_t audiofile_format_from_path(const char* path);
+// create the file and start the I/O thread
+bool audiofile_open(audiofile_t* file, const audiofile_desc_t* desc);
+// append samples, never blocks on disk
+void audiofile_push(audiofile_t* file, const float* samples, int num_samples);
+// audio callback, user_data is the audiofile_t
+void audiofile_callback(const float* samples, int num_samples, void* user_data);
+// write the rest, finish the headers and close the file, returns false on I/O errors
+bool audiofile_close(audiofile_t* file);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <stdlib.h>
+#include <string.h>
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
+
+#define _AUDIOFILE_WAV_HEADER_SIZE (44)
+#define _AUDIOFILE_FLAC_STREAMINFO_POS (8)
+#define _AUDIOFILE_FLAC_MAX_FRAME_SIZE (AUDIOFILE_FLAC_BLOCK_SIZE * 2 + 64)
+
+// ---- little helpers ----
+
+static void _audiofile_put_le(uint8_t* dst, uint32_t value, int num_bytes) {
+    for (int i = 0; i < num_bytes; i++) {
+        dst[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static bool _audiofile_write(audiofile_t* file, const void* data, size_t size) {
+    if (!file->io_error && (fwrite(data, 1, size, file->fp) != size)) {
+        file->io_error = true;
+    }
+    return !file->io_error;
+}
+
+// ---- WAV ----
+
+static void _audiofile_wav_header(audiofile_t* file, uint8_t* header) {
+    const uint32_t data_size = (uint32_t)(file->num_written * 2);
+    memcpy(&header[0], "RIFF", 4);
+    _audiofile_put_le(&header[4], 36 + data_size, 4);
+    memcpy(&header[8], "WAVEfmt ", 8);
+    _audiofile_put_le(&header[16], 16, 4);                      // fmt chunk size
+    _audiofile_put_le(&header[20], 1, 2);                       // PCM
+    _audiofile_put_le(&header[22], 1, 2);                       // mono
+    _audiofile_put_le(&header[24], file->sample_rate, 4);
+    _audiofile_put_le(&header[28], file->sample_rate * 2, 4);   // bytes per second
+    _audiofile_put_le(&header[32], 2, 2);                       // block align
+    _audiofile_put_le(&header[34], 16, 2);                      // bits per sample
+    memcpy(&header[36], "data", 4);
+    _audiofile_put_le(&header[40], data_size, 4);
+}
+
+// ---- FLAC ----
+
+typedef struct {
+    uint8_t* buf;
+    int pos;                // bytes
+    uint64_t acc;
+    int num_bits;           // bits in acc
+} _audiofile_bits_t;
+
+static void _audiofile_bits_put(_audiofile_bits_t* bits, uint32_t value, int num_bits) {
+    // num_bits <= 32
+    bits->acc = (bits->acc << num_bits) | (value & (uint32_t)((1ULL << num_bits) - 1));
+    bits->num_bits += num_bits;
+    while (bits->num_bits >= 8) {
+        bits->num_bits -= 8;
+        bits->buf[bits->pos++] = (uint8_t)(bits->acc >> bits->num_bits);
+    }
+}
+
+static void _audiofile_bits_align(_audiofile_bits_t* bits) {
+    if (bits->num_bits > 0) {
+        _audiofile_bits_put(bits, 0, 8 - bits->num_bits);
+    }
+}
+
+static uint8_t _audiofile_crc8(const uint8_t* data, int size) {
+    uint8_t crc = 0;
+    for (int i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint16_t _audiofile_crc16(const uint8_t* data, int size) {
+    uint16_t crc = 0;
+    for (int i = 0; i < size; i++) {
+        crc ^= (uint16_t)(data[i] << 8);
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x8005) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static int _audiofile_flac_rate_code(int sample_rate) {
+    switch (sample_rate) {
+        case 8000: return 4;
+        case 16000: return 5;
+        case 22050: return 6;
+        case 24000: return 7;
+        case 32000: return 8;
+        case 44100: return 9;
+        case 48000: return 10;
+        case 96000: return 11;
+        default: return 0;      // from STREAMINFO
+    }
+}
+
+static void _audiofile_flac_streaminfo(audiofile_t* file, uint8_t* info) {
+    const uint64_t total = file->num_written;
+    _audiofile_bits_t bits = { .buf = info };
+    // the last block may be shorter than the minimum
+    _audiofile_bits_put(&bits, AUDIOFILE_FLAC_BLOCK_SIZE, 16);  // min block size
+    _audiofile_bits_put(&bits, AUDIOFILE_FLAC_BLOCK_SIZE, 16);  // max block size
+    _audiofile_bits_put(&bits, file->min_frame_bytes, 24);
+    _audiofile_bits_put(&bits, file->max_frame_bytes, 24);
+    _audiofile_bits_put(&bits, file->sample_rate, 20);
+    _audiofile_bits_put(&bits, 0, 3);                           // channels - 1
+    _audiofile_bits_put(&bits, 15, 5);                          // bits per sample - 1
+    _audiofile_bits_put(&bits, (uint32_t)(total >> 32), 4);     // 36 bits total samples
+    _audiofile_bits_put(&bits, (uint32_t)total, 32);
+    memset(&info[18], 0, 16);                                   // MD5 unknown
+}
+
+// fixed predictor residual of sample i
+static int32_t _audiofile_flac_residual(const int16_t* x, int i, int order) {
+    switch (order) {
+        case 0: return x[i];
+        case 1: return x[i] - x[i-1];
+        case 2: return x[i] - 2*x[i-1] + x[i-2];
+        case 3: return x[i] - 3*x[i-1] + 3*x[i-2] - x[i-3];
+        default: return x[i] - 4*x[i-1] + 6*x[i-2] - 4*x[i-3] + x[i-4];
+    }
+}
+
+static uint32_t _audiofile_zigzag(int32_t value) {
+    return (uint32_t)(value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static void _audiofile_flac_frame(audiofile_t* file, const int16_t* x, int n) {
+    _audiofile_bits_t bits = { .buf = file->frame };
+
+    // header
+    const bool full_block = (n == AUDIOFILE_FLAC_BLOCK_SIZE);
+    _audiofile_bits_put(&bits, 0xFFF8, 16);                     // sync, fixed block size
+    _audiofile_bits_put(&bits, full_block ? 12 : 7, 4);         // 4096, or 16 bit size at the end of the header
+    _audiofile_bits_put(&bits, _audiofile_flac_rate_code(file->sample_rate), 4);
+    _audiofile_bits_put(&bits, 0, 4);                           // mono
+    _audiofile_bits_put(&bits, 4, 3);                           // 16 bits per sample
+    _audiofile_bits_put(&bits, 0, 1);
+    // frame number, UTF-8 style
+    const uint32_t number = file->frame_number++;
+    if (number < 0x80) {
+        _audiofile_bits_put(&bits, number, 8);
+    }
+    else {
+        int num_cont = (number < 0x800) ? 1 : (number < 0x10000) ? 2 : (number < 0x200000) ? 3 : (number < 0x4000000) ? 4 : 5;
+        const uint32_t lead = (0xFF00 >> (num_cont + 1)) & 0xFF;
+        _audiofile_bits_put(&bits, lead | (number >> (6 * num_cont)), 8);
+        for (int i = num_cont - 1; i >= 0; i--) {
+            _audiofile_bits_put(&bits, 0x80 | ((number >> (6 * i)) & 0x3F), 8);
+        }
+    }
+    if (!full_block) {
+        _audiofile_bits_put(&bits, n - 1, 16);
+    }
+    _audiofile_bits_put(&bits, _audiofile_crc8(bits.buf, bits.pos), 8);
+
+    // subframe, the cheapest of constant, verbatim and fixed orders 0..4
+    bool constant = true;
+    for (int i = 1; constant && (i < n); i++) {
+        constant = (x[i] == x[0]);
+    }
+    if (constant) {
+        _audiofile_bits_put(&bits, 0x00, 8);
+        _audiofile_bits_put(&bits, (uint16_t)x[0], 16);
+    }
+    else {
+        int best_order = -1;
+        int best_param = 0;
+        uint64_t best_bits = (uint64_t)n * 16;
+        for (int order = 0; (order <= 4) && (order < n); order++) {
+            uint64_t sums[15] = {0};
+            for (int i = order; i < n; i++) {
+                const uint32_t u = _audiofile_zigzag(_audiofile_flac_residual(x, i, order));
+                for (int k = 0; k < 15; k++) {
+                    sums[k] += u >> k;
+                }
+            }
+            for (int k = 0; k < 15; k++) {
+                const uint64_t cost = (uint64_t)order * 16 + 10 + sums[k] + (uint64_t)(n - order) * (k + 1);
+                if (cost < best_bits) {
+                    best_bits = cost;
+                    best_order = order;
+                    best_param = k;
+                }
+            }
+        }
+        if (best_order < 0) {
+            _audiofile_bits_put(&bits, 0x02, 8);                // verbatim
+            for (int i = 0; i < n; i++) {
+                _audiofile_bits_put(&bits, (uint16_t)x[i], 16);
+            }
+        }
+        else {
+            _audiofile_bits_put(&bits, (0x08 | best_order) << 1, 8);
+            for (int i = 0; i < best_order; i++) {
+                _audiofile_bits_put(&bits, (uint16_t)x[i], 16);
+            }
+            _audiofile_bits_put(&bits, 0, 2);                   // Rice, 4 bit parameter
+            _audiofile_bits_put(&bits, 0, 4);                   // one partition
+            _audiofile_bits_put(&bits, best_param, 4);
+            for (int i = best_order; i < n; i++) {
+                const uint32_t u = _audiofile_zigzag(_audiofile_flac_residual(x, i, best_order));
+                uint32_t q = u >> best_param;
+                while (q >= 32) {
+                    _audiofile_bits_put(&bits, 0, 32);
+                    q -= 32;
+                }
+                _audiofile_bits_put(&bits, 1, q + 1);           // unary quotient
+                if (best_param > 0) {
+                    _audiofile_bits_put(&bits, u, best_param);
+                }
+            }
+        }
+    }
+
+    // footer
+    _audiofile_bits_align(&bits);
+    const uint16_t crc = _audiofile_crc16(bits.buf, bits.pos);
+    _audiofile_bits_put(&bits, crc, 16);
+    const uint32_t frame_bytes = (uint32_t)bits.pos;
+    if ((file->min_frame_bytes == 0) || (frame_bytes < file->min_frame_bytes)) file->min_frame_bytes = frame_bytes;
+    if (frame_bytes > file->max_frame_bytes) file->max_frame_bytes = frame_bytes;
+    _audiofile_write(file, bits.buf, bits.pos);
+}
+
+// ---- chunk writer, runs on the I/O thread ----
+
+static void _audiofile_write_chunk(audiofile_t* file, const float* samples, int num_samples) {
+    int16_t* pcm = file->pcm;
+    for (int i = 0; i < num_samples; i++) {
+        float s = samples[i];
+        if (s > 1.0f) s = 1.0f;
+        if (s < -1.0f) s = -1.0f;
+        pcm[i] = (int16_t)(s * 32767.0f);
+    }
+    if (file->format == AUDIOFILE_WAV) {
+        uint8_t* bytes = (uint8_t*)file->frame;
+        for (int pos = 0; pos < num_samples; ) {
+            int n = num_samples - pos;
+            if (n > AUDIOFILE_FLAC_BLOCK_SIZE) n = AUDIOFILE_FLAC_BLOCK_SIZE;
+            for (int i = 0; i < n; i++) {
+                _audiofile_put_le(&bytes[i * 2], (uint16_t)pcm[pos + i], 2);
+            }
+            _audiofile_write(file, bytes, n * 2);
+            pos += n;
+        }
+    }
+    else {
+        for (int i = 0; i < num_samples; i++) {
+            file->block[file->block_size++] = pcm[i];
+            if (file->block_size == AUDIOFILE_FLAC_BLOCK_SIZE) {
+                _audiofile_flac_frame(file, file->block, file->block_size);
+                file->block_size = 0;
+            }
+        }
+    }
+    file->num_written += num_samples;
+}
+
+static void _audiofile_thread(void* arg) {
+    audiofile_t* file = (audiofile_t*)arg;
+    thread_mutex_lock(&file->mutex);
+    while (true) {
+        while ((file->num_queued == 0) && !file->quit) {
+            thread_cond_wait(&file->cond, &file->mutex);
+        }
+        if (file->num_queued == 0) {
+            break;
+        }
+        const int index = (file->fill + AUDIOFILE_NUM_CHUNKS - file->num_queued) % AUDIOFILE_NUM_CHUNKS;
+        thread_mutex_unlock(&file->mutex);
+        _audiofile_write_chunk(file, file->chunks[index], file->chunk_sizes[index]);
+        thread_mutex_lock(&file->mutex);
+        file->num_queued--;
+    }
+    thread_mutex_unlock(&file->mutex);
+}
+
+// hand the chunk being filled to the I/O thread, returns false if the queue is full
+static bool _audiofile_queue_chunk(audiofile_t* file) {
+    if (!file->threaded) {
+        _audiofile_write_chunk(file, file->chunks[file->fill], file->chunk_sizes[file->fill]);
+        file->chunk_sizes[file->fill] = 0;
+        return true;
+    }
+    bool queued = false;
+    thread_mutex_lock(&file->mutex);
+    if (file->num_queued < AUDIOFILE_NUM_CHUNKS - 1) {
+        file->num_queued++;
+        file->fill = (file->fill + 1) % AUDIOFILE_NUM_CHUNKS;
+        queued = true;
+        thread_cond_signal(&file->cond);
+    }
+    thread_mutex_unlock(&file->mutex);
+    file->chunk_sizes[file->fill] = 0;
+    return queued;
+}
+
+// ---- public functions ----
+
+audiofile_format_t audiofile_format_from_path(const char* path) {
+    CHIPS_ASSERT(path);
+    const char* ext = strrchr(path, '.');
+    if (ext && ((0 == strcmp(ext, ".flac")) || (0 == strcmp(ext, ".FLAC")))) {
+        return AUDIOFILE_FLAC;
+    }
+    return AUDIOFILE_WAV;
+}
+
+bool audiofile_open(audiofile_t* file, const audiofile_desc_t* desc) {
+    CHIPS_ASSERT(file && desc && desc->path && (desc->sample_rate > 0));
+    memset(file, 0, sizeof(audiofile_t));
+    file->format = desc->format;
+    file->sample_rate = desc->sample_rate;
+    file->pcm = malloc(AUDIOFILE_CHUNK_SAMPLES * sizeof(int16_t));
+    file->frame = malloc(_AUDIOFILE_FLAC_MAX_FRAME_SIZE);
+    bool ok = file->pcm && file->frame;
+    for (int i = 0; ok && (i < AUDIOFILE_NUM_CHUNKS); i++) {
+        file->chunks[i] = malloc(AUDIOFILE_CHUNK_SAMPLES * sizeof(float));
+        ok = (file->chunks[i] != 0);
+    }
+    if (ok) {
+        file->fp = fopen(desc->path, "wb");
+        ok = (file->fp != 0);
+    }
+    if (ok) {
+        // headers with unknown sizes, rewritten by audiofile_close()
+        if (file->format == AUDIOFILE_WAV) {
+            uint8_t header[_AUDIOFILE_WAV_HEADER_SIZE];
+            _audiofile_wav_header(file, header);
+            ok = _audiofile_write(file, header, sizeof(header));
+        }
+        else {
+            uint8_t header[_AUDIOFILE_FLAC_STREAMINFO_POS + 34] = { 'f', 'L', 'a', 'C', 0x80, 0, 0, 34 };
+            _audiofile_flac_streaminfo(file, &header[_AUDIOFILE_FLAC_STREAMINFO_POS]);
+            ok = _audiofile_write(file, header, sizeof(header));
+        }
+    }
+    if (!ok) {
+        if (file->fp) {
+            fclose(file->fp);
+        }
+        free(file->pcm);
+        free(file->frame);
+        for (int i = 0; i < AUDIOFILE_NUM_CHUNKS; i++) {
+            free(file->chunks[i]);
+        }
+        memset(file, 0, sizeof(audiofile_t));
+        return false;
+    }
+    if (thread_mutex_init(&file->mutex) && thread_cond_init(&file->cond)) {
+        file->threaded = thread_start(&file->thread, _audiofile_thread, file);
+    }
+    return true;
+}
+
+void audiofile_push(audiofile_t* file, const float* samples, int num_samples) {
+    CHIPS_ASSERT(file && samples);
+    if (!file->fp) {
+        return;
+    }
+    file->num_pushed += num_samples;
+    while (num_samples > 0) {
+        float* chunk = file->chunks[file->fill];
+        int* size = &file->chunk_sizes[file->fill];
+        int n = AUDIOFILE_CHUNK_SAMPLES - *size;
+        if (n > num_samples) n = num_samples;
+        memcpy(&chunk[*size], samples, n * sizeof(float));
+        *size += n;
+        samples += n;
+        num_samples -= n;
+        if ((*size == AUDIOFILE_CHUNK_SAMPLES) && !_audiofile_queue_chunk(file)) {
+            // the disk is too slow, drop this chunk instead of waiting
+            file->num_dropped += AUDIOFILE_CHUNK_SAMPLES;
+        }
+    }
+}
+
+void audiofile_callback(const float* samples, int num_samples, void* user_data) {
+    audiofile_push((audiofile_t*)user_data, samples, num_samples);
+}
+
+bool audiofile_close(audiofile_t* file) {
+    CHIPS_ASSERT(file);
+    if (!file->fp) {
+        return false;
+    }
+    // queue the partly filled chunk, then let the I/O thread finish
+    if (file->threaded) {
+        if ((file->chunk_sizes[file->fill] > 0) && !_audiofile_queue_chunk(file)) {
+            file->num_dropped += file->chunk_sizes[file->fill];
+        }
+        thread_mutex_lock(&file->mutex);
+        file->quit = true;
+        thread_cond_signal(&file->cond);
+        thread_mutex_unlock(&file->mutex);
+        thread_join(&file->thread);
+    }
+    else if (file->chunk_sizes[file->fill] > 0) {
+        _audiofile_queue_chunk(file);
+    }
+    thread_cond_discard(&file->cond);
+    thread_mutex_discard(&file->mutex);
+
+    if ((file->format == AUDIOFILE_FLAC) && (file->block_size > 0)) {
+        _audiofile_flac_frame(file, file->block, file->block_size);
+    }
+    // final sizes
+    if (file->format == AUDIOFILE_WAV) {
+        uint8_t header[_AUDIOFILE_WAV_HEADER_SIZE];
+        _audiofile_wav_header(file, header);
+        if (0 == fseek(file->fp, 0, SEEK_SET)) {
+            _audiofile_write(file, header, sizeof(header));
+        }
+    }
+    else {
+        uint8_t info[34];
+        _audiofile_flac_streaminfo(file, info);
+        if (0 == fseek(file->fp, _AUDIOFILE_FLAC_STREAMINFO_POS, SEEK_SET)) {
+            _audiofile_write(file, info, sizeof(info));
+        }
+    }
+    bool ok = !file->io_error;
+    ok = (0 == fclose(file->fp)) && ok;
+    free(file->pcm);
+    free(file->frame);
+    for (int i = 0; i < AUDIOFILE_NUM_CHUNKS; i++) {
+        free(file->chunks[i]);
+    }
+    file->fp = 0;
+    return ok;
+}
+
+#endif
@@ -0,0 +1,179 @@
+#pragma once
+/*
+    Adaptive output latency for the saudio push queue.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    Include the following headers before including audiolatency.h:
+        - audiostats.h
+
+    sokol_audio can't resize its buffers while it runs, so the latency is
+    adapted through the number of frames kept in the push queue instead,
+    the queue itself is made large enough for the slowest machine. The
+    target is the number of frames left in the queue when the next push
+    arrives, the headroom for late frames. It starts low and:
+
+        - doubles after every underrun
+        - grows to cover the slowest frames, the 99th percentile of the
+          frame time, plus one push
+        - shrinks by an eighth after AUDIOLATENCY_SHRINK_SEC without an
+          underrun, while the queue never ran below half the target
+
+    so it grows at once and shrinks slowly. The queue is moved towards
+    the target in two ways:
+
+        - audiolatency_rate() is a factor close to 1 for the speed of
+          the emulation, so it produces a little more audio while the
+          queue is below the target and a little less while it is above.
+          It is at most AUDIOLATENCY_MAX_RATE off, too little to hear in
+          the tempo, and enough for the drift between the frame clock
+          and the audio clock and for the audio lost in a long frame now
+          and then. A larger deficit runs the queue dry, which doubles
+          the target and pads the queue back up to it, see below.
+        - audiolatency_pad() is the silence to add when the queue ran
+          dry, so the next pushes start at the target again (the device
+          plays silence anyway at that moment). It fills the queue up to
+          whole packets, a partly filled packet left behind would never
+          be played, and the queue would never look empty again.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIOLATENCY_SHRINK_SEC (30.0f)
+#define AUDIOLATENCY_MAX_RATE (0.005f)      // the emulation runs at most 0.5% faster or slower
+#define AUDIOLATENCY_RATE_MS (20.0f)        // distance from the target at which the rate is at its limit
+
+typedef struct {
+    int sample_rate;
+    int push_frames;                    // frames per push
+    int packet_frames;                  // the queue plays whole packets, default: 1
+    int min_frames;                     // lowest target
+    int max_frames;                     // highest target, at most the queue capacity
+} audiolatency_desc_t;
+
+typedef struct {
+    int sample_rate;
+    int push_frames;
+    int packet_frames;
+    int min_frames;
+    int max_frames;
+    int target_frames;                  // frames left in the queue before a push
+    uint32_t underruns;                 // underruns seen so far
+    float stable_sec;                   // time since the target last changed
+} audiolatency_t;
+
+void audiolatency_init(audiolatency_t* lat, const audiolatency_desc_t* desc);
+// adapt the target once per frame, to the underruns so far and the frame time percentile
+void audiolatency_update(audiolatency_t* lat, const audiostats_t* stats, float frame_time_p99_ms, float dt_sec);
+// speed factor of the emulation, from the fill level after the last push
+float audiolatency_rate(const audiolatency_t* lat, int fill_frames);
+// frames of silence to push before the next push, with fill_frames in the queue before it,
+// including a partly filled packet
+int audiolatency_pad(const audiolatency_t* lat, int fill_frames);
+// target latency in milliseconds
+float audiolatency_target_ms(const audiolatency_t* lat);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <string.h>
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
+
+static int _audiolatency_clamp(const audiolatency_t* lat, int frames) {
+    if (frames < lat->min_frames) {
+        return lat->min_frames;
+    }
+    if (frames > lat->max_frames) {
+        return lat->max_frames;
+    }
+    return frames;
+}
+
+void audiolatency_init(audiolatency_t* lat, const audiolatency_desc_t* desc) {
+    CHIPS_ASSERT(lat && desc);
+    CHIPS_ASSERT((desc->sample_rate > 0) && (desc->push_frames > 0));
+    CHIPS_ASSERT((desc->min_frames > 0) && (desc->min_frames <= desc->max_frames));
+    memset(lat, 0, sizeof(audiolatency_t));
+    lat->sample_rate = desc->sample_rate;
+    lat->push_frames = desc->push_frames;
+    lat->packet_frames = desc->packet_frames ? desc->packet_frames : 1;
+    lat->min_frames = desc->min_frames;
+    lat->max_frames = desc->max_frames;
+    lat->target_frames = desc->min_frames;
+}
+
+void audiolatency_update(audiolatency_t* lat, const audiostats_t* stats, float frame_time_p99_ms, float dt_sec) {
+    CHIPS_ASSERT(lat && stats);
+    // the slowest frames must not drain the queue, pushes of whole blocks
+    // leave up to one push behind in the sample buffer
+    const int floor_frames = _audiolatency_clamp(lat, lat->push_frames + (int)(frame_time_p99_ms * (float)lat->sample_rate * 0.001f));
+    if (stats->underruns != lat->underruns) {
+        lat->underruns = stats->underruns;
+        lat->target_frames = _audiolatency_clamp(lat, 2 * lat->target_frames);
+        lat->stable_sec = 0.0f;
+    }
+    else {
+        lat->stable_sec += dt_sec;
+    }
+    if (lat->target_frames < floor_frames) {
+        lat->target_frames = floor_frames;
+        lat->stable_sec = 0.0f;
+    }
+    else if (lat->stable_sec >= AUDIOLATENCY_SHRINK_SEC) {
+        lat->stable_sec = 0.0f;
+        // the history has the fill after each push, the headroom is one push less
+        const int min_headroom = (int)(audiostats_min_fill(stats) * (float)stats->queue_frames) - lat->push_frames;
+        if (min_headroom > lat->target_frames / 2) {
+            const int target = lat->target_frames - lat->target_frames / 8;
+            lat->target_frames = (target > floor_frames) ? target : floor_frames;
+        }
+    }
+}
+
+float audiolatency_rate(const audiolatency_t* lat, int fill_frames) {
+    CHIPS_ASSERT(lat);
+    // right after a push the queue holds the headroom plus half a push on average
+    const float error = (float)(lat->target_frames + lat->push_frames / 2 - fill_frames);
+    float rate = error * AUDIOLATENCY_MAX_RATE / (AUDIOLATENCY_RATE_MS * 0.001f * (float)lat->sample_rate);
+    if (rate > AUDIOLATENCY_MAX_RATE) {
+        rate = AUDIOLATENCY_MAX_RATE;
+    }
+    else if (rate < -AUDIOLATENCY_MAX_RATE) {
+        rate = -AUDIOLATENCY_MAX_RATE;
+    }
+    return 1.0f + rate;
+}
+
+int audiolatency_pad(const audiolatency_t* lat, int fill_frames) {
+    CHIPS_ASSERT(lat);
+    // less than a packet is only the partly filled one, nothing is played
+    if (fill_frames >= lat->packet_frames) {
+        return 0;
+    }
+    const int fill = fill_frames + lat->target_frames + lat->packet_frames - 1;
+    return fill - fill % lat->packet_frames - fill_frames;
+}
+
+float audiolatency_target_ms(const audiolatency_t* lat) {
+    CHIPS_ASSERT(lat);
+    return (float)lat->target_frames * 1000.0f / (float)lat->sample_rate;
+}
+
+#endif
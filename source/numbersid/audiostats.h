@@ -0,0 +1,210 @@
+#pragma once
+/*
+    Audio output health counters.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    The audio path calls audiostats_push() for every push into the
+    output queue, with the number of frames it pushed, the number the
+    queue accepted and the free space it reported before the push
+    (saudio_push() and saudio_expect() with sokol_audio). From that:
+
+        - dropped frames and overruns: pushes the queue did not accept
+          completely, because it was full
+        - underruns: pushes that found the queue empty, so the device has
+          most likely played silence since the previous push. A queue of
+          packets (like sokol_audio's) hands on whole packets only, so it
+          is empty when less than one packet is left in it, the partly
+          filled packet of the pushes is never played
+        - the fill level of the queue after every push, the last
+          AUDIOSTATS_HISTORY_SIZE of them are kept
+        - the output latency, estimated as the queued frames plus the
+          device buffer, the time a pushed sample takes to be heard
+
+    When the audio path adds silence to the queue to steer the latency,
+    it reports that with audiostats_pad() after the push.
+
+    The counters don't depend on the audio backend, they can be fed from
+    a simulated queue (or the dummy backend of sokol_audio) in tests.
+    audiostats_write_json() writes them in a machine-readable form.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIOSTATS_HISTORY_SIZE (256)       // about 5 seconds of pushes at 48 kHz and 1024 frames
+
+typedef struct {
+    int sample_rate;
+    int queue_frames;                   // capacity of the push queue
+    int packet_frames;                  // the queue plays whole packets, default: 1
+    int buffer_frames;                  // device buffer, played after the queue
+} audiostats_desc_t;
+
+typedef struct {
+    int sample_rate;
+    int queue_frames;
+    int packet_frames;
+    int buffer_frames;
+    uint64_t num_pushes;
+    uint64_t frames_pushed;             // frames offered to the queue
+    uint64_t frames_accepted;           // frames the queue took
+    uint64_t frames_dropped;
+    uint64_t frames_padded;             // silence added to the queue
+    uint32_t underruns;                 // pushes that found the queue empty
+    uint32_t overruns;                  // pushes that were not accepted completely
+    int fill_frames;                    // queued frames after the last push
+    int history_pos;                    // next slot in fill_history
+    int history_count;
+    uint16_t fill_history[AUDIOSTATS_HISTORY_SIZE];    // queued frames after each push, clamped to 65535
+} audiostats_t;
+
+void audiostats_init(audiostats_t* stats, const audiostats_desc_t* desc);
+// record one push: frames offered, frames accepted and free frames in the queue before the push
+void audiostats_push(audiostats_t* stats, int num_frames, int num_accepted, int free_frames);
+// record silence added before the last push
+void audiostats_pad(audiostats_t* stats, int num_padded);
+// true if a queue with free_frames free frames has nothing left to play
+bool audiostats_empty(const audiostats_t* stats, int free_frames);
+// fill level of the queue after the last push, 0..1
+float audiostats_fill(const audiostats_t* stats);
+// lowest fill level in the history, 0..1
+float audiostats_min_fill(const audiostats_t* stats);
+// estimated output latency after the last push, in milliseconds
+float audiostats_latency_ms(const audiostats_t* stats);
+// write the counters as a JSON object, returns false on a write error
+bool audiostats_write_json(const audiostats_t* stats, FILE* fp);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <string.h>
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
+
+void audiostats_init(audiostats_t* stats, const audiostats_desc_t* desc) {
+    CHIPS_ASSERT(stats && desc);
+    CHIPS_ASSERT((desc->sample_rate > 0) && (desc->queue_frames > 0));
+    CHIPS_ASSERT((desc->packet_frames >= 0) && (desc->packet_frames <= desc->queue_frames));
+    memset(stats, 0, sizeof(audiostats_t));
+    stats->sample_rate = desc->sample_rate;
+    stats->queue_frames = desc->queue_frames;
+    stats->packet_frames = desc->packet_frames ? desc->packet_frames : 1;
+    stats->buffer_frames = desc->buffer_frames;
+}
+
+void audiostats_push(audiostats_t* stats, int num_frames, int num_accepted, int free_frames) {
+    CHIPS_ASSERT(stats);
+    CHIPS_ASSERT((num_accepted >= 0) && (num_accepted <= num_frames));
+    // the first push always finds an empty queue
+    if ((stats->num_pushes > 0) && audiostats_empty(stats, free_frames)) {
+        stats->underruns++;
+    }
+    if (num_accepted < num_frames) {
+        stats->overruns++;
+        stats->frames_dropped += (uint64_t)(num_frames - num_accepted);
+    }
+    stats->num_pushes++;
+    stats->frames_pushed += (uint64_t)num_frames;
+    stats->frames_accepted += (uint64_t)num_accepted;
+    int fill = stats->queue_frames - free_frames + num_accepted;
+    if (fill < 0) {
+        fill = 0;
+    }
+    else if (fill > stats->queue_frames) {
+        fill = stats->queue_frames;
+    }
+    stats->fill_frames = fill;
+    stats->fill_history[stats->history_pos] = (uint16_t)((fill < 0xFFFF) ? fill : 0xFFFF);
+    stats->history_pos = (stats->history_pos + 1) % AUDIOSTATS_HISTORY_SIZE;
+    if (stats->history_count < AUDIOSTATS_HISTORY_SIZE) {
+        stats->history_count++;
+    }
+}
+
+void audiostats_pad(audiostats_t* stats, int num_padded) {
+    CHIPS_ASSERT(stats && (num_padded >= 0));
+    stats->frames_padded += (uint64_t)num_padded;
+    if ((num_padded > 0) && (stats->history_count > 0)) {
+        int fill = stats->fill_frames + num_padded;
+        if (fill > stats->queue_frames) {
+            fill = stats->queue_frames;
+        }
+        stats->fill_frames = fill;
+        const int last = (stats->history_pos + AUDIOSTATS_HISTORY_SIZE - 1) % AUDIOSTATS_HISTORY_SIZE;
+        stats->fill_history[last] = (uint16_t)((fill < 0xFFFF) ? fill : 0xFFFF);
+    }
+}
+
+bool audiostats_empty(const audiostats_t* stats, int free_frames) {
+    CHIPS_ASSERT(stats);
+    return free_frames > stats->queue_frames - stats->packet_frames;
+}
+
+float audiostats_fill(const audiostats_t* stats) {
+    CHIPS_ASSERT(stats);
+    return (float)stats->fill_frames / (float)stats->queue_frames;
+}
+
+float audiostats_min_fill(const audiostats_t* stats) {
+    CHIPS_ASSERT(stats);
+    if (stats->history_count == 0) {
+        return 0.0f;
+    }
+    int min_fill = stats->queue_frames;
+    for (int i = 0; i < stats->history_count; i++) {
+        if (stats->fill_history[i] < min_fill) {
+            min_fill = stats->fill_history[i];
+        }
+    }
+    return (float)min_fill / (float)stats->queue_frames;
+}
+
+float audiostats_latency_ms(const audiostats_t* stats) {
+    CHIPS_ASSERT(stats);
+    return (float)(stats->fill_frames + stats->buffer_frames) * 1000.0f / (float)stats->sample_rate;
+}
+
+bool audiostats_write_json(const audiostats_t* stats, FILE* fp) {
+    CHIPS_ASSERT(stats && fp);
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"sample_rate\": %d,\n", stats->sample_rate);
+    fprintf(fp, "  \"queue_frames\": %d,\n", stats->queue_frames);
+    fprintf(fp, "  \"buffer_frames\": %d,\n", stats->buffer_frames);
+    fprintf(fp, "  \"pushes\": %llu,\n", (unsigned long long)stats->num_pushes);
+    fprintf(fp, "  \"frames_pushed\": %llu,\n", (unsigned long long)stats->frames_pushed);
+    fprintf(fp, "  \"frames_accepted\": %llu,\n", (unsigned long long)stats->frames_accepted);
+    fprintf(fp, "  \"frames_dropped\": %llu,\n", (unsigned long long)stats->frames_dropped);
+    fprintf(fp, "  \"frames_padded\": %llu,\n", (unsigned long long)stats->frames_padded);
+    fprintf(fp, "  \"underruns\": %u,\n", stats->underruns);
+    fprintf(fp, "  \"overruns\": %u,\n", stats->overruns);
+    fprintf(fp, "  \"fill\": %.3f,\n", audiostats_fill(stats));
+    fprintf(fp, "  \"min_fill\": %.3f,\n", audiostats_min_fill(stats));
+    fprintf(fp, "  \"latency_ms\": %.1f,\n", audiostats_latency_ms(stats));
+    fprintf(fp, "  \"fill_history\": [");
+    // oldest first
+    const int first = (stats->history_count < AUDIOSTATS_HISTORY_SIZE) ? 0 : stats->history_pos;
+    for (int i = 0; i < stats->history_count; i++) {
+        fprintf(fp, "%s%d", (i > 0) ? ", " : "", stats->fill_history[(first + i) % AUDIOSTATS_HISTORY_SIZE]);
+    }
+    fprintf(fp, "]\n}\n");
+    return !ferror(fp);
+}
+
+#endif
@@ -0,0 +1,149 @@
+#pragma once
+/*
+    Minimal C64 to run and check SID players: 64 KB RAM, a 6502 and the SID.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    Include the following headers before including c64host.h:
+        - chips/chips_common.h
+        - chips/m6502.h
+        - chips/m6581.h
+        - sequencer.h
+
+    Copy the player into mem, then c64host_start() installs a trampoline in
+    the cassette buffer that calls init once and play in a loop:
+
+        lda #song
+        jsr init
+        loop: jsr play
+        jmp loop
+
+    Every c64host_call() runs up to the next jsr play and returns its cycles,
+    the first one runs init. The SID is selected at $D400-$D7FF (mirrored
+    every 32 bytes), the registers written by a call are kept in
+    writes/write_mask.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define C64HOST_TRAMPOLINE_ADDR (0x0334)
+#define C64HOST_SID_ADDR (0xD400)
+#define C64HOST_PAL_CYCLES_PER_LINE (63)
+#define C64HOST_PAL_CYCLES_PER_FRAME (C64HOST_PAL_CYCLES_PER_LINE * 312)
+#define C64HOST_MAX_CALL_CYCLES (100 * C64HOST_PAL_CYCLES_PER_FRAME)  // give up on a call that takes longer
+
+typedef struct {
+    m6502_t cpu;
+    m6581_t sid;
+    uint64_t pins;
+    uint8_t mem[0x10000];
+    // SID registers written by the last call
+    uint32_t write_mask;
+    uint8_t writes[SID_NUM_REGS];
+    int num_calls;
+} c64host_t;
+
+// clear memory, e.g. before copying the player
+void c64host_init(c64host_t* host);
+// install the trampoline and reset the 6502
+void c64host_start(c64host_t* host, uint16_t init_addr, uint16_t play_addr, uint8_t song);
+// run until play is about to be called again, returns the cycles of the call or -1 on timeout,
+// play calls include their jsr and rts, the init call also the reset of the 6502
+int c64host_call(c64host_t* host);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <string.h>
+
+#define _C64HOST_PLAY_CALL_ADDR (C64HOST_TRAMPOLINE_ADDR + 5)
+
+void c64host_init(c64host_t* host) {
+    CHIPS_ASSERT(host);
+    memset(host, 0, sizeof(c64host_t));
+}
+
+void c64host_start(c64host_t* host, uint16_t init_addr, uint16_t play_addr, uint8_t song) {
+    CHIPS_ASSERT(host);
+    const uint8_t trampoline[] = {
+        0xA9, song,                                                 // lda #song
+        0x20, init_addr & 0xFF, init_addr >> 8,                     // jsr init
+        0x20, play_addr & 0xFF, play_addr >> 8,                     // loop: jsr play
+        0x4C, _C64HOST_PLAY_CALL_ADDR & 0xFF, _C64HOST_PLAY_CALL_ADDR >> 8,    // jmp loop
+    };
+    memcpy(&host->mem[C64HOST_TRAMPOLINE_ADDR], trampoline, sizeof(trampoline));
+    host->mem[0xFFFC] = C64HOST_TRAMPOLINE_ADDR & 0xFF;
+    host->mem[0xFFFD] = C64HOST_TRAMPOLINE_ADDR >> 8;
+    host->num_calls = 0;
+    host->pins = m6502_init(&host->cpu, &(m6502_desc_t){0});
+    m6581_init(&host->sid, &(m6581_desc_t){
+        .tick_hz = 985248,
+        .sound_hz = 48000,
+        .magnitude = 1.0f,
+    });
+}
+
+static void _c64host_tick(c64host_t* host) {
+    uint64_t pins = m6502_tick(&host->cpu, host->pins);
+    const uint16_t addr = M6502_GET_ADDR(pins);
+    const bool sid_selected = ((addr & 0xFC00) == C64HOST_SID_ADDR);
+
+    // the SID is ticked every cycle, chips share the address and data bus pins
+    uint64_t sid_pins = pins & 0xFFFFFFULL;
+    if (pins & M6502_RW) {
+        sid_pins |= M6581_RW;
+    }
+    if (sid_selected) {
+        sid_pins |= M6581_CS;
+    }
+    sid_pins = m6581_tick(&host->sid, sid_pins);
+
+    if (sid_selected) {
+        if (pins & M6502_RW) {
+            M6502_SET_DATA(pins, M6502_GET_DATA(sid_pins));
+        }
+        else {
+            const int reg = addr & 0x1F;
+            if (reg < SID_NUM_REGS) {
+                host->writes[reg] = M6502_GET_DATA(pins);
+                host->write_mask |= 1 << reg;
+            }
+        }
+    }
+    else if (pins & M6502_RW) {
+        M6502_SET_DATA(pins, host->mem[addr]);
+    }
+    else {
+        host->mem[addr] = M6502_GET_DATA(pins);
+    }
+    host->pins = pins;
+}
+
+int c64host_call(c64host_t* host) {
+    CHIPS_ASSERT(host);
+    host->write_mask = 0;
+    for (int cycles = 1; cycles <= C64HOST_MAX_CALL_CYCLES; cycles++) {
+        _c64host_tick(host);
+        if ((host->pins & M6502_SYNC) && (M6502_GET_ADDR(host->pins) == _C64HOST_PLAY_CALL_ADDR)) {
+            // the jmp back to the loop is not part of a play call
+            return (host->num_calls++ > 0) ? (cycles - 3) : cycles;
+        }
+    }
+    return -1;
+}
+
+#endif
@@ -0,0 +1,403 @@
+#pragma once
+/*
+    Patch to C code generator.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    Include the following headers before including codegen.h:
+        - chips/chips_common.h
+        - chips/m6581.h
+        - sequencer.h
+
+    codegen_build() turns the current patch into a standalone C function
+    that does the same as update_variables(), for patches that no longer
+    change:
+
+        void name(int16_t* values, bool* gate_states, int frame);
+
+    values and gate_states are laid out like in sequencer_t, so
+    name(seq->values, seq->gate_states, seq->frame) replaces the
+    update_variables() call of sequencer_advance(), see
+    render_t.update_variables.
+
+    Constant operands are inlined, stages that do nothing (add 0, div 0,
+    mul 0, mod 0, base 0/1, no array) are left out and the sequences follow
+    in evaluation order. Gate updates are resolved when the channel voice
+    is a constant, only variable operands are looked up at run time.
+    The generated code only needs <stdint.h> and <stdbool.h>, the results
+    match the interpreter bit for bit. Only variables A..Z are supported.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CODEGEN_MAX_SOURCE_SIZE (256 * 1024)
+
+typedef struct {
+    const char* name;       // name of the generated function, default "patch_update"
+} codegen_desc_t;
+
+typedef struct {
+    const char* error;      // error message if codegen_build() failed
+    char error_buf[128];
+    int num_operands;       // sequence operands
+    int num_constants;      // of which constant, inlined
+    int num_stages;         // sequence stages
+    int num_removed;        // of which left out
+    int source_size;
+    char source[CODEGEN_MAX_SOURCE_SIZE];  // generated C source
+} codegen_t;
+
+// generate the C source of the update function for the current patch
+bool codegen_build(codegen_t* codegen, sequencer_t* sequencer, const codegen_desc_t* desc);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+static bool _codegen_fail(codegen_t* codegen, const char* message) {
+    snprintf(codegen->error_buf, sizeof(codegen->error_buf), "%s", message);
+    codegen->error = codegen->error_buf;
+    return false;
+}
+
+static bool _codegen_append(codegen_t* codegen, const char* fmt, ...) {
+    if (codegen->error) return false;
+    const int space = CODEGEN_MAX_SOURCE_SIZE - codegen->source_size;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(&codegen->source[codegen->source_size], space, fmt, args);
+    va_end(args);
+    if ((n < 0) || (n >= space)) {
+        return _codegen_fail(codegen, "generated source too large");
+    }
+    codegen->source_size += n;
+    return true;
+}
+
+static bool _codegen_is_variable(char variable) {
+    return (variable >= 'A') && (variable <= 'Z');
+}
+
+// C expression of an operand, str must hold 16 chars
+static const char* _codegen_operand(const var_or_number_t* varonum, char* str) {
+    if (varonum->variable == 0) {
+        snprintf(str, 16, "%d", varonum->number);
+    }
+    else {
+        snprintf(str, 16, "values[%d]", varonum->variable - 'A');
+    }
+    return str;
+}
+
+// C expression of bit 0 of an operand, like the gate test of update_gate_state()
+static const char* _codegen_gate(const var_or_number_t* varonum, char* str) {
+    if (varonum->variable == 0) {
+        return (varonum->number & 1) ? "true" : "false";
+    }
+    snprintf(str, 32, "(values[%d] & 1) != 0", varonum->variable - 'A');
+    return str;
+}
+
+static bool _codegen_is_const(const var_or_number_t* varonum, int16_t number) {
+    return (varonum->variable == 0) && (varonum->number == number);
+}
+
+// gate update of one channel, same as update_gate_state()
+static void _codegen_gate_function(codegen_t* codegen, sequencer_t* sequencer, const char* name, int channel) {
+    char str[32];
+    const var_or_number_t* voice_param = &sequencer->channel_voice_params[channel];
+    _codegen_append(codegen,
+        "static inline void %s_gate_%d(int16_t* values, bool* gate_states) {\n",
+        name, channel);
+    if (voice_param->variable == 0) {
+        const int16_t voice_index = voice_param->number - 1;
+        const bool valid = (voice_index >= 0) && (voice_index < MAX_VOICES);
+        _codegen_append(codegen, "    const bool state = %s;\n",
+            valid ? _codegen_gate(&sequencer->voices[voice_index].gate, str) : "false");
+    }
+    else {
+        _codegen_append(codegen,
+            "    bool state = false;\n"
+            "    switch ((int16_t)(values[%d] - 1)) {\n",
+            voice_param->variable - 'A');
+        for (int v = 0; v < MAX_VOICES; v++) {
+            _codegen_append(codegen, "        case %d: state = %s; break;\n",
+                v, _codegen_gate(&sequencer->voices[v].gate, str));
+        }
+        _codegen_append(codegen, "    }\n");
+    }
+    _codegen_append(codegen,
+        "    if (state != gate_states[%d]) {\n"
+        "        if (state) {\n"
+        "            values[%d] = 0;\n"
+        "            values[%d] += 1;\n"
+        "        }\n"
+        "        gate_states[%d] = state;\n"
+        "    }\n"
+        "}\n\n",
+        channel, 'U' + channel - 'A', 'X' + channel - 'A', channel);
+}
+
+// value = array[floor_mod(value, size)] for a known array
+static void _codegen_array_lookup(codegen_t* codegen, sequencer_t* sequencer, const char* name, int array, const char* indent) {
+    char str[16];
+    const int size = sequencer->array_sizes[array];
+    bool all_const = true;
+    for (int i = 0; i < size; i++) {
+        all_const &= (sequencer->arrays[array][i].variable == 0);
+    }
+    if (all_const) {
+        _codegen_append(codegen, "%sstatic const int16_t array_%d[%d] = {", indent, array + 1, size);
+        for (int i = 0; i < size; i++) {
+            _codegen_append(codegen, "%s%d", (i == 0) ? " " : ", ", sequencer->arrays[array][i].number);
+        }
+        _codegen_append(codegen, " };\n%svalue = array_%d[%s_floor_mod(value, %d)];\n",
+            indent, array + 1, name, size);
+    }
+    else {
+        _codegen_append(codegen, "%sswitch (%s_floor_mod(value, %d)) {\n", indent, name, size);
+        for (int i = 0; i < size; i++) {
+            _codegen_append(codegen, "%s    case %d: value = %s; break;\n",
+                indent, i, _codegen_operand(&sequencer->arrays[array][i], str));
+        }
+        _codegen_append(codegen, "%s}\n", indent);
+    }
+}
+
+// one of the add, div, mul and mod stages, zero operands do nothing
+static void _codegen_stage(codegen_t* codegen, const var_or_number_t* varonum, const char* name, const char* stage) {
+    char str[16];
+    const char* operand = _codegen_operand(varonum, str);
+    codegen->num_stages++;
+    if (_codegen_is_const(varonum, 0)) {
+        codegen->num_removed++;
+        return;
+    }
+    const bool add = (0 == strcmp(stage, "+"));
+    const bool mod = (0 == strcmp(stage, "%"));
+    if (varonum->variable == 0) {
+        if (mod) {
+            _codegen_append(codegen, "        value = %s_floor_mod(value, %s);\n", name, operand);
+        }
+        else {
+            _codegen_append(codegen, "        value = value %s %s;\n", stage, operand);
+        }
+    }
+    else if (add) {
+        _codegen_append(codegen, "        value = value + %s;\n", operand);
+    }
+    else if (mod) {
+        _codegen_append(codegen, "        if (%s != 0) value = %s_floor_mod(value, %s);\n", operand, name, operand);
+    }
+    else {
+        _codegen_append(codegen, "        if (%s != 0) value = value %s %s;\n", operand, stage, operand);
+    }
+}
+
+static void _codegen_sequence(codegen_t* codegen, sequencer_t* sequencer, const char* name, const sequence_t* seq) {
+    char str[16];
+    const int var_index = seq->variable - 'A';
+    const var_or_number_t* operands[] = {
+        &seq->count, &seq->add1, &seq->div1, &seq->mul1, &seq->mod1, &seq->base,
+        &seq->mod2, &seq->mul2, &seq->div2, &seq->add2, &seq->array,
+    };
+    for (int i = 0; i < (int)(sizeof(operands) / sizeof(operands[0])); i++) {
+        codegen->num_operands++;
+        codegen->num_constants += (operands[i]->variable == 0);
+    }
+
+    _codegen_append(codegen, "    // %c\n    {\n        int16_t value = %s;\n",
+        seq->variable, _codegen_operand(&seq->count, str));
+    _codegen_stage(codegen, &seq->add1, name, "+");
+    _codegen_stage(codegen, &seq->div1, name, "/");
+    _codegen_stage(codegen, &seq->mul1, name, "*");
+    _codegen_stage(codegen, &seq->mod1, name, "%");
+
+    codegen->num_stages++;
+    if ((seq->base.variable == 0) && (seq->base.number <= 1)) {
+        codegen->num_removed++;
+    }
+    else {
+        _codegen_append(codegen, "        value = %s_sum_digits(%s, value);\n", name, _codegen_operand(&seq->base, str));
+    }
+
+    _codegen_stage(codegen, &seq->mod2, name, "%");
+    _codegen_stage(codegen, &seq->mul2, name, "*");
+    _codegen_stage(codegen, &seq->div2, name, "/");
+    _codegen_stage(codegen, &seq->add2, name, "+");
+
+    codegen->num_stages++;
+    if (seq->array.variable == 0) {
+        const int16_t array = seq->array.number;
+        if ((array >= 1) && (array <= sequencer->num_arrays) && (sequencer->array_sizes[array - 1] > 0)) {
+            _codegen_array_lookup(codegen, sequencer, name, array - 1, "        ");
+        }
+        else {
+            codegen->num_removed++;
+        }
+    }
+    else {
+        _codegen_append(codegen, "        switch (%s) {\n", _codegen_operand(&seq->array, str));
+        for (int a = 0; a < sequencer->num_arrays; a++) {
+            if (sequencer->array_sizes[a] == 0) continue;
+            _codegen_append(codegen, "            case %d: {\n", a + 1);
+            _codegen_array_lookup(codegen, sequencer, name, a, "                ");
+            _codegen_append(codegen, "            } break;\n");
+        }
+        _codegen_append(codegen, "        }\n");
+    }
+
+    // gate updates of the channels that depend on this variable, before storing it
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+        const var_or_number_t* voice_param = &sequencer->channel_voice_params[channel];
+        if (voice_param->variable == seq->variable) {
+            _codegen_append(codegen, "        %s_gate_%d(values, gate_states);\n", name, channel);
+        }
+        else if (voice_param->variable == 0) {
+            const int16_t voice_index = voice_param->number - 1;
+            if ((voice_index >= 0) && (voice_index < MAX_VOICES) &&
+                (sequencer->voices[voice_index].gate.variable == seq->variable)) {
+                _codegen_append(codegen, "        %s_gate_%d(values, gate_states);\n", name, channel);
+            }
+        }
+        else {
+            bool any = false;
+            for (int v = 0; v < MAX_VOICES; v++) {
+                if (sequencer->voices[v].gate.variable != seq->variable) continue;
+                if (any) {
+                    _codegen_append(codegen, " || voice == %d", v);
+                }
+                else {
+                    _codegen_append(codegen,
+                        "        {\n"
+                        "            const int16_t voice = values[%d] - 1;\n"
+                        "            if (voice == %d", voice_param->variable - 'A', v);
+                }
+                any = true;
+            }
+            if (any) {
+                _codegen_append(codegen, ") %s_gate_%d(values, gate_states);\n        }\n", name, channel);
+            }
+        }
+    }
+    _codegen_append(codegen, "        values[%d] = value;\n    }\n", var_index);
+}
+
+bool codegen_build(codegen_t* codegen, sequencer_t* sequencer, const codegen_desc_t* desc) {
+    CHIPS_ASSERT(codegen && sequencer && desc);
+    memset(codegen, 0, offsetof(codegen_t, source));
+    codegen->source[0] = 0;
+    const char* name = desc->name ? desc->name : "patch_update";
+
+    // the generated code indexes the values array directly
+    for (int s = 0; s < sequencer->num_sequences; s++) {
+        const sequence_t* seq = &sequencer->sequences[s];
+        if (seq->variable == 0) continue;
+        const var_or_number_t* operands[] = {
+            &seq->count, &seq->add1, &seq->div1, &seq->mul1, &seq->mod1, &seq->base,
+            &seq->mod2, &seq->mul2, &seq->div2, &seq->add2, &seq->array,
+        };
+        bool valid = _codegen_is_variable(seq->variable);
+        for (int i = 0; i < (int)(sizeof(operands) / sizeof(operands[0])); i++) {
+            valid &= (operands[i]->variable == 0) || _codegen_is_variable(operands[i]->variable);
+        }
+        if (!valid) {
+            return _codegen_fail(codegen, "only variables A-Z are supported");
+        }
+    }
+    for (int a = 0; a < sequencer->num_arrays; a++) {
+        for (int i = 0; i < sequencer->array_sizes[a]; i++) {
+            const char variable = sequencer->arrays[a][i].variable;
+            if (variable && !_codegen_is_variable(variable)) {
+                return _codegen_fail(codegen, "only variables A-Z are supported");
+            }
+        }
+    }
+    for (int v = 0; v < MAX_VOICES; v++) {
+        const char variable = sequencer->voices[v].gate.variable;
+        if (variable && !_codegen_is_variable(variable)) {
+            return _codegen_fail(codegen, "only variables A-Z are supported");
+        }
+    }
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+        const char variable = sequencer->channel_voice_params[channel].variable;
+        if (variable && !_codegen_is_variable(variable)) {
+            return _codegen_fail(codegen, "only variables A-Z are supported");
+        }
+    }
+
+    _codegen_append(codegen,
+        "// numbersid patch, generated source: same as update_variables() for this patch\n"
+        "#include <stdint.h>\n"
+        "#include <stdbool.h>\n"
+        "\n"
+        "static inline int16_t %s_floor_mod(int16_t value, int16_t mod) {\n"
+        "    int absmod = (mod < 0) ? -mod : mod;\n"
+        "    int result = value %% absmod;\n"
+        "    if (result < 0) result += absmod;\n"
+        "    if (mod < 0) result = absmod - result - 1;\n"
+        "    return result;\n"
+        "}\n"
+        "\n"
+        "static inline int16_t %s_sum_digits(int16_t base, int16_t value) {\n"
+        "    if (base <= 1) return value;\n"
+        "    int16_t remainder = value;\n"
+        "    int16_t sum = 0;\n"
+        "    while (remainder != 0) {\n"
+        "        sum += %s_floor_mod(remainder, base);\n"
+        "        remainder = remainder / base;\n"
+        "    }\n"
+        "    return sum;\n"
+        "}\n"
+        "\n",
+        name, name, name);
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+        _codegen_gate_function(codegen, sequencer, name, channel);
+    }
+
+    _codegen_append(codegen,
+        "void %s(int16_t* values, bool* gate_states, int frame) {\n"
+        "    (void)gate_states;\n"
+        "\n"
+        "    // gate time counters\n"
+        "    const int16_t new_t = frame;\n"
+        "    if ((int)(new_t - values[%d]) == 1) {\n"
+        "        values[%d] += 1;\n"
+        "        values[%d] += 1;\n"
+        "        values[%d] += 1;\n"
+        "    }\n"
+        "    else {\n"
+        "        for (int i = %d; i < %d; i++) {\n"
+        "            values[i] = 0;\n"
+        "        }\n"
+        "    }\n"
+        "    values[%d] = new_t;\n"
+        "\n",
+        name, 'T' - 'A', 'U' - 'A', 'V' - 'A', 'W' - 'A', 'U' - 'A', 'Z' - 'A' + 1, 'T' - 'A');
+    for (int s = 0; s < sequencer->num_sequences; s++) {
+        if (sequencer->sequences[s].variable == 0) continue;
+        _codegen_sequence(codegen, sequencer, name, &sequencer->sequences[s]);
+    }
+    _codegen_append(codegen, "}\n");
+    return codegen->error == 0;
+}
+
+#endif
@@ -0,0 +1,199 @@
+#pragma once
+/*
+    The sequencer engine, and how the UI hands it edits.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    Include the following headers before including engine.h:
+        - chips/chips_common.h
+        - chips/m6581.h
+        - sequencer.h
+        - thread.h
+
+    The UI windows edit a staging sequencer_t, the engine runs its own
+    copy. They only meet through two triple buffers (see thread_tribuf_t),
+    so the engine can run on another thread without locks, and neither
+    side ever sees a half-written patch:
+
+        - engine_publish() (UI thread) copies the staging sequencer into
+          a config buffer, if its patch or runtime state changed since the
+          last publish. A config is not changed after it was published.
+        - engine_step() (engine thread) takes the latest published config
+          at the start of a frame, then runs the frame and publishes its
+          runtime state into a status buffer.
+        - engine_sync() (UI thread) copies the latest status into the
+          staging sequencer, so the windows show the engine's frame and
+          variable values.
+
+    The patch is the part of sequencer_t from voices up to the preview,
+    the runtime state is running, muted, frame, values and gate states.
+    A config replaces the patch of the engine, and its runtime state only
+    if the UI changed that (play, pause, seek, loading a snapshot, ...).
+    Until the engine reported that it took such a config, engine_sync()
+    leaves the runtime state of the staging copy alone, so an edit isn't
+    undone by an older status.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    bool running;
+    bool muted;
+    bool gate_states[NUM_CHANNELS];
+    int frame;
+    int16_t values[MAX_VARIABLES];
+} engine_runtime_t;
+
+typedef struct {
+    sequencer_t sequencer;              // the staging copy when it was published
+    bool runtime;                       // also take the runtime state
+    uint32_t version;
+} engine_config_t;
+
+typedef struct {
+    engine_runtime_t runtime;
+    uint32_t version;                   // version of the last config the engine took
+} engine_status_t;
+
+typedef struct {
+    sequencer_t sequencer;              // engine thread only
+    uint32_t version;                   // engine thread only
+    engine_config_t configs[3];
+    thread_tribuf_t config_buf;
+    engine_status_t status[3];
+    thread_tribuf_t status_buf;
+    // UI thread only
+    struct {
+        sequencer_t published;          // staging copy of the last publish, the patch part is compared
+        engine_runtime_t runtime;       // runtime state of the staging copy after the last publish or sync
+        uint32_t version;               // version of the last publish
+        uint32_t runtime_version;       // version of the last publish that changed the runtime state
+    } ui;
+} engine_t;
+
+// start with the state of a sequencer, which becomes the staging copy
+void engine_init(engine_t* engine, const sequencer_t* staging);
+// UI thread: publish the staging copy if it changed, returns true if it did
+bool engine_publish(engine_t* engine, const sequencer_t* staging);
+// UI thread: copy the latest runtime state of the engine into the staging copy
+void engine_sync(engine_t* engine, sequencer_t* staging);
+// engine thread: take the latest config, run one sequencer frame and publish the runtime state
+void engine_step(engine_t* engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <stddef.h>
+#include <string.h>
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
+
+#define _ENGINE_PATCH_OFFSET (offsetof(sequencer_t, voices))
+#define _ENGINE_PATCH_SIZE (offsetof(sequencer_t, preview) - offsetof(sequencer_t, voices))
+
+static void _engine_get_runtime(engine_runtime_t* rt, const sequencer_t* seq) {
+    // cleared first, runtime states are compared with memcmp()
+    memset(rt, 0, sizeof(engine_runtime_t));
+    rt->running = seq->running;
+    rt->muted = seq->muted;
+    memcpy(rt->gate_states, seq->gate_states, sizeof(rt->gate_states));
+    rt->frame = seq->frame;
+    memcpy(rt->values, seq->values, sizeof(rt->values));
+}
+
+static void _engine_set_runtime(sequencer_t* seq, const engine_runtime_t* rt) {
+    seq->running = rt->running;
+    seq->muted = rt->muted;
+    memcpy(seq->gate_states, rt->gate_states, sizeof(seq->gate_states));
+    seq->frame = rt->frame;
+    memcpy(seq->values, rt->values, sizeof(seq->values));
+}
+
+static bool _engine_patch_equal(const sequencer_t* a, const sequencer_t* b) {
+    return 0 == memcmp((const uint8_t*)a + _ENGINE_PATCH_OFFSET, (const uint8_t*)b + _ENGINE_PATCH_OFFSET, _ENGINE_PATCH_SIZE);
+}
+
+void engine_init(engine_t* engine, const sequencer_t* staging) {
+    CHIPS_ASSERT(engine && staging);
+    memset(engine, 0, sizeof(engine_t));
+    memcpy(&engine->sequencer, staging, sizeof(sequencer_t));
+    memcpy(&engine->ui.published, staging, sizeof(sequencer_t));
+    _engine_get_runtime(&engine->ui.runtime, staging);
+    thread_tribuf_init(&engine->config_buf);
+    thread_tribuf_init(&engine->status_buf);
+}
+
+bool engine_publish(engine_t* engine, const sequencer_t* staging) {
+    CHIPS_ASSERT(engine && staging);
+    engine_runtime_t rt;
+    _engine_get_runtime(&rt, staging);
+    const bool runtime_changed = (0 != memcmp(&rt, &engine->ui.runtime, sizeof(rt)));
+    if (!runtime_changed && _engine_patch_equal(staging, &engine->ui.published)) {
+        return false;
+    }
+    engine->ui.version++;
+    if (runtime_changed) {
+        engine->ui.runtime_version = engine->ui.version;
+        engine->ui.runtime = rt;
+    }
+    engine_config_t* config = &engine->configs[thread_tribuf_write_index(&engine->config_buf)];
+    memcpy(&config->sequencer, staging, sizeof(sequencer_t));
+    config->version = engine->ui.version;
+    // the engine may skip configs, so the runtime state goes along until the engine took it
+    const engine_status_t* status = &engine->status[thread_tribuf_read_index(&engine->status_buf)];
+    config->runtime = (engine->ui.runtime_version != 0) && (status->version < engine->ui.runtime_version);
+    thread_tribuf_publish(&engine->config_buf);
+    memcpy(&engine->ui.published, staging, sizeof(sequencer_t));
+    return true;
+}
+
+void engine_sync(engine_t* engine, sequencer_t* staging) {
+    CHIPS_ASSERT(engine && staging);
+    if (!thread_tribuf_acquire(&engine->status_buf)) {
+        return;
+    }
+    const engine_status_t* status = &engine->status[thread_tribuf_read_index(&engine->status_buf)];
+    if (status->version >= engine->ui.runtime_version) {
+        _engine_set_runtime(staging, &status->runtime);
+        engine->ui.runtime = status->runtime;
+    }
+}
+
+void engine_step(engine_t* engine) {
+    CHIPS_ASSERT(engine);
+    sequencer_t* seq = &engine->sequencer;
+    if (thread_tribuf_acquire(&engine->config_buf)) {
+        const engine_config_t* config = &engine->configs[thread_tribuf_read_index(&engine->config_buf)];
+        memcpy((uint8_t*)seq + _ENGINE_PATCH_OFFSET, (const uint8_t*)&config->sequencer + _ENGINE_PATCH_OFFSET, _ENGINE_PATCH_SIZE);
+        if (config->runtime) {
+            engine_runtime_t rt;
+            _engine_get_runtime(&rt, &config->sequencer);
+            _engine_set_runtime(seq, &rt);
+        }
+        engine->version = config->version;
+    }
+    sequencer_advance(seq);
+
+    engine_status_t* status = &engine->status[thread_tribuf_write_index(&engine->status_buf)];
+    _engine_get_runtime(&status->runtime, seq);
+    status->version = engine->version;
+    thread_tribuf_publish(&engine->status_buf);
+}
+
+#endif
@@ -0,0 +1,370 @@
+#pragma once
+/*
+    Golden output of patches, to check that optimizations don't change
+    what a patch computes or sounds like.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    Include the following headers before including golden.h:
+        - chips/chips_common.h
+        - chips/m6581.h
+        - sequencer.h
+        - lz.h
+
+    Every rendered frame is captured as a golden_frame_t:
+
+        - the variable values after the frame, as they are
+        - a hash of the SID register writes of the frame (the mask and
+          the written registers)
+        - a hash of the audio samples of the frame, as 16-bit integers
+
+    The values are kept as they are instead of hashed, so a difference
+    names the variables that diverged, and the values come first because
+    both other streams follow from them. Comparing two captures reports
+    the first frame that differs.
+
+    Golden file, little-endian:
+
+        header:   'N','S','G','D', version (u8), reserved (u8, u16),
+                  number of entries (u32)
+        entry:    name length (u8), name, binary patch size (u16),
+                  binary patch (see sequencer_export_binary()), number of
+                  frames (u32), size of the frame data (u32), frame data
+
+    Frame data is stored in columns: for every variable its value in all
+    frames, as i16 difference to the frame before, then the register
+    hashes and the audio hashes of all frames as u32, compressed with
+    lz_compress(). Variables that count or hold still compress to almost
+    nothing, the hashes don't compress, a minute of frames takes 30 to
+    100 KB.
+
+    The audio hash depends on the floating point math of the SID
+    emulation, so golden files should be recorded and checked with the
+    same compiler and build configuration.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GOLDEN_VERSION (1)
+#define GOLDEN_HEADER_SIZE (12)
+#define GOLDEN_FRAME_SIZE (MAX_VARIABLES*2 + 8)
+#define GOLDEN_NAME_SIZE (256)          // including the terminating zero
+#define GOLDEN_MAX_FRAMES (1<<20)
+
+typedef struct {
+    int16_t values[MAX_VARIABLES];
+    uint32_t regs_hash;
+    uint32_t audio_hash;
+} golden_frame_t;
+
+typedef enum {
+    GOLDEN_MATCH,
+    GOLDEN_VALUES,
+    GOLDEN_REGS,
+    GOLDEN_AUDIO,
+    GOLDEN_LENGTH,          // one capture has more frames than the other
+} golden_stream_t;
+
+// result of golden_compare()
+typedef struct {
+    golden_stream_t stream;         // first stream that differs in the frame
+    int frame;                      // first frame that differs, -1 on a match
+    uint32_t variables;             // for GOLDEN_VALUES: the variables that differ, bit 0 is A
+    int16_t expected[MAX_VARIABLES];
+    int16_t actual[MAX_VARIABLES];
+} golden_diff_t;
+
+// one patch of a golden file
+typedef struct {
+    char name[GOLDEN_NAME_SIZE];
+    uint8_t patch[SEQUENCER_BINARY_MAX_SIZE];
+    int patch_size;
+    golden_frame_t* frames;         // malloc'ed by golden_read_entry()
+    int num_frames;
+} golden_entry_t;
+
+// 32-bit FNV-1a of size bytes, continuing from hash (start with GOLDEN_HASH_INIT)
+#define GOLDEN_HASH_INIT (2166136261u)
+uint32_t golden_hash(uint32_t hash, const void* data, int size);
+// capture one frame: variable values, SID register writes and audio samples
+void golden_capture(golden_frame_t* frame, const int16_t* values, const uint8_t* regs, uint32_t mask, const float* samples, int num_samples);
+// compare two captures, returns true if they are equal, diff is optional
+bool golden_compare(const golden_frame_t* expected, int num_expected, const golden_frame_t* actual, int num_actual, golden_diff_t* diff);
+// write the header of a golden file with num_entries entries
+bool golden_write_header(FILE* fp, int num_entries);
+bool golden_write_entry(FILE* fp, const char* name, const uint8_t* patch, int patch_size, const golden_frame_t* frames, int num_frames);
+// read the header, returns the number of entries, -1 if it isn't a golden file
+int golden_read_header(FILE* fp);
+// read the next entry, free its frames with golden_entry_discard()
+bool golden_read_entry(FILE* fp, golden_entry_t* entry);
+void golden_entry_discard(golden_entry_t* entry);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <stdlib.h>
+#include <string.h>
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
+
+uint32_t golden_hash(uint32_t hash, const void* data, int size) {
+    const uint8_t* p = (const uint8_t*) data;
+    for (int i = 0; i < size; i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void golden_capture(golden_frame_t* frame, const int16_t* values, const uint8_t* regs, uint32_t mask, const float* samples, int num_samples) {
+    CHIPS_ASSERT(frame && values && regs && (samples || (num_samples == 0)));
+    memcpy(frame->values, values, sizeof(frame->values));
+
+    uint8_t buf[4 + SID_NUM_REGS];
+    int n = 0;
+    for (int i = 0; i < 4; i++) {
+        buf[n++] = (uint8_t)(mask >> (i * 8));
+    }
+    for (int reg = 0; reg < SID_NUM_REGS; reg++) {
+        if (mask & (1u << reg)) {
+            buf[n++] = regs[reg];
+        }
+    }
+    frame->regs_hash = golden_hash(GOLDEN_HASH_INIT, buf, n);
+
+    uint32_t hash = GOLDEN_HASH_INIT;
+    for (int i = 0; i < num_samples; i++) {
+        float s = samples[i] * 32767.0f;
+        s = (s > 32767.0f) ? 32767.0f : (s < -32768.0f) ? -32768.0f : s;
+        const int16_t v = (int16_t)s;
+        const uint8_t b[2] = { (uint8_t)v, (uint8_t)((uint16_t)v >> 8) };
+        hash = golden_hash(hash, b, 2);
+    }
+    frame->audio_hash = hash;
+}
+
+bool golden_compare(const golden_frame_t* expected, int num_expected, const golden_frame_t* actual, int num_actual, golden_diff_t* diff) {
+    CHIPS_ASSERT((expected || (num_expected == 0)) && (actual || (num_actual == 0)));
+    golden_diff_t d;
+    memset(&d, 0, sizeof(d));
+    d.frame = -1;
+    const int num_frames = (num_expected < num_actual) ? num_expected : num_actual;
+    for (int f = 0; f < num_frames; f++) {
+        const golden_frame_t* e = &expected[f];
+        const golden_frame_t* a = &actual[f];
+        for (int v = 0; v < MAX_VARIABLES; v++) {
+            if (e->values[v] != a->values[v]) {
+                d.variables |= 1u << v;
+            }
+        }
+        if (d.variables) {
+            d.stream = GOLDEN_VALUES;
+        }
+        else if (e->regs_hash != a->regs_hash) {
+            d.stream = GOLDEN_REGS;
+        }
+        else if (e->audio_hash != a->audio_hash) {
+            d.stream = GOLDEN_AUDIO;
+        }
+        else {
+            continue;
+        }
+        d.frame = f;
+        memcpy(d.expected, e->values, sizeof(d.expected));
+        memcpy(d.actual, a->values, sizeof(d.actual));
+        break;
+    }
+    if ((d.frame < 0) && (num_expected != num_actual)) {
+        d.stream = GOLDEN_LENGTH;
+        d.frame = num_frames;
+    }
+    if (diff) {
+        *diff = d;
+    }
+    return d.stream == GOLDEN_MATCH;
+}
+
+static void _golden_put(uint8_t* p, uint32_t value, int num_bytes) {
+    for (int i = 0; i < num_bytes; i++) {
+        p[i] = (uint8_t)(value >> (i * 8));
+    }
+}
+
+static uint32_t _golden_get(const uint8_t* p, int num_bytes) {
+    uint32_t value = 0;
+    for (int i = 0; i < num_bytes; i++) {
+        value |= (uint32_t)p[i] << (i * 8);
+    }
+    return value;
+}
+
+// columns: every variable as the difference to the frame before, then both hashes
+static void _golden_pack(const golden_frame_t* frames, int num_frames, uint8_t* raw) {
+    uint8_t* p = raw;
+    for (int v = 0; v < MAX_VARIABLES; v++) {
+        int16_t prev = 0;
+        for (int f = 0; f < num_frames; f++, p += 2) {
+            _golden_put(p, (uint16_t)(frames[f].values[v] - prev), 2);
+            prev = frames[f].values[v];
+        }
+    }
+    for (int f = 0; f < num_frames; f++, p += 4) {
+        _golden_put(p, frames[f].regs_hash, 4);
+    }
+    for (int f = 0; f < num_frames; f++, p += 4) {
+        _golden_put(p, frames[f].audio_hash, 4);
+    }
+}
+
+static void _golden_unpack(const uint8_t* raw, int num_frames, golden_frame_t* frames) {
+    const uint8_t* p = raw;
+    for (int v = 0; v < MAX_VARIABLES; v++) {
+        int16_t prev = 0;
+        for (int f = 0; f < num_frames; f++, p += 2) {
+            prev = (int16_t)(prev + (int16_t)_golden_get(p, 2));
+            frames[f].values[v] = prev;
+        }
+    }
+    for (int f = 0; f < num_frames; f++, p += 4) {
+        frames[f].regs_hash = _golden_get(p, 4);
+    }
+    for (int f = 0; f < num_frames; f++, p += 4) {
+        frames[f].audio_hash = _golden_get(p, 4);
+    }
+}
+
+static bool _golden_write_u32(FILE* fp, uint32_t value) {
+    uint8_t b[4];
+    _golden_put(b, value, 4);
+    return fwrite(b, 4, 1, fp) == 1;
+}
+
+static bool _golden_read_u32(FILE* fp, uint32_t* value) {
+    uint8_t b[4];
+    if (fread(b, 4, 1, fp) != 1) {
+        return false;
+    }
+    *value = _golden_get(b, 4);
+    return true;
+}
+
+bool golden_write_header(FILE* fp, int num_entries) {
+    CHIPS_ASSERT(fp && (num_entries >= 0));
+    uint8_t header[GOLDEN_HEADER_SIZE] = { 'N', 'S', 'G', 'D', GOLDEN_VERSION, 0, 0, 0 };
+    _golden_put(&header[8], (uint32_t)num_entries, 4);
+    return fwrite(header, sizeof(header), 1, fp) == 1;
+}
+
+bool golden_write_entry(FILE* fp, const char* name, const uint8_t* patch, int patch_size, const golden_frame_t* frames, int num_frames) {
+    CHIPS_ASSERT(fp && name && patch && (patch_size > 0) && (patch_size <= 0xFFFF));
+    CHIPS_ASSERT((frames || (num_frames == 0)) && (num_frames >= 0) && (num_frames <= GOLDEN_MAX_FRAMES));
+    const size_t name_len = strlen(name);
+    if (name_len >= GOLDEN_NAME_SIZE) {
+        return false;
+    }
+    const int raw_size = num_frames * GOLDEN_FRAME_SIZE;
+    uint8_t* raw = malloc(raw_size ? raw_size : 1);
+    uint8_t* packed = malloc(LZ_BOUND(raw_size));
+    bool ok = raw && packed;
+    int packed_size = 0;
+    if (ok) {
+        _golden_pack(frames, num_frames, raw);
+        packed_size = lz_compress(raw, raw_size, packed, LZ_BOUND(raw_size));
+        ok = (packed_size > 0);
+    }
+    const uint8_t name_size = (uint8_t)name_len;
+    const uint8_t patch_size_le[2] = { (uint8_t)patch_size, (uint8_t)(patch_size >> 8) };
+    ok = ok && (fwrite(&name_size, 1, 1, fp) == 1);
+    ok = ok && (fwrite(name, 1, name_len, fp) == name_len);
+    ok = ok && (fwrite(patch_size_le, 2, 1, fp) == 1);
+    ok = ok && (fwrite(patch, patch_size, 1, fp) == 1);
+    ok = ok && _golden_write_u32(fp, (uint32_t)num_frames);
+    ok = ok && _golden_write_u32(fp, (uint32_t)packed_size);
+    ok = ok && (fwrite(packed, packed_size, 1, fp) == 1);
+    free(packed);
+    free(raw);
+    return ok;
+}
+
+int golden_read_header(FILE* fp) {
+    CHIPS_ASSERT(fp);
+    uint8_t header[GOLDEN_HEADER_SIZE];
+    if (fread(header, sizeof(header), 1, fp) != 1) {
+        return -1;
+    }
+    if ((0 != memcmp(header, "NSGD", 4)) || (header[4] != GOLDEN_VERSION)) {
+        return -1;
+    }
+    const uint32_t num_entries = _golden_get(&header[8], 4);
+    return (num_entries <= 0x7FFFFFFF) ? (int)num_entries : -1;
+}
+
+bool golden_read_entry(FILE* fp, golden_entry_t* entry) {
+    CHIPS_ASSERT(fp && entry);
+    memset(entry, 0, sizeof(golden_entry_t));
+    uint8_t name_size = 0;
+    uint8_t patch_size_le[2];
+    uint32_t num_frames = 0;
+    uint32_t packed_size = 0;
+    if ((fread(&name_size, 1, 1, fp) != 1) || (fread(entry->name, 1, name_size, fp) != name_size)) {
+        return false;
+    }
+    if (fread(patch_size_le, 2, 1, fp) != 1) {
+        return false;
+    }
+    entry->patch_size = (int)_golden_get(patch_size_le, 2);
+    if ((entry->patch_size == 0) || (entry->patch_size > SEQUENCER_BINARY_MAX_SIZE)) {
+        return false;
+    }
+    if (fread(entry->patch, entry->patch_size, 1, fp) != 1) {
+        return false;
+    }
+    if (!_golden_read_u32(fp, &num_frames) || !_golden_read_u32(fp, &packed_size)) {
+        return false;
+    }
+    if ((num_frames > GOLDEN_MAX_FRAMES) || (packed_size > (uint32_t)LZ_BOUND(GOLDEN_MAX_FRAMES * GOLDEN_FRAME_SIZE))) {
+        return false;
+    }
+    const int raw_size = (int)num_frames * GOLDEN_FRAME_SIZE;
+    uint8_t* packed = malloc(packed_size ? packed_size : 1);
+    uint8_t* raw = malloc(raw_size ? raw_size : 1);
+    entry->frames = malloc(num_frames ? num_frames * sizeof(golden_frame_t) : 1);
+    bool ok = packed && raw && entry->frames;
+    ok = ok && (fread(packed, packed_size, 1, fp) == 1);
+    ok = ok && (lz_decompress(packed, (int)packed_size, raw, raw_size) == raw_size);
+    if (ok) {
+        _golden_unpack(raw, (int)num_frames, entry->frames);
+        entry->num_frames = (int)num_frames;
+    }
+    free(raw);
+    free(packed);
+    if (!ok) {
+        golden_entry_discard(entry);
+    }
+    return ok;
+}
+
+void golden_entry_discard(golden_entry_t* entry) {
+    CHIPS_ASSERT(entry);
+    free(entry->frames);
+    entry->frames = 0;
+    entry->num_frames = 0;
+}
+
+#endif
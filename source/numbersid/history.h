@@ -0,0 +1,269 @@
+#pragma once
+/*
+    Undo and redo of sequencer edits.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    Include the following headers before including history.h:
+        - sequencer.h
+
+    Only the configuration of the sequencer is tracked: voices, channels,
+    filter, volume, sequences and arrays (the bytes of sequencer_t from
+    voices up to preview). Time control, the preview and the variable
+    values are not part of the history.
+
+    history_commit() compares the configuration with a copy of the last
+    committed one and stores the changed byte runs as one step, with the
+    old and the new bytes of every run:
+
+        run:    offset (u16), length (u16), old bytes, new bytes
+
+    Steps live in a ring buffer of HISTORY_BUFFER_SIZE bytes, the oldest
+    steps are dropped when it is full, so a single parameter tweak costs
+    about a dozen bytes and thousands of them fit. Undo and redo copy the
+    bytes of one step back, so their cost only depends on the size of
+    the step.
+
+    Call history_commit() when an edit is complete, for instance when no
+    UI item is active anymore, so a dragged slider becomes one step.
+    Changes made outside the UI (loading a snapshot or a patch) become
+    steps as well.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HISTORY_BUFFER_SIZE (64 * 1024)     // must be a power of two
+#define HISTORY_MAX_STEPS (4096)            // must be a power of two
+#define HISTORY_CONFIG_OFFSET (offsetof(sequencer_t, voices))
+#define HISTORY_CONFIG_SIZE (offsetof(sequencer_t, preview) - offsetof(sequencer_t, voices))
+
+typedef struct {
+    uint32_t start;                 // position of the first byte in the ring
+    uint32_t size;
+} history_step_t;
+
+typedef struct {
+    uint32_t first;                 // oldest step that can be undone
+    uint32_t cursor;                // steps before the cursor can be undone, from the cursor on redone
+    uint32_t last;                  // one past the newest step
+    uint32_t tail;                  // ring position of the oldest byte, steps count up and wrap
+    history_step_t steps[HISTORY_MAX_STEPS];
+    uint8_t buffer[HISTORY_BUFFER_SIZE];
+    uint8_t config[HISTORY_CONFIG_SIZE];    // configuration after the last step
+} history_t;
+
+// start with an empty history, at the current configuration
+void history_init(history_t* history, const sequencer_t* sequencer);
+// record the changes since the last step, returns false if nothing changed
+bool history_commit(history_t* history, const sequencer_t* sequencer);
+// undo the last step, returns false if there is none
+bool history_undo(history_t* history, sequencer_t* sequencer);
+// redo the last undone step, returns false if there is none
+bool history_redo(history_t* history, sequencer_t* sequencer);
+bool history_can_undo(const history_t* history);
+bool history_can_redo(const history_t* history);
+// number of undoable steps and the bytes they use
+int history_num_steps(const history_t* history);
+int history_num_bytes(const history_t* history);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <string.h>
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
+
+#define _HISTORY_RUN_HEADER_SIZE (4)
+#define _HISTORY_MAX_GAP (4)        // equal bytes that are cheaper to store than a new run header
+
+typedef char _history_config_size_check[(HISTORY_CONFIG_SIZE <= 0xFFFF) ? 1 : -1];
+typedef char _history_buffer_size_check[((HISTORY_BUFFER_SIZE & (HISTORY_BUFFER_SIZE - 1)) == 0) ? 1 : -1];
+typedef char _history_max_steps_check[((HISTORY_MAX_STEPS & (HISTORY_MAX_STEPS - 1)) == 0) ? 1 : -1];
+
+static const uint8_t* _history_config(const sequencer_t* sequencer) {
+    return (const uint8_t*)sequencer + HISTORY_CONFIG_OFFSET;
+}
+
+static history_step_t* _history_step(history_t* history, uint32_t step) {
+    return &history->steps[step & (HISTORY_MAX_STEPS - 1)];
+}
+
+// end of the newest step that is kept, where the next one starts
+static uint32_t _history_head(const history_t* history) {
+    if (history->cursor == history->first) {
+        return history->tail;
+    }
+    const history_step_t* step = &history->steps[(history->cursor - 1) & (HISTORY_MAX_STEPS - 1)];
+    return step->start + step->size;
+}
+
+static void _history_write(history_t* history, uint32_t* pos, const uint8_t* src, int size) {
+    for (int i = 0; i < size; i++) {
+        history->buffer[(*pos)++ & (HISTORY_BUFFER_SIZE - 1)] = src[i];
+    }
+}
+
+static void _history_write_u16(history_t* history, uint32_t* pos, int value) {
+    const uint8_t bytes[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+    _history_write(history, pos, bytes, 2);
+}
+
+static int _history_read_u16(const history_t* history, uint32_t* pos) {
+    const int lo = history->buffer[(*pos)++ & (HISTORY_BUFFER_SIZE - 1)];
+    const int hi = history->buffer[(*pos)++ & (HISTORY_BUFFER_SIZE - 1)];
+    return lo | (hi << 8);
+}
+
+// size of the runs of changed bytes from a to b, written at pos if it is set,
+// runs with a few equal bytes in between are merged
+static int _history_diff(const uint8_t* a, const uint8_t* b, history_t* history, uint32_t* pos) {
+    int size = 0;
+    int i = 0;
+    while (i < (int)HISTORY_CONFIG_SIZE) {
+        if (a[i] == b[i]) {
+            i++;
+            continue;
+        }
+        int end = i + 1;
+        for (int j = end; (j < (int)HISTORY_CONFIG_SIZE) && (j - end < _HISTORY_MAX_GAP); j++) {
+            if (a[j] != b[j]) {
+                end = j + 1;
+            }
+        }
+        const int length = end - i;
+        if (pos) {
+            _history_write_u16(history, pos, i);
+            _history_write_u16(history, pos, length);
+            _history_write(history, pos, &a[i], length);
+            _history_write(history, pos, &b[i], length);
+        }
+        size += _HISTORY_RUN_HEADER_SIZE + 2 * length;
+        i = end;
+    }
+    return size;
+}
+
+// copy the old or the new bytes of a step into the sequencer and the committed configuration
+static void _history_apply(history_t* history, sequencer_t* sequencer, const history_step_t* step, bool redo) {
+    uint8_t* config = (uint8_t*)sequencer + HISTORY_CONFIG_OFFSET;
+    uint32_t pos = step->start;
+    const uint32_t end = step->start + step->size;
+    while (pos != end) {
+        const int offset = _history_read_u16(history, &pos);
+        const int length = _history_read_u16(history, &pos);
+        CHIPS_ASSERT(offset + length <= (int)HISTORY_CONFIG_SIZE);
+        if (redo) {
+            pos += (uint32_t)length;
+        }
+        for (int i = 0; i < length; i++) {
+            config[offset + i] = history->buffer[pos++ & (HISTORY_BUFFER_SIZE - 1)];
+        }
+        if (!redo) {
+            pos += (uint32_t)length;
+        }
+        memcpy(&history->config[offset], &config[offset], (size_t)length);
+    }
+}
+
+void history_init(history_t* history, const sequencer_t* sequencer) {
+    CHIPS_ASSERT(history && sequencer);
+    history->first = history->cursor = history->last = 0;
+    history->tail = 0;
+    memcpy(history->config, _history_config(sequencer), HISTORY_CONFIG_SIZE);
+}
+
+bool history_commit(history_t* history, const sequencer_t* sequencer) {
+    CHIPS_ASSERT(history && sequencer);
+    const uint8_t* config = _history_config(sequencer);
+    if (0 == memcmp(history->config, config, HISTORY_CONFIG_SIZE)) {
+        return false;
+    }
+    const int size = _history_diff(history->config, config, 0, 0);
+    if (size > HISTORY_BUFFER_SIZE) {
+        // too large to undo, start over
+        history_init(history, sequencer);
+        return false;
+    }
+    // a new step replaces the undone ones, old steps make room
+    uint32_t start = _history_head(history);
+    history->last = history->cursor;
+    while ((history->first != history->last) &&
+           ((start + (uint32_t)size - history->tail > HISTORY_BUFFER_SIZE) || (history->last - history->first >= HISTORY_MAX_STEPS)))
+    {
+        history->first++;
+        history->tail = (history->first == history->last) ? start : _history_step(history, history->first)->start;
+    }
+    history_step_t* step = _history_step(history, history->last);
+    step->start = start;
+    step->size = (uint32_t)size;
+    _history_diff(history->config, config, history, &start);
+    CHIPS_ASSERT(start == step->start + step->size);
+    history->cursor = ++history->last;
+    memcpy(history->config, config, HISTORY_CONFIG_SIZE);
+    return true;
+}
+
+bool history_undo(history_t* history, sequencer_t* sequencer) {
+    CHIPS_ASSERT(history && sequencer);
+    // edits since the last commit are undone first
+    history_commit(history, sequencer);
+    if (!history_can_undo(history)) {
+        return false;
+    }
+    history->cursor--;
+    _history_apply(history, sequencer, _history_step(history, history->cursor), false);
+    return true;
+}
+
+bool history_redo(history_t* history, sequencer_t* sequencer) {
+    CHIPS_ASSERT(history && sequencer);
+    if (!history_can_redo(history)) {
+        return false;
+    }
+    // redo steps are dropped by an edit since the last commit
+    if (history_commit(history, sequencer)) {
+        return false;
+    }
+    _history_apply(history, sequencer, _history_step(history, history->cursor), true);
+    history->cursor++;
+    return true;
+}
+
+bool history_can_undo(const history_t* history) {
+    CHIPS_ASSERT(history);
+    return history->cursor != history->first;
+}
+
+bool history_can_redo(const history_t* history) {
+    CHIPS_ASSERT(history);
+    return history->cursor != history->last;
+}
+
+int history_num_steps(const history_t* history) {
+    CHIPS_ASSERT(history);
+    return (int)(history->cursor - history->first);
+}
+
+int history_num_bytes(const history_t* history) {
+    CHIPS_ASSERT(history);
+    return (int)(_history_head(history) - history->tail);
+}
+
+#endif
@@ -0,0 +1,189 @@
+#pragma once
+/*
+    Small LZ77 byte compressor, used for snapshot screenshots.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    Compressed data is a list of sequences, in the style of LZ4:
+
+        token       literal count (high nibble), match length - 4 (low nibble)
+        count       if the literal count nibble is 15: more bytes of up to
+                    255 that are added to it, the last one is less than 255
+        literals
+        offset      u16 little-endian, distance back to the match (1..65535)
+        length      if the match length nibble is 15: more bytes like count
+
+    The last sequence only has literals and ends the data. Matches are
+    found with a single hash table probe per position, which is fast and
+    good enough for images with long runs and repeated rows, such as the
+    spectrogram. Both functions are reentrant, the hash table lives on
+    the stack.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// max size of the compressed data for size input bytes
+#define LZ_BOUND(size) ((size) + (size) / 255 + 16)
+
+// returns the compressed size, 0 if dst is too small
+int lz_compress(const uint8_t* src, int src_size, uint8_t* dst, int dst_size);
+// returns the decompressed size, -1 if the data is invalid or does not fit into dst
+int lz_decompress(const uint8_t* src, int src_size, uint8_t* dst, int dst_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <string.h>
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
+
+#define _LZ_HASH_BITS (12)
+#define _LZ_MIN_MATCH (4)
+#define _LZ_MAX_OFFSET (65535)
+
+static uint32_t _lz_read32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t _lz_hash(uint32_t value) {
+    return (value * 2654435761u) >> (32 - _LZ_HASH_BITS);
+}
+
+static uint8_t* _lz_put_length(uint8_t* dst, int length) {
+    while (length >= 255) {
+        *dst++ = 255;
+        length -= 255;
+    }
+    *dst++ = (uint8_t)length;
+    return dst;
+}
+
+// literals and an optional match, returns 0 if it does not fit
+static uint8_t* _lz_put_sequence(uint8_t* dst, const uint8_t* dst_end, const uint8_t* literals, int num_literals, int offset, int match_length) {
+    // worst case size of the sequence
+    if (dst_end - dst < 1 + num_literals / 255 + 1 + num_literals + 2 + match_length / 255 + 1) {
+        return 0;
+    }
+    const int match_code = match_length ? (match_length - _LZ_MIN_MATCH) : 0;
+    uint8_t* token = dst++;
+    *token = (uint8_t)(((num_literals < 15) ? num_literals : 15) << 4);
+    if (num_literals >= 15) {
+        dst = _lz_put_length(dst, num_literals - 15);
+    }
+    memcpy(dst, literals, num_literals);
+    dst += num_literals;
+    if (match_length) {
+        *token |= (uint8_t)((match_code < 15) ? match_code : 15);
+        *dst++ = (uint8_t)offset;
+        *dst++ = (uint8_t)(offset >> 8);
+        if (match_code >= 15) {
+            dst = _lz_put_length(dst, match_code - 15);
+        }
+    }
+    return dst;
+}
+
+int lz_compress(const uint8_t* src, int src_size, uint8_t* dst, int dst_size) {
+    CHIPS_ASSERT(src && dst && (src_size >= 0));
+    int table[1 << _LZ_HASH_BITS];
+    memset(table, 0xFF, sizeof(table));
+    const uint8_t* dst_end = dst + dst_size;
+    uint8_t* out = dst;
+    int anchor = 0;         // first literal of the current sequence
+    int pos = 0;
+    // the last bytes are always literals, so the match search can read 4 bytes
+    const int match_limit = src_size - _LZ_MIN_MATCH;
+    while (pos < match_limit) {
+        const uint32_t value = _lz_read32(&src[pos]);
+        const uint32_t h = _lz_hash(value);
+        const int candidate = table[h];
+        table[h] = pos;
+        if ((candidate < 0) || (pos - candidate > _LZ_MAX_OFFSET) || (_lz_read32(&src[candidate]) != value)) {
+            pos++;
+            continue;
+        }
+        int length = _LZ_MIN_MATCH;
+        while ((pos + length < src_size) && (src[candidate + length] == src[pos + length])) {
+            length++;
+        }
+        out = _lz_put_sequence(out, dst_end, &src[anchor], pos - anchor, pos - candidate, length);
+        if (!out) {
+            return 0;
+        }
+        pos += length;
+        anchor = pos;
+    }
+    out = _lz_put_sequence(out, dst_end, &src[anchor], src_size - anchor, 0, 0);
+    return out ? (int)(out - dst) : 0;
+}
+
+static bool _lz_get_length(const uint8_t** src, const uint8_t* src_end, int* length) {
+    uint8_t byte;
+    do {
+        if (*src >= src_end) {
+            return false;
+        }
+        byte = *(*src)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+int lz_decompress(const uint8_t* src, int src_size, uint8_t* dst, int dst_size) {
+    CHIPS_ASSERT(src && dst);
+    const uint8_t* src_end = src + src_size;
+    int pos = 0;
+    while (src < src_end) {
+        const uint8_t token = *src++;
+        int num_literals = token >> 4;
+        if ((num_literals == 15) && !_lz_get_length(&src, src_end, &num_literals)) {
+            return -1;
+        }
+        if ((num_literals > src_end - src) || (num_literals > dst_size - pos)) {
+            return -1;
+        }
+        memcpy(&dst[pos], src, num_literals);
+        src += num_literals;
+        pos += num_literals;
+        if (src == src_end) {
+            // the last sequence has no match
+            break;
+        }
+        if (src_end - src < 2) {
+            return -1;
+        }
+        const int offset = src[0] | (src[1] << 8);
+        src += 2;
+        int length = token & 15;
+        if ((length == 15) && !_lz_get_length(&src, src_end, &length)) {
+            return -1;
+        }
+        length += _LZ_MIN_MATCH;
+        if ((offset == 0) || (offset > pos) || (length > dst_size - pos)) {
+            return -1;
+        }
+        // byte by byte, matches may overlap
+        for (int i = 0; i < length; i++, pos++) {
+            dst[pos] = dst[pos - offset];
+        }
+    }
+    return pos;
+}
+
+#endif
@@ -0,0 +1,415 @@
+/*
+    Numbersid microbenchmarks.
+
+    Times the hot paths of the sequencer, the SID emulation and the FFT in
+    isolation, and writes the results as JSON to track them over time.
+
+    Usage:
+
+        numbersid-bench [json=out.json] [filter=name] [min-time=0.2]
+                        [repeat=5] [patch=file|-] [list]
+
+    - json:     write the results to a JSON file
+    - filter:   only run the benchmarks with this text in their name
+    - min-time: seconds to run every sample of a benchmark
+    - repeat:   number of samples, the median is reported
+    - patch:    benchmark with this patch instead of the built-in one with
+                64 sequences, 16 voices and 16 arrays
+    - list:     print the names of the benchmarks and exit
+
+    A benchmark runs an operation (one call of the benchmarked function,
+    e.g. one sequence update or one FFT) in a loop. The number of
+    operations is calibrated first so one sample takes min-time, then
+    every sample reports the time per operation, in nanoseconds, and on
+    x86 the time stamp counter ticks per operation as 'cycles'. The TSC
+    runs at a fixed rate, so with turbo or power saving it isn't exactly
+    the core clock, but it is stable across runs on the same machine.
+
+    The JSON file holds one object per benchmark with its name, the
+    number of operations per sample, ns/op as median and minimum of the
+    samples, and cycles/op (null without a cycle counter):
+
+        { "version": 1, "cycle_counter": "tsc", "min_time": 0.2, "repeat": 5,
+          "results": [
+            { "name": "update_variables", "ops": 2097152,
+              "ns_per_op": 98.1, "ns_per_op_min": 97.6, "cycles_per_op": 294.3 },
+            ...
+          ] }
+
+    ## zlib/libpng license
+
+    Copyright (c) 2025 Rick van der Meiden
+
+    This software is provided 'as-is', without any express or implied warranty.
+    In no event will the authors be held liable for any damages arising from the
+    use of this software.
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+        1. The origin of this software must not be misrepresented; you must not
+        claim that you wrote the original software. If you use this software in a
+        product, an acknowledgment in the product documentation would be
+        appreciated but is not required.
+        2. Altered source versions must be plainly marked as such, and must not
+        be misrepresented as being the original software.
+        3. This notice may not be removed or altered from any source
+        distribution.
+*/
+
+#define CHIPS_IMPL
+#include "chips/chips_common.h"
+#include "chips/m6581.h"
+
+#define SOKOL_ARGS_IMPL
+#include "sokol_args.h"
+#define SOKOL_TIME_IMPL
+#include "sokol_time.h"
+
+#include "sequencer.h"
+#include "render.h"
+#include "patchgen.h"
+#include "lamefft.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define BENCH_CYCLE_COUNTER "tsc"
+    #define bench_cycles() __rdtsc()
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <intrin.h>
+    #define BENCH_CYCLE_COUNTER "tsc"
+    #define bench_cycles() __rdtsc()
+#else
+    #define BENCH_CYCLE_COUNTER 0
+    #define bench_cycles() (0)
+#endif
+
+#define MAX_REPEAT (32)
+#define MAX_RESULTS (64)
+#define EXPORT_BUFFER_SIZE (64*1024)    // same as the Data window
+
+typedef struct {
+    const char* name;
+    void (*run)(int param, uint64_t num_ops);
+    int param;
+} bench_t;
+
+typedef struct {
+    char name[64];
+    uint64_t ops;
+    double ns_per_op;
+    double ns_per_op_min;
+    double cycles_per_op;
+} bench_result_t;
+
+static struct {
+    sequencer_t patch;          // the benchmarked patch, copied into sequencer before every benchmark
+    sequencer_t sequencer;
+    render_t render;
+    double fft_input[FFT_MAX];
+    double fft_buffer[FFT_MAX];
+    char text[EXPORT_BUFFER_SIZE];
+    uint8_t binary[SEQUENCER_BINARY_MAX_SIZE];
+    int binary_size;
+    bench_result_t results[MAX_RESULTS];
+    int num_results;
+} state;
+
+// results are written here, so the compiler can't drop the benchmarked calls
+static volatile uint32_t bench_sink;
+
+/*== BENCHMARKS ==============================================================*/
+
+static void bench_update_sequence(int param, uint64_t num_ops) {
+    sequencer_t* seq = &state.sequencer;
+    const int num_sequences = seq->num_sequences ? seq->num_sequences : 1;
+    int i = 0;
+    for (uint64_t op = 0; op < num_ops; op++) {
+        update_sequence(&seq->sequences[i], seq);
+        if (++i == num_sequences) {
+            i = 0;
+            seq->values['T'-'A']++;
+        }
+    }
+    bench_sink = (uint32_t)seq->values[0];
+}
+
+static void bench_update_variables(int param, uint64_t num_ops) {
+    sequencer_t* seq = &state.sequencer;
+    for (uint64_t op = 0; op < num_ops; op++) {
+        update_variables(seq, seq->frame++);
+    }
+    bench_sink = (uint32_t)seq->values[0];
+}
+
+static void bench_update_preview(int param, uint64_t num_ops) {
+    sequencer_t* seq = &state.sequencer;
+    seq->preview.step = param;
+    for (uint64_t op = 0; op < num_ops; op++) {
+        sequencer_update_preview(seq);
+        seq->frame++;
+    }
+    bench_sink = (uint32_t)seq->preview.values[NUM_PREVIEW_ROWS-1][0];
+}
+
+static void bench_compute_freq(int param, uint64_t num_ops) {
+    sequencer_t* seq = &state.sequencer;
+    const int num_voices = seq->num_voices ? seq->num_voices : 1;
+    uint32_t sum = 0;
+    int v = 0;
+    for (uint64_t op = 0; op < num_ops; op++) {
+        sum += compute_freq(seq, v);
+        if (++v == num_voices) {
+            v = 0;
+            update_variables(seq, seq->frame++);
+        }
+    }
+    bench_sink = sum;
+}
+
+static void bench_m6581_tick(int param, uint64_t num_ops) {
+    m6581_t* sid = &state.render.sid;
+    uint64_t pins = state.render.pins;
+    float sum = 0.0f;
+    for (uint64_t op = 0; op < num_ops; op++) {
+        pins = m6581_tick(sid, pins);
+        if (pins & M6581_SAMPLE) {
+            sum += sid->sample;
+        }
+    }
+    state.render.pins = pins;
+    bench_sink = (uint32_t)(sum != 0.0f);
+}
+
+static void bench_fft(int param, uint64_t num_ops) {
+    // C_FFT_real() works in place, the copy of the input is part of every operation
+    for (uint64_t op = 0; op < num_ops; op++) {
+        memcpy(state.fft_buffer, state.fft_input, param * sizeof(double));
+        C_FFT_real(state.fft_buffer, param);
+    }
+    bench_sink = (uint32_t)state.fft_buffer[1];
+}
+
+static void bench_export_data(int param, uint64_t num_ops) {
+    for (uint64_t op = 0; op < num_ops; op++) {
+        sequencer_export_data(&state.sequencer, state.text, sizeof(state.text), 4);
+    }
+    bench_sink = (uint32_t)state.text[0];
+}
+
+static void bench_import_data(int param, uint64_t num_ops) {
+    bool ok = true;
+    for (uint64_t op = 0; op < num_ops; op++) {
+        ok = sequencer_import_data(&state.sequencer, state.text, 0) && ok;
+    }
+    bench_sink = ok;
+}
+
+static void bench_export_binary(int param, uint64_t num_ops) {
+    int size = 0;
+    for (uint64_t op = 0; op < num_ops; op++) {
+        size = sequencer_export_binary(&state.sequencer, state.binary, sizeof(state.binary));
+    }
+    bench_sink = (uint32_t)size;
+}
+
+static void bench_import_binary(int param, uint64_t num_ops) {
+    bool ok = true;
+    for (uint64_t op = 0; op < num_ops; op++) {
+        ok = sequencer_import_binary(&state.sequencer, state.binary, state.binary_size) && ok;
+    }
+    bench_sink = ok;
+}
+
+static const bench_t benchmarks[] = {
+    { "update_sequence", bench_update_sequence, 0 },
+    { "update_variables", bench_update_variables, 0 },
+    { "update_preview/step=1", bench_update_preview, 1 },
+    { "update_preview/step=4", bench_update_preview, 4 },
+    { "update_preview/step=16", bench_update_preview, 16 },
+    { "update_preview/step=64", bench_update_preview, 64 },
+    { "compute_freq", bench_compute_freq, 0 },
+    { "m6581_tick", bench_m6581_tick, 0 },
+    { "fft/16", bench_fft, 16 },
+    { "fft/32", bench_fft, 32 },
+    { "fft/64", bench_fft, 64 },
+    { "fft/128", bench_fft, 128 },
+    { "fft/256", bench_fft, 256 },
+    { "fft/512", bench_fft, 512 },
+    { "fft/1024", bench_fft, 1024 },
+    { "export_data", bench_export_data, 0 },
+    { "import_data", bench_import_data, 0 },
+    { "export_binary", bench_export_binary, 0 },
+    { "import_binary", bench_import_binary, 0 },
+};
+#define NUM_BENCHMARKS ((int)(sizeof(benchmarks) / sizeof(benchmarks[0])))
+
+/*== RUNNER ==================================================================*/
+
+// every benchmark starts from the same state, so the results don't depend on the order
+static void bench_reset(void) {
+    state.sequencer = state.patch;
+    update_variables(&state.sequencer, state.sequencer.frame);
+    sequencer_export_data(&state.sequencer, state.text, sizeof(state.text), 4);
+    state.binary_size = sequencer_export_binary(&state.sequencer, state.binary, sizeof(state.binary));
+    // a second of audio, so the envelopes are running
+    render_init(&state.render);
+    state.render.sequencer = state.patch;
+    static float samples[RENDER_MAX_FRAME_SAMPLES];
+    for (int i = 0; i < RENDER_FRAME_HZ; i++) {
+        render_frame(&state.render, samples, RENDER_MAX_FRAME_SAMPLES);
+    }
+    // a sweep with some noise, like the audio the FFT display gets
+    uint32_t rnd = 0x12345678;
+    for (int i = 0; i < FFT_MAX; i++) {
+        rnd = rnd * 1664525u + 1013904223u;
+        state.fft_input[i] = (double)((i * i) % 97) / 97.0 - 0.5 + (double)(rnd >> 24) / 1024.0;
+    }
+}
+
+static int compare_double(const void* a, const void* b) {
+    const double da = *(const double*)a;
+    const double db = *(const double*)b;
+    return (da < db) ? -1 : (da > db) ? 1 : 0;
+}
+
+static void bench_run(const bench_t* bench, double min_time, int repeat) {
+    bench_reset();
+    // calibrate: double the number of operations until a sample takes long enough
+    uint64_t num_ops = 1;
+    for (;;) {
+        const uint64_t t = stm_now();
+        bench->run(bench->param, num_ops);
+        const double sec = stm_sec(stm_since(t));
+        if (sec >= min_time) {
+            break;
+        }
+        if (sec < min_time / 16.0) {
+            num_ops *= 2;
+        }
+        else {
+            num_ops = (uint64_t)((double)num_ops * min_time / sec) + 1;
+        }
+    }
+    double ns[MAX_REPEAT];
+    double cycles[MAX_REPEAT];
+    for (int i = 0; i < repeat; i++) {
+        const uint64_t t = stm_now();
+        const uint64_t c = bench_cycles();
+        bench->run(bench->param, num_ops);
+        cycles[i] = (double)(bench_cycles() - c) / (double)num_ops;
+        ns[i] = stm_ns(stm_since(t)) / (double)num_ops;
+    }
+    qsort(ns, repeat, sizeof(double), compare_double);
+    qsort(cycles, repeat, sizeof(double), compare_double);
+
+    bench_result_t* res = &state.results[state.num_results++];
+    snprintf(res->name, sizeof(res->name), "%s", bench->name);
+    res->ops = num_ops;
+    res->ns_per_op = ns[repeat / 2];
+    res->ns_per_op_min = ns[0];
+    res->cycles_per_op = cycles[repeat / 2];
+    if (BENCH_CYCLE_COUNTER) {
+        printf("%-24s %12.1f ns/op %12.1f cycles/op  (min %.1f ns/op, %llu ops)\n",
+            res->name, res->ns_per_op, res->cycles_per_op, res->ns_per_op_min, (unsigned long long)res->ops);
+    }
+    else {
+        printf("%-24s %12.1f ns/op  (min %.1f ns/op, %llu ops)\n",
+            res->name, res->ns_per_op, res->ns_per_op_min, (unsigned long long)res->ops);
+    }
+    fflush(stdout);
+}
+
+static bool write_json(FILE* fp, double min_time, int repeat) {
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"version\": 1,\n");
+    if (BENCH_CYCLE_COUNTER) {
+        fprintf(fp, "  \"cycle_counter\": \"%s\",\n", BENCH_CYCLE_COUNTER);
+    }
+    else {
+        fprintf(fp, "  \"cycle_counter\": null,\n");
+    }
+    fprintf(fp, "  \"min_time\": %g,\n", min_time);
+    fprintf(fp, "  \"repeat\": %d,\n", repeat);
+    fprintf(fp, "  \"results\": [\n");
+    for (int i = 0; i < state.num_results; i++) {
+        const bench_result_t* res = &state.results[i];
+        fprintf(fp, "    { \"name\": \"%s\", \"ops\": %llu, \"ns_per_op\": %.3f, \"ns_per_op_min\": %.3f, ",
+            res->name, (unsigned long long)res->ops, res->ns_per_op, res->ns_per_op_min);
+        if (BENCH_CYCLE_COUNTER) {
+            fprintf(fp, "\"cycles_per_op\": %.3f }", res->cycles_per_op);
+        }
+        else {
+            fprintf(fp, "\"cycles_per_op\": null }");
+        }
+        fprintf(fp, "%s\n", (i + 1 < state.num_results) ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    return !ferror(fp);
+}
+
+int main(int argc, char* argv[]) {
+    sargs_setup(&(sargs_desc){ .argc = argc, .argv = argv });
+    stm_setup();
+
+    if (sargs_exists("list")) {
+        for (int i = 0; i < NUM_BENCHMARKS; i++) {
+            printf("%s\n", benchmarks[i].name);
+        }
+        sargs_shutdown();
+        return EXIT_SUCCESS;
+    }
+    const char* json_path = sargs_value_def("json", 0);
+    const char* filter = sargs_value_def("filter", "");
+    const double min_time = atof(sargs_value_def("min-time", "0.2"));
+    const int repeat = atoi(sargs_value_def("repeat", "5"));
+    if ((min_time <= 0.0) || (repeat <= 0) || (repeat > MAX_REPEAT)) {
+        fprintf(stderr, "usage: numbersid-bench [json=out.json] [filter=name] [min-time=0.2] [repeat=5] [patch=file|-] [list]\n");
+        return EXIT_FAILURE;
+    }
+
+    if (sargs_exists("patch")) {
+        const char* patch_path = sargs_value("patch");
+        sequencer_import_result_t result = {0};
+        sequencer_init(&state.patch);
+        if (!render_load_patch(&state.patch, patch_path, &result)) {
+            if (result.error) {
+                fprintf(stderr, "numbersid-bench: %s:%d:%d: %s\n", patch_path, result.error_line, result.error_column, result.error);
+            }
+            else {
+                fprintf(stderr, "numbersid-bench: failed to load patch '%s'\n", patch_path);
+            }
+            return EXIT_FAILURE;
+        }
+    }
+    else {
+        patchgen_make(&state.patch, PATCHGEN_FULL);
+    }
+
+    for (int i = 0; i < NUM_BENCHMARKS; i++) {
+        if (strstr(benchmarks[i].name, filter)) {
+            bench_run(&benchmarks[i], min_time, repeat);
+        }
+    }
+    if (state.num_results == 0) {
+        fprintf(stderr, "numbersid-bench: no benchmark matches '%s'\n", filter);
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+    if (json_path) {
+        FILE* fp = fopen(json_path, "w");
+        ok = fp && write_json(fp, min_time, repeat);
+        if (fp) {
+            ok = (0 == fclose(fp)) && ok;
+        }
+        if (!ok) {
+            fprintf(stderr, "numbersid-bench: failed to write '%s'\n", json_path);
+        }
+    }
+    sargs_shutdown();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
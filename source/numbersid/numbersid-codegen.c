@@ -0,0 +1,102 @@
+/*
+    Numbersid patch to C code generator.
+
+    Writes a C function that computes the sequencer variables of a patch
+    like update_variables(), with the constant operands inlined, see
+    codegen.h. For finished patches on embedded targets, or compiled into
+    numbersid-render.
+
+    Usage:
+
+        numbersid-codegen [patch=file|-] [out=file.c] [name=patch_update]
+
+    - patch:    patch data as exported from the Data window, '-' for stdin
+                (default: the patch the application boots with)
+    - out:      output file (default: stdout)
+    - name:     name of the generated function
+
+    ## zlib/libpng license
+
+    Copyright (c) 2025 Rick van der Meiden
+
+    This software is provided 'as-is', without any express or implied warranty.
+    In no event will the authors be held liable for any damages arising from the
+    use of this software.
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+        1. The origin of this software must not be misrepresented; you must not
+        claim that you wrote the original software. If you use this software in a
+        product, an acknowledgment in the product documentation would be
+        appreciated but is not required.
+        2. Altered source versions must be plainly marked as such, and must not
+        be misrepresented as being the original software.
+        3. This notice may not be removed or altered from any source
+        distribution.
+*/
+
+#define CHIPS_IMPL
+#include "chips/chips_common.h"
+#include "chips/m6581.h"
+
+#define SOKOL_ARGS_IMPL
+#include "sokol_args.h"
+
+#include "sequencer.h"
+#include "render.h"
+#include "codegen.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct {
+    sequencer_t sequencer;
+    codegen_t codegen;
+} state;
+
+int main(int argc, char* argv[]) {
+    sargs_setup(&(sargs_desc){ .argc = argc, .argv = argv });
+
+    sequencer_init(&state.sequencer);
+    if (sargs_exists("patch")) {
+        const char* patch_path = sargs_value("patch");
+        sequencer_import_result_t result = {0};
+        if (!render_load_patch(&state.sequencer, patch_path, &result)) {
+            if (result.error) {
+                fprintf(stderr, "numbersid-codegen: %s:%d:%d: %s\n", patch_path, result.error_line, result.error_column, result.error);
+            }
+            else {
+                fprintf(stderr, "numbersid-codegen: failed to load patch '%s'\n", patch_path);
+            }
+            return EXIT_FAILURE;
+        }
+    }
+
+    const codegen_desc_t desc = {
+        .name = sargs_value_def("name", "patch_update"),
+    };
+    codegen_t* codegen = &state.codegen;
+    if (!codegen_build(codegen, &state.sequencer, &desc)) {
+        fprintf(stderr, "numbersid-codegen: %s\n", codegen->error);
+        return EXIT_FAILURE;
+    }
+
+    const char* out_path = sargs_value_def("out", "-");
+    const bool to_stdout = (0 == strcmp(out_path, "-"));
+    FILE* fp = to_stdout ? stdout : fopen(out_path, "wb");
+    if (!fp) {
+        fprintf(stderr, "numbersid-codegen: failed to open '%s'\n", out_path);
+        return EXIT_FAILURE;
+    }
+    bool ok = (fwrite(codegen->source, 1, codegen->source_size, fp) == (size_t)codegen->source_size);
+    ok = (0 == (to_stdout ? fflush(fp) : fclose(fp))) && ok;
+    if (!ok) {
+        fprintf(stderr, "numbersid-codegen: failed to write '%s'\n", out_path);
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "numbersid-codegen: %s(): %d of %d operands constant, %d of %d stages left out\n",
+        desc.name, codegen->num_constants, codegen->num_operands, codegen->num_removed, codegen->num_stages);
+    sargs_shutdown();
+    return EXIT_SUCCESS;
+}
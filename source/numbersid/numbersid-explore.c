@@ -0,0 +1,589 @@
+/*
+    Numbersid patch explorer.
+
+    Searches the numbers of a patch for variations that sound interesting,
+    headless and on all cores. Every generation mutates the best patches
+    found so far within the given ranges, renders a short excerpt of every
+    candidate, and scores it with cheap features of the output. The best
+    patches are written as patch files, load them in the Data window.
+
+        numbersid-explore [start=sparse] [minutes=5] [generations=N]
+                          [population=256] [keep=32] [seconds=4]
+                          [threads=N] [seed=1] [out=explore]
+                          [div=0:16] [mul=0:8] [mod=0:64] [base=0:16]
+                          [add=-16:16] [array=-12:24] [fixed=base,array]
+                          [onsets=4] [entropy=0.7]
+
+    - start:        comma separated generated patches (see patchgen.h) or
+                    patch files to start from
+    - minutes:      stop after this many minutes
+    - generations:  stop after this many generations instead
+    - population:   candidates rendered per generation
+    - keep:         number of best patches kept and written
+    - seconds:      length of the excerpt rendered of every candidate
+    - threads:      number of render threads (default: number of cores)
+    - seed:         seed of the search, the same seed and arguments find
+                    the same patches on any number of threads
+    - out:          prefix of the patch files, out-01.txt is the best one,
+                    they are rewritten whenever the best patches change
+    - div ... add:  range lo:hi of the DIV, MUL, MOD, BASE and ADD numbers
+                    of the sequences (both of them, e.g. DIV1 and DIV2),
+                    0 switches the operation off
+    - array:        range of the numbers in the arrays
+    - fixed:        comma separated kinds (div, mul, mod, base, add, array)
+                    to leave alone
+    - onsets:       onsets per second that score best
+    - entropy:      pitch class entropy that scores best, from 0 (one
+                    pitch class) to 1 (all twelve equally often)
+
+    Only numbers change, the variables stay, so every patch keeps the
+    structure of the patch it started from (which sequence drives which
+    voice parameter). A generation mostly mutates one to three numbers of
+    a good patch (the better of two random ones), and some candidates
+    start again from a start patch with many mutations, so the search
+    doesn't get stuck.
+
+    The score of a candidate goes from 0 to 1, the share of its excerpt
+    that is audible times the mean of:
+
+        - onset density: the frames where the energy jumps, best at the
+          onsets target, half as good at half or double of it
+        - pitch class entropy: how the notes of the gated voices spread
+          over the 12 pitch classes, taken from the SID frequency
+          registers instead of a pitch detector, best at the target
+        - non-repetition: the share of distinct quarter second windows of
+          SID voice registers, low for short loops and long held notes
+
+    ## zlib/libpng license
+
+    Copyright (c) 2025 Rick van der Meiden
+
+    This software is provided 'as-is', without any express or implied warranty.
+    In no event will the authors be held liable for any damages arising from the
+    use of this software.
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+        1. The origin of this software must not be misrepresented; you must not
+        claim that you wrote the original software. If you use this software in a
+        product, an acknowledgment in the product documentation would be
+        appreciated but is not required.
+        2. Altered source versions must be plainly marked as such, and must not
+        be misrepresented as being the original software.
+        3. This notice may not be removed or altered from any source
+        distribution.
+*/
+
+#define CHIPS_IMPL
+#include "chips/chips_common.h"
+#include "chips/m6581.h"
+
+#define SOKOL_ARGS_IMPL
+#include "sokol_args.h"
+#define SOKOL_TIME_IMPL
+#include "sokol_time.h"
+
+#include "sequencer.h"
+#include "render.h"
+#include "patchgen.h"
+#include "thread.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MAX_THREADS (64)
+#define MAX_STARTS (32)
+#define MAX_POPULATION (4096)
+#define MAX_KEEP (256)
+#define MAX_SECONDS (16)
+#define MAX_FRAMES (MAX_SECONDS * RENDER_FRAME_HZ)
+#define NAME_SIZE (256)
+#define EXPORT_BUFFER_SIZE (64*1024)    // same as the Data window
+#define MAX_SLOTS (MAX_SEQUENCES * 9 + MAX_ARRAYS * MAX_ARRAY_SIZE)
+#define RESTART_PERCENT (10)            // candidates that start again from a start patch
+#define RESTART_MUTATIONS (8)
+#define SILENCE_RMS (0.002f)            // about -54 dB
+#define ONSET_RATIO (2.0f)              // energy jump of an onset, 3 dB
+#define ONSET_GAP_FRAMES (3)            // an attack over several frames is one onset
+#define WINDOW_FRAMES (15)              // quarter second windows for the non-repetition
+#define WINDOW_SET_SIZE (2048)          // power of two, more than twice MAX_FRAMES
+
+typedef enum {
+    KIND_DIV,
+    KIND_MUL,
+    KIND_MOD,
+    KIND_BASE,
+    KIND_ADD,
+    KIND_ARRAY,
+    NUM_KINDS,
+} kind_t;
+
+static const char* kind_names[NUM_KINDS] = { "div", "mul", "mod", "base", "add", "array" };
+static const char* kind_defaults[NUM_KINDS] = { "0:16", "0:8", "0:64", "0:16", "-16:16", "-12:24" };
+
+typedef struct {
+    float audible;                      // share of frames above SILENCE_RMS
+    float onsets;                       // per second
+    float entropy;                      // of the pitch classes, 0..1
+    float novelty;                      // share of distinct windows
+    float score;
+} features_t;
+
+typedef struct {
+    sequencer_t patch;
+    uint32_t hash;                      // of the patch part, to keep duplicates out
+    features_t features;
+} candidate_t;
+
+typedef struct {
+    render_t render;
+    float samples[RENDER_MAX_FRAME_SAMPLES];
+    uint32_t frame_hashes[MAX_FRAMES];
+    uint32_t windows[WINDOW_SET_SIZE];
+} worker_t;
+
+static struct {
+    int num_frames;
+    float onsets_target;
+    float entropy_target;
+    int ranges[NUM_KINDS][2];
+    bool fixed[NUM_KINDS];
+    uint32_t rnd;
+    render_t fresh;                     // initialized once, copied for every candidate
+    candidate_t starts[MAX_STARTS];
+    char start_names[MAX_STARTS][NAME_SIZE];
+    int num_starts;
+    candidate_t* population;
+    int num_population;
+    volatile uint32_t next;             // next candidate to evaluate
+    candidate_t archive[MAX_KEEP];      // best first
+    int num_archive;
+    int keep;
+    worker_t* workers;
+    char text[EXPORT_BUFFER_SIZE];
+} state;
+
+// small LCG, the search must not depend on the C library
+static int rand_range(int lo, int hi) {
+    state.rnd = state.rnd * 1664525u + 1013904223u;
+    return lo + (int)((state.rnd >> 8) % (uint32_t)(hi - lo + 1));
+}
+
+// FNV-1a of the patch part of a sequencer (see sequencer.h)
+static uint32_t patch_hash(const sequencer_t* seq) {
+    const uint8_t* p = (const uint8_t*)seq + offsetof(sequencer_t, voices);
+    const size_t size = offsetof(sequencer_t, preview) - offsetof(sequencer_t, voices);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// ---- mutation ----
+
+typedef struct {
+    var_or_number_t* value;
+    kind_t kind;
+} slot_t;
+
+static int add_slot(slot_t* slots, int num_slots, var_or_number_t* value, kind_t kind) {
+    if (!state.fixed[kind] && (value->variable == 0)) {
+        slots[num_slots++] = (slot_t){ .value = value, .kind = kind };
+    }
+    return num_slots;
+}
+
+// the numbers of a patch that may change
+static int find_slots(sequencer_t* seq, slot_t* slots) {
+    int n = 0;
+    for (int i = 0; i < seq->num_sequences; i++) {
+        sequence_t* s = &seq->sequences[i];
+        n = add_slot(slots, n, &s->add1, KIND_ADD);
+        n = add_slot(slots, n, &s->div1, KIND_DIV);
+        n = add_slot(slots, n, &s->mul1, KIND_MUL);
+        n = add_slot(slots, n, &s->mod1, KIND_MOD);
+        n = add_slot(slots, n, &s->base, KIND_BASE);
+        n = add_slot(slots, n, &s->mod2, KIND_MOD);
+        n = add_slot(slots, n, &s->mul2, KIND_MUL);
+        n = add_slot(slots, n, &s->div2, KIND_DIV);
+        n = add_slot(slots, n, &s->add2, KIND_ADD);
+    }
+    for (int a = 0; a < seq->num_arrays; a++) {
+        for (int i = 0; i < seq->array_sizes[a]; i++) {
+            n = add_slot(slots, n, &seq->arrays[a][i], KIND_ARRAY);
+        }
+    }
+    return n;
+}
+
+// change num_mutations numbers, each to a random value in its range or one step away
+static void mutate(sequencer_t* seq, int num_mutations) {
+    static slot_t slots[MAX_SLOTS];
+    const int num_slots = find_slots(seq, slots);
+    if (num_slots == 0) {
+        return;
+    }
+    for (int m = 0; m < num_mutations; m++) {
+        const slot_t* slot = &slots[rand_range(0, num_slots - 1)];
+        const int lo = state.ranges[slot->kind][0];
+        const int hi = state.ranges[slot->kind][1];
+        int value = slot->value->number;
+        if (rand_range(0, 1) || (value < lo) || (value > hi)) {
+            value = rand_range(lo, hi);
+        }
+        else {
+            value += rand_range(0, 1) ? 1 : -1;
+            value = (value < lo) ? lo : (value > hi) ? hi : value;
+        }
+        slot->value->number = (int16_t)value;
+    }
+}
+
+// ---- features ----
+
+static uint32_t hash_words(const uint32_t* words, int num_words) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < num_words; i++) {
+        hash = (hash ^ words[i]) * 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+// pitch class of a SID frequency register value, -1 if inaudible
+static int pitch_class(int freq) {
+    if (freq <= 0) {
+        return -1;
+    }
+    const double hz = (double)freq * RENDER_TICK_HZ / 16777216.0;
+    const int note = (int)lround(12.0 * log2(hz / 440.0));
+    return ((note % 12) + 12) % 12;
+}
+
+static float score_features(features_t* f) {
+    // best at the target, half as good at half or double of it
+    float onset_score = 0.0f;
+    if (f->onsets > 0.0f) {
+        const float octaves = log2f(f->onsets / state.onsets_target);
+        onset_score = exp2f(-octaves * octaves);
+    }
+    const float t = state.entropy_target;
+    const float entropy_score = 1.0f - fabsf(f->entropy - t) / ((t > 0.5f) ? t : (1.0f - t));
+    return f->audible * (onset_score + entropy_score + f->novelty) / 3.0f;
+}
+
+static void evaluate(worker_t* w, candidate_t* cand) {
+    render_t* render = &w->render;
+    *render = state.fresh;
+    render->sequencer = cand->patch;
+    const int num_frames = state.num_frames;
+    int num_audible = 0;
+    int num_onsets = 0;
+    int last_onset = -ONSET_GAP_FRAMES;
+    float prev_energy = 0.0f;
+    uint32_t pitch_classes[12] = {0};
+    uint32_t num_pitched = 0;
+    for (int frame = 0; frame < num_frames; frame++) {
+        const int n = render_frame(render, w->samples, RENDER_MAX_FRAME_SAMPLES);
+        float energy = 0.0f;
+        for (int i = 0; i < n; i++) {
+            energy += w->samples[i] * w->samples[i];
+        }
+        energy = (n > 0) ? (energy / (float)n) : 0.0f;
+        const bool audible = energy > (SILENCE_RMS * SILENCE_RMS);
+        if (audible) {
+            num_audible++;
+            if ((energy > ONSET_RATIO * prev_energy) && (frame - last_onset >= ONSET_GAP_FRAMES)) {
+                num_onsets++;
+                last_onset = frame;
+            }
+        }
+        prev_energy = energy;
+
+        // frequency and control of the voices, the notes as they are played
+        const uint8_t* regs = render->sid_regs;
+        uint32_t voices[NUM_CHANNELS];
+        for (int v = 0; v < NUM_CHANNELS; v++) {
+            const int freq = regs[v * 7] | (regs[v * 7 + 1] << 8);
+            const uint8_t ctrl = regs[SID_REG_CTRL(v)];
+            voices[v] = (uint32_t)freq | ((uint32_t)ctrl << 16);
+            // gated, with triangle, sawtooth or pulse (noise has no pitch)
+            const bool gated = (ctrl & M6581_CTRL_GATE) && (ctrl & 0x70);
+            const int pc = (audible && gated) ? pitch_class(freq) : -1;
+            if (pc >= 0) {
+                pitch_classes[pc]++;
+                num_pitched++;
+            }
+        }
+        w->frame_hashes[frame] = hash_words(voices, NUM_CHANNELS);
+    }
+
+    features_t* f = &cand->features;
+    f->audible = (float)num_audible / (float)num_frames;
+    f->onsets = (float)num_onsets * RENDER_FRAME_HZ / (float)num_frames;
+    float entropy = 0.0f;
+    for (int pc = 0; pc < 12; pc++) {
+        if (pitch_classes[pc] > 0) {
+            const float p = (float)pitch_classes[pc] / (float)num_pitched;
+            entropy -= p * log2f(p);
+        }
+    }
+    f->entropy = entropy / log2f(12.0f);
+
+    // distinct windows, in a small open addressing set
+    memset(w->windows, 0, sizeof(w->windows));
+    const int num_windows = num_frames - WINDOW_FRAMES + 1;
+    int num_distinct = 0;
+    for (int i = 0; i < num_windows; i++) {
+        const uint32_t hash = hash_words(&w->frame_hashes[i], WINDOW_FRAMES);
+        uint32_t pos = hash & (WINDOW_SET_SIZE - 1);
+        while ((w->windows[pos] != 0) && (w->windows[pos] != hash)) {
+            pos = (pos + 1) & (WINDOW_SET_SIZE - 1);
+        }
+        if (w->windows[pos] == 0) {
+            w->windows[pos] = hash;
+            num_distinct++;
+        }
+    }
+    f->novelty = (float)num_distinct / (float)num_windows;
+    f->score = score_features(f);
+}
+
+static void evaluate_worker(void* arg) {
+    worker_t* w = (worker_t*)arg;
+    while (true) {
+        const uint32_t i = thread_atomic_add(&state.next, 1);
+        if (i >= (uint32_t)state.num_population) {
+            break;
+        }
+        evaluate(w, &state.population[i]);
+    }
+}
+
+// render and score the population on all threads
+static void evaluate_population(int num_threads) {
+    thread_t threads[MAX_THREADS];
+    bool started[MAX_THREADS];
+    thread_atomic_store(&state.next, 0);
+    for (int t = 0; t < num_threads; t++) {
+        started[t] = thread_start(&threads[t], evaluate_worker, &state.workers[t]);
+        if (!started[t]) {
+            evaluate_worker(&state.workers[t]);
+        }
+    }
+    for (int t = 0; t < num_threads; t++) {
+        if (started[t]) {
+            thread_join(&threads[t]);
+        }
+    }
+}
+
+// ---- search ----
+
+// into the archive if it is one of the best and not there yet, returns true if it went in
+static bool archive_add(const candidate_t* cand) {
+    if ((state.num_archive == state.keep) && (cand->features.score <= state.archive[state.num_archive - 1].features.score)) {
+        return false;
+    }
+    for (int i = 0; i < state.num_archive; i++) {
+        if (state.archive[i].hash == cand->hash) {
+            return false;
+        }
+    }
+    int pos = (state.num_archive < state.keep) ? state.num_archive++ : (state.num_archive - 1);
+    while ((pos > 0) && (state.archive[pos - 1].features.score < cand->features.score)) {
+        state.archive[pos] = state.archive[pos - 1];
+        pos--;
+    }
+    state.archive[pos] = *cand;
+    return true;
+}
+
+static void make_population(int size) {
+    for (int i = 0; i < size; i++) {
+        candidate_t* cand = &state.population[i];
+        if ((state.num_archive == 0) || (rand_range(0, 99) < RESTART_PERCENT)) {
+            *cand = state.starts[rand_range(0, state.num_starts - 1)];
+            mutate(&cand->patch, RESTART_MUTATIONS);
+        }
+        else {
+            // the better of two
+            const int a = rand_range(0, state.num_archive - 1);
+            const int b = rand_range(0, state.num_archive - 1);
+            *cand = state.archive[(a < b) ? a : b];
+            mutate(&cand->patch, rand_range(1, 3));
+        }
+        cand->hash = patch_hash(&cand->patch);
+    }
+    state.num_population = size;
+}
+
+static bool write_archive(const char* prefix) {
+    for (int i = 0; i < state.num_archive; i++) {
+        char path[NAME_SIZE + 16];
+        snprintf(path, sizeof(path), "%s-%02d.txt", prefix, i + 1);
+        sequencer_export_data(&state.archive[i].patch, state.text, sizeof(state.text), 4);
+        FILE* fp = fopen(path, "w");
+        bool ok = fp && (fputs(state.text, fp) >= 0);
+        if (fp) {
+            ok = (0 == fclose(fp)) && ok;
+        }
+        if (!ok) {
+            fprintf(stderr, "numbersid-explore: failed to write '%s'\n", path);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool add_starts(const char* list) {
+    const char* p = list;
+    while (*p) {
+        const char* end = strchr(p, ',');
+        const size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len >= NAME_SIZE) {
+            fprintf(stderr, "numbersid-explore: name too long '%.*s'\n", (int)len, p);
+            return false;
+        }
+        if (len > 0) {
+            if (state.num_starts == MAX_STARTS) {
+                fprintf(stderr, "numbersid-explore: more than %d start patches\n", MAX_STARTS);
+                return false;
+            }
+            char* name = state.start_names[state.num_starts];
+            memcpy(name, p, len);
+            name[len] = 0;
+            sequencer_t* seq = &state.starts[state.num_starts].patch;
+            const patchgen_kind_t kind = patchgen_find(name);
+            if (kind != PATCHGEN_NUM) {
+                patchgen_make(seq, kind);
+            }
+            else {
+                sequencer_import_result_t result = {0};
+                sequencer_init(seq);
+                if (!render_load_patch(seq, name, &result)) {
+                    if (result.error) {
+                        fprintf(stderr, "numbersid-explore: %s:%d:%d: %s\n", name, result.error_line, result.error_column, result.error);
+                    }
+                    else {
+                        fprintf(stderr, "numbersid-explore: failed to load patch '%s'\n", name);
+                    }
+                    return false;
+                }
+            }
+            state.starts[state.num_starts].hash = patch_hash(seq);
+            state.num_starts++;
+        }
+        p += len + (end ? 1 : 0);
+    }
+    return state.num_starts > 0;
+}
+
+static bool parse_ranges(void) {
+    for (int k = 0; k < NUM_KINDS; k++) {
+        const char* arg = sargs_value_def(kind_names[k], kind_defaults[k]);
+        int lo, hi;
+        if ((2 != sscanf(arg, "%d:%d", &lo, &hi)) || (lo > hi) || (lo < INT16_MIN) || (hi > INT16_MAX)) {
+            fprintf(stderr, "numbersid-explore: %s=%s is not a range lo:hi\n", kind_names[k], arg);
+            return false;
+        }
+        state.ranges[k][0] = lo;
+        state.ranges[k][1] = hi;
+        state.fixed[k] = false;
+    }
+    const char* fixed = sargs_value_def("fixed", "");
+    for (int k = 0; k < NUM_KINDS; k++) {
+        const size_t len = strlen(kind_names[k]);
+        for (const char* p = strstr(fixed, kind_names[k]); p; p = strstr(p + 1, kind_names[k])) {
+            if (((p == fixed) || (p[-1] == ',')) && ((p[len] == 0) || (p[len] == ','))) {
+                state.fixed[k] = true;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    sargs_setup(&(sargs_desc){ .argc = argc, .argv = argv });
+    stm_setup();
+
+    const double minutes = atof(sargs_value_def("minutes", "5"));
+    const int generations = atoi(sargs_value_def("generations", "0"));
+    const int population = atoi(sargs_value_def("population", "256"));
+    const double seconds = atof(sargs_value_def("seconds", "4"));
+    const char* out = sargs_value_def("out", "explore");
+    int num_threads = atoi(sargs_value_def("threads", "0"));
+    if (num_threads <= 0) num_threads = thread_num_cores();
+    if (num_threads > MAX_THREADS) num_threads = MAX_THREADS;
+    state.keep = atoi(sargs_value_def("keep", "32"));
+    state.rnd = (uint32_t)strtoul(sargs_value_def("seed", "1"), 0, 10);
+    state.onsets_target = (float)atof(sargs_value_def("onsets", "4"));
+    state.entropy_target = (float)atof(sargs_value_def("entropy", "0.7"));
+    state.num_frames = (int)(seconds * RENDER_FRAME_HZ);
+    if ((minutes <= 0.0) || (generations < 0) || (population <= 0) || (population > MAX_POPULATION) ||
+        (state.keep <= 0) || (state.keep > MAX_KEEP) || (state.num_frames <= WINDOW_FRAMES) || (state.num_frames > MAX_FRAMES) ||
+        (state.onsets_target <= 0.0f) || (state.entropy_target < 0.0f) || (state.entropy_target > 1.0f)) {
+        fprintf(stderr, "usage: numbersid-explore [start=sparse] [minutes=5] [generations=N] [population=256] [keep=32] [seconds=4]\n"
+                        "                         [threads=N] [seed=1] [out=explore] [div=0:16] [mul=0:8] [mod=0:64] [base=0:16]\n"
+                        "                         [add=-16:16] [array=-12:24] [fixed=base,array] [onsets=4] [entropy=0.7]\n");
+        return EXIT_FAILURE;
+    }
+    if (!parse_ranges() || !add_starts(sargs_value_def("start", "sparse"))) {
+        return EXIT_FAILURE;
+    }
+    render_init(&state.fresh);
+    state.population = calloc(population > MAX_STARTS ? population : MAX_STARTS, sizeof(candidate_t));
+    state.workers = calloc(num_threads, sizeof(worker_t));
+    if (!state.population || !state.workers) {
+        fprintf(stderr, "numbersid-explore: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    // the start patches are the first candidates
+    for (int i = 0; i < state.num_starts; i++) {
+        state.population[i] = state.starts[i];
+    }
+    state.num_population = state.num_starts;
+    evaluate_population(num_threads);
+    for (int i = 0; i < state.num_starts; i++) {
+        const features_t* f = &state.population[i].features;
+        printf("start %-24s score %.3f\n", state.start_names[i], f->score);
+        archive_add(&state.population[i]);
+    }
+
+    printf("%d threads, %d candidates of %g seconds per generation\n\n", num_threads, population, seconds);
+    const uint64_t start_time = stm_now();
+    uint64_t num_candidates = 0;
+    bool ok = true;
+    for (int gen = 1; ok && ((generations > 0) ? (gen <= generations) : (stm_sec(stm_since(start_time)) < minutes * 60.0)); gen++) {
+        make_population(population);
+        evaluate_population(num_threads);
+        num_candidates += (uint64_t)population;
+        int num_new = 0;
+        for (int i = 0; i < population; i++) {
+            num_new += archive_add(&state.population[i]) ? 1 : 0;
+        }
+        if (num_new > 0) {
+            ok = write_archive(out);
+        }
+        const double elapsed_min = stm_sec(stm_since(start_time)) / 60.0;
+        printf("gen %4d  %8.0f candidates/min  best %.3f  worst kept %.3f  %d new\n", gen,
+            (double)num_candidates / elapsed_min, state.archive[0].features.score,
+            state.archive[state.num_archive - 1].features.score, num_new);
+        fflush(stdout);
+    }
+
+    printf("\n%4s %7s %8s %8s %8s %8s  %s\n", "rank", "score", "audible", "onsets/s", "entropy", "novelty", "file");
+    for (int i = 0; i < state.num_archive; i++) {
+        const features_t* f = &state.archive[i].features;
+        printf("%4d %7.3f %7.0f%% %8.2f %8.2f %8.2f  %s-%02d.txt\n", i + 1, f->score, f->audible * 100.0f, f->onsets, f->entropy, f->novelty, out, i + 1);
+    }
+    ok = ok && write_archive(out);
+    free(state.workers);
+    free(state.population);
+    sargs_shutdown();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,268 @@
+/*
+    Numbersid golden output check.
+
+    Renders a corpus of patches headless and records, or checks against a
+    golden file, the variable values, the SID register writes and the
+    audio of every frame. Record a golden file before an optimization of
+    the sequencer or the SID loop, and check it after:
+
+        numbersid-golden record=golden.nsgd [frames=3600] [patches=a.txt,b.txt]
+                         [generated=yes]
+        numbersid-golden check=golden.nsgd [filter=name]
+
+    - record:    render the corpus and write the golden file
+    - check:     render the patches of a golden file and compare
+    - frames:    number of frames to render per patch (60 per second)
+    - patches:   comma separated patch files (as exported from the Data
+                 window, or binary) to add to the corpus
+    - generated: add the generated patches (see patchgen.h) to the corpus,
+                 'no' to only use the patch files
+    - filter:    only check the patches with this text in their name
+
+    The golden file holds the patches themselves, so check doesn't need
+    the patch files. A check reports for every patch whether it matches,
+    or the first frame that diverges, with the variables that differ and
+    their expected and actual values, or the stream (SID registers or
+    audio) that differs if all values are equal. It exits with a failure
+    if any patch diverges.
+
+    To check a patch compiled by numbersid-codegen, build with
+    -DRENDER_PATCH_SOURCE='"song.c"' -DRENDER_PATCH_FUNC=song_update and
+    check a golden file of the same patch.
+
+    ## zlib/libpng license
+
+    Copyright (c) 2025 Rick van der Meiden
+
+    This software is provided 'as-is', without any express or implied warranty.
+    In no event will the authors be held liable for any damages arising from the
+    use of this software.
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+        1. The origin of this software must not be misrepresented; you must not
+        claim that you wrote the original software. If you use this software in a
+        product, an acknowledgment in the product documentation would be
+        appreciated but is not required.
+        2. Altered source versions must be plainly marked as such, and must not
+        be misrepresented as being the original software.
+        3. This notice may not be removed or altered from any source
+        distribution.
+*/
+
+#define CHIPS_IMPL
+#include "chips/chips_common.h"
+#include "chips/m6581.h"
+
+#define SOKOL_ARGS_IMPL
+#include "sokol_args.h"
+
+#include "sequencer.h"
+#include "render.h"
+#include "patchgen.h"
+#include "lz.h"
+#include "golden.h"
+#if defined(RENDER_PATCH_SOURCE) && defined(RENDER_PATCH_FUNC)
+#include RENDER_PATCH_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_PATCHES (256)
+
+typedef struct {
+    char name[GOLDEN_NAME_SIZE];
+    uint8_t patch[SEQUENCER_BINARY_MAX_SIZE];
+    int patch_size;
+} corpus_patch_t;
+
+static struct {
+    render_t render;
+    float samples[RENDER_MAX_FRAME_SAMPLES];
+    corpus_patch_t corpus[MAX_PATCHES];
+    int num_patches;
+} state;
+
+static const char* stream_names[] = { "match", "values", "SID registers", "audio", "length" };
+
+// render num_frames frames of a binary patch, returns false if the patch is invalid
+static bool render_patch(const uint8_t* patch, int patch_size, golden_frame_t* frames, int num_frames) {
+    render_init(&state.render);
+#if defined(RENDER_PATCH_SOURCE) && defined(RENDER_PATCH_FUNC)
+    state.render.update_variables = RENDER_PATCH_FUNC;
+#endif
+    if (!sequencer_import_binary(&state.render.sequencer, patch, patch_size)) {
+        return false;
+    }
+    for (int f = 0; f < num_frames; f++) {
+        const int n = render_frame(&state.render, state.samples, RENDER_MAX_FRAME_SAMPLES);
+        golden_capture(&frames[f], state.render.sequencer.values, state.render.sid_regs, state.render.sid_mask, state.samples, n);
+    }
+    return true;
+}
+
+static bool add_patch(const char* name, sequencer_t* seq) {
+    if (state.num_patches == MAX_PATCHES) {
+        fprintf(stderr, "numbersid-golden: more than %d patches\n", MAX_PATCHES);
+        return false;
+    }
+    corpus_patch_t* p = &state.corpus[state.num_patches++];
+    snprintf(p->name, sizeof(p->name), "%s", name);
+    p->patch_size = sequencer_export_binary(seq, p->patch, sizeof(p->patch));
+    return p->patch_size > 0;
+}
+
+static bool add_patch_files(const char* list) {
+    static sequencer_t seq;
+    const char* p = list;
+    while (*p) {
+        const char* end = strchr(p, ',');
+        const size_t len = end ? (size_t)(end - p) : strlen(p);
+        char path[GOLDEN_NAME_SIZE];
+        if (len >= sizeof(path)) {
+            fprintf(stderr, "numbersid-golden: path too long '%.*s'\n", (int)len, p);
+            return false;
+        }
+        memcpy(path, p, len);
+        path[len] = 0;
+        if (len > 0) {
+            sequencer_import_result_t result = {0};
+            sequencer_init(&seq);
+            if (!render_load_patch(&seq, path, &result)) {
+                if (result.error) {
+                    fprintf(stderr, "numbersid-golden: %s:%d:%d: %s\n", path, result.error_line, result.error_column, result.error);
+                }
+                else {
+                    fprintf(stderr, "numbersid-golden: failed to load patch '%s'\n", path);
+                }
+                return false;
+            }
+            if (!add_patch(path, &seq)) {
+                return false;
+            }
+        }
+        p += len + (end ? 1 : 0);
+    }
+    return true;
+}
+
+static int record(const char* path, int num_frames) {
+    static sequencer_t seq;
+    if (0 != strcmp(sargs_value_def("generated", "yes"), "no")) {
+        for (int kind = 0; kind < PATCHGEN_NUM; kind++) {
+            patchgen_make(&seq, (patchgen_kind_t)kind);
+            if (!add_patch(patchgen_name((patchgen_kind_t)kind), &seq)) {
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    if (!add_patch_files(sargs_value_def("patches", ""))) {
+        return EXIT_FAILURE;
+    }
+    if (state.num_patches == 0) {
+        fprintf(stderr, "numbersid-golden: no patches\n");
+        return EXIT_FAILURE;
+    }
+
+    golden_frame_t* frames = malloc((size_t)num_frames * sizeof(golden_frame_t));
+    FILE* fp = fopen(path, "wb");
+    bool ok = frames && fp && golden_write_header(fp, state.num_patches);
+    for (int i = 0; ok && (i < state.num_patches); i++) {
+        const corpus_patch_t* p = &state.corpus[i];
+        ok = render_patch(p->patch, p->patch_size, frames, num_frames);
+        ok = ok && golden_write_entry(fp, p->name, p->patch, p->patch_size, frames, num_frames);
+        if (ok) {
+            printf("%-24s %d frames\n", p->name, num_frames);
+        }
+    }
+    if (fp) {
+        ok = (0 == fclose(fp)) && ok;
+    }
+    free(frames);
+    if (!ok) {
+        fprintf(stderr, "numbersid-golden: failed to write '%s'\n", path);
+        return EXIT_FAILURE;
+    }
+    printf("numbersid-golden: recorded %d patches to %s\n", state.num_patches, path);
+    return EXIT_SUCCESS;
+}
+
+static void print_diff(const golden_entry_t* entry, const golden_diff_t* diff) {
+    printf("%-24s DIVERGES at frame %d (%.2fs): %s\n", entry->name, diff->frame,
+        (double)diff->frame / RENDER_FRAME_HZ, stream_names[diff->stream]);
+    if (diff->stream == GOLDEN_VALUES) {
+        for (int v = 0; v < MAX_VARIABLES; v++) {
+            if (diff->variables & (1u << v)) {
+                printf("    %c: expected %d, actual %d\n", 'A' + v, diff->expected[v], diff->actual[v]);
+            }
+        }
+    }
+}
+
+static int check(const char* path) {
+    const char* filter = sargs_value_def("filter", "");
+    FILE* fp = fopen(path, "rb");
+    const int num_entries = fp ? golden_read_header(fp) : -1;
+    if (num_entries < 0) {
+        fprintf(stderr, "numbersid-golden: '%s' is not a golden file\n", path);
+        if (fp) {
+            fclose(fp);
+        }
+        return EXIT_FAILURE;
+    }
+    static golden_entry_t entry;
+    int num_checked = 0;
+    int num_diverged = 0;
+    bool ok = true;
+    for (int i = 0; i < num_entries; i++) {
+        if (!golden_read_entry(fp, &entry)) {
+            fprintf(stderr, "numbersid-golden: '%s' is damaged\n", path);
+            ok = false;
+            break;
+        }
+        if (strstr(entry.name, filter)) {
+            golden_frame_t* frames = malloc((entry.num_frames ? entry.num_frames : 1) * sizeof(golden_frame_t));
+            if (!frames || !render_patch(entry.patch, entry.patch_size, frames, entry.num_frames)) {
+                fprintf(stderr, "numbersid-golden: %s: invalid patch\n", entry.name);
+                ok = false;
+            }
+            else {
+                golden_diff_t diff;
+                if (golden_compare(entry.frames, entry.num_frames, frames, entry.num_frames, &diff)) {
+                    printf("%-24s ok (%d frames)\n", entry.name, entry.num_frames);
+                }
+                else {
+                    print_diff(&entry, &diff);
+                    num_diverged++;
+                }
+                num_checked++;
+            }
+            free(frames);
+        }
+        golden_entry_discard(&entry);
+    }
+    fclose(fp);
+    printf("numbersid-golden: %d of %d patches diverge\n", num_diverged, num_checked);
+    return (ok && (num_diverged == 0)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char* argv[]) {
+    sargs_setup(&(sargs_desc){ .argc = argc, .argv = argv });
+
+    int result = EXIT_FAILURE;
+    const int num_frames = atoi(sargs_value_def("frames", "3600"));
+    if (sargs_exists("record") && (num_frames > 0) && (num_frames <= GOLDEN_MAX_FRAMES)) {
+        result = record(sargs_value("record"), num_frames);
+    }
+    else if (sargs_exists("check")) {
+        result = check(sargs_value("check"));
+    }
+    else {
+        fprintf(stderr, "usage: numbersid-golden record=golden.nsgd [frames=3600] [patches=a.txt,b.txt] [generated=yes]\n"
+                        "       numbersid-golden check=golden.nsgd [filter=name]\n");
+    }
+    sargs_shutdown();
+    return result;
+}
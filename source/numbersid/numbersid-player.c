@@ -0,0 +1,202 @@
+/*
+    Numbersid C64 player export and profiler.
+
+    Builds the reference 6502 player for a patch, runs it on the emulated
+    6502 and SID, and reports the cost of the play routine per frame. The
+    SID register writes of every frame are checked against the sequencer,
+    so a patch that passes plays exactly like in the application.
+
+    Usage:
+
+        numbersid-player [patch=file|-] [frames=3600] [prg=out.prg] [asm=out.asm]
+                         [load=$1000] [zp=$02]
+
+    - patch:    patch data as exported from the Data window, '-' for stdin
+                (default: the patch the application boots with)
+    - frames:   number of sequencer frames to run and verify
+    - prg:      write the player as C64 program file
+    - asm:      write the generated assembler source of the player
+    - load:     load address of the player
+    - zp:       first of the zero page bytes used by the player
+
+    Cycle counts include the jsr to play and its rts, rasterlines are PAL
+    lines of 63 cycles. The exit code is non-zero if a register write
+    differs from the sequencer.
+
+    ## zlib/libpng license
+
+    Copyright (c) 2025 Rick van der Meiden
+
+    This software is provided 'as-is', without any express or implied warranty.
+    In no event will the authors be held liable for any damages arising from the
+    use of this software.
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+        1. The origin of this software must not be misrepresented; you must not
+        claim that you wrote the original software. If you use this software in a
+        product, an acknowledgment in the product documentation would be
+        appreciated but is not required.
+        2. Altered source versions must be plainly marked as such, and must not
+        be misrepresented as being the original software.
+        3. This notice may not be removed or altered from any source
+        distribution.
+*/
+
+#define CHIPS_IMPL
+#include "chips/chips_common.h"
+#include "chips/m6502.h"
+#include "chips/m6581.h"
+
+#define SOKOL_ARGS_IMPL
+#include "sokol_args.h"
+
+#include "sequencer.h"
+#include "render.h"
+#include "asm6502.h"
+#include "player6502.h"
+#include "c64host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct {
+    sequencer_t sequencer;      // patch as loaded
+    sequencer_t reference;      // runs in lockstep with the player
+    player_t player;
+    c64host_t host;
+} state;
+
+static uint16_t parse_addr(const char* str) {
+    return (uint16_t)((str[0] == '$') ? strtol(&str[1], 0, 16) : strtol(str, 0, 0));
+}
+
+static bool write_file(const char* path, const void* data, size_t size) {
+    FILE* fp = fopen(path, "wb");
+    if (!fp) {
+        return false;
+    }
+    bool ok = (fwrite(data, 1, size, fp) == size);
+    ok = (0 == fclose(fp)) && ok;
+    return ok;
+}
+
+static bool verify_frame(int frame, const uint8_t* expected, uint32_t expected_mask) {
+    if (state.host.write_mask != expected_mask) {
+        fprintf(stderr, "numbersid-player: frame %d: written registers $%07x, expected $%07x\n",
+            frame, state.host.write_mask, expected_mask);
+        return false;
+    }
+    for (int reg = 0; reg < SID_NUM_REGS; reg++) {
+        if ((expected_mask & (1 << reg)) && (state.host.writes[reg] != expected[reg])) {
+            fprintf(stderr, "numbersid-player: frame %d: register $%02x is $%02x, expected $%02x\n",
+                frame, reg, state.host.writes[reg], expected[reg]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    sargs_setup(&(sargs_desc){ .argc = argc, .argv = argv });
+
+    const int num_frames = atoi(sargs_value_def("frames", "3600"));
+    const player_desc_t desc = {
+        .load_addr = parse_addr(sargs_value_def("load", "$1000")),
+        .zp_addr = (uint8_t)parse_addr(sargs_value_def("zp", "$02")),
+    };
+
+    sequencer_init(&state.sequencer);
+    if (sargs_exists("patch")) {
+        const char* patch_path = sargs_value("patch");
+        sequencer_import_result_t result = {0};
+        if (!render_load_patch(&state.sequencer, patch_path, &result)) {
+            if (result.error) {
+                fprintf(stderr, "numbersid-player: %s:%d:%d: %s\n", patch_path, result.error_line, result.error_column, result.error);
+            }
+            else {
+                fprintf(stderr, "numbersid-player: failed to load patch '%s'\n", patch_path);
+            }
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!player_build(&state.player, &state.sequencer, &desc)) {
+        fprintf(stderr, "numbersid-player: %s\n", state.player.error);
+        return EXIT_FAILURE;
+    }
+    const player_t* player = &state.player;
+    if (sargs_exists("asm") && !write_file(sargs_value("asm"), player->source, player->source_size)) {
+        fprintf(stderr, "numbersid-player: failed to write '%s'\n", sargs_value("asm"));
+        return EXIT_FAILURE;
+    }
+    if (sargs_exists("prg")) {
+        static uint8_t prg[0x10002];
+        const int prg_size = player_prg(player, prg, sizeof(prg));
+        if (!write_file(sargs_value("prg"), prg, prg_size)) {
+            fprintf(stderr, "numbersid-player: failed to write '%s'\n", sargs_value("prg"));
+            return EXIT_FAILURE;
+        }
+    }
+    printf("numbersid-player: player $%04x-$%04x (%d bytes), working memory to $%04x, zero page $%02x-$%02x\n",
+        player->as.start, player->as.end - 1, player->as.end - player->as.start,
+        player->bss_end - 1, player->zp_addr, player->zp_addr + PLAYER_ZP_SIZE - 1);
+
+    // the player works from the binary export, so does the reference
+    uint8_t data[SEQUENCER_BINARY_MAX_SIZE];
+    const int data_size = sequencer_export_binary(&state.sequencer, data, sizeof(data));
+    sequencer_init(&state.reference);
+    sequencer_import_binary(&state.reference, data, data_size);
+    uint8_t regs[SID_NUM_REGS] = {0};
+
+    c64host_t* host = &state.host;
+    c64host_init(host);
+    memcpy(&host->mem[player->as.start], &player->as.mem[player->as.start], player->as.end - player->as.start);
+    c64host_start(host, player->init_addr, player->play_addr, 0);
+
+    // reset and init
+    int init_cycles = c64host_call(host);
+    if (init_cycles < 0) {
+        fprintf(stderr, "numbersid-player: init does not return\n");
+        return EXIT_FAILURE;
+    }
+
+    int min_cycles = 0;
+    int max_cycles = 0;
+    int max_frame = 0;
+    int64_t total_cycles = 0;
+    int frame;
+    for (frame = 0; frame < num_frames; frame++) {
+        const int call_cycles = c64host_call(host);
+        if (call_cycles < 0) {
+            fprintf(stderr, "numbersid-player: frame %d: play does not return\n", frame);
+            return EXIT_FAILURE;
+        }
+        sequencer_advance(&state.reference);
+        const uint32_t mask = sequencer_sid_writes(&state.reference, regs);
+        if (!verify_frame(frame, regs, mask)) {
+            break;
+        }
+        if ((frame == 0) || (call_cycles < min_cycles)) min_cycles = call_cycles;
+        if (call_cycles > max_cycles) {
+            max_cycles = call_cycles;
+            max_frame = frame;
+        }
+        total_cycles += call_cycles;
+    }
+
+    printf("  init: %d cycles\n", init_cycles);
+    if (frame > 0) {
+        const double avg_cycles = (double)total_cycles / frame;
+        printf("  play: %d frames, cycles min %d avg %.1f max %d (frame %d)\n",
+            frame, min_cycles, avg_cycles, max_cycles, max_frame);
+        printf("  rasterlines: min %.1f avg %.1f max %.1f (%.1f%% of a PAL frame at most)\n",
+            (double)min_cycles / C64HOST_PAL_CYCLES_PER_LINE, avg_cycles / C64HOST_PAL_CYCLES_PER_LINE,
+            (double)max_cycles / C64HOST_PAL_CYCLES_PER_LINE, 100.0 * max_cycles / C64HOST_PAL_CYCLES_PER_FRAME);
+    }
+    const bool ok = (frame == num_frames);
+    printf("  register writes: %s (%d of %d frames match)\n", ok ? "ok" : "MISMATCH", frame, num_frames);
+    sargs_shutdown();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,374 @@
+/*
+    Numbersid PSID (.sid) exporter.
+
+    Captures the SID register writes of a patch without running the SID,
+    converts them into a .sid file with a small register stream player,
+    and verifies the file by loading it into the emulated 6502 and SID
+    and comparing the SID registers after every frame with the capture.
+
+    Usage:
+
+        numbersid-psid out=song.sid [patch=file|-] [trace=in.nstr] [seconds=180]
+                       [name=...] [author=...] [released=...]
+                       [video=pal|ntsc] [speed=cia|vbi] [load=$1000] [verify=yes|no]
+        numbersid-psid verify=selftest [video=pal|ntsc] [speed=cia|vbi] [load=$1000]
+
+    - patch:    patch data as exported from the Data window, '-' for stdin
+                (default: the patch the application boots with)
+    - trace:    use a trace written by numbersid-render instead of the patch
+    - seconds:  length of the piece, ignored for a trace
+    - name, author, released: PSID info strings (at most 32 characters)
+    - video:    PAL or NTSC machine, on NTSC the frequencies are rescaled
+                to the NTSC clock to keep the pitch
+    - speed:    vbi calls play on the vertical blank, which is 50 Hz on PAL
+                (default: a 60 Hz CIA timer on PAL, the vertical blank on NTSC)
+    - load:     load address of the player
+    - verify:   'no' skips loading the file back into the emulator,
+                'selftest' exports nothing and checks the player with a
+                built-in trace instead, with registers held for up to 600
+                frames and changing pitches
+
+    ## zlib/libpng license
+
+    Copyright (c) 2025 Rick van der Meiden
+
+    This software is provided 'as-is', without any express or implied warranty.
+    In no event will the authors be held liable for any damages arising from the
+    use of this software.
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+        1. The origin of this software must not be misrepresented; you must not
+        claim that you wrote the original software. If you use this software in a
+        product, an acknowledgment in the product documentation would be
+        appreciated but is not required.
+        2. Altered source versions must be plainly marked as such, and must not
+        be misrepresented as being the original software.
+        3. This notice may not be removed or altered from any source
+        distribution.
+*/
+
+#define CHIPS_IMPL
+#include "chips/chips_common.h"
+#include "chips/m6502.h"
+#include "chips/m6581.h"
+
+#define SOKOL_ARGS_IMPL
+#include "sokol_args.h"
+#define SOKOL_TIME_IMPL
+#include "sokol_time.h"
+
+#include "sequencer.h"
+#include "render.h"
+#include "sidtrace.h"
+#include "asm6502.h"
+#include "psid.h"
+#include "c64host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct {
+    sequencer_t sequencer;
+    sidtrace_t trace;
+    psid_t psid;
+    c64host_t host;
+} state;
+
+static uint16_t parse_addr(const char* str) {
+    return (uint16_t)((str[0] == '$') ? strtol(&str[1], 0, 16) : strtol(str, 0, 0));
+}
+
+static uint16_t get_u16(const uint8_t* src) {
+    return (uint16_t)((src[0] << 8) | src[1]);
+}
+
+static uint8_t* read_file(const char* path, int* size) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        return 0;
+    }
+    uint8_t* data = 0;
+    if ((0 == fseek(fp, 0, SEEK_END)) && ((*size = (int)ftell(fp)) >= 0) && (0 == fseek(fp, 0, SEEK_SET))) {
+        data = malloc(*size ? *size : 1);
+        if (data && (fread(data, 1, *size, fp) != (size_t)*size)) {
+            free(data);
+            data = 0;
+        }
+    }
+    fclose(fp);
+    return data;
+}
+
+static bool write_file(const char* path, const void* data, size_t size) {
+    FILE* fp = fopen(path, "wb");
+    if (!fp) {
+        return false;
+    }
+    bool ok = (fwrite(data, 1, size, fp) == size);
+    ok = (0 == fclose(fp)) && ok;
+    return ok;
+}
+
+// load a .sid file like a player would, from the header only
+static bool load_psid(c64host_t* host, const uint8_t* data, int size) {
+    if ((size < PSID_HEADER_SIZE) || (0 != memcmp(data, "PSID", 4))) {
+        return false;
+    }
+    const int data_offset = get_u16(&data[0x06]);
+    int load_addr = get_u16(&data[0x08]);
+    const uint16_t init_addr = get_u16(&data[0x0A]);
+    const uint16_t play_addr = get_u16(&data[0x0C]);
+    const int start_song = get_u16(&data[0x10]);
+    int pos = data_offset;
+    if (load_addr == 0) {
+        if (pos + 2 > size) {
+            return false;
+        }
+        load_addr = data[pos] | (data[pos + 1] << 8);
+        pos += 2;
+    }
+    const int num_bytes = size - pos;
+    if ((num_bytes <= 0) || (load_addr + num_bytes > 0x10000)) {
+        return false;
+    }
+    c64host_init(host);
+    memcpy(&host->mem[load_addr], &data[pos], num_bytes);
+    c64host_start(host, init_addr ? init_addr : (uint16_t)load_addr, play_addr, (uint8_t)(start_song - 1));
+    return true;
+}
+
+// on NTSC the voice frequencies must give the pitch of the trace on PAL, to half a
+// register step, returns the first voice that is off or -1
+static int check_ntsc_pitch(const uint8_t* regs, const uint8_t* expected) {
+    for (int v = 0; v < NUM_CHANNELS; v++) {
+        const int64_t freq = regs[v * 7] | (regs[v * 7 + 1] << 8);
+        const int64_t pal_freq = expected[v * 7] | (expected[v * 7 + 1] << 8);
+        // both sides in Hz * 2^24
+        const int64_t diff = freq * PSID_NTSC_CLOCK - pal_freq * PSID_PAL_CLOCK;
+        if (2 * ((diff < 0) ? -diff : diff) > PSID_NTSC_CLOCK) {
+            return v;
+        }
+    }
+    return -1;
+}
+
+// run the .sid file and compare the SID registers after every frame with the trace,
+// returns the most cycles of a play call, or -1
+static int verify_psid(const psid_t* psid, const uint8_t* trace_data, int trace_size, bool ntsc) {
+    c64host_t* host = &state.host;
+    if (!load_psid(host, psid->data, psid->size)) {
+        fprintf(stderr, "numbersid-psid: verify: invalid .sid file\n");
+        return -1;
+    }
+    if (c64host_call(host) < 0) {
+        fprintf(stderr, "numbersid-psid: verify: init does not return\n");
+        return -1;
+    }
+    sidtrace_player_t trace;
+    sidtrace_player_init(&trace, trace_data, trace_size);
+    uint8_t expected[SID_NUM_REGS] = {0};
+    uint8_t regs[SID_NUM_REGS];
+    memcpy(regs, host->writes, sizeof(regs));
+    int max_cycles = 0;
+    for (int frame = 0; !sidtrace_player_done(&trace); frame++) {
+        sidtrace_player_next(&trace, expected);
+        const int cycles = c64host_call(host);
+        if (cycles < 0) {
+            fprintf(stderr, "numbersid-psid: verify: frame %d: play does not return\n", frame);
+            return -1;
+        }
+        if (cycles > max_cycles) max_cycles = cycles;
+        for (int reg = 0; reg < SID_NUM_REGS; reg++) {
+            if (host->write_mask & (1u << reg)) {
+                regs[reg] = host->writes[reg];
+            }
+        }
+        // the trace keeps its state, compare with a copy
+        uint8_t want[SID_NUM_REGS];
+        memcpy(want, expected, sizeof(want));
+        if (ntsc) {
+            const int v = check_ntsc_pitch(regs, want);
+            if (v >= 0) {
+                fprintf(stderr, "numbersid-psid: verify: frame %d: voice %d plays %.3f Hz on NTSC, expected %.3f Hz\n", frame, v + 1,
+                    (regs[v * 7] | (regs[v * 7 + 1] << 8)) * (double)PSID_NTSC_CLOCK / 16777216.0,
+                    (want[v * 7] | (want[v * 7 + 1] << 8)) * (double)PSID_PAL_CLOCK / 16777216.0);
+                return -1;
+            }
+            // the pitch is right, compare the other registers
+            for (int v = 0; v < NUM_CHANNELS; v++) {
+                want[v * 7] = regs[v * 7];
+                want[v * 7 + 1] = regs[v * 7 + 1];
+            }
+        }
+        if (0 != memcmp(regs, want, sizeof(regs))) {
+            for (int reg = 0; reg < SID_NUM_REGS; reg++) {
+                if (regs[reg] != want[reg]) {
+                    fprintf(stderr, "numbersid-psid: verify: frame %d: register $%02x is $%02x, expected $%02x\n",
+                        frame, reg, regs[reg], want[reg]);
+                    break;
+                }
+            }
+            return -1;
+        }
+    }
+    return max_cycles;
+}
+
+// registers held longer than a wait byte can skip must still change on time,
+// exports and verifies a trace with such gaps in the given player configuration
+static bool selftest(const psid_desc_t* player_desc) {
+    static const int gaps[] = { 255, 256, 257, 300, 511, 512, 600 };
+    sidtrace_t trace;
+    sidtrace_init(&trace);
+    uint8_t regs[SID_NUM_REGS] = {0};
+    bool ok = true;
+    for (int i = 0; ok && (i <= (int)(sizeof(gaps) / sizeof(gaps[0]))); i++) {
+        regs[0] = (uint8_t)(i * 37 + 1);
+        regs[1] = (uint8_t)(i * 29 + 7);
+        regs[SID_REG_MODEVOL] = (uint8_t)(0x0F - i);
+        ok = sidtrace_record(&trace, regs, (1u << 0) | (1u << 1) | (1u << SID_REG_MODEVOL));
+        const int gap = (i < (int)(sizeof(gaps) / sizeof(gaps[0]))) ? gaps[i] : 1;
+        for (int frame = 1; ok && (frame < gap); frame++) {
+            ok = sidtrace_record(&trace, regs, 0);
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "numbersid-psid: out of memory\n");
+        sidtrace_discard(&trace);
+        return false;
+    }
+    psid_desc_t desc = *player_desc;
+    desc.trace = trace.data;
+    desc.trace_size = trace.size;
+    psid_t* psid = &state.psid;
+    ok = psid_build(psid, &desc);
+    if (!ok) {
+        fprintf(stderr, "numbersid-psid: selftest: %s\n", psid->error);
+    }
+    else if (verify_psid(psid, trace.data, trace.size, desc.ntsc) < 0) {
+        fprintf(stderr, "numbersid-psid: selftest: gaps of up to %d frames are not played correctly\n", gaps[sizeof(gaps) / sizeof(gaps[0]) - 1]);
+        ok = false;
+    }
+    sidtrace_discard(&trace);
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    sargs_setup(&(sargs_desc){ .argc = argc, .argv = argv });
+    stm_setup();
+
+    if (sargs_equals("verify", "selftest")) {
+        const psid_desc_t desc = {
+            .load_addr = parse_addr(sargs_value_def("load", "$1000")),
+            .ntsc = sargs_equals("video", "ntsc"),
+            .vbi = sargs_equals("speed", "vbi"),
+        };
+        const bool ok = selftest(&desc);
+        if (ok) {
+            printf("numbersid-psid: selftest: ok\n");
+        }
+        sargs_shutdown();
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    const char* out_path = sargs_value_def("out", 0);
+    if (!out_path) {
+        fprintf(stderr, "usage: numbersid-psid out=song.sid [patch=file|-] [trace=in.nstr] [seconds=180] [name=...] [author=...] [released=...] [video=pal|ntsc] [speed=cia|vbi] [load=$1000] [verify=yes|no|selftest]\n");
+        return EXIT_FAILURE;
+    }
+
+    // capture the register writes, or load a capture
+    const uint64_t start_time = stm_now();
+    const uint8_t* trace_data = 0;
+    int trace_size = 0;
+    uint8_t* trace_file = 0;
+    if (sargs_exists("trace")) {
+        const char* trace_path = sargs_value("trace");
+        trace_file = read_file(trace_path, &trace_size);
+        if (!trace_file) {
+            fprintf(stderr, "numbersid-psid: failed to load trace '%s'\n", trace_path);
+            return EXIT_FAILURE;
+        }
+        trace_data = trace_file;
+    }
+    else {
+        sequencer_init(&state.sequencer);
+        if (sargs_exists("patch")) {
+            const char* patch_path = sargs_value("patch");
+            sequencer_import_result_t result = {0};
+            if (!render_load_patch(&state.sequencer, patch_path, &result)) {
+                if (result.error) {
+                    fprintf(stderr, "numbersid-psid: %s:%d:%d: %s\n", patch_path, result.error_line, result.error_column, result.error);
+                }
+                else {
+                    fprintf(stderr, "numbersid-psid: failed to load patch '%s'\n", patch_path);
+                }
+                return EXIT_FAILURE;
+            }
+        }
+        const int num_frames = (int)(atof(sargs_value_def("seconds", "180")) * RENDER_FRAME_HZ);
+        if (num_frames <= 0) {
+            fprintf(stderr, "numbersid-psid: invalid seconds\n");
+            return EXIT_FAILURE;
+        }
+        // same as render_frame(), without the SID
+        sidtrace_init(&state.trace);
+        uint8_t regs[SID_NUM_REGS] = {0};
+        for (int frame = 0; frame < num_frames; frame++) {
+            sequencer_advance(&state.sequencer);
+            const uint32_t mask = sequencer_sid_writes(&state.sequencer, regs);
+            if (!sidtrace_record(&state.trace, regs, mask)) {
+                fprintf(stderr, "numbersid-psid: out of memory\n");
+                return EXIT_FAILURE;
+            }
+        }
+        trace_data = state.trace.data;
+        trace_size = state.trace.size;
+    }
+
+    const psid_desc_t desc = {
+        .trace = trace_data,
+        .trace_size = trace_size,
+        .name = sargs_value_def("name", "numbersid"),
+        .author = sargs_value_def("author", ""),
+        .released = sargs_value_def("released", ""),
+        .load_addr = parse_addr(sargs_value_def("load", "$1000")),
+        .ntsc = sargs_equals("video", "ntsc"),
+        .vbi = sargs_equals("speed", "vbi"),
+    };
+    psid_t* psid = &state.psid;
+    if (!psid_build(psid, &desc)) {
+        fprintf(stderr, "numbersid-psid: %s\n", psid->error);
+        return EXIT_FAILURE;
+    }
+    const uint64_t export_ticks = stm_since(start_time);
+    if (!write_file(out_path, psid->data, psid->size)) {
+        fprintf(stderr, "numbersid-psid: failed to write '%s'\n", out_path);
+        return EXIT_FAILURE;
+    }
+    const double seconds = (double)psid->num_frames / RENDER_FRAME_HZ;
+    printf("numbersid-psid: %s: %d bytes, %.1f seconds, %s, %s (exported in %.1f ms)\n",
+        out_path, psid->size, seconds, desc.ntsc ? "NTSC" : "PAL",
+        psid->cia ? "60 Hz CIA timer" : (desc.ntsc ? "60 Hz vertical blank" : "50 Hz vertical blank"),
+        stm_ms(export_ticks));
+    printf("  load $%04x, init $%04x, play $%04x, end $%04x\n",
+        psid->load_addr, psid->init_addr, psid->play_addr, psid->stream_addr + psid->stream_size - 1);
+    printf("  player %d bytes, stream %d bytes (%d events, %.1f bytes per second)\n",
+        psid->code_size, psid->stream_size, psid->num_events, psid->stream_size / seconds);
+
+    bool ok = true;
+    if (!sargs_equals("verify", "no")) {
+        const int max_cycles = verify_psid(psid, trace_data, trace_size, desc.ntsc);
+        ok = (max_cycles >= 0);
+        if (ok) {
+            printf("  verify: ok, %d frames, play %d cycles at most (%.1f rasterlines)\n",
+                psid->num_frames, max_cycles, (double)max_cycles / C64HOST_PAL_CYCLES_PER_LINE);
+        }
+    }
+    sidtrace_discard(&state.trace);
+    free(trace_file);
+    sargs_shutdown();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,367 @@
+/*
+    Numbersid headless renderer.
+
+    Renders a patch without UI or audio output and writes the spectrogram
+    of the complete piece to a PNG file, using the same palette as the
+    FFT display of the application.
+
+    Usage:
+
+        numbersid-render png=out.png [patch=file|-] [seconds=60] [hop=256]
+                         [width=N] [height=300] [threads=N]
+                         [trace=out.nstr] [replay=in.nstr]
+
+    - patch:    patch data as exported from the Data window, '-' for stdin
+                (default: the patch the application boots with)
+    - seconds:  length of the rendered piece, at most the length of the
+                trace with replay (default: 60, or the whole trace)
+    - hop:      number of samples between spectrogram columns
+    - width:    image width, overrides hop
+    - height:   image height (number of frequency rows)
+    - threads:  number of STFT worker threads (default: number of cores)
+    - trace:    write the SID register writes of the piece to a trace file
+    - replay:   render the register writes of a trace file instead of
+                running the sequencer, patch is ignored
+
+    To render with a patch compiled by numbersid-codegen, build with
+    -DRENDER_PATCH_SOURCE='"song.c"' -DRENDER_PATCH_FUNC=song_update and
+    pass the same patch with patch=song.txt.
+
+    The piece is rendered in chunks of columns. While the worker threads
+    compute the STFT columns of one chunk, the main thread renders the
+    audio of the next one, so rendering and analysis overlap.
+
+    ## zlib/libpng license
+
+    Copyright (c) 2025 Rick van der Meiden
+
+    This software is provided 'as-is', without any express or implied warranty.
+    In no event will the authors be held liable for any damages arising from the
+    use of this software.
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+        1. The origin of this software must not be misrepresented; you must not
+        claim that you wrote the original software. If you use this software in a
+        product, an acknowledgment in the product documentation would be
+        appreciated but is not required.
+        2. Altered source versions must be plainly marked as such, and must not
+        be misrepresented as being the original software.
+        3. This notice may not be removed or altered from any source
+        distribution.
+*/
+
+#define CHIPS_IMPL
+#include "chips/chips_common.h"
+#include "chips/m6581.h"
+
+#define SOKOL_ARGS_IMPL
+#include "sokol_args.h"
+#define SOKOL_TIME_IMPL
+#include "sokol_time.h"
+
+#include "sequencer.h"
+#include "render.h"
+#include "spectrogram.h"
+#include "png.h"
+#include "sidtrace.h"
+#include "thread.h"
+#if defined(RENDER_PATCH_SOURCE) && defined(RENDER_PATCH_FUNC)
+#include RENDER_PATCH_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FFT_SIZE (1024)                 // same as the FFT display in the app
+#define CHUNK_COLUMNS (4096)            // spectrogram columns per chunk
+#define MAX_THREADS (64)
+
+typedef struct {
+    const spectrogram_t* spec;
+    const float* samples;       // chunk sample buffer, FFT_SIZE samples of history first
+    int hop;
+    int first_column;           // first column within the chunk
+    int num_columns;
+    uint8_t* pixels;            // top-left pixel of the first column
+    int stride;                 // image width
+} stft_job_t;
+
+static struct {
+    spectrogram_t spec;
+    render_t render;
+    float pending[RENDER_MAX_FRAME_SAMPLES];
+    int num_pending;
+    int num_frames;
+    int rendered_frames;
+    bool tracing;
+    bool trace_failed;                  // out of memory, no trace is written
+    sidtrace_t trace;
+    bool replaying;
+    sidtrace_player_t replay;
+    uint8_t replay_regs[SID_NUM_REGS];
+} state;
+
+static void stft_job(void* arg) {
+    const stft_job_t* job = (const stft_job_t*) arg;
+    for (int i = 0; i < job->num_columns; i++) {
+        int col = job->first_column + i;
+        // column col covers the FFT_SIZE samples up to and including the end of its hop
+        const float* window = &job->samples[(col + 1) * job->hop];
+        spectrogram_column(job->spec, window, &job->pixels[i], job->stride);
+    }
+}
+
+// fill dst with num_samples rendered samples, zero-padded when the piece is done
+static void render_samples(float* dst, int num_samples) {
+    int pos = 0;
+    while (pos < num_samples) {
+        if (state.num_pending == 0) {
+            if (state.rendered_frames < state.num_frames) {
+                if (state.replaying) {
+                    const uint32_t mask = sidtrace_player_next(&state.replay, state.replay_regs);
+                    state.num_pending = render_replay_frame(&state.render, state.replay_regs, mask, state.pending, RENDER_MAX_FRAME_SAMPLES);
+                }
+                else {
+                    state.num_pending = render_frame(&state.render, state.pending, RENDER_MAX_FRAME_SAMPLES);
+                    if (state.tracing && !sidtrace_record(&state.trace, state.render.sid_regs, state.render.sid_mask)) {
+                        state.tracing = false;
+                        state.trace_failed = true;
+                        fprintf(stderr, "numbersid-render: out of memory, the trace is not written\n");
+                    }
+                }
+                state.rendered_frames++;
+            }
+            else {
+                memset(&dst[pos], 0, (num_samples - pos) * sizeof(float));
+                return;
+            }
+        }
+        int n = num_samples - pos;
+        if (n > state.num_pending) n = state.num_pending;
+        memcpy(&dst[pos], state.pending, n * sizeof(float));
+        memmove(state.pending, &state.pending[n], (state.num_pending - n) * sizeof(float));
+        state.num_pending -= n;
+        pos += n;
+    }
+}
+
+static uint8_t* read_file(const char* path, int* size) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        return 0;
+    }
+    uint8_t* data = 0;
+    if ((0 == fseek(fp, 0, SEEK_END)) && ((*size = (int)ftell(fp)) >= 0) && (0 == fseek(fp, 0, SEEK_SET))) {
+        data = malloc(*size ? *size : 1);
+        if (data && (fread(data, 1, *size, fp) != (size_t)*size)) {
+            free(data);
+            data = 0;
+        }
+    }
+    fclose(fp);
+    return data;
+}
+
+static bool write_file(const char* path, const void* data, size_t size) {
+    FILE* fp = fopen(path, "wb");
+    if (!fp) {
+        return false;
+    }
+    bool ok = (fwrite(data, 1, size, fp) == size);
+    ok = (0 == fclose(fp)) && ok;
+    return ok;
+}
+
+static bool write_png(const char* path, const uint8_t* image, int width, int height) {
+    FILE* fp = fopen(path, "wb");
+    if (!fp) {
+        return false;
+    }
+    static png_t png;
+    uint32_t palette[256];
+    spectrogram_palette(palette);
+    bool ok = png_begin(&png, fp, width, height, palette);
+    for (int y = 0; ok && (y < height); y++) {
+        ok = png_write_row(&png, &image[(size_t)y * width]);
+    }
+    ok = ok && png_end(&png);
+    fclose(fp);
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    sargs_setup(&(sargs_desc){ .argc = argc, .argv = argv });
+    stm_setup();
+
+    const char* png_path = sargs_value_def("png", 0);
+    if (!png_path) {
+        fprintf(stderr, "usage: numbersid-render png=out.png [patch=file|-] [seconds=60] [hop=256] [width=N] [height=300] [threads=N] [trace=out.nstr] [replay=in.nstr]\n");
+        return EXIT_FAILURE;
+    }
+    const double seconds = atof(sargs_value_def("seconds", "60"));
+    const int height = atoi(sargs_value_def("height", "300"));
+    int hop = atoi(sargs_value_def("hop", "256"));
+    int num_threads = atoi(sargs_value_def("threads", "0"));
+    if (num_threads <= 0) num_threads = thread_num_cores();
+    if (num_threads > MAX_THREADS) num_threads = MAX_THREADS;
+
+    render_init(&state.render);
+#if defined(RENDER_PATCH_SOURCE) && defined(RENDER_PATCH_FUNC)
+    state.render.update_variables = RENDER_PATCH_FUNC;
+#endif
+    if (sargs_exists("patch")) {
+        const char* patch_path = sargs_value("patch");
+        sequencer_import_result_t result = {0};
+        if (!render_load_patch(&state.render.sequencer, patch_path, &result)) {
+            if (result.error) {
+                fprintf(stderr, "numbersid-render: %s:%d:%d: %s\n", patch_path, result.error_line, result.error_column, result.error);
+            }
+            else {
+                fprintf(stderr, "numbersid-render: failed to load patch '%s'\n", patch_path);
+            }
+            return EXIT_FAILURE;
+        }
+    }
+
+    uint8_t* replay_data = 0;
+    if (sargs_exists("replay")) {
+        const char* replay_path = sargs_value("replay");
+        int replay_size = 0;
+        replay_data = read_file(replay_path, &replay_size);
+        if (!replay_data || !sidtrace_player_init(&state.replay, replay_data, replay_size)) {
+            fprintf(stderr, "numbersid-render: failed to load trace '%s'\n", replay_path);
+            return EXIT_FAILURE;
+        }
+        state.replaying = true;
+    }
+    else if (sargs_exists("trace")) {
+        sidtrace_init(&state.trace);
+        state.tracing = true;
+    }
+
+    state.num_frames = (int)(seconds * RENDER_FRAME_HZ);
+    if (state.replaying) {
+        // the trace ends with its last frame, there is nothing to render after it
+        const int trace_frames = (int)state.replay.num_frames;
+        if (!sargs_exists("seconds")) {
+            state.num_frames = trace_frames;
+        }
+        else if (state.num_frames > trace_frames) {
+            fprintf(stderr, "numbersid-render: trace is only %.1f seconds long, rendering all of it\n",
+                (double)trace_frames / RENDER_FRAME_HZ);
+            state.num_frames = trace_frames;
+        }
+    }
+    const int64_t total_samples = ((int64_t)state.num_frames * RENDER_SAMPLE_HZ) / RENDER_FRAME_HZ;
+    if (sargs_exists("width")) {
+        int w = atoi(sargs_value("width"));
+        hop = (w > 0) ? (int)(total_samples / w) : 0;
+    }
+    if ((state.num_frames <= 0) || (hop <= 0) || (height <= 0) || (total_samples / hop) <= 0) {
+        fprintf(stderr, "numbersid-render: invalid seconds, hop, width or height\n");
+        return EXIT_FAILURE;
+    }
+    const int width = (int)(total_samples / hop);
+
+    spectrogram_init(&state.spec, FFT_SIZE, height);
+    uint8_t* image = calloc((size_t)width * height, 1);
+    // a chunk is never wider than the image, with a large hop the audio of a chunk is large
+    const int chunk_columns = (width < CHUNK_COLUMNS) ? width : CHUNK_COLUMNS;
+    const size_t chunk_samples = (size_t)chunk_columns * hop;
+    float* buffers[2] = {
+        calloc(FFT_SIZE + chunk_samples, sizeof(float)),
+        calloc(FFT_SIZE + chunk_samples, sizeof(float)),
+    };
+    if (!image || !buffers[0] || !buffers[1]) {
+        fprintf(stderr, "numbersid-render: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    const uint64_t start_time = stm_now();
+    uint64_t render_ticks = 0;
+    uint64_t t = stm_now();
+    render_samples(&buffers[0][FFT_SIZE], (int)chunk_samples);
+    render_ticks += stm_since(t);
+
+    const int num_chunks = (width + chunk_columns - 1) / chunk_columns;
+    for (int chunk = 0; chunk < num_chunks; chunk++) {
+        float* cur = buffers[chunk & 1];
+        float* next = buffers[(chunk + 1) & 1];
+        const int first_column = chunk * chunk_columns;
+        int num_columns = width - first_column;
+        if (num_columns > chunk_columns) num_columns = chunk_columns;
+
+        // start the STFT of this chunk on the worker threads
+        stft_job_t jobs[MAX_THREADS];
+        thread_t threads[MAX_THREADS];
+        const int columns_per_job = (num_columns + num_threads - 1) / num_threads;
+        int num_jobs = 0;
+        for (int first = 0; first < num_columns; first += columns_per_job) {
+            stft_job_t* job = &jobs[num_jobs];
+            *job = (stft_job_t){
+                .spec = &state.spec,
+                .samples = cur,
+                .hop = hop,
+                .first_column = first,
+                .num_columns = (first + columns_per_job < num_columns) ? columns_per_job : (num_columns - first),
+                .pixels = &image[first_column + first],
+                .stride = width,
+            };
+            if (!thread_start(&threads[num_jobs], stft_job, job)) {
+                stft_job(job);
+            }
+            num_jobs++;
+        }
+
+        // meanwhile render the audio of the next chunk, the last FFT_SIZE samples are its history
+        if (chunk + 1 < num_chunks) {
+            t = stm_now();
+            memcpy(next, &cur[chunk_samples], FFT_SIZE * sizeof(float));
+            render_samples(&next[FFT_SIZE], (int)chunk_samples);
+            render_ticks += stm_since(t);
+        }
+
+        for (int i = 0; i < num_jobs; i++) {
+            thread_join(&threads[i]);
+        }
+    }
+    const uint64_t analysis_ticks = stm_since(start_time);
+
+    t = stm_now();
+    bool ok = write_png(png_path, image, width, height);
+    const uint64_t png_ticks = stm_since(t);
+    if (!ok) {
+        fprintf(stderr, "numbersid-render: failed to write '%s'\n", png_path);
+    }
+    else {
+        printf("numbersid-render: %s: %dx%d (%d frames, hop %d, %d threads)\n",
+            png_path, width, height, state.num_frames, hop, num_threads);
+        printf("  render+stft: %.2fs (audio render: %.2fs), png: %.2fs\n",
+            stm_sec(analysis_ticks), stm_sec(render_ticks), stm_sec(png_ticks));
+    }
+
+    if (ok && state.tracing) {
+        const char* trace_path = sargs_value("trace");
+        ok = write_file(trace_path, state.trace.data, state.trace.size);
+        if (ok) {
+            printf("  trace: %s, %d bytes (%.2f bytes per frame)\n",
+                trace_path, state.trace.size, (double)state.trace.size / state.trace.num_frames);
+        }
+        else {
+            fprintf(stderr, "numbersid-render: failed to write '%s'\n", trace_path);
+        }
+    }
+
+    // the image is complete without the trace, but the run asked for both
+    ok = ok && !state.trace_failed;
+
+    sidtrace_discard(&state.trace);
+    free(replay_data);
+    free(buffers[0]);
+    free(buffers[1]);
+    free(image);
+    sargs_shutdown();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,351 @@
+/*
+    Numbersid render throughput benchmark.
+
+    Renders a set of representative patches headless, like numbersid-render
+    does (sequencer, SID emulation and spectrogram), and reports how many
+    seconds of audio are rendered per wall-clock second, on one thread and
+    on all cores, with the time of every stage and the peak memory use.
+
+    Usage:
+
+        numbersid-throughput [seconds=600] [threads=N] [hop=256] [fft=yes]
+                             [patches=sparse,dense,arrays,base,full]
+                             [json=out.json]
+
+    - seconds:  seconds of audio rendered per patch
+    - threads:  number of threads of the all-core run (default: number
+                of cores)
+    - hop:      number of samples between spectrogram columns, as in
+                numbersid-render
+    - fft:      'no' to leave out the spectrogram and only render audio
+    - patches:  comma separated generated patches (see patchgen.h) or
+                patch files
+    - json:     write the results to a JSON file
+
+    Every patch is first rendered on one thread, timing every stage:
+
+        - sequencer:    sequencer_advance(), the variables of a frame
+        - sid_writes:   sequencer_sid_writes(), the SID registers of a frame
+        - sid:          the SID emulation, 985248 ticks per second of audio
+        - spectrogram:  the STFT columns of the audio
+
+    Then every thread renders the same patch at the same time, to measure
+    how throughput scales with the cores (memory bandwidth, shared caches,
+    turbo clocks). The realtime factor is the seconds of audio per wall
+    clock second, summed over the threads for the all-core run. The peak
+    RSS is that of the whole process, after all single-thread runs and
+    after all runs.
+
+    ## zlib/libpng license
+
+    Copyright (c) 2025 Rick van der Meiden
+
+    This software is provided 'as-is', without any express or implied warranty.
+    In no event will the authors be held liable for any damages arising from the
+    use of this software.
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+        1. The origin of this software must not be misrepresented; you must not
+        claim that you wrote the original software. If you use this software in a
+        product, an acknowledgment in the product documentation would be
+        appreciated but is not required.
+        2. Altered source versions must be plainly marked as such, and must not
+        be misrepresented as being the original software.
+        3. This notice may not be removed or altered from any source
+        distribution.
+*/
+
+#define CHIPS_IMPL
+#include "chips/chips_common.h"
+#include "chips/m6581.h"
+
+#define SOKOL_ARGS_IMPL
+#include "sokol_args.h"
+#define SOKOL_TIME_IMPL
+#include "sokol_time.h"
+
+#include "sequencer.h"
+#include "render.h"
+#include "patchgen.h"
+#include "spectrogram.h"
+#include "thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+#define FFT_SIZE (1024)                 // same as numbersid-render
+#define SPECTROGRAM_HEIGHT (300)
+#define MAX_THREADS (64)
+#define MAX_PATCHES (32)
+#define NAME_SIZE (256)
+
+typedef enum {
+    STAGE_SEQUENCER,
+    STAGE_SID_WRITES,
+    STAGE_SID,
+    STAGE_SPECTROGRAM,
+    NUM_STAGES,
+} stage_t;
+
+static const char* stage_names[NUM_STAGES] = { "sequencer", "sid_writes", "sid", "spectrogram" };
+
+typedef struct {
+    const sequencer_t* patch;
+    int num_frames;
+    int hop;                            // 0: no spectrogram
+    uint64_t stage_ticks[NUM_STAGES];
+    render_t render;
+    float samples[RENDER_MAX_FRAME_SAMPLES];
+    float history[FFT_SIZE + RENDER_MAX_FRAME_SAMPLES];
+    uint8_t column[SPECTROGRAM_HEIGHT];
+} job_t;
+
+typedef struct {
+    char name[NAME_SIZE];
+    sequencer_t patch;
+    double single_sec;                  // wall clock time of the single-thread run
+    double stage_sec[NUM_STAGES];
+    double all_sec;                     // wall clock time of the all-core run
+} patch_result_t;
+
+static struct {
+    spectrogram_t spec;
+    patch_result_t patches[MAX_PATCHES];
+    int num_patches;
+    job_t* jobs;                        // one per thread
+} state;
+
+static uint64_t peak_rss_bytes(void) {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc;
+    return GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)) ? (uint64_t)pmc.PeakWorkingSetSize : 0;
+#else
+    struct rusage usage;
+    if (0 != getrusage(RUSAGE_SELF, &usage)) {
+        return 0;
+    }
+    #if defined(__APPLE__)
+        return (uint64_t)usage.ru_maxrss;
+    #else
+        return (uint64_t)usage.ru_maxrss * 1024;
+    #endif
+#endif
+}
+
+// same as render_frame() plus the spectrogram, with the time of every stage
+static void render_job(void* arg) {
+    job_t* job = (job_t*) arg;
+    render_t* render = &job->render;
+    render_init(render);
+    render->sequencer = *job->patch;
+    memset(job->stage_ticks, 0, sizeof(job->stage_ticks));
+    int num_history = 0;
+    int skip = 0;
+    for (int frame = 0; frame < job->num_frames; frame++) {
+        uint64_t t = stm_now();
+        sequencer_advance(&render->sequencer);
+        job->stage_ticks[STAGE_SEQUENCER] += stm_laptime(&t);
+        render->sid_mask = sequencer_sid_writes(&render->sequencer, render->sid_regs);
+        job->stage_ticks[STAGE_SID_WRITES] += stm_laptime(&t);
+        const int n = render_replay_frame(render, render->sid_regs, render->sid_mask, job->samples, RENDER_MAX_FRAME_SAMPLES);
+        job->stage_ticks[STAGE_SID] += stm_laptime(&t);
+        if (job->hop > 0) {
+            // columns every hop samples, the history keeps the samples of the next window
+            const int skipped = (skip < n) ? skip : n;
+            skip -= skipped;
+            memcpy(&job->history[num_history], &job->samples[skipped], (n - skipped) * sizeof(float));
+            num_history += n - skipped;
+            int pos = 0;
+            while (num_history - pos >= FFT_SIZE) {
+                spectrogram_column(&state.spec, &job->history[pos], job->column, 1);
+                pos += job->hop;
+            }
+            if (pos > num_history) {
+                // hop larger than the window
+                skip = pos - num_history;
+                pos = num_history;
+            }
+            memmove(job->history, &job->history[pos], (num_history - pos) * sizeof(float));
+            num_history -= pos;
+            job->stage_ticks[STAGE_SPECTROGRAM] += stm_laptime(&t);
+        }
+    }
+}
+
+static bool add_patches(const char* list) {
+    const char* p = list;
+    while (*p) {
+        const char* end = strchr(p, ',');
+        const size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len >= NAME_SIZE) {
+            fprintf(stderr, "numbersid-throughput: name too long '%.*s'\n", (int)len, p);
+            return false;
+        }
+        if (len > 0) {
+            if (state.num_patches == MAX_PATCHES) {
+                fprintf(stderr, "numbersid-throughput: more than %d patches\n", MAX_PATCHES);
+                return false;
+            }
+            patch_result_t* res = &state.patches[state.num_patches++];
+            memcpy(res->name, p, len);
+            res->name[len] = 0;
+            const patchgen_kind_t kind = patchgen_find(res->name);
+            if (kind != PATCHGEN_NUM) {
+                patchgen_make(&res->patch, kind);
+            }
+            else {
+                sequencer_import_result_t result = {0};
+                sequencer_init(&res->patch);
+                if (!render_load_patch(&res->patch, res->name, &result)) {
+                    if (result.error) {
+                        fprintf(stderr, "numbersid-throughput: %s:%d:%d: %s\n", res->name, result.error_line, result.error_column, result.error);
+                    }
+                    else {
+                        fprintf(stderr, "numbersid-throughput: failed to load patch '%s'\n", res->name);
+                    }
+                    return false;
+                }
+            }
+        }
+        p += len + (end ? 1 : 0);
+    }
+    return true;
+}
+
+static bool write_json(FILE* fp, double seconds, int num_threads, int hop, uint64_t rss_single, uint64_t rss_all) {
+    double single_sec = 0.0;
+    double all_sec = 0.0;
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"version\": 1,\n");
+    fprintf(fp, "  \"seconds\": %g,\n", seconds);
+    fprintf(fp, "  \"threads\": %d,\n", num_threads);
+    fprintf(fp, "  \"hop\": %d,\n", hop);
+    fprintf(fp, "  \"fft_size\": %d,\n", FFT_SIZE);
+    fprintf(fp, "  \"peak_rss_single_bytes\": %llu,\n", (unsigned long long)rss_single);
+    fprintf(fp, "  \"peak_rss_all_bytes\": %llu,\n", (unsigned long long)rss_all);
+    fprintf(fp, "  \"patches\": [\n");
+    for (int i = 0; i < state.num_patches; i++) {
+        const patch_result_t* res = &state.patches[i];
+        fprintf(fp, "    { \"name\": \"%s\",\n", res->name);
+        fprintf(fp, "      \"single\": { \"wall_sec\": %.3f, \"realtime_factor\": %.2f, \"stages_sec\": { ",
+            res->single_sec, seconds / res->single_sec);
+        for (int s = 0; s < NUM_STAGES; s++) {
+            fprintf(fp, "%s\"%s\": %.3f", (s > 0) ? ", " : "", stage_names[s], res->stage_sec[s]);
+        }
+        fprintf(fp, " } },\n");
+        fprintf(fp, "      \"all_cores\": { \"wall_sec\": %.3f, \"realtime_factor\": %.2f } }%s\n",
+            res->all_sec, seconds * num_threads / res->all_sec, (i + 1 < state.num_patches) ? "," : "");
+        single_sec += res->single_sec;
+        all_sec += res->all_sec;
+    }
+    fprintf(fp, "  ],\n");
+    fprintf(fp, "  \"total\": { \"single_realtime_factor\": %.2f, \"all_cores_realtime_factor\": %.2f }\n",
+        seconds * state.num_patches / single_sec, seconds * state.num_patches * num_threads / all_sec);
+    fprintf(fp, "}\n");
+    return !ferror(fp);
+}
+
+int main(int argc, char* argv[]) {
+    sargs_setup(&(sargs_desc){ .argc = argc, .argv = argv });
+    stm_setup();
+
+    const double seconds = atof(sargs_value_def("seconds", "600"));
+    const int hop = (0 == strcmp(sargs_value_def("fft", "yes"), "no")) ? 0 : atoi(sargs_value_def("hop", "256"));
+    int num_threads = atoi(sargs_value_def("threads", "0"));
+    if (num_threads <= 0) num_threads = thread_num_cores();
+    if (num_threads > MAX_THREADS) num_threads = MAX_THREADS;
+    const int num_frames = (int)(seconds * RENDER_FRAME_HZ);
+    if ((num_frames <= 0) || (hop < 0) || (sargs_exists("hop") && (hop == 0))) {
+        fprintf(stderr, "usage: numbersid-throughput [seconds=600] [threads=N] [hop=256] [fft=yes] [patches=sparse,dense,arrays,base,full] [json=out.json]\n");
+        return EXIT_FAILURE;
+    }
+    if (!add_patches(sargs_value_def("patches", "sparse,dense,arrays,base,full"))) {
+        return EXIT_FAILURE;
+    }
+    spectrogram_init(&state.spec, FFT_SIZE, SPECTROGRAM_HEIGHT);
+    state.jobs = calloc(num_threads, sizeof(job_t));
+    if (!state.jobs) {
+        fprintf(stderr, "numbersid-throughput: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%d patches, %g seconds each, hop %d, %d threads\n\n", state.num_patches, seconds, hop, num_threads);
+    printf("%-24s %10s", "single thread", "realtime");
+    for (int s = 0; s < NUM_STAGES; s++) {
+        printf(" %11s", stage_names[s]);
+    }
+    printf("\n");
+    for (int i = 0; i < state.num_patches; i++) {
+        patch_result_t* res = &state.patches[i];
+        job_t* job = &state.jobs[0];
+        job->patch = &res->patch;
+        job->num_frames = num_frames;
+        job->hop = hop;
+        const uint64_t t = stm_now();
+        render_job(job);
+        res->single_sec = stm_sec(stm_since(t));
+        printf("%-24s %9.1fx", res->name, seconds / res->single_sec);
+        for (int s = 0; s < NUM_STAGES; s++) {
+            res->stage_sec[s] = stm_sec(job->stage_ticks[s]);
+            printf(" %10.1f%%", 100.0 * res->stage_sec[s] / res->single_sec);
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+    const uint64_t rss_single = peak_rss_bytes();
+
+    printf("\n%-24s %10s\n", "all cores", "realtime");
+    for (int i = 0; i < state.num_patches; i++) {
+        patch_result_t* res = &state.patches[i];
+        thread_t threads[MAX_THREADS];
+        bool started[MAX_THREADS];
+        const uint64_t t = stm_now();
+        for (int j = 0; j < num_threads; j++) {
+            job_t* job = &state.jobs[j];
+            job->patch = &res->patch;
+            job->num_frames = num_frames;
+            job->hop = hop;
+            started[j] = thread_start(&threads[j], render_job, job);
+            if (!started[j]) {
+                render_job(job);
+            }
+        }
+        for (int j = 0; j < num_threads; j++) {
+            if (started[j]) {
+                thread_join(&threads[j]);
+            }
+        }
+        res->all_sec = stm_sec(stm_since(t));
+        printf("%-24s %9.1fx  (%.1fx per thread)\n", res->name,
+            seconds * num_threads / res->all_sec, seconds / res->all_sec);
+        fflush(stdout);
+    }
+    const uint64_t rss_all = peak_rss_bytes();
+    printf("\npeak RSS: %.1f MB single thread, %.1f MB all cores\n",
+        (double)rss_single / (1024.0 * 1024.0), (double)rss_all / (1024.0 * 1024.0));
+
+    bool ok = true;
+    if (sargs_exists("json")) {
+        const char* json_path = sargs_value("json");
+        FILE* fp = fopen(json_path, "w");
+        ok = fp && write_json(fp, seconds, num_threads, hop, rss_single, rss_all);
+        if (fp) {
+            ok = (0 == fclose(fp)) && ok;
+        }
+        if (!ok) {
+            fprintf(stderr, "numbersid-throughput: failed to write '%s'\n", json_path);
+        }
+    }
+    free(state.jobs);
+    sargs_shutdown();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
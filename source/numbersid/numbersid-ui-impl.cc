@@ -19,6 +19,7 @@
 #include "ui/ui_display.h"
 
 #include "sequencer.h"
+#include "history.h"
 #include "ui_timecontrol.h"
 #include "ui_parameters.h"
 #include "ui_variables.h"
@@ -26,5 +27,9 @@
 #include "ui_preview.h"
 #include "ui_help.h"
 #include "ui_data.h"
+#include "patchlib.h"
+#include "ui_library.h"
+#include "prof.h"
+#include "ui_profiler.h"
 
 #include "ui_numbersid.h"
@@ -34,7 +34,16 @@
 #include "chips/clk.h"
 
 #include "common.h"
+#include "thread.h"
 #include "sequencer.h"
+#include "engine.h"
+#include "history.h"
+#include "spectrogram.h"
+#include "audiofile.h"
+#include "audiostats.h"
+#include "audiolatency.h"
+#include "lz.h"
+#include "patchlib.h"
 
 #include "ui.h"
 #include "ui/ui_settings.h"
@@ -50,44 +59,243 @@
 #include "ui_preview.h"
 #include "ui_help.h"
 #include "ui_data.h"
+#include "ui_library.h"
+#include "ui_profiler.h"
 #include "ui/ui_snapshot.h"
 #include "ui_numbersid.h"
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 // --------------
 
 #define C64_FREQUENCY (985248)          // clock frequency in Hz; We'll be updating the SID as if in a C64
+#define AUDIO_SAMPLE_RATE (48000)       // SID output and saudio sample rate
 #define MAX_AUDIO_SAMPLES (1024)        // max number of audio samples in internal sample buffer
 #define DEFAULT_AUDIO_SAMPLES (1024)    // default number of samples in internal sample buffer
                                         // Note: this is quite high, but we are only updating at 60PS = 800 samples/frame
+#define MAX_AUDIO_SINKS (4)             // saudio, the recorder, ...
+#define AUDIO_PACKET_FRAMES (64)        // saudio push queue: 64x128 = 8192 samples =~ 0.17 secs, room for slow machines,
+#define AUDIO_NUM_PACKETS (128)         // the latency is the adaptive fill level of the queue, not its size
+#define AUDIO_MIN_LATENCY_FRAMES (256)  // lowest adaptive latency target
+#define AUDIO_BUFFER_FRAMES (512)       // must be larger than packet_frames, but <1024 (in browser at least)
 #define FFT_BUFFER_SIZE 1024            // must be  a power of two 
+#define SEQUENCER_HZ (60)               // sequencer frames per second, independent of display rate
+#define DEFAULT_IDLE_FPS (10)           // redraw rate when throttled
+#define THROTTLED_FRAME_US (33333)      // frame period when throttled, short enough to keep the audio queue filled
+#define PIPELINE_BLOCK_SAMPLES (1024)   // audio of one step for the spectrogram, 800 samples at 48 kHz
+#define PIPELINE_NUM_BLOCKS (64)        // engine -> analysis queue, about a second of steps
+#define PIPELINE_NUM_COLUMNS (64)       // analysis -> render queue, about a second of spectrogram columns
+#define PIPELINE_MAX_LAG_US (250000)    // a late engine thread skips ahead instead of catching up beyond this
 
 #define FRAMEBUFFER_WIDTH 400
 #define FRAMEBUFFER_HEIGHT 300
 #define FRAMEBUFFER_SIZE_BYTES (FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT)
 
+#define SNAPSHOT_NAME "numbersid"                   // fs names of the snapshot and screenshot blobs
+#define SCREENSHOT_NAME "numbersid_screenshot"
+#define SCREENSHOT_HEADER_SIZE (8)                  // 'N','S','S','C', width, height (u16 each)
+#define SCREENSHOT_MAX_BLOB_SIZE (SCREENSHOT_HEADER_SIZE + LZ_BOUND(SCREENSHOT_SIZE_BYTES))
+
+#define LIBRARY_DEFAULT_PATH "numbersid-library.nspl"   // in the working directory
+#define THUMBNAIL_WIDTH (2 * UI_LIBRARY_THUMBNAIL_WIDTH)     // the texture is downscaled once more
+#define THUMBNAIL_HEIGHT (2 * UI_LIBRARY_THUMBNAIL_HEIGHT)
+#define THUMBNAIL_SIZE_BYTES (THUMBNAIL_WIDTH * THUMBNAIL_HEIGHT)
+#define THUMBNAIL_MAX_BLOB_SIZE (SCREENSHOT_HEADER_SIZE + LZ_BOUND(THUMBNAIL_SIZE_BYTES))
+#define ATLAS_COLUMNS (4)                           // snapshot thumbnails, all in one texture
+#define ATLAS_ROWS ((UI_SNAPSHOT_MAX_SLOTS + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS)
+#define ATLAS_SLOT_WIDTH (UI_LIBRARY_THUMBNAIL_WIDTH)
+#define ATLAS_SLOT_HEIGHT (UI_LIBRARY_THUMBNAIL_HEIGHT)
+#define ATLAS_WIDTH (ATLAS_COLUMNS * ATLAS_SLOT_WIDTH)
+#define ATLAS_HEIGHT (ATLAS_ROWS * ATLAS_SLOT_HEIGHT)
+#define LIBRARY_MAX_TEXTURES (48)                   // thumbnail textures kept for the library window
+#define LIBRARY_MAX_TEXTURES_PER_FRAME (4)          // thumbnails decoded per frame, the others follow
+
+// a snapshot slot, the screenshot only lives in the UI texture and in storage
+typedef struct {
+    int size;                           // 0 if the slot is empty
+    uint8_t data[SEQUENCER_SNAPSHOT_MAX_SIZE];
+} snapshot_t;
+
+// compression of saved snapshots happens on the save thread, the file writes on the fs writer thread
+typedef struct {
+    thread_t thread;
+    thread_mutex_t mutex;
+    thread_cond_t cond;
+    bool threaded;
+    bool quit;                          // guarded by mutex
+    uint32_t pending;                   // one bit per slot with a job, guarded by mutex
+    uint32_t failed;                    // one bit per slot with a failed write, guarded by mutex
+    struct {
+        snapshot_t snapshot;
+        uint8_t screenshot[SCREENSHOT_SIZE_BYTES];
+    } jobs[UI_SNAPSHOT_MAX_SLOTS];      // guarded by mutex
+    // save thread only
+    uint32_t saved_hashes[UI_SNAPSHOT_MAX_SLOTS][2];    // last written snapshot and screenshot, 0: none
+    snapshot_t snapshot;
+    uint8_t screenshot[SCREENSHOT_SIZE_BYTES];
+    uint8_t blob[SCREENSHOT_MAX_BLOB_SIZE];
+} snapshot_saver_t;
+
+// snapshot thumbnails, downscaled once into a CPU copy of the texture, which is
+// created when a snapshot menu is opened and updated at most once per frame
+typedef struct {
+    ui_numbersid_thumbnails_t ui;
+    bool requested;                     // a menu was opened, screenshots are fetched
+    uint32_t dirty;                     // one bit per slot changed since the last upload
+    uint32_t pixels[ATLAS_WIDTH * ATLAS_HEIGHT];
+} thumbnail_atlas_t;
+
+// patch library, only the thumbnails of the visible rows become textures
 typedef struct {
-    chips_audio_callback_t callback;
+    const char* path;
+    patchlib_t lib;
+    bool valid;
+    bool failed;                        // opening failed, not tried again
+    struct {
+        int index;                      // patch, -1: unused
+        ui_texture_t texture;           // 0 if the patch has no thumbnail
+        uint64_t used_frame;
+    } textures[LIBRARY_MAX_TEXTURES];
+    uint64_t frame;                     // frame of the last decoded thumbnail
+    int num_decoded;                    // thumbnails decoded in that frame
+    uint8_t thumbnail[THUMBNAIL_SIZE_BYTES];
+    uint8_t blob[THUMBNAIL_MAX_BLOB_SIZE];
+    uint8_t patch[SEQUENCER_BINARY_MAX_SIZE];
+} library_t;
+
+typedef struct {
+    chips_audio_callback_t callback;    // fans out to the sinks
+    chips_audio_callback_t sinks[MAX_AUDIO_SINKS];
+    int num_sinks;
     int num_samples;
     int sample_pos;
     float sample_buffer[MAX_AUDIO_SAMPLES];
+    audiofile_t recorder;               // file sink, writes on its own thread
+    bool recording;
+    audiostats_t stats;                 // health of the saudio output, valid if saudio is
+    audiolatency_t latency;             // adaptive fill level of the saudio queue
+    float silence[MAX_AUDIO_SAMPLES];
+    thread_mutex_t mutex;               // guards the sinks and the recorder, the engine stage pushes to them
 } audio_t;
 
+// audio of one engine step, for the spectrogram
+typedef struct {
+    int num_samples;
+    float samples[PIPELINE_BLOCK_SAMPLES];
+} pipeline_block_t;
+
+// a spectrogram column, and the time it took
+typedef struct {
+    uint64_t time;
+    uint8_t pixels[FRAMEBUFFER_HEIGHT];
+} pipeline_column_t;
+
+// state of the engine stage after a step, times and counts add up from the start
+typedef struct {
+    m6581_t sid;
+    float samples[MAX_AUDIO_SAMPLES];
+    audiostats_t stats;
+    float latency_target_ms;
+    uint64_t ticks;
+    uint64_t sequencer_time;
+    uint64_t sid_update_time;
+    uint64_t sid_ticks_time;
+} pipeline_report_t;
+
+// a preview of the staging sequencer, and the time it took
+typedef struct {
+    preview_t preview;
+    uint64_t time;
+} pipeline_preview_t;
+
+/*
+    A frame runs in three stages, which hand their results on through
+    lock-free queues and triple buffers (see thread.h):
+
+        - engine: sequencer and SID on a fixed 60 Hz timestep, pushes the
+          audio to the sinks, and the samples of every step on to analysis
+        - analysis: a spectrogram column per step, and the preview of the
+          staging sequencer
+        - render: UI and gfx, in the app's frame callback
+
+    Every stage owns its state, the others only see what it hands on.
+    Where threads are available the engine and analysis stages run on
+    threads of their own, so a frame takes as long as the slowest stage
+    instead of all of them together, and a slow frame no longer starves
+    the audio. Otherwise (and with pipeline=no) app_frame() runs them
+    one after the other, through the same queues.
+*/
+typedef struct {
+    bool threaded;
+    volatile uint32_t quit;
+    thread_t engine_thread;
+    thread_t analysis_thread;
+    thread_event_t analysis_wake;       // new blocks or a new preview request
+    // engine -> analysis
+    pipeline_block_t blocks[PIPELINE_NUM_BLOCKS];
+    thread_spsc_t block_queue;
+    // analysis -> render
+    pipeline_column_t columns[PIPELINE_NUM_COLUMNS];
+    thread_spsc_t column_queue;
+    // engine -> render
+    pipeline_report_t reports[3];
+    thread_tribuf_t report_buf;
+    // render -> analysis, the staging sequencer to preview
+    sequencer_t preview_requests[3];
+    thread_tribuf_t preview_request_buf;
+    // analysis -> render
+    pipeline_preview_t previews[3];
+    thread_tribuf_t preview_buf;
+    // engine stage only
+    struct {
+        uint64_t step_count;
+        pipeline_block_t* block;        // the block being filled, 0 if the queue is full
+        uint64_t last_step_time;
+        uint64_t window_start;
+        float slowest_ms[2];            // slowest time between steps in this second and the one before
+        uint64_t ticks;
+        uint64_t sequencer_time;
+        uint64_t sid_update_time;
+        uint64_t sid_ticks_time;
+    } engine;
+    // render stage only, the SID and audio windows show the latest report
+    pipeline_report_t report;
+} pipeline_t;
+
 static struct {
     uint32_t frame_time_us;
     uint32_t ticks;
     double emu_time_ms;
-    audio_t audio;
-    uint64_t pins;
-    m6581_t sid;
-    sequencer_t sequencer;
+    audio_t audio;                      // engine stage, except the sinks
+    uint64_t pins;                      // engine stage
+    m6581_t sid;                        // engine stage
+    sequencer_t sequencer;              // staging copy, edited by the UI
+    engine_t engine;                    // runs its own copy of the sequencer
     ui_numbersid_t ui;
     //alignas(64) 
     uint8_t framebuffer[FRAMEBUFFER_SIZE_BYTES];
-    sequencer_snapshot_t snapshots[UI_SNAPSHOT_MAX_SLOTS];
-    double fft_buffer[FFT_BUFFER_SIZE];
-    size_t fft_pos;
+    snapshot_t snapshots[UI_SNAPSHOT_MAX_SLOTS];
+    uint8_t screenshot[SCREENSHOT_SIZE_BYTES];      // scratch buffer for saving and loading screenshots
+    snapshot_saver_t saver;
+    thumbnail_atlas_t atlas;
+    library_t library;
+    float fft_buffer[FFT_BUFFER_SIZE];  // analysis stage
+    size_t fft_pos;                     // analysis stage
+    spectrogram_t spectrogram;          // analysis stage
+    int fft_x;                          // framebuffer column of the latest spectrogram column
+    uint64_t step_time;                 // fixed timestep accumulator without threads, in microseconds * SEQUENCER_HZ
+    pipeline_t pipeline;
+    uint64_t last_frame_start_time;     // sokol_time timestamp of the previous app_frame()
+    struct {
+        double idle_timeout_sec;        // throttle after this many seconds without input, 0: never
+        uint32_t idle_frame_us;         // time between redraws when throttled
+        uint64_t last_input_time;       // sokol_time timestamp of the last input event
+        uint64_t last_draw_time;
+        bool hidden;                    // window is iconified or app is suspended
+    } throttle;
 } state;
 
 
@@ -97,11 +305,111 @@ static void ui_boot_cb(sequencer_t* sequencer);
 static void ui_save_snapshot(size_t slot_index);
 static bool ui_load_snapshot(size_t slot_index);
 static void ui_load_snapshots_from_storage(void);
+static void snapshot_saver_init(void);
+static void snapshot_saver_discard(void);
+static const ui_numbersid_thumbnails_t* ui_thumbnails_cb(void);
+static void thumbnail_atlas_upload(void);
+static void thumbnail_atlas_discard(void);
+static void library_init(void);
+static void library_discard(void);
+static bool ui_library_open(void);
+static int ui_library_add(const char* name);
+static bool ui_library_load(int index);
+static ui_texture_t ui_library_thumbnail(int index);
+#if !defined(__EMSCRIPTEN__)
+static bool ui_record_cb(bool start);
+static void ui_trace_cb(void);
+static void write_audio_stats(void);
+#endif
 
-// audio-streaming callback
+// audio-streaming callback, passes the samples on to all sinks
 static void push_audio(const float* samples, int num_samples, void* user_data) {
     (void)user_data;
-    saudio_push(samples, num_samples);
+    const uint64_t start = trace_begin();
+    thread_mutex_lock(&state.audio.mutex);
+    for (int i = 0; i < state.audio.num_sinks; i++) {
+        state.audio.sinks[i].func(samples, num_samples, state.audio.sinks[i].user_data);
+    }
+    thread_mutex_unlock(&state.audio.mutex);
+    trace_end("audio push", start);
+}
+
+// push silence, returns the number of frames the queue took
+static int push_saudio_silence(int num_frames) {
+    int num_pushed = 0;
+    while (num_pushed < num_frames) {
+        const int n = (num_frames - num_pushed < MAX_AUDIO_SAMPLES) ? (num_frames - num_pushed) : MAX_AUDIO_SAMPLES;
+        const int accepted = saudio_push(state.audio.silence, n);
+        num_pushed += accepted;
+        if (accepted < n) {
+            break;
+        }
+    }
+    return num_pushed;
+}
+
+// restarts at the adaptive latency target when the queue ran dry
+static void push_saudio(const float* samples, int num_samples, void* user_data) {
+    (void)user_data;
+    if (!saudio_isvalid()) {
+        return;
+    }
+    const uint64_t start = trace_begin();
+    const int free_frames = saudio_expect();
+    const int num_padded = push_saudio_silence(audiolatency_pad(&state.audio.latency, state.audio.stats.queue_frames - free_frames));
+    const int num_accepted = saudio_push(samples, num_samples);
+    audiostats_push(&state.audio.stats, num_samples, num_accepted, free_frames);
+    audiostats_pad(&state.audio.stats, num_padded);
+    trace_end("saudio_push", start);
+}
+
+static void add_audio_sink(chips_audio_callback_t sink) {
+    thread_mutex_lock(&state.audio.mutex);
+    if (state.audio.num_sinks < MAX_AUDIO_SINKS) {
+        state.audio.sinks[state.audio.num_sinks++] = sink;
+    }
+    thread_mutex_unlock(&state.audio.mutex);
+}
+
+// after this the engine stage doesn't push to the sink anymore
+static void remove_audio_sink(void* user_data) {
+    thread_mutex_lock(&state.audio.mutex);
+    for (int i = 0; i < state.audio.num_sinks; i++) {
+        if (state.audio.sinks[i].user_data == user_data) {
+            state.audio.sinks[i] = state.audio.sinks[--state.audio.num_sinks];
+            break;
+        }
+    }
+    thread_mutex_unlock(&state.audio.mutex);
+}
+
+// record the audio output to a WAV or FLAC file, from the extension or record-format
+static bool start_recording(const char* path) {
+    if (state.audio.recording) {
+        return false;
+    }
+    audiofile_format_t format = audiofile_format_from_path(path);
+    if (sargs_exists("record-format")) {
+        format = sargs_equals("record-format", "flac") ? AUDIOFILE_FLAC : AUDIOFILE_WAV;
+    }
+    if (!audiofile_open(&state.audio.recorder, &(audiofile_desc_t){
+        .path = path,
+        .format = format,
+        .sample_rate = AUDIO_SAMPLE_RATE,
+    })) {
+        return false;
+    }
+    add_audio_sink((chips_audio_callback_t){ .func = audiofile_callback, .user_data = &state.audio.recorder });
+    state.audio.recording = true;
+    return true;
+}
+
+static void stop_recording(void) {
+    if (state.audio.recording) {
+        remove_audio_sink(&state.audio.recorder);
+        audiofile_close(&state.audio.recorder);
+        state.audio.recording = false;
+    }
 }
 
 // TODO: this GFX framebuffer/screen stuff, not really needed 
@@ -114,16 +422,9 @@ static void push_audio(const float* samples, int num_samples, void* user_data) {
 #define BORDER_BOTTOM (16)
 #define LOAD_DELAY_FRAMES (180)
 
-#define RGBA8(r,g,b) (0xFF000000|(b<<16)|(g<<8)|(r))
-
 chips_range_t palette(void) {
     static uint32_t palette_[256];
-    for (int i=0;i<256;++i) {
-        int r = (i & 255);
-        int g = (i & 127) << 1;
-        int b = (i & 63) << 2;
-        palette_[i] = RGBA8(r,g,b);
-    }
+    spectrogram_palette(palette_);
     return (chips_range_t){
         .ptr = palette_,
         .size = sizeof(palette_)
@@ -153,6 +454,10 @@ chips_display_info_t numbersid_display_info() {
    return res;
 }
 
+// declare for use in app_init and app_frame
+static void draw_status_bar(void);
+static void pipeline_init(void);
+
 void app_init(void) {
     saudio_setup(&(saudio_desc){
         //int sample_rate;        // requested sample rate
@@ -160,23 +465,52 @@ void app_init(void) {
         //int buffer_frames;      // number of frames in streaming buffer
         //int packet_frames;      // number of frames in a packet (for push model)
         //int num_packets;        // number of packets in packet queue (for push model)
-        .sample_rate = 48000,       // note 48Khz / 60FPS  = 800 audio frames/video frame
-        .packet_frames = 64,
-        .num_packets = 64,          // 64x64 = 4096 samples =~ 0.085 secs delay or 5 video frames
-        .buffer_frames = 512,       // must be larger than packet_frames, but <1024 (in browser at least)
+        .sample_rate = AUDIO_SAMPLE_RATE,   // note 48Khz / 60FPS  = 800 audio frames/video frame
+        .packet_frames = AUDIO_PACKET_FRAMES,
+        .num_packets = AUDIO_NUM_PACKETS,
+        .buffer_frames = AUDIO_BUFFER_FRAMES,
         //.logger.func = slog_func,
     });
+    if (saudio_isvalid()) {
+        audiostats_init(&state.audio.stats, &(audiostats_desc_t){
+            .sample_rate = saudio_sample_rate(),
+            .queue_frames = AUDIO_PACKET_FRAMES * AUDIO_NUM_PACKETS,
+            .packet_frames = AUDIO_PACKET_FRAMES,
+            .buffer_frames = saudio_buffer_frames(),
+        });
+        audiolatency_init(&state.audio.latency, &(audiolatency_desc_t){
+            .sample_rate = saudio_sample_rate(),
+            .push_frames = DEFAULT_AUDIO_SAMPLES,
+            .packet_frames = AUDIO_PACKET_FRAMES,
+            .min_frames = AUDIO_MIN_LATENCY_FRAMES,
+            .max_frames = AUDIO_PACKET_FRAMES * AUDIO_NUM_PACKETS - 2 * DEFAULT_AUDIO_SAMPLES,
+        });
+    }
+
+    // idle throttling: redraw at idle-fps after idle-timeout seconds without input
+    state.throttle.idle_timeout_sec = atof(sargs_value_def("idle-timeout", "0"));
+    int idle_fps = atoi(sargs_value_def("idle-fps", "0"));
+    if (idle_fps <= 0) idle_fps = DEFAULT_IDLE_FPS;
+    if (idle_fps > SEQUENCER_HZ) idle_fps = SEQUENCER_HZ;
+    state.throttle.idle_frame_us = 1000000 / idle_fps;
 
+    thread_mutex_init(&state.audio.mutex);
     state.audio.callback.func = push_audio;
     state.audio.num_samples = DEFAULT_AUDIO_SAMPLES;
+    add_audio_sink((chips_audio_callback_t){ .func = push_saudio });
+    if (sargs_exists("record")) {
+        start_recording(sargs_value("record"));
+    }
 
     m6581_init(&state.sid, &(m6581_desc_t){
         .tick_hz = C64_FREQUENCY,
-        .sound_hz = 48000,
+        .sound_hz = AUDIO_SAMPLE_RATE,
         .magnitude = 1.0f,
     });
     
     sequencer_init(&state.sequencer);
+    engine_init(&state.engine, &state.sequencer);
+    spectrogram_init(&state.spectrogram, FFT_BUFFER_SIZE, FRAMEBUFFER_HEIGHT);
     
     // TODO: GFX is intended to diplay a (retro machine's) framebuffer. 
     // I don't think I need it, but it also handles some setup for 
@@ -191,11 +525,17 @@ void app_init(void) {
             .bottom = BORDER_BOTTOM,
         },
         .display_info = numbersid_display_info(),
+        .column_updates = true,
     });
 
     clock_init();
     prof_init();
+    #if !defined(__EMSCRIPTEN__)
+    trace_init(sargs_exists("perf-trace"));
+    trace_thread_name("main");
+    #endif
     fs_init();         
+    library_init();
        
     ui_init(&(ui_desc_t){
         .draw_cb = ui_draw_cb,
@@ -204,9 +544,13 @@ void app_init(void) {
     });
     ui_numbersid_init(&state.ui, &(ui_numbersid_desc_t){
         .sequencer = &state.sequencer,
-        .sid = &state.sid,
+        .sid = &state.pipeline.report.sid,
         .boot_cb = ui_boot_cb,
-        .audio_sample_buffer = state.audio.sample_buffer,
+        #if !defined(__EMSCRIPTEN__)
+        .record_cb = ui_record_cb,
+        .trace_cb = trace_enabled() ? ui_trace_cb : 0,
+        #endif
+        .audio_sample_buffer = state.pipeline.report.samples,
         .audio_num_samples = state.audio.num_samples,
         .snapshot = {
                 .load_cb = ui_load_snapshot,
@@ -215,17 +559,25 @@ void app_init(void) {
                     .texture = ui_shared_empty_snapshot_texture(),
                 },
             },
+        .thumbnails_cb = ui_thumbnails_cb,
+        .library = {
+            .library = state.library.path ? &state.library.lib : 0,
+            .open_cb = ui_library_open,
+            .add_cb = ui_library_add,
+            .load_cb = ui_library_load,
+            .thumbnail_cb = ui_library_thumbnail,
+        },
     });
     ui_numbersid_load_settings(&state.ui, ui_settings());
+    state.ui.recording = state.audio.recording;
+    snapshot_saver_init();
     ui_load_snapshots_from_storage();
+    pipeline_init();
 }
 
-// declare for use in app_frame
-static void draw_status_bar(void);
 
-uint32_t numbersid_exec(uint32_t micro_seconds) {
+uint32_t numbersid_exec(uint32_t num_ticks) {
     
-    uint32_t num_ticks = clk_us_to_ticks(C64_FREQUENCY, micro_seconds);
     uint64_t pins = state.pins;
     
     for (uint32_t ticks = 0; ticks < num_ticks; ticks++) {
@@ -239,12 +591,10 @@ uint32_t numbersid_exec(uint32_t micro_seconds) {
                 }
                 state.audio.sample_pos = 0;
             }
-            // also store sample in FFT buffer
-            {
-                state.fft_buffer[state.fft_pos++] = state.sid.sample;
-                if (state.fft_pos >= FFT_BUFFER_SIZE) {
-                    state.fft_pos = 0;
-                }
+            // also keep the sample for the spectrogram
+            pipeline_block_t* block = state.pipeline.engine.block;
+            if (block && (block->num_samples < PIPELINE_BLOCK_SAMPLES)) {
+                block->samples[block->num_samples++] = state.sid.sample;
             }
         }
     }
@@ -253,69 +603,341 @@ uint32_t numbersid_exec(uint32_t micro_seconds) {
     return num_ticks;
 }
 
-// TODO: move to a separate fft gfx file?
+// engine stage: one step of sequencer and SID, 1/60 second of audio
+static void pipeline_engine_step(void) {
+    pipeline_t* p = &state.pipeline;
+    const uint64_t t0 = stm_now();
+    // the slowest time between steps sets the headroom of the audio latency,
+    // without threads that is the frame time
+    if (p->engine.last_step_time != 0) {
+        const float step_ms = (float)stm_ms(stm_diff(t0, p->engine.last_step_time));
+        if (stm_sec(stm_diff(t0, p->engine.window_start)) >= 1.0) {
+            p->engine.slowest_ms[1] = p->engine.slowest_ms[0];
+            p->engine.slowest_ms[0] = 0.0f;
+            p->engine.window_start = t0;
+        }
+        if (step_ms > p->engine.slowest_ms[0]) {
+            p->engine.slowest_ms[0] = step_ms;
+        }
+        if (saudio_isvalid()) {
+            const float slowest_ms = (p->engine.slowest_ms[0] > p->engine.slowest_ms[1]) ? p->engine.slowest_ms[0] : p->engine.slowest_ms[1];
+            audiolatency_update(&state.audio.latency, &state.audio.stats, slowest_ms, step_ms * 0.001f);
+        }
+    }
+    p->engine.last_step_time = t0;
+
+    engine_step(&state.engine);
+    const uint64_t t1 = stm_now();
 
-#include "lamefft.h"
+    sequencer_update_sid(&state.engine.sequencer, &state.sid);
+    const uint64_t t2 = stm_now();
 
-void update_fft_framebuffer(uint8_t* framebuffer, chips_display_info_t info) 
-{
-    int w = info.frame.dim.width;
-    int h = info.frame.dim.height;
-    
-    // each frame move right
-    static int x = 0;
-    x = (x+1)%w;
-
-    // copy from buffer and apply Hanning window
-    double fft[FFT_BUFFER_SIZE];
-    for (int i=0;i<FFT_BUFFER_SIZE;i++) {
-        int index = state.fft_pos + i - FFT_BUFFER_SIZE;
-        if (index >= FFT_BUFFER_SIZE) index -= FFT_BUFFER_SIZE;
-        if (index < 0) index += FFT_BUFFER_SIZE;
-        // Apply Hann window
-        double hann = 0.5 * (1.0 - cos(2.0 * M_PI * i / (FFT_BUFFER_SIZE - 1)));
-        fft[i] = state.fft_buffer[index] * hann;
+    // the samples of this step go on to analysis, unless it fell behind
+    const int b = thread_spsc_write_index(&p->block_queue);
+    p->engine.block = (b >= 0) ? &p->blocks[b] : 0;
+    if (p->engine.block) {
+        p->engine.block->num_samples = 0;
     }
-    
-    // compute FFT on current fft buffer
-    C_FFT_real(fft,FFT_BUFFER_SIZE);
+    // distribute SID ticks evenly over the steps, without drift
+    const uint64_t n = p->engine.step_count++;
+    const uint32_t num_ticks = (uint32_t)(((n+1)*C64_FREQUENCY)/SEQUENCER_HZ - (n*C64_FREQUENCY)/SEQUENCER_HZ);
+    numbersid_exec(num_ticks);
+    const uint64_t t3 = stm_now();
+    if (p->engine.block) {
+        p->engine.block = 0;
+        thread_spsc_push(&p->block_queue);
+        if (p->threaded) {
+            thread_event_signal(&p->analysis_wake);
+        }
+    }
+
+    p->engine.ticks += num_ticks;
+    p->engine.sequencer_time += stm_diff(t1, t0);
+    p->engine.sid_update_time += stm_diff(t2, t1);
+    p->engine.sid_ticks_time += stm_diff(t3, t2);
+    trace_event("sequencer", t0, t1);
+    trace_event("sid update", t1, t2);
+    trace_event("sid ticks", t2, t3);
+
+    pipeline_report_t* report = &p->reports[thread_tribuf_write_index(&p->report_buf)];
+    report->sid = state.sid;
+    memcpy(report->samples, state.audio.sample_buffer, sizeof(report->samples));
+    report->stats = state.audio.stats;
+    report->latency_target_ms = saudio_isvalid() ? audiolatency_target_ms(&state.audio.latency) : 0.0f;
+    report->ticks = p->engine.ticks;
+    report->sequencer_time = p->engine.sequencer_time;
+    report->sid_update_time = p->engine.sid_update_time;
+    report->sid_ticks_time = p->engine.sid_ticks_time;
+    thread_tribuf_publish(&p->report_buf);
+}
+
+// analysis stage: a spectrogram column for every queued step, and the preview if one was asked for
+static void pipeline_analysis_run(void) {
+    pipeline_t* p = &state.pipeline;
+    int b;
+    while ((b = thread_spsc_read_index(&p->block_queue)) >= 0) {
+        const uint64_t start = stm_now();
+        const pipeline_block_t* block = &p->blocks[b];
+        for (int i = 0; i < block->num_samples; i++) {
+            state.fft_buffer[state.fft_pos++] = block->samples[i];
+            if (state.fft_pos >= FFT_BUFFER_SIZE) {
+                state.fft_pos = 0;
+            }
+        }
+        thread_spsc_pop(&p->block_queue);
 
-    // draw FFT result into framebuffer
-    const int f_start = 2;
-    const int f_end = FFT_BUFFER_SIZE / 8;
-    for (int y=0;y<h;y++) {
-        int f = (y*(f_end-f_start))/h + f_start;
-        int color = 512*log(1+fft[f])/log(1+FFT_BUFFER_SIZE);
-        if (color > 255) color = 255;
-        int index = y*w+x;
-        framebuffer[index] = color;
+        // the column is dropped if render doesn't take them
+        const int c = thread_spsc_write_index(&p->column_queue);
+        if (c >= 0) {
+            // unroll ring buffer, oldest sample first
+            float samples[FFT_BUFFER_SIZE];
+            const size_t tail = FFT_BUFFER_SIZE - state.fft_pos;
+            memcpy(samples, &state.fft_buffer[state.fft_pos], tail * sizeof(float));
+            memcpy(&samples[tail], state.fft_buffer, state.fft_pos * sizeof(float));
+
+            // window, FFT and draw one column
+            pipeline_column_t* column = &p->columns[c];
+            spectrogram_column(&state.spectrogram, samples, column->pixels, 1);
+            column->time = stm_since(start);
+            thread_spsc_push(&p->column_queue);
+        }
+        trace_end("fft", start);
+    }
+    if (thread_tribuf_acquire(&p->preview_request_buf)) {
+        const uint64_t start = stm_now();
+        sequencer_t* sequencer = &p->preview_requests[thread_tribuf_read_index(&p->preview_request_buf)];
+        sequencer_update_preview(sequencer);
+        pipeline_preview_t* preview = &p->previews[thread_tribuf_write_index(&p->preview_buf)];
+        preview->preview = sequencer->preview;
+        preview->time = stm_since(start);
+        thread_tribuf_publish(&p->preview_buf);
+        trace_end("preview", start);
     }
 }
 
-void app_frame(void) {
-    
-    state.frame_time_us = clock_frame_time();
-    const uint64_t emu_start_time = stm_now();
+static void pipeline_engine_thread(void* arg) {
+    (void)arg;
+    trace_thread_name("engine");
+    const uint64_t start = stm_now();
+    double next_us = 0.0;
+    while (0 == thread_atomic_load(&state.pipeline.quit)) {
+        pipeline_engine_step();
+        // a little faster or slower to keep the audio queue at its latency target
+        float rate = 1.0f;
+        if (saudio_isvalid()) {
+            rate = audiolatency_rate(&state.audio.latency, state.audio.stats.fill_frames);
+        }
+        next_us += 1000000.0 / ((double)SEQUENCER_HZ * (double)rate);
+        const double now_us = stm_us(stm_since(start));
+        if (next_us > now_us) {
+            clock_sleep_us((uint32_t)(next_us - now_us));
+        }
+        else if (now_us - next_us > PIPELINE_MAX_LAG_US) {
+            next_us = now_us;
+        }
+    }
+}
 
-    sequencer_update(&state.sequencer);
+static void pipeline_analysis_thread(void* arg) {
+    (void)arg;
+    trace_thread_name("analysis");
+    while (true) {
+        thread_event_wait(&state.pipeline.analysis_wake);
+        if (0 != thread_atomic_load(&state.pipeline.quit)) {
+            break;
+        }
+        pipeline_analysis_run();
+    }
+}
 
-    sequencer_update_sid(&state.sequencer, &state.sid);
+static void pipeline_init(void) {
+    pipeline_t* p = &state.pipeline;
+    thread_spsc_init(&p->block_queue, PIPELINE_NUM_BLOCKS);
+    thread_spsc_init(&p->column_queue, PIPELINE_NUM_COLUMNS);
+    thread_tribuf_init(&p->report_buf);
+    thread_tribuf_init(&p->preview_request_buf);
+    thread_tribuf_init(&p->preview_buf);
+    p->report.sid = state.sid;
+    if (sargs_equals("pipeline", "no") || !thread_event_init(&p->analysis_wake)) {
+        return;
+    }
+    // both threads or none
+    if (thread_start(&p->analysis_thread, pipeline_analysis_thread, 0)) {
+        p->threaded = thread_start(&p->engine_thread, pipeline_engine_thread, 0);
+        if (!p->threaded) {
+            thread_atomic_store(&p->quit, 1);
+            thread_event_signal(&p->analysis_wake);
+            thread_join(&p->analysis_thread);
+            thread_atomic_store(&p->quit, 0);
+        }
+    }
+}
+
+static void pipeline_discard(void) {
+    pipeline_t* p = &state.pipeline;
+    if (p->threaded) {
+        thread_atomic_store(&p->quit, 1);
+        thread_event_signal(&p->analysis_wake);
+        thread_join(&p->engine_thread);
+        thread_join(&p->analysis_thread);
+        p->threaded = false;
+    }
+    thread_event_discard(&p->analysis_wake);
+}
+
+// render stage: the latest report of the engine, and the new spectrogram columns
+static void pipeline_render_take(void) {
+    pipeline_t* p = &state.pipeline;
+    const pipeline_report_t* report = &p->report;
+    const uint64_t ticks = report->ticks;
+    const uint64_t sequencer_time = report->sequencer_time;
+    const uint64_t sid_update_time = report->sid_update_time;
+    const uint64_t sid_ticks_time = report->sid_ticks_time;
+    if (thread_tribuf_acquire(&p->report_buf)) {
+        p->report = p->reports[thread_tribuf_read_index(&p->report_buf)];
+    }
+    // the steps since the last frame
+    state.ticks = (uint32_t)(report->ticks - ticks);
+    state.emu_time_ms = stm_ms((report->sequencer_time - sequencer_time) + (report->sid_update_time - sid_update_time) + (report->sid_ticks_time - sid_ticks_time));
+    prof_push(PROF_SEQUENCER, (float)stm_ms(report->sequencer_time - sequencer_time));
+    prof_push(PROF_SID_UPDATE, (float)stm_ms(report->sid_update_time - sid_update_time));
+    prof_push(PROF_SID_TICKS, (float)stm_ms(report->sid_ticks_time - sid_ticks_time));
 
-    //sequencer_update_framebuffer(&state.sequencer, state.framebuffer, numbersid_display_info());
+    // each column moves right, the framebuffer is a ring buffer of columns
+    uint64_t fft_time = 0;
+    int c;
+    while ((c = thread_spsc_read_index(&p->column_queue)) >= 0) {
+        const pipeline_column_t* column = &p->columns[c];
+        const int x = state.fft_x = (state.fft_x + 1) % FRAMEBUFFER_WIDTH;
+        for (int y = 0; y < FRAMEBUFFER_HEIGHT; y++) {
+            state.framebuffer[y * FRAMEBUFFER_WIDTH + x] = column->pixels[y];
+        }
+        fft_time += column->time;
+        thread_spsc_pop(&p->column_queue);
+        // only upload the new column, and scroll so it shows at the right edge
+        gfx_update_columns(x, 1);
+        gfx_scroll((x + 1) % FRAMEBUFFER_WIDTH);
+    }
+    prof_push(PROF_FFT, (float)stm_ms(fft_time));
+}
+
+// render stage: ask for the preview of the staging sequencer, and take the latest one
+static void pipeline_render_preview(void) {
+    pipeline_t* p = &state.pipeline;
+    memcpy(&p->preview_requests[thread_tribuf_write_index(&p->preview_request_buf)], &state.sequencer, sizeof(sequencer_t));
+    thread_tribuf_publish(&p->preview_request_buf);
+    if (p->threaded) {
+        thread_event_signal(&p->analysis_wake);
+    }
+    else {
+        pipeline_analysis_run();
+    }
+    if (thread_tribuf_acquire(&p->preview_buf)) {
+        const pipeline_preview_t* result = &p->previews[thread_tribuf_read_index(&p->preview_buf)];
+        preview_t* preview = &state.sequencer.preview;
+        // with threads the preview is a frame late, skip it if the UI changed what it shows in between
+        if ((result->preview.step == preview->step) && (result->preview.offset == preview->offset) &&
+            (result->preview.follow == preview->follow) && (result->preview.num_columns == preview->num_columns) &&
+            (0 == memcmp(result->preview.variables, preview->variables, sizeof(preview->variables)))) {
+            memcpy(preview->frames, result->preview.frames, sizeof(preview->frames));
+            memcpy(preview->values, result->preview.values, sizeof(preview->values));
+        }
+        prof_push(PROF_PREVIEW, (float)stm_ms(result->time));
+    }
+}
 
-    state.ticks = numbersid_exec(state.frame_time_us);
+// throttled: window hidden, or no input for a while
+static bool throttle_active(void) {
+    if (state.throttle.hidden) {
+        return true;
+    }
+    if (state.throttle.idle_timeout_sec <= 0.0) {
+        return false;
+    }
+    return stm_sec(stm_since(state.throttle.last_input_time)) > state.throttle.idle_timeout_sec;
+}
 
-    update_fft_framebuffer(state.framebuffer, numbersid_display_info());
+void app_frame(void) {
+    const uint64_t frame_start_time = stm_now();
+    const bool throttled = throttle_active();
+    // measured time between frames
+    if (state.last_frame_start_time != 0) {
+        prof_push(PROF_FRAME, (float)stm_ms(stm_diff(frame_start_time, state.last_frame_start_time)));
+    }
+    state.last_frame_start_time = frame_start_time;
     
-    state.emu_time_ms = stm_ms(stm_since(emu_start_time));
+    // throttled frames are long and irregular, measure them instead of using the display rate
+    state.frame_time_us = throttled ? clock_frame_time_measured() : clock_frame_time();
 
-    gfx_draw(numbersid_display_info());
-    draw_status_bar();
+    // hand the edits of the last frame's UI and input to the engine
+    engine_publish(&state.engine, &state.sequencer);
+    if (!state.pipeline.threaded) {
+        const uint64_t emu_start_time = trace_begin();
+        // run sequencer and SID on a fixed 60Hz timestep, so that playback 
+        // doesn't depend on display rate or throttling, a little faster or 
+        // slower to keep the audio queue at its latency target
+        uint64_t step_us = state.frame_time_us;
+        if (saudio_isvalid()) {
+            step_us = (uint64_t)((float)step_us * audiolatency_rate(&state.audio.latency, state.audio.stats.fill_frames));
+        }
+        state.step_time += step_us * SEQUENCER_HZ;
+        while (state.step_time >= 1000000) {
+            state.step_time -= 1000000;
+            pipeline_engine_step();
+        }
+        pipeline_analysis_run();
+        trace_end("emu", emu_start_time);
+    }
+    pipeline_render_take();
+    // show the engine's frame and variable values
+    engine_sync(&state.engine, &state.sequencer);
 
+    // skip UI and gfx when hidden, and redraw at a low rate when idle
+    bool draw = !throttled;
+    if (throttled && !state.throttle.hidden) {
+        draw = stm_us(stm_since(state.throttle.last_draw_time)) >= state.throttle.idle_frame_us;
+    }
+    if (draw) {
+        state.throttle.last_draw_time = stm_now();
+        pipeline_render_preview();
+        const uint64_t start = prof_begin();
+        gfx_draw(numbersid_display_info());
+        prof_end(PROF_GFX, start);
+        trace_end("gfx draw", start);
+        draw_status_bar();
+    }
+
+    const uint64_t fs_start_time = trace_begin();
     fs_dowork();    // should work for both fs and sfetch
+    trace_end("fs dowork", fs_start_time);
+    trace_end("frame", frame_start_time);
+
+    // on native platforms frame callbacks keep coming at display rate (or 
+    // faster when hidden), so sleep the rest of a throttled frame
+    if (throttled) {
+        const uint64_t elapsed_us = (uint64_t)stm_us(stm_since(frame_start_time));
+        if (elapsed_us < THROTTLED_FRAME_US) {
+            clock_sleep_us(THROTTLED_FRAME_US - (uint32_t)elapsed_us);
+        }
+    }
 }
 
 void app_input(const sapp_event* event) {
+    switch (event->type) {
+        case SAPP_EVENTTYPE_ICONIFIED:
+        case SAPP_EVENTTYPE_SUSPENDED:
+            state.throttle.hidden = true;
+            break;
+        case SAPP_EVENTTYPE_RESTORED:
+        case SAPP_EVENTTYPE_RESUMED:
+            state.throttle.hidden = false;
+            state.throttle.last_input_time = stm_now();
+            break;
+        default:
+            state.throttle.last_input_time = stm_now();
+            break;
+    }
+
     // accept dropped files also when ImGui grabs input
     // if (event->type == SAPP_EVENTTYPE_FILES_DROPPED) {
     //     fs_load_dropped_file_async(FS_CHANNEL_IMAGES);
@@ -327,8 +949,20 @@ void app_input(const sapp_event* event) {
 }
 
 void app_cleanup(void) {
+    pipeline_discard();
+    stop_recording();
+    snapshot_saver_discard();
     ui_numbersid_discard(&state.ui);
+    library_discard();
+    thumbnail_atlas_discard();
     ui_discard();
+    fs_shutdown();      // waits for the queued writes
+    #if !defined(__EMSCRIPTEN__)
+    ui_trace_cb();
+    trace_shutdown();
+    write_audio_stats();
+    #endif
+    thread_mutex_discard(&state.audio.mutex);
     saudio_shutdown();
     gfx_shutdown();
     sargs_shutdown();
@@ -343,91 +977,502 @@ static void draw_status_bar(void) {
     sdtx_color3b(255, 255, 255);
     sdtx_pos(1.0f, (h / 8.0f) - 1.5f);
     sdtx_printf("frame:%.2fms emu:%.2fms (min:%.2fms max:%.2fms) ticks:%d", (float)state.frame_time_us * 0.001f, emu_stats.avg_val, emu_stats.min_val, emu_stats.max_val, state.ticks);
+    if (state.audio.recording) {
+        const audiofile_t* rec = &state.audio.recorder;
+        thread_mutex_lock(&state.audio.mutex);
+        const uint64_t num_pushed = rec->num_pushed;
+        const uint64_t num_dropped = rec->num_dropped;
+        thread_mutex_unlock(&state.audio.mutex);
+        sdtx_color3b(255, 64, 64);
+        sdtx_printf(" REC %.1fs", (double)num_pushed / rec->sample_rate);
+        if (num_dropped > 0) {
+            sdtx_printf(" (%.1fs dropped)", (double)num_dropped / rec->sample_rate);
+        }
+    }
+    if (saudio_isvalid()) {
+        const audiostats_t* stats = &state.pipeline.report.stats;
+        sdtx_color3b(255, 255, 255);
+        sdtx_printf(" audio:%d%% (min:%d%%) %.0fms (target:%.0fms)", (int)(audiostats_fill(stats) * 100.0f), (int)(audiostats_min_fill(stats) * 100.0f), audiostats_latency_ms(stats), state.pipeline.report.latency_target_ms);
+        if ((stats->underruns > 0) || (stats->overruns > 0)) {
+            sdtx_color3b(255, 64, 64);
+            sdtx_printf(" under:%u over:%u", stats->underruns, stats->overruns);
+        }
+    }
 }
 
 static void ui_draw_cb(const ui_draw_info_t* draw_info) {
+    thumbnail_atlas_upload();
+    const uint64_t start = prof_begin();
     ui_numbersid_draw(&state.ui, &draw_info->display);
+    prof_end(PROF_UI, start);
+    trace_end("ui build", start);
 }
 
 static void ui_save_settings_cb(ui_settings_t* settings) {
     ui_numbersid_save_settings(&state.ui, settings);
 }
 
+#if !defined(__EMSCRIPTEN__)
+// start recording to a new file in the working directory, or stop
+static bool ui_record_cb(bool start) {
+    if (!start) {
+        stop_recording();
+        return false;
+    }
+    char path[64];
+    const time_t now = time(0);
+    const char* ext = sargs_equals("record-format", "flac") ? "flac" : "wav";
+    strftime(path, sizeof(path), "numbersid-%Y%m%d-%H%M%S.", localtime(&now));
+    strncat(path, ext, sizeof(path) - strlen(path) - 1);
+    return start_recording(path);
+}
+
+// write the audio health counters to the file given with audio-stats=
+static void write_audio_stats(void) {
+    if (!sargs_exists("audio-stats") || !saudio_isvalid()) {
+        return;
+    }
+    const char* path = sargs_value("audio-stats");
+    FILE* fp = fopen(path, "w");
+    bool ok = fp && audiostats_write_json(&state.audio.stats, fp);
+    ok = fp && (0 == fclose(fp)) && ok;
+    if (!ok) {
+        fprintf(stderr, "numbersid: could not write audio stats to '%s'\n", path);
+    }
+}
+
+// write the timeline trace to the file given with perf-trace=, the last events of every thread
+static void ui_trace_cb(void) {
+    if (trace_enabled() && !trace_dump(sargs_value("perf-trace"))) {
+        fprintf(stderr, "numbersid: could not write trace to '%s'\n", sargs_value("perf-trace"));
+    }
+}
+#endif
+
 static void ui_boot_cb(sequencer_t* sequencer) {
     clock_init();
     sequencer_init(sequencer);
 }
 
-static void ui_update_snapshot_screenshot(size_t slot) {
-    chips_display_info_t screenshot_display_info = {
+// display info of a palette-indexed image, for ui_create_screenshot_texture()
+static chips_display_info_t image_display_info(uint8_t* pixels, int width, int height) {
+    return (chips_display_info_t){
         .frame = {
             .dim = {
-                .width = FRAMEBUFFER_WIDTH,
-                .height = FRAMEBUFFER_HEIGHT,
+                .width = width,
+                .height = height,
             },
             .bytes_per_pixel = 1,
             .buffer = {
-                .ptr = state.snapshots[slot].screenshot_data,
-                .size = FRAMEBUFFER_SIZE_BYTES,
+                .ptr = pixels,
+                .size = (size_t)(width * height),
             }
         },
         .palette = palette(),
         .screen = (chips_rect_t){
             .x = 0,
             .y = 0,
-            .width = FRAMEBUFFER_WIDTH,
-            .height = FRAMEBUFFER_HEIGHT
+            .width = width,
+            .height = height
         }
     };
+}
 
-    ui_snapshot_screenshot_t screenshot = {    
-        .texture = ui_create_screenshot_texture(screenshot_display_info),
-        .portrait = false,
-    };
-    ui_snapshot_screenshot_t prev_screenshot = ui_snapshot_set_screenshot(&state.ui.snapshot, slot, screenshot);
-    if (prev_screenshot.texture) {
-        ui_destroy_texture(prev_screenshot.texture);
+// unroll the framebuffer ring into state.screenshot, so it looks like the display
+static void capture_screenshot(void) {
+    const int first = (state.fft_x + 1) % FRAMEBUFFER_WIDTH;
+    for (int y = 0; y < FRAMEBUFFER_HEIGHT; y++) {
+        const uint8_t* src = &state.framebuffer[y * FRAMEBUFFER_WIDTH];
+        uint8_t* dst = &state.screenshot[y * SCREENSHOT_WIDTH];
+        memcpy(dst, &src[first], FRAMEBUFFER_WIDTH - first);
+        memcpy(&dst[FRAMEBUFFER_WIDTH - first], src, first);
+    }
+}
+
+// downscale a screenshot into the slot of the atlas, the brightest pixel of each block
+static void thumbnail_atlas_put(size_t slot, const uint8_t* screenshot) {
+    thumbnail_atlas_t* atlas = &state.atlas;
+    const uint32_t* colors = (const uint32_t*)palette().ptr;
+    const int sx = SCREENSHOT_WIDTH / ATLAS_SLOT_WIDTH;
+    const int sy = SCREENSHOT_HEIGHT / ATLAS_SLOT_HEIGHT;
+    uint32_t* dst = &atlas->pixels[(slot / ATLAS_COLUMNS) * ATLAS_SLOT_HEIGHT * ATLAS_WIDTH + (slot % ATLAS_COLUMNS) * ATLAS_SLOT_WIDTH];
+    for (int y = 0; y < ATLAS_SLOT_HEIGHT; y++) {
+        for (int x = 0; x < ATLAS_SLOT_WIDTH; x++) {
+            uint8_t p = 0;
+            for (int by = 0; by < sy; by++) {
+                const uint8_t* src = &screenshot[(y * sy + by) * SCREENSHOT_WIDTH + x * sx];
+                for (int bx = 0; bx < sx; bx++) {
+                    if (src[bx] > p) p = src[bx];
+                }
+            }
+            dst[y * ATLAS_WIDTH + x] = colors[p];
+        }
+    }
+    atlas->ui.valid |= 1u << slot;
+    atlas->dirty |= 1u << slot;
+}
+
+// all changed slots go to the GPU in one update
+static void thumbnail_atlas_upload(void) {
+    thumbnail_atlas_t* atlas = &state.atlas;
+    if (atlas->ui.texture && atlas->dirty) {
+        ui_update_texture(atlas->ui.texture, atlas->pixels, (int)sizeof(atlas->pixels));
+        atlas->dirty = 0;
+    }
+}
+
+static void thumbnail_atlas_discard(void) {
+    if (state.atlas.ui.texture) {
+        ui_destroy_texture(state.atlas.ui.texture);
+        state.atlas.ui.texture = 0;
+    }
+}
+
+// FNV-1a, to skip writing blobs that did not change since the last save
+static uint32_t snapshot_hash(const uint8_t* data, int size) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+// completion of a write, on the frame thread, a failed slot is written completely on the next save
+static void snapshot_saved_callback(const fs_snapshot_response_t* response) {
+    if ((response->result != FS_RESULT_SUCCESS) && (response->snapshot_index < UI_SNAPSHOT_MAX_SLOTS)) {
+        thread_mutex_lock(&state.saver.mutex);
+        state.saver.failed |= 1u << response->snapshot_index;
+        thread_mutex_unlock(&state.saver.mutex);
+    }
+}
+
+// compress a snapshot and its screenshot and queue the file writes, on the save thread
+static void snapshot_saver_write(snapshot_saver_t* saver, size_t slot) {
+    uint32_t* hashes = saver->saved_hashes[slot];
+    const uint32_t snapshot_hash_value = snapshot_hash(saver->snapshot.data, saver->snapshot.size);
+    if (hashes[0] != snapshot_hash_value) {
+        const bool ok = fs_save_snapshot_async(SNAPSHOT_NAME, slot, (chips_range_t){ .ptr = saver->snapshot.data, .size = (size_t)saver->snapshot.size }, snapshot_saved_callback);
+        hashes[0] = ok ? snapshot_hash_value : 0;
+    }
+    const uint32_t screenshot_hash_value = snapshot_hash(saver->screenshot, SCREENSHOT_SIZE_BYTES);
+    if (hashes[1] != screenshot_hash_value) {
+        uint8_t* blob = saver->blob;
+        memcpy(blob, "NSSC", 4);
+        blob[4] = SCREENSHOT_WIDTH & 0xFF; blob[5] = SCREENSHOT_WIDTH >> 8;
+        blob[6] = SCREENSHOT_HEIGHT & 0xFF; blob[7] = SCREENSHOT_HEIGHT >> 8;
+        const int size = lz_compress(saver->screenshot, SCREENSHOT_SIZE_BYTES, &blob[SCREENSHOT_HEADER_SIZE], SCREENSHOT_MAX_BLOB_SIZE - SCREENSHOT_HEADER_SIZE);
+        const bool ok = (size > 0) && fs_save_snapshot_async(SCREENSHOT_NAME, slot, (chips_range_t){ .ptr = blob, .size = (size_t)(SCREENSHOT_HEADER_SIZE + size) }, snapshot_saved_callback);
+        hashes[1] = ok ? screenshot_hash_value : 0;
+    }
+}
+
+// take the next job, returns false if there is none, call with the mutex locked
+static bool snapshot_saver_take(snapshot_saver_t* saver, size_t* slot) {
+    for (size_t i = 0; i < UI_SNAPSHOT_MAX_SLOTS; i++) {
+        if (saver->failed & (1u << i)) {
+            saver->saved_hashes[i][0] = saver->saved_hashes[i][1] = 0;
+        }
+    }
+    saver->failed = 0;
+    for (size_t i = 0; i < UI_SNAPSHOT_MAX_SLOTS; i++) {
+        if (saver->pending & (1u << i)) {
+            saver->pending &= ~(1u << i);
+            saver->snapshot = saver->jobs[i].snapshot;
+            memcpy(saver->screenshot, saver->jobs[i].screenshot, SCREENSHOT_SIZE_BYTES);
+            *slot = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void snapshot_saver_thread(void* arg) {
+    snapshot_saver_t* saver = (snapshot_saver_t*)arg;
+    trace_thread_name("snapshot saver");
+    thread_mutex_lock(&saver->mutex);
+    while (true) {
+        size_t slot = 0;
+        if (snapshot_saver_take(saver, &slot)) {
+            thread_mutex_unlock(&saver->mutex);
+            const uint64_t start = trace_begin();
+            snapshot_saver_write(saver, slot);
+            trace_end("snapshot save", start);
+            thread_mutex_lock(&saver->mutex);
+        }
+        else if (saver->quit) {
+            break;
+        }
+        else {
+            thread_cond_wait(&saver->cond, &saver->mutex);
+        }
+    }
+    thread_mutex_unlock(&saver->mutex);
+}
+
+static void snapshot_saver_init(void) {
+    snapshot_saver_t* saver = &state.saver;
+    if (thread_mutex_init(&saver->mutex) && thread_cond_init(&saver->cond)) {
+        saver->threaded = thread_start(&saver->thread, snapshot_saver_thread, saver);
+    }
+}
+
+// finishes the pending saves
+static void snapshot_saver_discard(void) {
+    snapshot_saver_t* saver = &state.saver;
+    if (saver->threaded) {
+        thread_mutex_lock(&saver->mutex);
+        saver->quit = true;
+        thread_cond_signal(&saver->cond);
+        thread_mutex_unlock(&saver->mutex);
+        thread_join(&saver->thread);
+        saver->threaded = false;
+    }
+    thread_cond_discard(&saver->cond);
+    thread_mutex_discard(&saver->mutex);
+}
+
+// queue a slot for saving, a newer save of the same slot replaces a waiting one
+static void snapshot_saver_push(size_t slot, const snapshot_t* snapshot, const uint8_t* screenshot) {
+    snapshot_saver_t* saver = &state.saver;
+    thread_mutex_lock(&saver->mutex);
+    saver->jobs[slot].snapshot = *snapshot;
+    memcpy(saver->jobs[slot].screenshot, screenshot, SCREENSHOT_SIZE_BYTES);
+    saver->pending |= 1u << slot;
+    thread_cond_signal(&saver->cond);
+    thread_mutex_unlock(&saver->mutex);
+    if (!saver->threaded) {
+        size_t next = 0;
+        while (snapshot_saver_take(saver, &next)) {
+            snapshot_saver_write(saver, next);
+        }
     }
 }
 
 static void ui_save_snapshot(size_t slot) {
     if (slot < UI_SNAPSHOT_MAX_SLOTS) {
-        state.snapshots[slot].version = sequencer_save_snapshot(&state.sequencer, &state.snapshots[slot].sequencer);
-        memcpy(state.snapshots[slot].screenshot_data, state.framebuffer, SCREENSHOT_SIZE_BYTES);
-        ui_update_snapshot_screenshot(slot);
-        fs_save_snapshot("sequencer", slot, (chips_range_t){ .ptr = &state.snapshots[slot], sizeof(sequencer_snapshot_t) });
+        static snapshot_t saved;
+        saved.size = sequencer_save_snapshot(&state.sequencer, saved.data, sizeof(saved.data));
+        if (saved.size == 0) {
+            // the menu already marked the slot valid, it still holds what it held before
+            state.ui.snapshot.slots[slot].valid = (state.snapshots[slot].size > 0);
+            return;
+        }
+        snapshot_t* snapshot = &state.snapshots[slot];
+        memcpy(snapshot->data, saved.data, (size_t)saved.size);
+        snapshot->size = saved.size;
+        capture_screenshot();
+        thumbnail_atlas_put(slot, state.screenshot);
+        snapshot_saver_push(slot, snapshot, state.screenshot);
     }
 }
 
 static bool ui_load_snapshot(size_t slot) {
     bool success = false;
     if ((slot < UI_SNAPSHOT_MAX_SLOTS) && (state.ui.snapshot.slots[slot].valid)) {
-        success = sequencer_load_snapshot(&state.sequencer, state.snapshots[slot].version, &state.snapshots[slot].sequencer);
+        success = sequencer_load_snapshot(&state.sequencer, state.snapshots[slot].data, state.snapshots[slot].size);
     }
     return success;
 }
 
+static void ui_fetch_screenshot_callback(const fs_snapshot_response_t* response) {
+    assert(response);
+    const uint8_t* blob = (const uint8_t*)response->data.ptr;
+    const int size = (int)response->data.size;
+    if ((response->result != FS_RESULT_SUCCESS) || (size < SCREENSHOT_HEADER_SIZE) || (0 != memcmp(blob, "NSSC", 4))) {
+        return;
+    }
+    if (((blob[4] | (blob[5] << 8)) != SCREENSHOT_WIDTH) || ((blob[6] | (blob[7] << 8)) != SCREENSHOT_HEIGHT)) {
+        return;
+    }
+    const size_t slot = response->snapshot_index;
+    assert(slot < UI_SNAPSHOT_MAX_SLOTS);
+    // a slot saved in the meantime already has a newer thumbnail
+    if (!state.ui.snapshot.slots[slot].valid || (state.atlas.ui.valid & (1u << slot))) {
+        return;
+    }
+    const int n = lz_decompress(&blob[SCREENSHOT_HEADER_SIZE], size - SCREENSHOT_HEADER_SIZE, state.screenshot, SCREENSHOT_SIZE_BYTES);
+    if (n == SCREENSHOT_SIZE_BYTES) {
+        thumbnail_atlas_put(slot, state.screenshot);
+    }
+}
+
 static void ui_fetch_snapshot_callback(const fs_snapshot_response_t* response) {
     assert(response);
     if (response->result != FS_RESULT_SUCCESS) {
         return;
     }
-    if (response->data.size != sizeof(sequencer_snapshot_t)) {
+    const uint8_t* data = (const uint8_t*)response->data.ptr;
+    if ((response->data.size > SEQUENCER_SNAPSHOT_MAX_SIZE) || (response->data.size < SEQUENCER_SNAPSHOT_HEADER_SIZE)) {
         return;
     }
-    if (((sequencer_snapshot_t*)response->data.ptr)->version != SEQUENCER_SNAPSHOT_VERSION) {
+    if ((0 != memcmp(data, "NSSN", 4)) || (data[4] != SEQUENCER_SNAPSHOT_VERSION)) {
         return;
     }
     size_t snapshot_slot = response->snapshot_index;
     assert(snapshot_slot < UI_SNAPSHOT_MAX_SLOTS);
-    memcpy(&state.snapshots[snapshot_slot], response->data.ptr, response->data.size);
-    ui_update_snapshot_screenshot(snapshot_slot);
+    memcpy(state.snapshots[snapshot_slot].data, data, response->data.size);
+    state.snapshots[snapshot_slot].size = (int)response->data.size;
+    state.ui.snapshot.slots[snapshot_slot].valid = true;
+    // the screenshot is only needed once the thumbnails are shown
+    if (state.atlas.requested) {
+        fs_load_snapshot_async(SCREENSHOT_NAME, snapshot_slot, ui_fetch_screenshot_callback);
+    }
 }
 
+// The snapshot slots stay next to the patch library: they are the quick save
+// slots of the menu bar and the only storage on the web, where the library
+// can't be memory-mapped. The library replaces them as the place to keep any
+// number of patches. The slots are a fixed handful of compact snapshots, their
+// screenshots are only fetched when a snapshot menu is opened.
 static void ui_load_snapshots_from_storage(void) {
     for (size_t snapshot_slot = 0; snapshot_slot < UI_SNAPSHOT_MAX_SLOTS; snapshot_slot++) {
-        fs_load_snapshot_async("sequencer", snapshot_slot, ui_fetch_snapshot_callback);
+        fs_load_snapshot_async(SNAPSHOT_NAME, snapshot_slot, ui_fetch_snapshot_callback);
+    }
+}
+
+// first opening of a snapshot menu: create the texture and fetch the screenshots
+static const ui_numbersid_thumbnails_t* ui_thumbnails_cb(void) {
+    thumbnail_atlas_t* atlas = &state.atlas;
+    if (!atlas->requested) {
+        atlas->requested = true;
+        atlas->ui.texture = ui_create_texture(ATLAS_WIDTH, ATLAS_HEIGHT);
+        atlas->ui.slot_width = ATLAS_SLOT_WIDTH;
+        atlas->ui.slot_height = ATLAS_SLOT_HEIGHT;
+        atlas->ui.columns = ATLAS_COLUMNS;
+        atlas->ui.rows = ATLAS_ROWS;
+        atlas->dirty = (1u << UI_SNAPSHOT_MAX_SLOTS) - 1;
+        for (size_t slot = 0; slot < UI_SNAPSHOT_MAX_SLOTS; slot++) {
+            if (state.ui.snapshot.slots[slot].valid && !(atlas->ui.valid & (1u << slot))) {
+                fs_load_snapshot_async(SCREENSHOT_NAME, slot, ui_fetch_screenshot_callback);
+            }
+        }
+    }
+    return &atlas->ui;
+}
+
+// ----------------------
+
+// only the records and thumbnails that are shown are read
+static void library_init(void) {
+    #if !defined(__EMSCRIPTEN__)
+    library_t* library = &state.library;
+    for (int i = 0; i < LIBRARY_MAX_TEXTURES; i++) {
+        library->textures[i].index = -1;
+    }
+    library->path = sargs_value_def("library", LIBRARY_DEFAULT_PATH);
+    #endif
+}
+
+// opens (and creates) the library when its window is first shown, not at startup,
+// so no library files appear in the working directory of a session that doesn't use it
+static bool ui_library_open(void) {
+    library_t* library = &state.library;
+    if (!library->valid && !library->failed && library->path) {
+        library->valid = patchlib_open(&library->lib, library->path);
+        library->failed = !library->valid;
+    }
+    return library->valid;
+}
+
+static void library_discard(void) {
+    library_t* library = &state.library;
+    if (library->valid) {
+        for (int i = 0; i < LIBRARY_MAX_TEXTURES; i++) {
+            if (library->textures[i].texture) {
+                ui_destroy_texture(library->textures[i].texture);
+            }
+        }
+        patchlib_close(&library->lib);
+        library->valid = false;
+    }
+}
+
+// thumbnail blob: 'N','S','T','H', width, height (u16 each), lz compressed pixels
+static int library_make_thumbnail(void) {
+    library_t* library = &state.library;
+    capture_screenshot();
+    // the brightest of each 2x2 block, so thin lines of the spectrogram survive
+    for (int y = 0; y < THUMBNAIL_HEIGHT; y++) {
+        for (int x = 0; x < THUMBNAIL_WIDTH; x++) {
+            const uint8_t* src = &state.screenshot[(y * 2) * SCREENSHOT_WIDTH + x * 2];
+            uint8_t p = src[0];
+            if (src[1] > p) p = src[1];
+            if (src[SCREENSHOT_WIDTH] > p) p = src[SCREENSHOT_WIDTH];
+            if (src[SCREENSHOT_WIDTH + 1] > p) p = src[SCREENSHOT_WIDTH + 1];
+            library->thumbnail[y * THUMBNAIL_WIDTH + x] = p;
+        }
+    }
+    uint8_t* blob = library->blob;
+    memcpy(blob, "NSTH", 4);
+    blob[4] = THUMBNAIL_WIDTH & 0xFF; blob[5] = THUMBNAIL_WIDTH >> 8;
+    blob[6] = THUMBNAIL_HEIGHT & 0xFF; blob[7] = THUMBNAIL_HEIGHT >> 8;
+    const int size = lz_compress(library->thumbnail, THUMBNAIL_SIZE_BYTES, &blob[SCREENSHOT_HEADER_SIZE], THUMBNAIL_MAX_BLOB_SIZE - SCREENSHOT_HEADER_SIZE);
+    return (size > 0) ? SCREENSHOT_HEADER_SIZE + size : 0;
+}
+
+static int ui_library_add(const char* name) {
+    library_t* library = &state.library;
+    const int patch_size = sequencer_export_binary(&state.sequencer, library->patch, sizeof(library->patch));
+    if (!ui_library_open() || (patch_size <= 0)) {
+        return -1;
+    }
+    const int thumbnail_size = library_make_thumbnail();
+    return patchlib_add(&library->lib, name, library->patch, patch_size, thumbnail_size ? library->blob : 0, thumbnail_size);
+}
+
+static bool ui_library_load(int index) {
+    int size = 0;
+    const uint8_t* patch = ui_library_open() ? patchlib_patch(&state.library.lib, index, &size) : 0;
+    return patch && sequencer_import_binary(&state.sequencer, patch, size);
+}
+
+// decode a thumbnail into a new texture, 0 if the patch has none or it is damaged
+static ui_texture_t library_create_texture(int index) {
+    library_t* library = &state.library;
+    int size = 0;
+    const uint8_t* blob = patchlib_thumbnail(&library->lib, index, &size);
+    if (!blob || (size < SCREENSHOT_HEADER_SIZE) || (0 != memcmp(blob, "NSTH", 4))) {
+        return 0;
+    }
+    if (((blob[4] | (blob[5] << 8)) != THUMBNAIL_WIDTH) || ((blob[6] | (blob[7] << 8)) != THUMBNAIL_HEIGHT)) {
+        return 0;
+    }
+    const int n = lz_decompress(&blob[SCREENSHOT_HEADER_SIZE], size - SCREENSHOT_HEADER_SIZE, library->thumbnail, THUMBNAIL_SIZE_BYTES);
+    if (n != THUMBNAIL_SIZE_BYTES) {
+        return 0;
+    }
+    return ui_create_screenshot_texture(image_display_info(library->thumbnail, THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT));
+}
+
+// textures of recently shown thumbnails are kept, a few new ones are decoded per frame
+static ui_texture_t ui_library_thumbnail(int index) {
+    library_t* library = &state.library;
+    const uint64_t frame = sapp_frame_count();
+    int oldest = 0;
+    for (int i = 0; i < LIBRARY_MAX_TEXTURES; i++) {
+        if (library->textures[i].index == index) {
+            library->textures[i].used_frame = frame;
+            return library->textures[i].texture;
+        }
+        if (library->textures[i].used_frame < library->textures[oldest].used_frame) {
+            oldest = i;
+        }
+    }
+    if (library->frame != frame) {
+        library->frame = frame;
+        library->num_decoded = 0;
+    }
+    if (library->num_decoded >= LIBRARY_MAX_TEXTURES_PER_FRAME) {
+        return 0;
+    }
+    library->num_decoded++;
+    if (library->textures[oldest].texture) {
+        ui_destroy_texture(library->textures[oldest].texture);
     }
+    library->textures[oldest].index = index;
+    library->textures[oldest].texture = library_create_texture(index);
+    library->textures[oldest].used_frame = frame;
+    return library->textures[oldest].texture;
 }
 
 // ----------------------
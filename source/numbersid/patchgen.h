@@ -0,0 +1,273 @@
+#pragma once
+/*
+    Generated patches for headless tests and benchmarks.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    Include the following headers before including patchgen.h:
+        - chips/chips_common.h
+        - chips/m6581.h
+        - sequencer.h
+
+    Every kind of patch stresses a different part of the sequencer, so
+    together they cover what real patches do:
+
+        - default:  the patch the application boots with
+        - sparse:   a few sequences and two voices, a simple tune
+        - dense:    32 sequences with every parameter set, all voice
+                    parameters driven by variables
+        - arrays:   all 16 arrays filled, most sequences look up an array
+        - base:     sequences with BASE 2..16 on large counts, so
+                    sum_digits() loops over many digits
+        - full:     all 64 sequences, 16 voices and 16 arrays
+
+    The patches only depend on the kind, a generated patch is the same on
+    every machine and in every build.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    PATCHGEN_DEFAULT,
+    PATCHGEN_SPARSE,
+    PATCHGEN_DENSE,
+    PATCHGEN_ARRAYS,
+    PATCHGEN_BASE,
+    PATCHGEN_FULL,
+    PATCHGEN_NUM,
+} patchgen_kind_t;
+
+// build a patch of the given kind, replaces the whole sequencer state
+void patchgen_make(sequencer_t* seq, patchgen_kind_t kind);
+// name of a kind, e.g. for command line arguments
+const char* patchgen_name(patchgen_kind_t kind);
+// kind with the given name, PATCHGEN_NUM if there is none
+patchgen_kind_t patchgen_find(const char* name);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <string.h>
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
+
+// variables A..S are free, T is the frame and U..Z are gate times and counts
+#define _PATCHGEN_NUM_FREE_VARS (19)
+
+static const char* _patchgen_names[PATCHGEN_NUM] = {
+    "default", "sparse", "dense", "arrays", "base", "full",
+};
+
+static var_or_number_t _patchgen_num(int number) {
+    return (var_or_number_t){ .number = (int16_t)number };
+}
+
+static var_or_number_t _patchgen_var(char variable) {
+    return (var_or_number_t){ .variable = variable };
+}
+
+// small LCG, the patches must not depend on the C library
+static int _patchgen_rand(uint32_t* rnd, int lo, int hi) {
+    *rnd = *rnd * 1664525u + 1013904223u;
+    return lo + (int)((*rnd >> 16) % (uint32_t)(hi - lo + 1));
+}
+
+static char _patchgen_free_var(int i) {
+    return (char)('A' + i % _PATCHGEN_NUM_FREE_VARS);
+}
+
+static void _patchgen_voices(sequencer_t* seq, int num_voices, uint32_t* rnd, bool variable) {
+    seq->num_voices = (uint8_t)num_voices;
+    for (int v = 0; v < num_voices; v++) {
+        voice_t* voice = &seq->voices[v];
+        voice->gate = _patchgen_var(_patchgen_free_var(v * 3 + 1));
+        voice->note = _patchgen_var(_patchgen_free_var(v * 5));
+        voice->scale = _patchgen_num((v % 2) ? 0x0AB5 : 0x0295);
+        voice->transpose = _patchgen_num(12 * (v % 4) - 24);
+        voice->pitch = (v % 4) ? _patchgen_num(0) : _patchgen_var('B');
+        voice->waveform = _patchgen_num(1 << (v % 4));
+        voice->pulsewidth = _patchgen_num(2048);
+        voice->attack = _patchgen_num(1);
+        voice->decay = _patchgen_num(8);
+        voice->sustain = _patchgen_num(10);
+        voice->release = _patchgen_num(6);
+        if (variable) {
+            voice->waveform = _patchgen_var(_patchgen_free_var(v + 7));
+            voice->pulsewidth = _patchgen_var(_patchgen_free_var(v + 11));
+            voice->ring = _patchgen_var(_patchgen_free_var(v + 2));
+            voice->sync = _patchgen_var(_patchgen_free_var(v + 3));
+            voice->attack = _patchgen_num(_patchgen_rand(rnd, 0, 4));
+            voice->decay = _patchgen_var(_patchgen_free_var(v + 13));
+            voice->filter = _patchgen_var(_patchgen_free_var(v + 5));
+        }
+    }
+}
+
+// random sequences that read the frame, the gate counters and each other
+static void _patchgen_sequences(sequencer_t* seq, int num_sequences, uint32_t* rnd, int min_base, int max_base, bool use_arrays) {
+    seq->num_sequences = (uint8_t)num_sequences;
+    for (int i = 0; i < num_sequences; i++) {
+        sequence_t* s = &seq->sequences[i];
+        *s = (sequence_t){0};
+        s->variable = _patchgen_free_var(i);
+        s->count = (i == 0) ? _patchgen_var('T') : _patchgen_var(_patchgen_rand(rnd, 0, 3) ? 'T' : _patchgen_free_var(i - 1));
+        s->add1 = _patchgen_num(_patchgen_rand(rnd, -4, 16));
+        s->div1 = _patchgen_num(_patchgen_rand(rnd, 1, 16));
+        s->mul1 = _patchgen_num(_patchgen_rand(rnd, 0, 3));
+        s->mod1 = _patchgen_num(_patchgen_rand(rnd, 0, 64));
+        s->base = _patchgen_num(_patchgen_rand(rnd, min_base, max_base));
+        s->mod2 = _patchgen_num(_patchgen_rand(rnd, 0, 24));
+        s->mul2 = _patchgen_rand(rnd, 0, 1) ? _patchgen_var(_patchgen_free_var(i + 1)) : _patchgen_num(_patchgen_rand(rnd, 0, 3));
+        s->div2 = _patchgen_num(_patchgen_rand(rnd, 0, 4));
+        s->add2 = _patchgen_rand(rnd, 0, 1) ? _patchgen_var((char)('U' + _patchgen_rand(rnd, 0, 5))) : _patchgen_num(_patchgen_rand(rnd, -12, 12));
+        s->array = use_arrays ? _patchgen_num(_patchgen_rand(rnd, 0, seq->num_arrays)) : _patchgen_num(0);
+    }
+}
+
+static void _patchgen_arrays(sequencer_t* seq, int num_arrays, uint32_t* rnd) {
+    seq->num_arrays = (uint8_t)num_arrays;
+    for (int a = 0; a < num_arrays; a++) {
+        seq->array_sizes[a] = (uint8_t)_patchgen_rand(rnd, 4, MAX_ARRAY_SIZE);
+        for (int i = 0; i < MAX_ARRAY_SIZE; i++) {
+            seq->arrays[a][i] = _patchgen_rand(rnd, 0, 3) ? _patchgen_num(_patchgen_rand(rnd, -6, 18)) : _patchgen_var(_patchgen_free_var(a + i));
+        }
+    }
+}
+
+static void _patchgen_sparse(sequencer_t* seq) {
+    static const int notes[8] = { 0, 2, 4, 5, 7, 9, 11, 12 };
+    seq->num_arrays = 1;
+    seq->array_sizes[0] = 8;
+    for (int i = 0; i < 8; i++) {
+        seq->arrays[0][i] = _patchgen_num(notes[i]);
+    }
+    seq->num_sequences = 4;
+    // S = T/8, A = melody from array 1, B = bass, G = gate every 4 frames
+    seq->sequences[0] = (sequence_t){ .variable = 'S', .count = _patchgen_var('T'), .div1 = _patchgen_num(8) };
+    seq->sequences[1] = (sequence_t){ .variable = 'A', .count = _patchgen_var('S'), .mul1 = _patchgen_num(3), .mod1 = _patchgen_num(8), .array = _patchgen_num(1) };
+    seq->sequences[2] = (sequence_t){ .variable = 'B', .count = _patchgen_var('S'), .div1 = _patchgen_num(8), .mod1 = _patchgen_num(4) };
+    seq->sequences[3] = (sequence_t){ .variable = 'G', .count = _patchgen_var('T'), .div1 = _patchgen_num(4), .mod1 = _patchgen_num(2) };
+    seq->num_voices = 2;
+    seq->voices[0] = (voice_t){
+        .gate = _patchgen_var('G'), .note = _patchgen_var('A'), .waveform = _patchgen_num(2),
+        .attack = _patchgen_num(0), .decay = _patchgen_num(6), .sustain = _patchgen_num(8), .release = _patchgen_num(4),
+    };
+    seq->voices[1] = (voice_t){
+        .gate = _patchgen_num(1), .note = _patchgen_var('B'), .transpose = _patchgen_num(-24), .waveform = _patchgen_num(4),
+        .pulsewidth = _patchgen_num(1024), .sustain = _patchgen_num(12), .release = _patchgen_num(2),
+    };
+    seq->channel_voice_params[2] = _patchgen_num(0);
+}
+
+// 64 sequences that depend on each other and read arrays, 16 voices with variable notes
+static void _patchgen_full(sequencer_t* seq) {
+    seq->num_arrays = MAX_ARRAYS;
+    for (int a = 0; a < MAX_ARRAYS; a++) {
+        seq->array_sizes[a] = (uint8_t)(4 + a % (MAX_ARRAY_SIZE - 3));
+        for (int i = 0; i < MAX_ARRAY_SIZE; i++) {
+            seq->arrays[a][i] = ((i % 3) == 2) ? _patchgen_var(_patchgen_free_var(a + i)) : _patchgen_num((a * 7 + i * 5) % 24 - 6);
+        }
+    }
+    seq->num_sequences = MAX_SEQUENCES;
+    for (int i = 0; i < MAX_SEQUENCES; i++) {
+        const char prev = (i == 0) ? 'T' : _patchgen_free_var(i - 1);
+        seq->sequences[i] = (sequence_t){
+            .variable = _patchgen_free_var(i),
+            .count = _patchgen_var((i % 4) ? prev : 'T'),
+            .add1 = _patchgen_num(i % 5),
+            .div1 = _patchgen_num(1 + i % 8),
+            .mul1 = _patchgen_num((i % 3) ? 0 : 3),
+            .mod1 = _patchgen_num(16 + i % 48),
+            .base = _patchgen_num((i % 2) ? 0 : 2 + i % 9),
+            .mod2 = _patchgen_num(i % 13),
+            .mul2 = _patchgen_num((i % 7) ? 0 : 2),
+            .div2 = _patchgen_num((i % 5) ? 0 : 2),
+            .add2 = (i % 6) ? _patchgen_num(0) : _patchgen_var('U'),
+            .array = _patchgen_num((i % 3) ? 1 + i % MAX_ARRAYS : 0),
+        };
+    }
+    _patchgen_voices(seq, MAX_VOICES, 0, false);
+    seq->channel_voice_params[0] = _patchgen_var('C');
+    seq->channel_voice_params[1] = _patchgen_num(6);
+    seq->channel_voice_params[2] = _patchgen_num(11);
+    seq->cutoff = _patchgen_var('D');
+    seq->resonance = _patchgen_num(8);
+    seq->filter_mode = _patchgen_num(1);
+}
+
+void patchgen_make(sequencer_t* seq, patchgen_kind_t kind) {
+    CHIPS_ASSERT(seq && (kind >= 0) && (kind < PATCHGEN_NUM));
+    sequencer_init(seq);
+    uint32_t rnd = 0x6E756D62 + (uint32_t)kind;
+    switch (kind) {
+        case PATCHGEN_SPARSE:
+            _patchgen_sparse(seq);
+            break;
+        case PATCHGEN_DENSE:
+            _patchgen_arrays(seq, 4, &rnd);
+            _patchgen_sequences(seq, 32, &rnd, 0, 4, true);
+            _patchgen_voices(seq, NUM_CHANNELS, &rnd, true);
+            seq->cutoff = _patchgen_var('E');
+            seq->resonance = _patchgen_var('F');
+            seq->filter_mode = _patchgen_num(2);
+            break;
+        case PATCHGEN_ARRAYS:
+            _patchgen_arrays(seq, MAX_ARRAYS, &rnd);
+            _patchgen_sequences(seq, 24, &rnd, 0, 0, true);
+            _patchgen_voices(seq, 6, &rnd, false);
+            seq->channel_voice_params[0] = _patchgen_var('H');
+            break;
+        case PATCHGEN_BASE:
+            _patchgen_sequences(seq, 24, &rnd, 2, 16, false);
+            for (int i = 0; i < seq->num_sequences; i++) {
+                // large values have many digits
+                seq->sequences[i].div1 = _patchgen_num(1);
+                seq->sequences[i].mul1 = _patchgen_num(_patchgen_rand(&rnd, 50, 300));
+                seq->sequences[i].mod1 = _patchgen_num(0);
+            }
+            _patchgen_voices(seq, NUM_CHANNELS, &rnd, false);
+            break;
+        case PATCHGEN_FULL:
+            _patchgen_full(seq);
+            break;
+        default:
+            break;
+    }
+    seq->preview.num_columns = 8;
+    for (int c = 0; c < seq->preview.num_columns; c++) {
+        seq->preview.variables[c] = (char)('A' + c * 2);
+    }
+}
+
+const char* patchgen_name(patchgen_kind_t kind) {
+    CHIPS_ASSERT((kind >= 0) && (kind < PATCHGEN_NUM));
+    return _patchgen_names[kind];
+}
+
+patchgen_kind_t patchgen_find(const char* name) {
+    CHIPS_ASSERT(name);
+    for (int kind = 0; kind < PATCHGEN_NUM; kind++) {
+        if (0 == strcmp(name, _patchgen_names[kind])) {
+            return (patchgen_kind_t)kind;
+        }
+    }
+    return PATCHGEN_NUM;
+}
+
+#endif
@@ -0,0 +1,500 @@
+#pragma once
+/*
+    Patch library, an unlimited number of named patches with thumbnails.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    A library is an index file and a data file next to it (the index path
+    with ".data" appended). Both are append-only and memory-mapped, so
+    opening a library costs the same for ten patches as for a million, and
+    any patch is found by its index without reading the others.
+
+    Index file:
+
+        header      'N','S','P','L', version (u32), record size (u32), 0 (u32)
+        records     patchlib_record_t, in native byte order
+
+    Data file:
+
+        header      'N','S','P','D', version (u32)
+        blobs       binary patches (see sequencer_export_binary()) and
+                    thumbnails, at the offsets given by the records
+
+    A patch is added by appending its blobs to the data file first and its
+    record to the index after that. The number of patches follows from the
+    size of the index, so a write that was cut short leaves at most an
+    incomplete record at the end, which is dropped by the next
+    patchlib_open() or patchlib_add(), and blobs that no record refers to.
+    A failed patchlib_add() truncates both files back to where they were.
+    If a file can't be mapped again after an add, the library is left
+    without patches and further adds fail, until it is opened again.
+
+    Pointers returned by patchlib_record(), patchlib_patch() and
+    patchlib_thumbnail() point into the mappings and are only valid until
+    the next patchlib_add() or patchlib_close().
+
+    The library is not thread-safe. Memory mapping is not available on
+    emscripten, patchlib_open() fails there.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PATCHLIB_VERSION (1)
+#define PATCHLIB_INDEX_HEADER_SIZE (16)
+#define PATCHLIB_DATA_HEADER_SIZE (8)
+#define PATCHLIB_NAME_SIZE (88)         // including the terminating zero
+#define PATCHLIB_PATH_SIZE (1024)
+
+typedef struct {
+    uint64_t patch_offset;              // binary patch in the data file
+    uint64_t thumbnail_offset;          // thumbnail in the data file, 0: none
+    uint32_t patch_size;
+    uint32_t thumbnail_size;
+    uint32_t hash;                      // FNV-1a of the binary patch
+    uint32_t flags;                     // reserved, 0
+    int64_t time;                       // when the patch was added, seconds since the epoch
+    char name[PATCHLIB_NAME_SIZE];      // zero-terminated
+} patchlib_record_t;
+
+typedef struct {
+    const char* error;                  // error message if a function failed
+    char error_buf[128];
+    char path[PATCHLIB_PATH_SIZE];
+    int num_records;
+    struct {
+        intptr_t handle;                // file descriptor or HANDLE
+        uint8_t* ptr;                   // read-only mapping of the whole file
+        uint64_t size;
+    } index, data;
+} patchlib_t;
+
+// open a library, create it if it does not exist
+bool patchlib_open(patchlib_t* lib, const char* path);
+// unmap and close the library
+void patchlib_close(patchlib_t* lib);
+// number of patches in the library
+int patchlib_count(const patchlib_t* lib);
+// record of a patch, 0 if out of range
+const patchlib_record_t* patchlib_record(const patchlib_t* lib, int index);
+// binary patch, 0 if out of range or damaged
+const uint8_t* patchlib_patch(const patchlib_t* lib, int index, int* size);
+// thumbnail, 0 if the patch has none or if it is damaged
+const uint8_t* patchlib_thumbnail(const patchlib_t* lib, int index, int* size);
+// append a patch, thumbnail is optional, returns the index of the patch or -1
+int patchlib_add(patchlib_t* lib, const char* name, const uint8_t* patch, int patch_size, const uint8_t* thumbnail, int thumbnail_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#if defined(_WIN32)
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
+
+typedef char _patchlib_record_size_check[(sizeof(patchlib_record_t) == 128) ? 1 : -1];
+
+static bool _patchlib_fail(patchlib_t* lib, const char* message, const char* path) {
+    snprintf(lib->error_buf, sizeof(lib->error_buf), "%s: %s", message, path);
+    lib->error = lib->error_buf;
+    return false;
+}
+
+static uint32_t _patchlib_hash(const uint8_t* data, int size) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void _patchlib_put_u32(uint8_t* dst, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        dst[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+/*-- platform layer: open, size, append, map ---------------------------------*/
+
+#if defined(_WIN32)
+
+#define _PATCHLIB_NO_FILE ((intptr_t)INVALID_HANDLE_VALUE)
+
+static intptr_t _patchlib_file_open(const char* path) {
+    return (intptr_t)CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, 0, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+}
+
+static void _patchlib_file_close(intptr_t file) {
+    CloseHandle((HANDLE)file);
+}
+
+static bool _patchlib_file_size(intptr_t file, uint64_t* size) {
+    LARGE_INTEGER li;
+    if (!GetFileSizeEx((HANDLE)file, &li)) {
+        return false;
+    }
+    *size = (uint64_t)li.QuadPart;
+    return true;
+}
+
+static bool _patchlib_file_append(intptr_t file, const void* data, int size) {
+    LARGE_INTEGER zero = {0};
+    DWORD written = 0;
+    return SetFilePointerEx((HANDLE)file, zero, 0, FILE_END)
+        && WriteFile((HANDLE)file, data, (DWORD)size, &written, 0)
+        && (written == (DWORD)size);
+}
+
+static bool _patchlib_file_truncate(intptr_t file, uint64_t size) {
+    LARGE_INTEGER li;
+    li.QuadPart = (LONGLONG)size;
+    return SetFilePointerEx((HANDLE)file, li, 0, FILE_BEGIN) && SetEndOfFile((HANDLE)file);
+}
+
+static uint8_t* _patchlib_map(intptr_t file, uint64_t size) {
+    HANDLE mapping = CreateFileMappingA((HANDLE)file, 0, PAGE_READONLY, (DWORD)(size >> 32), (DWORD)size, 0);
+    if (!mapping) {
+        return 0;
+    }
+    // the view keeps the mapping alive
+    uint8_t* ptr = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, (SIZE_T)size);
+    CloseHandle(mapping);
+    return ptr;
+}
+
+static void _patchlib_unmap(uint8_t* ptr, uint64_t size) {
+    (void)size;
+    UnmapViewOfFile(ptr);
+}
+
+#elif !defined(__EMSCRIPTEN__)
+
+#define _PATCHLIB_NO_FILE ((intptr_t)-1)
+
+static intptr_t _patchlib_file_open(const char* path) {
+    return (intptr_t)open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+}
+
+static void _patchlib_file_close(intptr_t file) {
+    close((int)file);
+}
+
+static bool _patchlib_file_size(intptr_t file, uint64_t* size) {
+    struct stat st;
+    if (fstat((int)file, &st) != 0) {
+        return false;
+    }
+    *size = (uint64_t)st.st_size;
+    return true;
+}
+
+static bool _patchlib_file_append(intptr_t file, const void* data, int size) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (size > 0) {
+        const ssize_t n = write((int)file, p, (size_t)size);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= (int)n;
+    }
+    return true;
+}
+
+static bool _patchlib_file_truncate(intptr_t file, uint64_t size) {
+    return ftruncate((int)file, (off_t)size) == 0;
+}
+
+static uint8_t* _patchlib_map(intptr_t file, uint64_t size) {
+    void* ptr = mmap(0, (size_t)size, PROT_READ, MAP_SHARED, (int)file, 0);
+    return (ptr == MAP_FAILED) ? 0 : (uint8_t*)ptr;
+}
+
+static void _patchlib_unmap(uint8_t* ptr, uint64_t size) {
+    munmap(ptr, (size_t)size);
+}
+
+#else
+
+#define _PATCHLIB_NO_FILE ((intptr_t)-1)
+
+static intptr_t _patchlib_file_open(const char* path) { (void)path; return _PATCHLIB_NO_FILE; }
+static void _patchlib_file_close(intptr_t file) { (void)file; }
+static bool _patchlib_file_size(intptr_t file, uint64_t* size) { (void)file; *size = 0; return false; }
+static bool _patchlib_file_append(intptr_t file, const void* data, int size) { (void)file; (void)data; (void)size; return false; }
+static bool _patchlib_file_truncate(intptr_t file, uint64_t size) { (void)file; (void)size; return false; }
+static uint8_t* _patchlib_map(intptr_t file, uint64_t size) { (void)file; (void)size; return 0; }
+static void _patchlib_unmap(uint8_t* ptr, uint64_t size) { (void)ptr; (void)size; }
+
+#endif
+
+/*-- files --------------------------------------------------------------------*/
+
+// drop the mapping of a file, with nothing mapped it holds no records or blobs
+static void _patchlib_unmap_file(patchlib_t* lib, bool index) {
+    if (index) {
+        if (lib->index.ptr) {
+            _patchlib_unmap(lib->index.ptr, lib->index.size);
+        }
+        lib->index.ptr = 0;
+        lib->index.size = 0;
+        lib->num_records = 0;
+    }
+    else {
+        if (lib->data.ptr) {
+            _patchlib_unmap(lib->data.ptr, lib->data.size);
+        }
+        lib->data.ptr = 0;
+        lib->data.size = 0;
+    }
+}
+
+// map the file as it is now, replacing the previous mapping, on failure nothing is mapped
+static bool _patchlib_remap(patchlib_t* lib, bool index) {
+    _patchlib_unmap_file(lib, index);
+    uint64_t size = 0;
+    if (index) {
+        if (!_patchlib_file_size(lib->index.handle, &size) || (size < PATCHLIB_INDEX_HEADER_SIZE)) {
+            return false;
+        }
+        lib->index.ptr = _patchlib_map(lib->index.handle, size);
+        if (!lib->index.ptr) {
+            return false;
+        }
+        lib->index.size = size;
+        lib->num_records = (int)((size - PATCHLIB_INDEX_HEADER_SIZE) / sizeof(patchlib_record_t));
+    }
+    else {
+        if (!_patchlib_file_size(lib->data.handle, &size) || (size < PATCHLIB_DATA_HEADER_SIZE)) {
+            return false;
+        }
+        lib->data.ptr = _patchlib_map(lib->data.handle, size);
+        if (!lib->data.ptr) {
+            return false;
+        }
+        lib->data.size = size;
+    }
+    return true;
+}
+
+// truncate a file, Windows can't truncate a file with a mapped view, so the mapping is dropped first
+static bool _patchlib_truncate(patchlib_t* lib, bool index, uint64_t size) {
+    _patchlib_unmap_file(lib, index);
+    return _patchlib_file_truncate(index ? lib->index.handle : lib->data.handle, size);
+}
+
+// open one of the files, write the header of a new file, check the header of an existing one
+static bool _patchlib_open_file(patchlib_t* lib, intptr_t* handle, const char* path, const uint8_t* header, int header_size) {
+    *handle = _patchlib_file_open(path);
+    uint64_t size = 0;
+    if ((*handle == _PATCHLIB_NO_FILE) || !_patchlib_file_size(*handle, &size)) {
+        return _patchlib_fail(lib, "cannot open", path);
+    }
+    if (size == 0) {
+        if (!_patchlib_file_append(*handle, header, header_size)) {
+            return _patchlib_fail(lib, "cannot write", path);
+        }
+        return true;
+    }
+    if (size < (uint64_t)header_size) {
+        return _patchlib_fail(lib, "not a patch library", path);
+    }
+    uint8_t* ptr = _patchlib_map(*handle, size);
+    if (!ptr) {
+        return _patchlib_fail(lib, "cannot map", path);
+    }
+    const bool valid = (0 == memcmp(ptr, header, header_size));
+    _patchlib_unmap(ptr, size);
+    return valid ? true : _patchlib_fail(lib, "not a patch library of this version", path);
+}
+
+bool patchlib_open(patchlib_t* lib, const char* path) {
+    CHIPS_ASSERT(lib && path);
+    memset(lib, 0, sizeof(patchlib_t));
+    lib->index.handle = lib->data.handle = _PATCHLIB_NO_FILE;
+    if (strlen(path) + sizeof(".data") > sizeof(lib->path)) {
+        return _patchlib_fail(lib, "path too long", path);
+    }
+    snprintf(lib->path, sizeof(lib->path), "%s", path);
+    char data_path[PATCHLIB_PATH_SIZE];
+    snprintf(data_path, sizeof(data_path), "%s.data", path);
+
+    uint8_t index_header[PATCHLIB_INDEX_HEADER_SIZE] = { 'N', 'S', 'P', 'L' };
+    _patchlib_put_u32(&index_header[4], PATCHLIB_VERSION);
+    _patchlib_put_u32(&index_header[8], (uint32_t)sizeof(patchlib_record_t));
+    uint8_t data_header[PATCHLIB_DATA_HEADER_SIZE] = { 'N', 'S', 'P', 'D' };
+    _patchlib_put_u32(&data_header[4], PATCHLIB_VERSION);
+    const char* error = 0;
+    if (!_patchlib_open_file(lib, &lib->index.handle, path, index_header, sizeof(index_header))
+        || !_patchlib_open_file(lib, &lib->data.handle, data_path, data_header, sizeof(data_header)))
+    {
+        error = lib->error_buf;
+    }
+    else if (!_patchlib_remap(lib, true) || !_patchlib_remap(lib, false)) {
+        _patchlib_fail(lib, "cannot map", path);
+        error = lib->error_buf;
+    }
+    else if (lib->index.size != PATCHLIB_INDEX_HEADER_SIZE + (uint64_t)lib->num_records * sizeof(patchlib_record_t)) {
+        // drop a record that was cut short, so the next one is appended in its place
+        const uint64_t size = PATCHLIB_INDEX_HEADER_SIZE + (uint64_t)lib->num_records * sizeof(patchlib_record_t);
+        if (!_patchlib_truncate(lib, true, size) || !_patchlib_remap(lib, true)) {
+            _patchlib_fail(lib, "cannot repair", path);
+            error = lib->error_buf;
+        }
+    }
+    if (error) {
+        char error_buf[sizeof(lib->error_buf)];
+        memcpy(error_buf, lib->error_buf, sizeof(error_buf));
+        patchlib_close(lib);
+        memcpy(lib->error_buf, error_buf, sizeof(error_buf));
+        lib->error = lib->error_buf;
+        return false;
+    }
+    return true;
+}
+
+void patchlib_close(patchlib_t* lib) {
+    CHIPS_ASSERT(lib);
+    if (lib->index.ptr) {
+        _patchlib_unmap(lib->index.ptr, lib->index.size);
+    }
+    if (lib->data.ptr) {
+        _patchlib_unmap(lib->data.ptr, lib->data.size);
+    }
+    if (lib->index.handle != _PATCHLIB_NO_FILE) {
+        _patchlib_file_close(lib->index.handle);
+    }
+    if (lib->data.handle != _PATCHLIB_NO_FILE) {
+        _patchlib_file_close(lib->data.handle);
+    }
+    memset(lib, 0, sizeof(patchlib_t));
+    lib->index.handle = lib->data.handle = _PATCHLIB_NO_FILE;
+}
+
+int patchlib_count(const patchlib_t* lib) {
+    CHIPS_ASSERT(lib);
+    return lib->num_records;
+}
+
+const patchlib_record_t* patchlib_record(const patchlib_t* lib, int index) {
+    CHIPS_ASSERT(lib);
+    if ((index < 0) || (index >= lib->num_records)) {
+        return 0;
+    }
+    return (const patchlib_record_t*)&lib->index.ptr[PATCHLIB_INDEX_HEADER_SIZE + (size_t)index * sizeof(patchlib_record_t)];
+}
+
+// a blob of a record, 0 if it is not inside the data file
+static const uint8_t* _patchlib_blob(const patchlib_t* lib, uint64_t offset, uint32_t blob_size, int* size) {
+    if ((offset < PATCHLIB_DATA_HEADER_SIZE) || (offset > lib->data.size) || (blob_size > lib->data.size - offset)) {
+        return 0;
+    }
+    *size = (int)blob_size;
+    return &lib->data.ptr[offset];
+}
+
+const uint8_t* patchlib_patch(const patchlib_t* lib, int index, int* size) {
+    CHIPS_ASSERT(lib && size);
+    *size = 0;
+    const patchlib_record_t* record = patchlib_record(lib, index);
+    if (!record) {
+        return 0;
+    }
+    const uint8_t* patch = _patchlib_blob(lib, record->patch_offset, record->patch_size, size);
+    if (!patch || (_patchlib_hash(patch, *size) != record->hash)) {
+        *size = 0;
+        return 0;
+    }
+    return patch;
+}
+
+const uint8_t* patchlib_thumbnail(const patchlib_t* lib, int index, int* size) {
+    CHIPS_ASSERT(lib && size);
+    *size = 0;
+    const patchlib_record_t* record = patchlib_record(lib, index);
+    if (!record || (record->thumbnail_offset == 0)) {
+        return 0;
+    }
+    return _patchlib_blob(lib, record->thumbnail_offset, record->thumbnail_size, size);
+}
+
+int patchlib_add(patchlib_t* lib, const char* name, const uint8_t* patch, int patch_size, const uint8_t* thumbnail, int thumbnail_size) {
+    CHIPS_ASSERT(lib && name && patch && (patch_size > 0));
+    CHIPS_ASSERT((thumbnail == 0) || (thumbnail_size > 0));
+    if (!lib->index.ptr || !lib->data.ptr) {
+        _patchlib_fail(lib, "library not open", lib->path);
+        return -1;
+    }
+    // the offsets come from the files, not the mappings, which are older
+    // if a previous add failed and could not undo all of its writes
+    uint64_t data_size = 0;
+    uint64_t index_size = 0;
+    if (!_patchlib_file_size(lib->data.handle, &data_size) || !_patchlib_file_size(lib->index.handle, &index_size)) {
+        _patchlib_fail(lib, "cannot write", lib->path);
+        return -1;
+    }
+    const uint64_t index_end = PATCHLIB_INDEX_HEADER_SIZE + (uint64_t)lib->num_records * sizeof(patchlib_record_t);
+    if ((index_size != index_end) && (!_patchlib_truncate(lib, true, index_end) || !_patchlib_remap(lib, true))) {
+        _patchlib_unmap_file(lib, false);
+        _patchlib_fail(lib, "cannot repair", lib->path);
+        return -1;
+    }
+    patchlib_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.patch_offset = data_size;
+    record.patch_size = (uint32_t)patch_size;
+    record.hash = _patchlib_hash(patch, patch_size);
+    record.time = (int64_t)time(0);
+    snprintf(record.name, sizeof(record.name), "%s", name);
+    bool ok = _patchlib_file_append(lib->data.handle, patch, patch_size);
+    if (ok && thumbnail) {
+        record.thumbnail_offset = data_size + (uint64_t)patch_size;
+        record.thumbnail_size = (uint32_t)thumbnail_size;
+        ok = _patchlib_file_append(lib->data.handle, thumbnail, thumbnail_size);
+    }
+    ok = ok && _patchlib_file_append(lib->index.handle, &record, (int)sizeof(record));
+    if (!ok) {
+        // undo what was written, a partly written record would shift the records after it
+        _patchlib_truncate(lib, true, index_end);
+        _patchlib_truncate(lib, false, data_size);
+    }
+    if (!_patchlib_remap(lib, false) || !_patchlib_remap(lib, true)) {
+        // with nothing mapped the library has no patches, and further adds fail
+        _patchlib_unmap_file(lib, false);
+        _patchlib_unmap_file(lib, true);
+        _patchlib_fail(lib, "cannot map", lib->path);
+        return -1;
+    }
+    if (!ok) {
+        _patchlib_fail(lib, "cannot write", lib->path);
+        return -1;
+    }
+    return lib->num_records - 1;
+}
+
+#endif
@@ -0,0 +1,1518 @@
+#pragma once
+/*
+    Reference C64 player: 6502 code that plays a patch exactly like
+    sequencer_advance() and sequencer_update_sid().
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    Include the following headers before including player6502.h:
+        - chips/chips_common.h
+        - chips/m6581.h
+        - sequencer.h
+        - asm6502.h
+
+    player_build() generates the assembler source of the player with the
+    patch attached as packed data (the payload of the binary patch format)
+    and assembles it. The source can be saved and assembled with a regular
+    6502 assembler, player_prg() returns a C64 program file.
+
+    Memory layout, starting at the load address:
+
+        load+0      jsr to init once, before the first play
+        load+3      jsr to play once per sequencer frame (60 Hz in the app)
+        ...         code, frequency table and packed patch data
+        ...         working memory up to player_t.bss_end (not in the file)
+
+    The player uses PLAYER_ZP_SIZE bytes of zero page from desc.zp_addr.
+    The code is generic: init unpacks the patch into parameter records
+    and play interprets them, so its cost depends on the patch. Only
+    variables A..Z are supported, player_build() fails on other ones.
+
+    Frequencies are computed with the integer algorithm and table of
+    sequencer_sid_freq(), so the register values match the sequencer
+    bit for bit.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PLAYER_DEFAULT_LOAD_ADDR (0x1000)
+#define PLAYER_DEFAULT_ZP_ADDR (0x02)
+#define PLAYER_DEFAULT_SID_ADDR (0xD400)
+#define PLAYER_ZP_SIZE (86)
+#define PLAYER_MAX_SOURCE_SIZE (96 * 1024)
+
+typedef struct {
+    uint16_t load_addr;     // default PLAYER_DEFAULT_LOAD_ADDR
+    uint8_t zp_addr;        // first zero page byte used, default PLAYER_DEFAULT_ZP_ADDR
+    uint16_t sid_addr;      // default PLAYER_DEFAULT_SID_ADDR
+} player_desc_t;
+
+typedef struct {
+    asm6502_t as;           // assembled player, file content is as.mem[as.start..as.end)
+    uint16_t init_addr;
+    uint16_t play_addr;
+    int bss_end;            // end of the working memory
+    uint8_t zp_addr;
+    const char* error;      // error message if player_build() failed
+    char error_buf[128];
+    int source_size;
+    char source[PLAYER_MAX_SOURCE_SIZE];    // generated assembler source
+} player_t;
+
+// generate and assemble a player for the current patch
+bool player_build(player_t* player, sequencer_t* sequencer, const player_desc_t* desc);
+// write a C64 program file (load address followed by the player), returns the size or 0 if the buffer is too small
+int player_prg(const player_t* player, uint8_t* buffer, int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+static const char* player_source_code =
+    "; zero page\n"
+    "vlo     = zp            ; variable values A..Z, low bytes\n"
+    "vhi     = zp+26         ; high bytes\n"
+    "acc     = zp+52         ; result of eval\n"
+    "rec     = zp+54         ; parameter record pointer for eval\n"
+    "seqp    = zp+56         ; record of the current sequence\n"
+    "val     = zp+58         ; value of the current sequence\n"
+    "num     = zp+60         ; dividend/quotient, multiplicand/product\n"
+    "den     = zp+62         ; divisor, multiplier\n"
+    "rem     = zp+64         ; remainder\n"
+    "tmp     = zp+66\n"
+    "sum     = zp+68\n"
+    "ptr     = zp+70\n"
+    "oct     = zp+72         ; octave of the frequency\n"
+    "cents   = zp+74         ; cents within the octave\n"
+    "fval    = zp+76         ; 3 bytes, frequency table value\n"
+    "sgn     = zp+79\n"
+    "sgn2    = zp+80\n"
+    "svar    = zp+81         ; variable index of the current sequence\n"
+    "seqi    = zp+82         ; index of the current sequence\n"
+    "chn     = zp+83         ; SID channel\n"
+    "filt    = zp+84         ; filter routing bits\n"
+    "fingers = zp+85         ; number of notes in the scale\n"
+    "zp_end  = zp+86\n"
+    "\n"
+    "; only used by init\n"
+    "mptr    = seqp          ; type mask\n"
+    "optr    = val           ; operands\n"
+    "cnt     = sum           ; parameters left\n"
+    "mbits   = sgn\n"
+    "mleft   = fingers\n"
+    "\n"
+    "var_t   = 19            ; frame number\n"
+    "var_u   = 20            ; gate times U,V,W\n"
+    "var_x   = 23            ; gate counts X,Y,Z\n"
+    "\n"
+    "        jmp init\n"
+    "        jmp play\n"
+    "\n"
+    ";----------------------------------------------------------------------------\n"
+    "; init: unpack the patch into parameter records, reset all state\n"
+    ";\n"
+    "; A record has 3 bytes per parameter: the variable index, or $ff for a\n"
+    "; number followed by the number (lo, hi). Records are in the order of the\n"
+    "; patch data: voices (14 parameters each), channel voices, filter mode,\n"
+    "; cutoff, resonance, volume, sequences (11 each) and array elements.\n"
+    "init:\n"
+    "        lda #0\n"
+    "        ldx #zp_end-zp-1\n"
+    "init_zp:\n"
+    "        sta zp,x\n"
+    "        dex\n"
+    "        bpl init_zp\n"
+    "        ldx #9\n"
+    "init_state:\n"
+    "        sta gstate,x            ; gate states, control shadows, frame, scale\n"
+    "        dex\n"
+    "        bpl init_state\n"
+    "        lda patch\n"
+    "        sta nvoices\n"
+    "        lda patch+1\n"
+    "        sta nseq\n"
+    "        lda patch+2\n"
+    "        sta narrays\n"
+    "        ldx #0\n"
+    "init_asize:\n"
+    "        cpx narrays\n"
+    "        beq init_asize_done\n"
+    "        lda patch+3,x\n"
+    "        sta asize,x\n"
+    "        inx\n"
+    "        bne init_asize\n"
+    "init_asize_done:\n"
+    "        txa\n"
+    "        clc\n"
+    "        adc #<patch+3\n"
+    "        sta ptr\n"
+    "        lda #>patch+3\n"
+    "        adc #0\n"
+    "        sta ptr+1\n"
+    "        ldy #0\n"
+    "init_svars:\n"
+    "        cpy nseq\n"
+    "        beq init_svars_done\n"
+    "        lda (ptr),y\n"
+    "        sec\n"
+    "        sbc #'A'\n"
+    "        bcs init_svar_store\n"
+    "        lda #$ff                ; inactive sequence\n"
+    "init_svar_store:\n"
+    "        sta svars,y\n"
+    "        iny\n"
+    "        bne init_svars\n"
+    "init_svars_done:\n"
+    "        tya\n"
+    "        clc\n"
+    "        adc ptr\n"
+    "        sta mptr\n"
+    "        lda ptr+1\n"
+    "        adc #0\n"
+    "        sta mptr+1\n"
+    "        ; number of parameters\n"
+    "        lda #7\n"
+    "        sta cnt\n"
+    "        lda #0\n"
+    "        sta cnt+1\n"
+    "        ldx nvoices\n"
+    "        beq init_count_sequences\n"
+    "init_count_voices:\n"
+    "        lda #14\n"
+    "        jsr add_cnt\n"
+    "        dex\n"
+    "        bne init_count_voices\n"
+    "init_count_sequences:\n"
+    "        ldx nseq\n"
+    "        beq init_count_arrays\n"
+    "init_count_sequences_loop:\n"
+    "        lda #11\n"
+    "        jsr add_cnt\n"
+    "        dex\n"
+    "        bne init_count_sequences_loop\n"
+    "init_count_arrays:\n"
+    "        ldx narrays\n"
+    "        beq init_count_done\n"
+    "init_count_arrays_loop:\n"
+    "        lda asize-1,x\n"
+    "        jsr add_cnt\n"
+    "        dex\n"
+    "        bne init_count_arrays_loop\n"
+    "init_count_done:\n"
+    "        ; operands follow the type mask of (cnt+7)/8 bytes\n"
+    "        lda cnt\n"
+    "        clc\n"
+    "        adc #7\n"
+    "        sta tmp\n"
+    "        lda cnt+1\n"
+    "        adc #0\n"
+    "        lsr a\n"
+    "        ror tmp\n"
+    "        lsr a\n"
+    "        ror tmp\n"
+    "        lsr a\n"
+    "        ror tmp\n"
+    "        sta tmp+1\n"
+    "        lda mptr\n"
+    "        clc\n"
+    "        adc tmp\n"
+    "        sta optr\n"
+    "        lda mptr+1\n"
+    "        adc tmp+1\n"
+    "        sta optr+1\n"
+    "        lda #<records\n"
+    "        sta ptr\n"
+    "        lda #>records\n"
+    "        sta ptr+1\n"
+    "        lda #0\n"
+    "        sta mleft\n"
+    "init_unpack:\n"
+    "        lda cnt\n"
+    "        ora cnt+1\n"
+    "        beq init_pointers\n"
+    "        lda mleft\n"
+    "        bne init_unpack_type\n"
+    "        ldy #0\n"
+    "        lda (mptr),y\n"
+    "        sta mbits\n"
+    "        inc mptr\n"
+    "        bne init_mask_next\n"
+    "        inc mptr+1\n"
+    "init_mask_next:\n"
+    "        lda #8\n"
+    "        sta mleft\n"
+    "init_unpack_type:\n"
+    "        dec mleft\n"
+    "        ldy #0\n"
+    "        lsr mbits\n"
+    "        bcc init_unpack_number\n"
+    "        lda (optr),y\n"
+    "        sec\n"
+    "        sbc #'A'\n"
+    "        sta (ptr),y\n"
+    "        jmp init_unpack_next\n"
+    "init_unpack_number:\n"
+    "        lda #$ff\n"
+    "        sta (ptr),y\n"
+    "        lda (optr),y\n"
+    "        iny\n"
+    "        sta (ptr),y\n"
+    "        lda (optr),y\n"
+    "        iny\n"
+    "        sta (ptr),y\n"
+    "init_unpack_next:\n"
+    "        lda #3\n"
+    "        jsr add_ptr\n"
+    "        lda optr\n"
+    "        clc\n"
+    "        adc #2\n"
+    "        sta optr\n"
+    "        bcc init_optr_next\n"
+    "        inc optr+1\n"
+    "init_optr_next:\n"
+    "        lda cnt\n"
+    "        bne init_cnt_next\n"
+    "        dec cnt+1\n"
+    "init_cnt_next:\n"
+    "        dec cnt\n"
+    "        jmp init_unpack\n"
+    "init_pointers:\n"
+    "        lda #<records\n"
+    "        sta ptr\n"
+    "        lda #>records\n"
+    "        sta ptr+1\n"
+    "        ldx #0\n"
+    "init_voices:\n"
+    "        cpx nvoices\n"
+    "        beq init_unused_voices\n"
+    "        lda ptr\n"
+    "        sta vptrlo,x\n"
+    "        lda ptr+1\n"
+    "        sta vptrhi,x\n"
+    "        lda #14*3\n"
+    "        jsr add_ptr\n"
+    "        inx\n"
+    "        bne init_voices\n"
+    "init_unused_voices:\n"
+    "        cpx #16\n"
+    "        beq init_globals\n"
+    "        lda #<zero_record       ; gate of an unused voice is 0\n"
+    "        sta vptrlo,x\n"
+    "        lda #>zero_record\n"
+    "        sta vptrhi,x\n"
+    "        inx\n"
+    "        bne init_unused_voices\n"
+    "init_globals:\n"
+    "        lda ptr\n"
+    "        sta gptr\n"
+    "        lda ptr+1\n"
+    "        sta gptr+1\n"
+    "        lda #7*3\n"
+    "        jsr add_ptr\n"
+    "        lda ptr\n"
+    "        sta sbase\n"
+    "        lda ptr+1\n"
+    "        sta sbase+1\n"
+    "        ldx nseq\n"
+    "        beq init_arrays\n"
+    "init_sequences:\n"
+    "        lda #11*3\n"
+    "        jsr add_ptr\n"
+    "        dex\n"
+    "        bne init_sequences\n"
+    "init_arrays:\n"
+    "        ldx #0\n"
+    "init_arrays_loop:\n"
+    "        cpx narrays\n"
+    "        beq init_done\n"
+    "        lda ptr\n"
+    "        sta aptrlo,x\n"
+    "        lda ptr+1\n"
+    "        sta aptrhi,x\n"
+    "        lda asize,x\n"
+    "        jsr add_ptr\n"
+    "        lda asize,x\n"
+    "        jsr add_ptr\n"
+    "        lda asize,x\n"
+    "        jsr add_ptr\n"
+    "        inx\n"
+    "        bne init_arrays_loop\n"
+    "init_done:\n"
+    "        rts\n"
+    "\n"
+    "add_cnt:\n"
+    "        clc\n"
+    "        adc cnt\n"
+    "        sta cnt\n"
+    "        bcc add_cnt_done\n"
+    "        inc cnt+1\n"
+    "add_cnt_done:\n"
+    "        rts\n"
+    "\n"
+    "add_ptr:\n"
+    "        clc\n"
+    "        adc ptr\n"
+    "        sta ptr\n"
+    "        bcc add_ptr_done\n"
+    "        inc ptr+1\n"
+    "add_ptr_done:\n"
+    "        rts\n"
+    "\n"
+    ";----------------------------------------------------------------------------\n"
+    "; play: advance one sequencer frame and write the SID registers\n"
+    "play:\n"
+    "        jsr update_variables\n"
+    "        inc frame\n"
+    "        bne play_sid\n"
+    "        inc frame+1\n"
+    "play_sid:\n"
+    "        jmp update_sid\n"
+    "\n"
+    ";----------------------------------------------------------------------------\n"
+    "update_variables:\n"
+    "        ; gate times count while the frame number increases by one,\n"
+    "        ; otherwise gate times and counts are reset\n"
+    "        lda vlo+var_t\n"
+    "        clc\n"
+    "        adc #1\n"
+    "        tax\n"
+    "        lda vhi+var_t\n"
+    "        adc #0\n"
+    "        bvs uv_reset\n"
+    "        cmp frame+1\n"
+    "        bne uv_reset\n"
+    "        cpx frame\n"
+    "        bne uv_reset\n"
+    "        ldx #2\n"
+    "uv_count:\n"
+    "        inc vlo+var_u,x\n"
+    "        bne uv_count_next\n"
+    "        inc vhi+var_u,x\n"
+    "uv_count_next:\n"
+    "        dex\n"
+    "        bpl uv_count\n"
+    "        bmi uv_frame\n"
+    "uv_reset:\n"
+    "        lda #0\n"
+    "        ldx #5\n"
+    "uv_reset_loop:\n"
+    "        sta vlo+var_u,x\n"
+    "        sta vhi+var_u,x\n"
+    "        dex\n"
+    "        bpl uv_reset_loop\n"
+    "uv_frame:\n"
+    "        lda frame\n"
+    "        sta vlo+var_t\n"
+    "        lda frame+1\n"
+    "        sta vhi+var_t\n"
+    "        ; sequences\n"
+    "        lda sbase\n"
+    "        sta seqp\n"
+    "        lda sbase+1\n"
+    "        sta seqp+1\n"
+    "        ldx #0\n"
+    "        stx seqi\n"
+    "uv_sequence:\n"
+    "        cpx nseq\n"
+    "        beq uv_done\n"
+    "        lda svars,x\n"
+    "        bmi uv_sequence_next\n"
+    "        sta svar\n"
+    "        jsr update_sequence\n"
+    "uv_sequence_next:\n"
+    "        lda seqp\n"
+    "        clc\n"
+    "        adc #11*3\n"
+    "        sta seqp\n"
+    "        bcc uv_sequence_ptr\n"
+    "        inc seqp+1\n"
+    "uv_sequence_ptr:\n"
+    "        inc seqi\n"
+    "        ldx seqi\n"
+    "        jmp uv_sequence\n"
+    "uv_done:\n"
+    "        rts\n"
+    "\n"
+    "update_sequence:\n"
+    "        lda seqp\n"
+    "        sta rec\n"
+    "        lda seqp+1\n"
+    "        sta rec+1\n"
+    "        ldy #0                  ; count\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        sta val\n"
+    "        lda acc+1\n"
+    "        sta val+1\n"
+    "        ldy #1*3                ; add1\n"
+    "        jsr eval\n"
+    "        jsr add_acc\n"
+    "        ldy #2*3                ; div1\n"
+    "        jsr eval\n"
+    "        jsr div_acc\n"
+    "        ldy #3*3                ; mul1\n"
+    "        jsr eval\n"
+    "        jsr mul_acc\n"
+    "        ldy #4*3                ; mod1\n"
+    "        jsr eval\n"
+    "        jsr mod_acc\n"
+    "        ldy #5*3                ; base\n"
+    "        jsr eval\n"
+    "        jsr sum_digits\n"
+    "        ldy #6*3                ; mod2\n"
+    "        jsr eval\n"
+    "        jsr mod_acc\n"
+    "        ldy #7*3                ; mul2\n"
+    "        jsr eval\n"
+    "        jsr mul_acc\n"
+    "        ldy #8*3                ; div2\n"
+    "        jsr eval\n"
+    "        jsr div_acc\n"
+    "        ldy #9*3                ; add2\n"
+    "        jsr eval\n"
+    "        jsr add_acc\n"
+    "        ldy #10*3               ; array\n"
+    "        jsr eval\n"
+    "        jsr lookup\n"
+    "        ; update the gate state of channels whose voice or gate is this variable\n"
+    "        lda #0\n"
+    "        sta chn\n"
+    "us_gate:\n"
+    "        lda gptr\n"
+    "        sta rec\n"
+    "        lda gptr+1\n"
+    "        sta rec+1\n"
+    "        lda chn\n"
+    "        asl a\n"
+    "        adc chn\n"
+    "        tay\n"
+    "        lda (rec),y\n"
+    "        cmp svar\n"
+    "        beq us_gate_update\n"
+    "        jsr eval\n"
+    "        jsr voice_index\n"
+    "        bcs us_gate_next\n"
+    "        lda vptrlo,x\n"
+    "        sta rec\n"
+    "        lda vptrhi,x\n"
+    "        sta rec+1\n"
+    "        ldy #0\n"
+    "        lda (rec),y\n"
+    "        cmp svar\n"
+    "        bne us_gate_next\n"
+    "us_gate_update:\n"
+    "        jsr update_gate\n"
+    "us_gate_next:\n"
+    "        inc chn\n"
+    "        lda chn\n"
+    "        cmp #3\n"
+    "        bne us_gate\n"
+    "        ; store the new value\n"
+    "        ldx svar\n"
+    "        lda val\n"
+    "        sta vlo,x\n"
+    "        lda val+1\n"
+    "        sta vhi,x\n"
+    "        rts\n"
+    "\n"
+    "; channel chn: on a rising gate reset the gate time and count the gate\n"
+    "update_gate:\n"
+    "        lda gptr\n"
+    "        sta rec\n"
+    "        lda gptr+1\n"
+    "        sta rec+1\n"
+    "        lda chn\n"
+    "        asl a\n"
+    "        adc chn\n"
+    "        tay\n"
+    "        jsr eval\n"
+    "        jsr voice_index\n"
+    "        lda #0\n"
+    "        bcs ug_state\n"
+    "        lda vptrlo,x\n"
+    "        sta rec\n"
+    "        lda vptrhi,x\n"
+    "        sta rec+1\n"
+    "        ldy #0\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        and #1\n"
+    "ug_state:\n"
+    "        ldx chn\n"
+    "        cmp gstate,x\n"
+    "        beq ug_done\n"
+    "        sta gstate,x\n"
+    "        tay\n"
+    "        beq ug_done\n"
+    "        lda #0\n"
+    "        sta vlo+var_u,x\n"
+    "        sta vhi+var_u,x\n"
+    "        inc vlo+var_x,x\n"
+    "        bne ug_done\n"
+    "        inc vhi+var_x,x\n"
+    "ug_done:\n"
+    "        rts\n"
+    "\n"
+    "; acc is a voice number 1..16: x = voice index and carry clear, else carry set\n"
+    "voice_index:\n"
+    "        lda acc+1\n"
+    "        bne voice_index_invalid\n"
+    "        ldx acc\n"
+    "        dex\n"
+    "        cpx #16\n"
+    "        rts\n"
+    "voice_index_invalid:\n"
+    "        sec\n"
+    "        rts\n"
+    "\n"
+    "; acc = parameter at offset y of the record at rec\n"
+    "eval:\n"
+    "        lda (rec),y\n"
+    "        bmi eval_number\n"
+    "        tax\n"
+    "        lda vlo,x\n"
+    "        sta acc\n"
+    "        lda vhi,x\n"
+    "        sta acc+1\n"
+    "        rts\n"
+    "eval_number:\n"
+    "        iny\n"
+    "        lda (rec),y\n"
+    "        sta acc\n"
+    "        iny\n"
+    "        lda (rec),y\n"
+    "        sta acc+1\n"
+    "        rts\n"
+    "\n"
+    "load_operands:\n"
+    "        lda val\n"
+    "        sta num\n"
+    "        lda val+1\n"
+    "        sta num+1\n"
+    "        lda acc\n"
+    "        sta den\n"
+    "        lda acc+1\n"
+    "        sta den+1\n"
+    "        rts\n"
+    "\n"
+    "add_acc:\n"
+    "        lda val\n"
+    "        clc\n"
+    "        adc acc\n"
+    "        sta val\n"
+    "        lda val+1\n"
+    "        adc acc+1\n"
+    "        sta val+1\n"
+    "        rts\n"
+    "\n"
+    "div_acc:\n"
+    "        lda acc\n"
+    "        ora acc+1\n"
+    "        beq div_acc_done\n"
+    "        jsr load_operands\n"
+    "        jsr sdiv\n"
+    "        lda num\n"
+    "        sta val\n"
+    "        lda num+1\n"
+    "        sta val+1\n"
+    "div_acc_done:\n"
+    "        rts\n"
+    "\n"
+    "mul_acc:\n"
+    "        lda acc\n"
+    "        ora acc+1\n"
+    "        beq mul_acc_done\n"
+    "        jsr load_operands\n"
+    "        jsr mul\n"
+    "        lda num\n"
+    "        sta val\n"
+    "        lda num+1\n"
+    "        sta val+1\n"
+    "mul_acc_done:\n"
+    "        rts\n"
+    "\n"
+    "mod_acc:\n"
+    "        lda acc\n"
+    "        ora acc+1\n"
+    "        beq mod_acc_done\n"
+    "        jsr load_operands\n"
+    "        jsr fmod\n"
+    "        lda rem\n"
+    "        sta val\n"
+    "        lda rem+1\n"
+    "        sta val+1\n"
+    "mod_acc_done:\n"
+    "        rts\n"
+    "\n"
+    "; val = sum of the digits of val in base acc, if acc > 1\n"
+    "sum_digits:\n"
+    "        lda acc+1\n"
+    "        bmi sd_done\n"
+    "        bne sd_start\n"
+    "        lda acc\n"
+    "        cmp #2\n"
+    "        bcc sd_done\n"
+    "sd_start:\n"
+    "        lda acc\n"
+    "        sta den\n"
+    "        lda acc+1\n"
+    "        sta den+1\n"
+    "        lda val\n"
+    "        sta num\n"
+    "        lda val+1\n"
+    "        sta num+1\n"
+    "        sta sgn2\n"
+    "        bpl sd_positive\n"
+    "        jsr neg_num\n"
+    "sd_positive:\n"
+    "        lda #0\n"
+    "        sta sum\n"
+    "        sta sum+1\n"
+    "sd_loop:\n"
+    "        lda num\n"
+    "        ora num+1\n"
+    "        beq sd_store\n"
+    "        jsr udiv\n"
+    "        bit sgn2\n"
+    "        bpl sd_add\n"
+    "        ; digits of a negative value are floor modulo\n"
+    "        lda rem\n"
+    "        ora rem+1\n"
+    "        beq sd_add\n"
+    "        sec\n"
+    "        lda den\n"
+    "        sbc rem\n"
+    "        sta rem\n"
+    "        lda den+1\n"
+    "        sbc rem+1\n"
+    "        sta rem+1\n"
+    "sd_add:\n"
+    "        clc\n"
+    "        lda sum\n"
+    "        adc rem\n"
+    "        sta sum\n"
+    "        lda sum+1\n"
+    "        adc rem+1\n"
+    "        sta sum+1\n"
+    "        jmp sd_loop\n"
+    "sd_store:\n"
+    "        lda sum\n"
+    "        sta val\n"
+    "        lda sum+1\n"
+    "        sta val+1\n"
+    "sd_done:\n"
+    "        rts\n"
+    "\n"
+    "; val = element floor_mod(val, size) of array acc (1-based), if it exists\n"
+    "lookup:\n"
+    "        lda acc+1\n"
+    "        bne lookup_done\n"
+    "        ldx acc\n"
+    "        beq lookup_done\n"
+    "        cpx narrays\n"
+    "        beq lookup_array\n"
+    "        bcs lookup_done\n"
+    "lookup_array:\n"
+    "        dex\n"
+    "        lda asize,x\n"
+    "        beq lookup_done\n"
+    "        sta den\n"
+    "        lda #0\n"
+    "        sta den+1\n"
+    "        lda aptrlo,x\n"
+    "        sta rec\n"
+    "        lda aptrhi,x\n"
+    "        sta rec+1\n"
+    "        lda val\n"
+    "        sta num\n"
+    "        lda val+1\n"
+    "        sta num+1\n"
+    "        jsr floordiv\n"
+    "        lda rem\n"
+    "        asl a\n"
+    "        adc rem\n"
+    "        tay\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        sta val\n"
+    "        lda acc+1\n"
+    "        sta val+1\n"
+    "lookup_done:\n"
+    "        rts\n"
+    "\n"
+    ";----------------------------------------------------------------------------\n"
+    "; 16 bit arithmetic\n"
+    "\n"
+    "; num = num / den, rem = num % den, unsigned, den <= $8000\n"
+    "udiv:\n"
+    "        ldx #16\n"
+    "        lda num+1\n"
+    "        bne udiv_divisor\n"
+    "        ; high byte is 0, only divide the low byte\n"
+    "        lda num\n"
+    "        beq udiv_zero\n"
+    "        sta num+1\n"
+    "        lda #0\n"
+    "        sta num\n"
+    "        ldx #8\n"
+    "udiv_divisor:\n"
+    "        lda den+1\n"
+    "        bne udiv_wide\n"
+    "        ; divisor below 256, the remainder is kept in a\n"
+    "        lda #0\n"
+    "udiv_narrow_loop:\n"
+    "        asl num\n"
+    "        rol num+1\n"
+    "        rol a\n"
+    "        bcs udiv_narrow_sub\n"
+    "        cmp den\n"
+    "        bcc udiv_narrow_next\n"
+    "udiv_narrow_sub:\n"
+    "        sbc den\n"
+    "        inc num\n"
+    "udiv_narrow_next:\n"
+    "        dex\n"
+    "        bne udiv_narrow_loop\n"
+    "        sta rem\n"
+    "        lda #0\n"
+    "        sta rem+1\n"
+    "        rts\n"
+    "udiv_zero:\n"
+    "        sta rem\n"
+    "        sta rem+1\n"
+    "        rts\n"
+    "udiv_wide:\n"
+    "        lda #0\n"
+    "        sta rem\n"
+    "        sta rem+1\n"
+    "udiv_loop:\n"
+    "        asl num\n"
+    "        rol num+1\n"
+    "        rol rem\n"
+    "        rol rem+1\n"
+    "        lda rem\n"
+    "        sec\n"
+    "        sbc den\n"
+    "        tay\n"
+    "        lda rem+1\n"
+    "        sbc den+1\n"
+    "        bcc udiv_next\n"
+    "        sta rem+1\n"
+    "        sty rem\n"
+    "        inc num\n"
+    "udiv_next:\n"
+    "        dex\n"
+    "        bne udiv_loop\n"
+    "        rts\n"
+    "\n"
+    "; num = floor(num / den), rem = num - num*den, signed num, unsigned den > 0\n"
+    "floordiv:\n"
+    "        lda num+1\n"
+    "        sta sgn\n"
+    "        bpl floordiv_div\n"
+    "        jsr not_num\n"
+    "floordiv_div:\n"
+    "        jsr udiv\n"
+    "        bit sgn\n"
+    "        bpl floordiv_done\n"
+    "        ; floor(v/d) = ~(~v/d), floor remainder = d-1-(~v%d)\n"
+    "        jsr not_num\n"
+    "        clc\n"
+    "        lda den\n"
+    "        sbc rem\n"
+    "        sta rem\n"
+    "        lda den+1\n"
+    "        sbc rem+1\n"
+    "        sta rem+1\n"
+    "floordiv_done:\n"
+    "        rts\n"
+    "\n"
+    "; rem = floor_mod(num, den), den != 0\n"
+    "fmod:\n"
+    "        lda den+1\n"
+    "        sta sgn2\n"
+    "        bpl fmod_div\n"
+    "        jsr neg_den\n"
+    "fmod_div:\n"
+    "        jsr floordiv\n"
+    "        bit sgn2\n"
+    "        bpl fmod_done\n"
+    "        clc\n"
+    "        lda den\n"
+    "        sbc rem\n"
+    "        sta rem\n"
+    "        lda den+1\n"
+    "        sbc rem+1\n"
+    "        sta rem+1\n"
+    "fmod_done:\n"
+    "        rts\n"
+    "\n"
+    "; num = num / den, signed, truncated, den != 0\n"
+    "sdiv:\n"
+    "        lda num+1\n"
+    "        eor den+1\n"
+    "        sta sgn\n"
+    "        lda num+1\n"
+    "        bpl sdiv_den\n"
+    "        jsr neg_num\n"
+    "sdiv_den:\n"
+    "        lda den+1\n"
+    "        bpl sdiv_div\n"
+    "        jsr neg_den\n"
+    "sdiv_div:\n"
+    "        jsr udiv\n"
+    "        bit sgn\n"
+    "        bpl sdiv_done\n"
+    "        jsr neg_num\n"
+    "sdiv_done:\n"
+    "        rts\n"
+    "\n"
+    "; num = num * den, low 16 bits\n"
+    "mul:\n"
+    "        lda #0\n"
+    "        sta tmp\n"
+    "        sta tmp+1\n"
+    "mul_loop:\n"
+    "        lda den\n"
+    "        ora den+1\n"
+    "        beq mul_done\n"
+    "        lsr den+1\n"
+    "        ror den\n"
+    "        bcc mul_shift\n"
+    "        lda tmp\n"
+    "        clc\n"
+    "        adc num\n"
+    "        sta tmp\n"
+    "        lda tmp+1\n"
+    "        adc num+1\n"
+    "        sta tmp+1\n"
+    "mul_shift:\n"
+    "        asl num\n"
+    "        rol num+1\n"
+    "        jmp mul_loop\n"
+    "mul_done:\n"
+    "        lda tmp\n"
+    "        sta num\n"
+    "        lda tmp+1\n"
+    "        sta num+1\n"
+    "        rts\n"
+    "\n"
+    "not_num:\n"
+    "        lda num\n"
+    "        eor #$ff\n"
+    "        sta num\n"
+    "        lda num+1\n"
+    "        eor #$ff\n"
+    "        sta num+1\n"
+    "        rts\n"
+    "\n"
+    "neg_num:\n"
+    "        sec\n"
+    "        lda #0\n"
+    "        sbc num\n"
+    "        sta num\n"
+    "        lda #0\n"
+    "        sbc num+1\n"
+    "        sta num+1\n"
+    "        rts\n"
+    "\n"
+    "neg_den:\n"
+    "        sec\n"
+    "        lda #0\n"
+    "        sbc den\n"
+    "        sta den\n"
+    "        lda #0\n"
+    "        sbc den+1\n"
+    "        sta den+1\n"
+    "        rts\n"
+    "\n"
+    ";----------------------------------------------------------------------------\n"
+    "update_sid:\n"
+    "        lda #0\n"
+    "        sta chn\n"
+    "        sta filt\n"
+    "sid_channel:\n"
+    "        lda gptr\n"
+    "        sta rec\n"
+    "        lda gptr+1\n"
+    "        sta rec+1\n"
+    "        lda chn\n"
+    "        asl a\n"
+    "        adc chn\n"
+    "        tay\n"
+    "        jsr eval\n"
+    "        ; voice number must be 1..nvoices\n"
+    "        lda acc+1\n"
+    "        bne sid_no_voice\n"
+    "        ldx acc\n"
+    "        beq sid_no_voice\n"
+    "        cpx nvoices\n"
+    "        beq sid_on\n"
+    "        bcc sid_on\n"
+    "sid_no_voice:\n"
+    "        jmp sid_off\n"
+    "sid_on:\n"
+    "        dex\n"
+    "        lda vptrlo,x\n"
+    "        sta rec\n"
+    "        lda vptrhi,x\n"
+    "        sta rec+1\n"
+    "        ; control: waveform, ring, sync, gate\n"
+    "        ldy #5*3\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        asl a\n"
+    "        asl a\n"
+    "        asl a\n"
+    "        asl a\n"
+    "        sta tmp\n"
+    "        ldy #7*3\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        and #1\n"
+    "        asl a\n"
+    "        asl a\n"
+    "        ora tmp\n"
+    "        sta tmp\n"
+    "        ldy #8*3\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        and #1\n"
+    "        asl a\n"
+    "        ora tmp\n"
+    "        sta tmp\n"
+    "        ldy #0\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        and #1\n"
+    "        ora tmp\n"
+    "        ldx chn\n"
+    "        sta ctrl,x\n"
+    "        ldy sid_offsets,x\n"
+    "        sta sid+4,y\n"
+    "        ; frequency\n"
+    "        jsr voice_freq\n"
+    "        ldx chn\n"
+    "        ldy sid_offsets,x\n"
+    "        lda num\n"
+    "        sta sid,y\n"
+    "        lda num+1\n"
+    "        sta sid+1,y\n"
+    "        ; pulse width\n"
+    "        ldy #6*3\n"
+    "        jsr eval\n"
+    "        ldx chn\n"
+    "        ldy sid_offsets,x\n"
+    "        lda acc\n"
+    "        sta sid+2,y\n"
+    "        lda acc+1\n"
+    "        sta sid+3,y\n"
+    "        ; attack, decay\n"
+    "        ldy #9*3\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        asl a\n"
+    "        asl a\n"
+    "        asl a\n"
+    "        asl a\n"
+    "        sta tmp\n"
+    "        ldy #10*3\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        and #15\n"
+    "        ora tmp\n"
+    "        ldx chn\n"
+    "        ldy sid_offsets,x\n"
+    "        sta sid+5,y\n"
+    "        ; sustain, release\n"
+    "        ldy #11*3\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        asl a\n"
+    "        asl a\n"
+    "        asl a\n"
+    "        asl a\n"
+    "        sta tmp\n"
+    "        ldy #12*3\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        and #15\n"
+    "        ora tmp\n"
+    "        ldx chn\n"
+    "        ldy sid_offsets,x\n"
+    "        sta sid+6,y\n"
+    "        ; filter routing\n"
+    "        ldy #13*3\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        and #1\n"
+    "        beq sid_next\n"
+    "        ldx chn\n"
+    "        lda filt\n"
+    "        ora filter_bits,x\n"
+    "        sta filt\n"
+    "        jmp sid_next\n"
+    "sid_off:\n"
+    "        ; no voice: close the gate, keep the other control bits\n"
+    "        ldx chn\n"
+    "        lda ctrl,x\n"
+    "        and #$fe\n"
+    "        sta ctrl,x\n"
+    "        ldy sid_offsets,x\n"
+    "        sta sid+4,y\n"
+    "sid_next:\n"
+    "        inc chn\n"
+    "        lda chn\n"
+    "        cmp #3\n"
+    "        beq sid_filter\n"
+    "        jmp sid_channel\n"
+    "sid_filter:\n"
+    "        lda gptr\n"
+    "        sta rec\n"
+    "        lda gptr+1\n"
+    "        sta rec+1\n"
+    "        ; cutoff, bits 0-2 and 3-10\n"
+    "        ldy #4*3\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        and #7\n"
+    "        sta sid+$15\n"
+    "        lda acc+1\n"
+    "        sta tmp\n"
+    "        lda acc\n"
+    "        lsr tmp\n"
+    "        ror a\n"
+    "        lsr tmp\n"
+    "        ror a\n"
+    "        lsr tmp\n"
+    "        ror a\n"
+    "        sta sid+$16\n"
+    "        ; resonance, filter routing\n"
+    "        ldy #5*3\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        asl a\n"
+    "        asl a\n"
+    "        asl a\n"
+    "        asl a\n"
+    "        ora filt\n"
+    "        sta sid+$17\n"
+    "        ; filter mode, volume\n"
+    "        ldy #3*3\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        asl a\n"
+    "        asl a\n"
+    "        asl a\n"
+    "        asl a\n"
+    "        sta tmp\n"
+    "        ldy #6*3\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        and #15\n"
+    "        ora tmp\n"
+    "        sta sid+$18\n"
+    "        rts\n"
+    "\n"
+    "; num = SID frequency of the voice at rec, see sequencer_sid_freq()\n"
+    "voice_freq:\n"
+    "        ; notes of the scale, 12 bits, 0 is chromatic\n"
+    "        ldy #2*3\n"
+    "        jsr eval\n"
+    "        lda acc+1\n"
+    "        and #$0f\n"
+    "        sta tmp+1\n"
+    "        ora acc\n"
+    "        bne vf_scale\n"
+    "        lda #$ff\n"
+    "        sta acc\n"
+    "        lda #$0f\n"
+    "        sta tmp+1\n"
+    "vf_scale:\n"
+    "        ; decode the scale, unless it was decoded last time\n"
+    "        lda acc\n"
+    "        sta tmp\n"
+    "        cmp scale\n"
+    "        bne vf_decode_scale\n"
+    "        lda tmp+1\n"
+    "        cmp scale+1\n"
+    "        beq vf_note\n"
+    "vf_decode_scale:\n"
+    "        lda tmp\n"
+    "        sta scale\n"
+    "        lda tmp+1\n"
+    "        sta scale+1\n"
+    "        ldx #0\n"
+    "        ldy #0\n"
+    "vf_decode:\n"
+    "        lsr tmp+1\n"
+    "        ror tmp\n"
+    "        bcc vf_decode_next\n"
+    "        tya\n"
+    "        sta fnotes,x\n"
+    "        inx\n"
+    "vf_decode_next:\n"
+    "        iny\n"
+    "        cpy #12\n"
+    "        bne vf_decode\n"
+    "        stx fingers\n"
+    "vf_note:\n"
+    "        ; octave and finger of the note\n"
+    "        ldy #1*3\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        sta num\n"
+    "        lda acc+1\n"
+    "        sta num+1\n"
+    "        lda fingers\n"
+    "        sta den\n"
+    "        lda #0\n"
+    "        sta den+1\n"
+    "        jsr floordiv\n"
+    "        ; semitone = octave*12 + note of the finger + transpose\n"
+    "        ldx rem\n"
+    "        lda fnotes,x\n"
+    "        sta sum\n"
+    "        lda #0\n"
+    "        sta sum+1\n"
+    "        asl num\n"
+    "        rol num+1\n"
+    "        asl num\n"
+    "        rol num+1\n"
+    "        lda num\n"
+    "        clc\n"
+    "        adc sum\n"
+    "        sta sum\n"
+    "        lda num+1\n"
+    "        adc sum+1\n"
+    "        sta sum+1\n"
+    "        asl num\n"
+    "        rol num+1\n"
+    "        lda num\n"
+    "        clc\n"
+    "        adc sum\n"
+    "        sta sum\n"
+    "        lda num+1\n"
+    "        adc sum+1\n"
+    "        sta sum+1\n"
+    "        ldy #3*3\n"
+    "        jsr eval\n"
+    "        lda sum\n"
+    "        clc\n"
+    "        adc acc\n"
+    "        sta num\n"
+    "        lda sum+1\n"
+    "        adc acc+1\n"
+    "        sta num+1\n"
+    "        ; octave and cents of the semitone\n"
+    "        lda #12\n"
+    "        sta den\n"
+    "        lda #0\n"
+    "        sta den+1\n"
+    "        jsr floordiv\n"
+    "        lda num\n"
+    "        sta oct\n"
+    "        lda num+1\n"
+    "        sta oct+1\n"
+    "        ldx rem\n"
+    "        lda cents_lo,x\n"
+    "        sta cents\n"
+    "        lda cents_hi,x\n"
+    "        sta cents+1\n"
+    "        ; add the pitch cents\n"
+    "        ldy #4*3\n"
+    "        jsr eval\n"
+    "        lda acc\n"
+    "        sta num\n"
+    "        lda acc+1\n"
+    "        sta num+1\n"
+    "        lda #<1200\n"
+    "        sta den\n"
+    "        lda #>1200\n"
+    "        sta den+1\n"
+    "        jsr floordiv\n"
+    "        lda cents\n"
+    "        clc\n"
+    "        adc rem\n"
+    "        sta cents\n"
+    "        lda cents+1\n"
+    "        adc rem+1\n"
+    "        sta cents+1\n"
+    "        lda oct\n"
+    "        clc\n"
+    "        adc num\n"
+    "        sta oct\n"
+    "        lda oct+1\n"
+    "        adc num+1\n"
+    "        sta oct+1\n"
+    "        lda cents\n"
+    "        sec\n"
+    "        sbc #<1200\n"
+    "        tax\n"
+    "        lda cents+1\n"
+    "        sbc #>1200\n"
+    "        bcc vf_table\n"
+    "        sta cents+1\n"
+    "        stx cents\n"
+    "        inc oct\n"
+    "        bne vf_table\n"
+    "        inc oct+1\n"
+    "vf_table:\n"
+    "        ; the table value is shifted by octave-8, only -23..15 give a non-zero result\n"
+    "        lda oct\n"
+    "        clc\n"
+    "        adc #15\n"
+    "        tax\n"
+    "        lda oct+1\n"
+    "        adc #0\n"
+    "        bne vf_out_of_range\n"
+    "        cpx #39\n"
+    "        bcc vf_in_range\n"
+    "vf_out_of_range:\n"
+    "        jmp vf_zero\n"
+    "vf_in_range:\n"
+    "        stx tmp\n"
+    "        lda cents\n"
+    "        sta ptr\n"
+    "        lda cents+1\n"
+    "        sta ptr+1\n"
+    "        asl ptr\n"
+    "        rol ptr+1\n"
+    "        lda ptr\n"
+    "        clc\n"
+    "        adc cents\n"
+    "        sta ptr\n"
+    "        lda ptr+1\n"
+    "        adc cents+1\n"
+    "        sta ptr+1\n"
+    "        lda ptr\n"
+    "        clc\n"
+    "        adc #<freq_table\n"
+    "        sta ptr\n"
+    "        lda ptr+1\n"
+    "        adc #>freq_table\n"
+    "        sta ptr+1\n"
+    "        ldy #0\n"
+    "        lda (ptr),y\n"
+    "        sta fval\n"
+    "        iny\n"
+    "        lda (ptr),y\n"
+    "        sta fval+1\n"
+    "        iny\n"
+    "        lda (ptr),y\n"
+    "        sta fval+2\n"
+    "        lda tmp\n"
+    "        sec\n"
+    "        sbc #23\n"
+    "        bcs vf_left\n"
+    "        eor #$ff\n"
+    "        adc #1\n"
+    "        tax\n"
+    "vf_right_bytes:\n"
+    "        cpx #8\n"
+    "        bcc vf_right\n"
+    "        lda fval+1\n"
+    "        sta fval\n"
+    "        lda fval+2\n"
+    "        sta fval+1\n"
+    "        lda #0\n"
+    "        sta fval+2\n"
+    "        txa\n"
+    "        sbc #8\n"
+    "        tax\n"
+    "        jmp vf_right_bytes\n"
+    "vf_right:\n"
+    "        cpx #0\n"
+    "        beq vf_done\n"
+    "        lsr fval+2\n"
+    "        ror fval+1\n"
+    "        ror fval\n"
+    "        dex\n"
+    "        jmp vf_right\n"
+    "vf_left:\n"
+    "        tax\n"
+    "vf_left_loop:\n"
+    "        beq vf_done\n"
+    "        asl fval\n"
+    "        rol fval+1\n"
+    "        dex\n"
+    "        jmp vf_left_loop\n"
+    "vf_done:\n"
+    "        lda fval\n"
+    "        sta num\n"
+    "        lda fval+1\n"
+    "        sta num+1\n"
+    "        rts\n"
+    "vf_zero:\n"
+    "        lda #0\n"
+    "        sta num\n"
+    "        sta num+1\n"
+    "        rts\n"
+    "\n"
+    "sid_offsets:\n"
+    "        .byte 0, 7, 14\n"
+    "filter_bits:\n"
+    "        .byte 1, 2, 4\n"
+    "cents_lo:\n"
+    "        .byte <0, <100, <200, <300, <400, <500, <600, <700, <800, <900, <1000, <1100\n"
+    "cents_hi:\n"
+    "        .byte >0, >100, >200, >300, >400, >500, >600, >700, >800, >900, >1000, >1100\n"
+    "zero_record:\n"
+    "        .byte $ff, 0, 0\n"
+;
+
+static const char* player_source_bss =
+    "; working memory, not part of the program file\n"
+    "bss     = *\n"
+    "vptrlo  = bss           ; record pointers of the voices, 16 each\n"
+    "vptrhi  = bss+16\n"
+    "aptrlo  = bss+32        ; record pointers of the arrays\n"
+    "aptrhi  = bss+48\n"
+    "asize   = bss+64        ; array sizes\n"
+    "svars   = bss+80        ; variable index per sequence, $ff if inactive\n"
+    "fnotes  = bss+144       ; notes of the scale\n"
+    "gstate  = bss+156       ; gate state per channel\n"
+    "ctrl    = bss+159       ; control register per channel\n"
+    "frame   = bss+162\n"
+    "scale   = bss+164       ; scale of fnotes\n"
+    "gptr    = bss+166       ; record of the channel voices, filter and volume\n"
+    "sbase   = bss+168       ; record of the first sequence\n"
+    "nvoices = bss+170\n"
+    "nseq    = bss+171\n"
+    "narrays = bss+172\n"
+    "records = bss+173\n"
+    "bss_end = records+num_params*3\n"
+;
+
+static bool _player_fail(player_t* player, const char* message) {
+    snprintf(player->error_buf, sizeof(player->error_buf), "%s", message);
+    player->error = player->error_buf;
+    return false;
+}
+
+static bool _player_append(player_t* player, const char* fmt, ...) {
+    if (player->error) return false;
+    const int space = PLAYER_MAX_SOURCE_SIZE - player->source_size;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(&player->source[player->source_size], space, fmt, args);
+    va_end(args);
+    if ((n < 0) || (n >= space)) {
+        return _player_fail(player, "player source too large");
+    }
+    player->source_size += n;
+    return true;
+}
+
+static bool _player_is_variable(char variable) {
+    return (variable >= 'A') && (variable <= 'Z');
+}
+
+bool player_build(player_t* player, sequencer_t* sequencer, const player_desc_t* desc) {
+    CHIPS_ASSERT(player && sequencer && desc);
+    player->error = 0;
+    player->source_size = 0;
+    player->source[0] = 0;
+    const int load_addr = desc->load_addr ? desc->load_addr : PLAYER_DEFAULT_LOAD_ADDR;
+    const int zp_addr = desc->zp_addr ? desc->zp_addr : PLAYER_DEFAULT_ZP_ADDR;
+    const int sid_addr = desc->sid_addr ? desc->sid_addr : PLAYER_DEFAULT_SID_ADDR;
+    if (zp_addr + PLAYER_ZP_SIZE > 0x100) {
+        return _player_fail(player, "zero page area does not fit");
+    }
+
+    // the player keeps variables in 26 slots
+    var_or_number_t* params[SEQUENCER_MAX_PARAMS];
+    const int num_params = collect_params(sequencer, params);
+    for (int i = 0; i < num_params; i++) {
+        if (params[i]->variable && !_player_is_variable(params[i]->variable)) {
+            return _player_fail(player, "only variables A-Z are supported");
+        }
+    }
+    for (int s = 0; s < sequencer->num_sequences; s++) {
+        if (sequencer->sequences[s].variable && !_player_is_variable(sequencer->sequences[s].variable)) {
+            return _player_fail(player, "only variables A-Z are supported");
+        }
+    }
+    uint8_t data[SEQUENCER_BINARY_MAX_SIZE];
+    const int size = sequencer_export_binary(sequencer, data, sizeof(data));
+    CHIPS_ASSERT(size > SEQUENCER_BINARY_HEADER_SIZE);
+
+    _player_append(player,
+        "; numbersid player, generated source\n"
+        ";\n"
+        "; jsr load+0 to initialize, jsr load+3 once per sequencer frame\n"
+        "\n"
+        "zp      = $%02x\n"
+        "sid     = $%04x\n"
+        "num_params = %d\n"
+        "\n"
+        "        * = $%04x\n"
+        "\n",
+        zp_addr, sid_addr, num_params, load_addr);
+    _player_append(player, "%s", player_source_code);
+
+    // packed patch data, the payload of the binary patch format
+    _player_append(player, "\npatch:");
+    for (int i = SEQUENCER_BINARY_HEADER_SIZE; i < size; i++) {
+        const int col = (i - SEQUENCER_BINARY_HEADER_SIZE) % 16;
+        _player_append(player, "%s$%02x", (col == 0) ? "\n        .byte " : ", ", data[i]);
+    }
+
+    // frequency table, 3 bytes per cent of the top octave, see sequencer_sid_freq()
+    _player_append(player, "\n\nfreq_table:");
+    for (int i = 0; i < SID_FREQ_TABLE_SIZE; i++) {
+        const uint32_t value = sid_freq_table[i];
+        _player_append(player, "%s$%02x, $%02x, $%02x", ((i % 4) == 0) ? "\n        .byte " : ", ",
+            value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF);
+    }
+    _player_append(player, "\n\n%s", player_source_bss);
+    if (player->error) {
+        return false;
+    }
+
+    if (!asm6502_assemble(&player->as, player->source)) {
+        snprintf(player->error_buf, sizeof(player->error_buf), "assembler error in line %d: %s",
+            player->as.error_line, player->as.error);
+        player->error = player->error_buf;
+        return false;
+    }
+    player->init_addr = (uint16_t)load_addr;
+    player->play_addr = (uint16_t)(load_addr + 3);
+    player->zp_addr = (uint8_t)zp_addr;
+    player->bss_end = asm6502_symbol(&player->as, "bss_end");
+    if (player->bss_end > 0x10000) {
+        return _player_fail(player, "player does not fit in memory");
+    }
+    return true;
+}
+
+int player_prg(const player_t* player, uint8_t* buffer, int size) {
+    CHIPS_ASSERT(player && buffer && !player->error);
+    const int num_bytes = player->as.end - player->as.start;
+    if (num_bytes + 2 > size) {
+        return 0;
+    }
+    buffer[0] = (uint8_t)player->as.start;
+    buffer[1] = (uint8_t)(player->as.start >> 8);
+    memcpy(&buffer[2], &player->as.mem[player->as.start], num_bytes);
+    return num_bytes + 2;
+}
+
+#endif
@@ -0,0 +1,204 @@
+#pragma once
+/*
+    Streaming writer for 8-bit paletted PNG images.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    Rows are written one at a time with png_write_row() and go straight
+    to the output file as uncompressed (stored) deflate blocks, the
+    writer never holds more than one 64 KB block in memory. Stored
+    blocks keep encoding cost at a CRC and Adler-32 per byte, at the
+    price of a file size of roughly width*height bytes.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PNG_BLOCK_SIZE (65535)      // max payload of a stored deflate block
+
+typedef struct {
+    FILE* fp;
+    int width;
+    int height;
+    int rows_written;
+    uint32_t adler_a;
+    uint32_t adler_b;
+    int block_fill;
+    bool error;
+    uint8_t block[PNG_BLOCK_SIZE];
+} png_t;
+
+// start a PNG file; palette points to 256 RGBA8 entries (alpha is ignored)
+bool png_begin(png_t* png, FILE* fp, int width, int height, const uint32_t* palette);
+// write the next row of width palette indices
+bool png_write_row(png_t* png, const uint8_t* row);
+// finish the PNG file, all height rows must have been written
+bool png_end(png_t* png);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <string.h>
+#include <stddef.h>
+#include <assert.h>
+
+static uint32_t _png_crc_table[256];
+
+static void _png_init_crc_table(void) {
+    if (_png_crc_table[1] != 0) {
+        return;
+    }
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+        }
+        _png_crc_table[n] = c;
+    }
+}
+
+static uint32_t _png_crc(uint32_t crc, const uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        crc = _png_crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static void _png_put_u32(uint8_t* dst, uint32_t v) {
+    dst[0] = (uint8_t)(v >> 24);
+    dst[1] = (uint8_t)(v >> 16);
+    dst[2] = (uint8_t)(v >> 8);
+    dst[3] = (uint8_t)v;
+}
+
+// write a chunk, the data is split in two parts to avoid copying stored blocks
+static void _png_write_chunk(png_t* png, const char* type, const uint8_t* head, size_t head_size, const uint8_t* data, size_t data_size) {
+    uint8_t buf[8];
+    _png_put_u32(buf, (uint32_t)(head_size + data_size));
+    memcpy(&buf[4], type, 4);
+    uint32_t crc = _png_crc(0xFFFFFFFF, (const uint8_t*)type, 4);
+    crc = _png_crc(crc, head, head_size);
+    crc = _png_crc(crc, data, data_size);
+    fwrite(buf, 8, 1, png->fp);
+    if (head_size > 0) fwrite(head, head_size, 1, png->fp);
+    if (data_size > 0) fwrite(data, data_size, 1, png->fp);
+    _png_put_u32(buf, crc ^ 0xFFFFFFFF);
+    if (fwrite(buf, 4, 1, png->fp) != 1) {
+        png->error = true;
+    }
+}
+
+// emit the buffered bytes as one stored deflate block in its own IDAT chunk
+static void _png_flush_block(png_t* png, bool final) {
+    uint16_t len = (uint16_t)png->block_fill;
+    uint8_t head[5] = {
+        final ? 1 : 0,
+        (uint8_t)len, (uint8_t)(len >> 8),
+        (uint8_t)~len, (uint8_t)(~len >> 8)
+    };
+    _png_write_chunk(png, "IDAT", head, sizeof(head), png->block, png->block_fill);
+    png->block_fill = 0;
+}
+
+static void _png_put_bytes(png_t* png, const uint8_t* data, int size) {
+    // Adler-32 over the uncompressed stream (deferred modulo is safe for < 5552 bytes)
+    uint32_t a = png->adler_a;
+    uint32_t b = png->adler_b;
+    while (size > 0) {
+        int n = PNG_BLOCK_SIZE - png->block_fill;
+        if (n > size) n = size;
+        memcpy(&png->block[png->block_fill], data, n);
+        for (int i = 0; i < n; i += 5552) {
+            int end = (i + 5552 < n) ? (i + 5552) : n;
+            for (int j = i; j < end; j++) {
+                a += data[j];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        png->block_fill += n;
+        data += n;
+        size -= n;
+        if (png->block_fill == PNG_BLOCK_SIZE) {
+            _png_flush_block(png, false);
+        }
+    }
+    png->adler_a = a;
+    png->adler_b = b;
+}
+
+bool png_begin(png_t* png, FILE* fp, int width, int height, const uint32_t* palette) {
+    assert(png && fp && palette);
+    assert((width > 0) && (height > 0));
+    _png_init_crc_table();
+    memset(png, 0, offsetof(png_t, block));
+    png->fp = fp;
+    png->width = width;
+    png->height = height;
+    png->adler_a = 1;
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    fwrite(signature, sizeof(signature), 1, fp);
+
+    uint8_t ihdr[13];
+    _png_put_u32(&ihdr[0], (uint32_t)width);
+    _png_put_u32(&ihdr[4], (uint32_t)height);
+    ihdr[8] = 8;        // bit depth
+    ihdr[9] = 3;        // color type: palette
+    ihdr[10] = 0;       // compression: deflate
+    ihdr[11] = 0;       // filter method
+    ihdr[12] = 0;       // no interlace
+    _png_write_chunk(png, "IHDR", ihdr, sizeof(ihdr), 0, 0);
+
+    uint8_t plte[256*3];
+    for (int i = 0; i < 256; i++) {
+        plte[i*3+0] = (uint8_t)(palette[i]);
+        plte[i*3+1] = (uint8_t)(palette[i] >> 8);
+        plte[i*3+2] = (uint8_t)(palette[i] >> 16);
+    }
+    _png_write_chunk(png, "PLTE", plte, sizeof(plte), 0, 0);
+
+    // zlib header: deflate, 32K window, no dictionary, check bits
+    static const uint8_t zlib_header[2] = { 0x78, 0x01 };
+    _png_write_chunk(png, "IDAT", zlib_header, sizeof(zlib_header), 0, 0);
+    return !png->error;
+}
+
+bool png_write_row(png_t* png, const uint8_t* row) {
+    assert(png && png->fp && row);
+    assert(png->rows_written < png->height);
+    const uint8_t filter = 0;
+    _png_put_bytes(png, &filter, 1);
+    _png_put_bytes(png, row, png->width);
+    png->rows_written++;
+    return !png->error;
+}
+
+bool png_end(png_t* png) {
+    assert(png && png->fp);
+    assert(png->rows_written == png->height);
+    _png_flush_block(png, true);
+    uint8_t adler[4];
+    _png_put_u32(adler, (png->adler_b << 16) | png->adler_a);
+    _png_write_chunk(png, "IDAT", adler, sizeof(adler), 0, 0);
+    _png_write_chunk(png, "IEND", 0, 0, 0, 0);
+    png->fp = 0;
+    return !png->error;
+}
+
+#endif
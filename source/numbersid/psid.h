@@ -0,0 +1,321 @@
+#pragma once
+/*
+    PSID (.sid) export of SID register traces.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    Include the following headers before including psid.h:
+        - chips/chips_common.h
+        - chips/m6581.h
+        - sequencer.h
+        - sidtrace.h
+        - asm6502.h
+
+    psid_build() converts a trace (see sidtrace.h) into a register stream
+    and wraps it with a small 6502 player into a PSID v2 file with one
+    song. The player writes the changed registers of every frame, so its
+    cost is a few rasterlines at most, and the result plays exactly like
+    the trace.
+
+    Stream, following the player code:
+
+        wait        number of calls to skip before the next event (u8)
+        event:      pairs of register (bit 7 set on the last pair) and
+                    value, followed by the wait before the next event
+        end:        $ff instead of the first register of an event
+
+    Gaps of more than 256 frames are bridged by rewriting a register with
+    the value it already has.
+
+    The register values of a trace are for the PAL SID clock, like the
+    application. For NTSC the voice frequencies are rescaled to the NTSC
+    clock (see psid_ntsc_regs()), so the piece keeps its pitch.
+
+    The sequencer runs at 60 Hz. On PAL the player is called by a CIA
+    timer that init sets to 60 Hz, on NTSC the vertical blank is used.
+    desc.vbi forces the vertical blank (50 Hz on PAL, the piece plays
+    slower). The player uses zero page $FB/$FC and the stream has to end
+    before $A000 (BASIC ROM), which limits the length of a piece.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PSID_HEADER_SIZE (0x7C)
+#define PSID_DEFAULT_LOAD_ADDR (0x1000)
+#define PSID_END_ADDR (0xA000)
+#define PSID_MAX_SIZE (PSID_HEADER_SIZE + 2 + PSID_END_ADDR)
+#define PSID_PAL_CLOCK (985248)
+#define PSID_NTSC_CLOCK (1022727)
+
+typedef struct {
+    const uint8_t* trace;   // SID register trace, see sidtrace.h
+    int trace_size;
+    const char* name;       // title, author and release info, at most 32 characters
+    const char* author;
+    const char* released;
+    uint16_t load_addr;     // default PSID_DEFAULT_LOAD_ADDR
+    bool ntsc;              // NTSC instead of PAL
+    bool vbi;               // call play on the vertical blank, also on PAL
+} psid_desc_t;
+
+typedef struct {
+    asm6502_t as;           // assembled player, the stream follows at stream_addr
+    uint16_t load_addr;
+    uint16_t init_addr;
+    uint16_t play_addr;
+    uint16_t stream_addr;
+    bool cia;               // speed flag, played by a CIA timer
+    int num_frames;
+    int num_events;         // frames with register changes, including gap fillers
+    int code_size;
+    int stream_size;
+    const char* error;      // error message if psid_build() failed
+    char error_buf[128];
+    int size;               // size of the .sid file in data
+    uint8_t data[PSID_MAX_SIZE];
+} psid_t;
+
+// build a .sid file from a trace
+bool psid_build(psid_t* psid, const psid_desc_t* desc);
+// rescale the voice frequencies of PAL register values in place, for the same pitch on NTSC
+void psid_ntsc_regs(uint8_t* regs);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char* _psid_player_init_source =
+    "; numbersid register stream player\n"
+    "\n"
+    "sid     = $d400\n"
+    "ptr     = $fb\n"
+    "\n"
+    "        jmp init\n"
+    "        jmp play\n"
+    "\n"
+    "wait:   .byte 0\n"
+    "\n"
+    "init:   ldx #$18\n"
+    "        lda #0\n"
+    "clear:  sta sid,x\n"
+    "        dex\n"
+    "        bpl clear\n"
+    "        lda #<stream\n"
+    "        sta ptr\n"
+    "        lda #>stream\n"
+    "        sta ptr+1\n"
+    "        ldy #0\n"
+    "        lda (ptr),y\n"
+    "        sta wait\n"
+    "        inc ptr\n"
+    "        bne init_timer\n"
+    "        inc ptr+1\n"
+    "init_timer:\n";
+
+// CIA 1 timer A, when the player is not called on the vertical blank
+static const char* _psid_player_timer_source =
+    "        lda #<timer\n"
+    "        sta $dc04\n"
+    "        lda #>timer\n"
+    "        sta $dc05\n";
+
+static const char* _psid_player_play_source =
+    "        rts\n"
+    "\n"
+    "play:   lda wait\n"
+    "        beq event\n"
+    "        dec wait\n"
+    "        rts\n"
+    "event:  ldy #0\n"
+    "        lda (ptr),y\n"
+    "        cmp #$ff\n"
+    "        beq done\n"
+    "write:  iny\n"
+    "        pha\n"
+    "        and #$1f\n"
+    "        tax\n"
+    "        lda (ptr),y\n"
+    "        sta sid,x\n"
+    "        iny\n"
+    "        pla\n"
+    "        bmi last\n"
+    "        lda (ptr),y\n"
+    "        jmp write\n"
+    "last:   lda (ptr),y\n"
+    "        sta wait\n"
+    "        iny\n"
+    "        tya\n"
+    "        clc\n"
+    "        adc ptr\n"
+    "        sta ptr\n"
+    "        bcc done\n"
+    "        inc ptr+1\n"
+    "done:   rts\n"
+    "\n"
+    "stream:\n";
+
+static bool _psid_fail(psid_t* psid, const char* message) {
+    snprintf(psid->error_buf, sizeof(psid->error_buf), "%s", message);
+    psid->error = psid->error_buf;
+    return false;
+}
+
+static void _psid_put_u16(uint8_t* dst, uint16_t value) {
+    dst[0] = (uint8_t)(value >> 8);
+    dst[1] = (uint8_t)value;
+}
+
+static void _psid_put_string(uint8_t* dst, const char* str) {
+    if (str) {
+        strncpy((char*)dst, str, 32);
+    }
+}
+
+// append one stream byte after the player code, false if it does not fit
+static bool _psid_put(psid_t* psid, uint8_t byte) {
+    if (psid->stream_addr + psid->stream_size >= PSID_END_ADDR) {
+        return _psid_fail(psid, "piece does not fit in C64 memory");
+    }
+    psid->as.mem[psid->stream_addr + psid->stream_size++] = byte;
+    return true;
+}
+
+void psid_ntsc_regs(uint8_t* regs) {
+    CHIPS_ASSERT(regs);
+    for (int v = 0; v < NUM_CHANNELS; v++) {
+        const uint64_t freq = regs[v * 7] | (regs[v * 7 + 1] << 8);
+        // rounded, always smaller than the PAL value so it can't overflow
+        const uint32_t scaled = (uint32_t)((freq * PSID_PAL_CLOCK + PSID_NTSC_CLOCK / 2) / PSID_NTSC_CLOCK);
+        regs[v * 7] = (uint8_t)scaled;
+        regs[v * 7 + 1] = (uint8_t)(scaled >> 8);
+    }
+}
+
+bool psid_build(psid_t* psid, const psid_desc_t* desc) {
+    CHIPS_ASSERT(psid && desc && desc->trace);
+    memset(psid, 0, offsetof(psid_t, data));
+    const uint16_t load_addr = desc->load_addr ? desc->load_addr : PSID_DEFAULT_LOAD_ADDR;
+    sidtrace_player_t trace;
+    if (!sidtrace_player_init(&trace, desc->trace, desc->trace_size)) {
+        return _psid_fail(psid, "not a SID register trace");
+    }
+    if ((load_addr < 0x0400) || (load_addr >= PSID_END_ADDR)) {
+        return _psid_fail(psid, "load address out of range");
+    }
+
+    // a CIA timer gives 60 Hz on PAL, NTSC has 60 Hz vertical blanks
+    psid->cia = !desc->ntsc && !desc->vbi;
+    // the timer counts down to 0 and reloads, the period is one more than the latch
+    const int timer = psid->cia ? ((PSID_PAL_CLOCK + 30) / 60 - 1) : 0;
+    char source[4096];
+    snprintf(source, sizeof(source), "timer   = $%04x\n\n        * = $%04x\n\n%s%s%s", timer, load_addr,
+        _psid_player_init_source, psid->cia ? _psid_player_timer_source : "", _psid_player_play_source);
+    if (!asm6502_assemble(&psid->as, source)) {
+        snprintf(psid->error_buf, sizeof(psid->error_buf), "assembler error in line %d: %s",
+            psid->as.error_line, psid->as.error);
+        psid->error = psid->error_buf;
+        return false;
+    }
+    psid->load_addr = load_addr;
+    psid->init_addr = load_addr;
+    psid->play_addr = load_addr + 3;
+    psid->stream_addr = (uint16_t)asm6502_symbol(&psid->as, "stream");
+    psid->code_size = psid->stream_addr - load_addr;
+
+    // register stream, regs follows the SID as the player leaves it,
+    // next the trace and out the values the player writes for it
+    uint8_t regs[SID_NUM_REGS] = {0};
+    uint8_t next[SID_NUM_REGS] = {0};
+    uint8_t out[SID_NUM_REGS];
+    int last_event = -1;
+    bool ok = true;
+    for (int frame = 0; ok && !sidtrace_player_done(&trace); frame++) {
+        uint32_t mask = sidtrace_player_next(&trace, next);
+        memcpy(out, next, sizeof(out));
+        if (desc->ntsc) {
+            psid_ntsc_regs(out);
+            // a frequency is scaled as a whole, both of its registers may change
+            for (int v = 0; v < NUM_CHANNELS; v++) {
+                if (mask & (3u << (v * 7))) {
+                    mask |= 3u << (v * 7);
+                }
+            }
+        }
+        for (int reg = 0; reg < SID_NUM_REGS; reg++) {
+            if ((mask & (1u << reg)) && (out[reg] == regs[reg])) {
+                mask &= ~(1u << reg);
+            }
+        }
+        psid->num_frames = frame + 1;
+        // the wait byte is one less than the frames since the last event
+        if (!mask && (frame - last_event < 256)) {
+            continue;
+        }
+        if (!mask) {
+            // rewrite the volume to bridge the gap while the wait still fits
+            mask = 1u << SID_REG_MODEVOL;
+        }
+        ok = _psid_put(psid, (uint8_t)(frame - last_event - 1));
+        int last_reg = 0;
+        for (int reg = 0; reg < SID_NUM_REGS; reg++) {
+            if (mask & (1u << reg)) last_reg = reg;
+        }
+        for (int reg = 0; ok && (reg < SID_NUM_REGS); reg++) {
+            if (mask & (1u << reg)) {
+                regs[reg] = out[reg];
+                ok = _psid_put(psid, (uint8_t)(reg | ((reg == last_reg) ? 0x80 : 0))) && _psid_put(psid, regs[reg]);
+            }
+        }
+        psid->num_events++;
+        last_event = frame;
+    }
+    ok = ok && _psid_put(psid, 0) && _psid_put(psid, 0xFF);
+    if (!ok) {
+        snprintf(psid->error_buf, sizeof(psid->error_buf),
+            "piece does not fit in C64 memory, stream full after frame %d", last_event);
+        return false;
+    }
+
+    // PSID v2 header, big-endian
+    const int num_bytes = psid->code_size + psid->stream_size;
+    uint8_t* dst = psid->data;
+    memset(dst, 0, PSID_HEADER_SIZE);
+    memcpy(dst, "PSID", 4);
+    _psid_put_u16(&dst[0x04], 2);                   // version
+    _psid_put_u16(&dst[0x06], PSID_HEADER_SIZE);    // data offset
+    _psid_put_u16(&dst[0x08], 0);                   // load address in the first two data bytes
+    _psid_put_u16(&dst[0x0A], psid->init_addr);
+    _psid_put_u16(&dst[0x0C], psid->play_addr);
+    _psid_put_u16(&dst[0x0E], 1);                   // songs
+    _psid_put_u16(&dst[0x10], 1);                   // start song
+    dst[0x15] = psid->cia ? 1 : 0;                  // speed of song 1
+    _psid_put_string(&dst[0x16], desc->name);
+    _psid_put_string(&dst[0x36], desc->author);
+    _psid_put_string(&dst[0x56], desc->released);
+    // flags: PAL or NTSC, 6581
+    _psid_put_u16(&dst[0x76], (uint16_t)(((desc->ntsc ? 2 : 1) << 2) | (1 << 4)));
+    dst[PSID_HEADER_SIZE + 0] = (uint8_t)load_addr;
+    dst[PSID_HEADER_SIZE + 1] = (uint8_t)(load_addr >> 8);
+    memcpy(&dst[PSID_HEADER_SIZE + 2], &psid->as.mem[load_addr], num_bytes);
+    psid->size = PSID_HEADER_SIZE + 2 + num_bytes;
+    return true;
+}
+
+#endif
@@ -0,0 +1,165 @@
+#pragma once
+/*
+    Headless rendering of a sequencer patch to audio samples.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    Include the following headers before including render.h:
+        - chips/chips_common.h
+        - chips/m6581.h
+        - sequencer.h
+
+    The sequencer runs on a fixed 60 Hz clock and the SID is ticked at the
+    C64 PAL clock in between, like the application does in real time.
+    Every render_t is independent, so several can run on different threads.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RENDER_TICK_HZ (985248)             // SID clock frequency, same as in the app
+#define RENDER_SAMPLE_HZ (48000)
+#define RENDER_FRAME_HZ (60)                // sequencer frames per second
+#define RENDER_MAX_FRAME_SAMPLES (1024)     // upper bound of samples produced by one frame
+
+typedef struct {
+    sequencer_t sequencer;
+    m6581_t sid;
+    uint64_t pins;
+    uint64_t num_frames;        // number of frames rendered so far
+    // optional replacement of update_variables(), e.g. generated by numbersid-codegen
+    void (*update_variables)(int16_t* values, bool* gate_states, int frame);
+    // SID registers, and the ones written by the last frame, e.g. to record a trace
+    uint8_t sid_regs[SID_NUM_REGS];
+    uint32_t sid_mask;
+} render_t;
+
+void render_init(render_t* render);
+// render one sequencer frame, returns number of samples written (at most RENDER_MAX_FRAME_SAMPLES)
+int render_frame(render_t* render, float* samples, int max_samples);
+// render one frame from recorded register writes (e.g. a trace), without the sequencer
+int render_replay_frame(render_t* render, const uint8_t* regs, uint32_t mask, float* samples, int max_samples);
+// load a patch (text as exported from the Data window, or binary) from a file, "-" reads from stdin
+// result is optional and reports the position of text import errors
+bool render_load_patch(sequencer_t* sequencer, const char* path, sequencer_import_result_t* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void render_init(render_t* render) {
+    CHIPS_ASSERT(render);
+    memset(render, 0, sizeof(render_t));
+    sequencer_init(&render->sequencer);
+    m6581_init(&render->sid, &(m6581_desc_t){
+        .tick_hz = RENDER_TICK_HZ,
+        .sound_hz = RENDER_SAMPLE_HZ,
+        .magnitude = 1.0f,
+    });
+}
+
+int render_frame(render_t* render, float* samples, int max_samples) {
+    CHIPS_ASSERT(render && samples);
+
+    sequencer_t* sequencer = &render->sequencer;
+    if (render->update_variables) {
+        // same as sequencer_advance()
+        render->update_variables(sequencer->values, sequencer->gate_states, sequencer->frame);
+        if (sequencer->running) {
+            sequencer->frame += 1;
+        }
+    }
+    else {
+        sequencer_advance(sequencer);
+    }
+    // sid_regs holds the control registers the SID got last, like sequencer_update_sid() reads them
+    render->sid_mask = sequencer_sid_writes(sequencer, render->sid_regs);
+    return render_replay_frame(render, render->sid_regs, render->sid_mask, samples, max_samples);
+}
+
+int render_replay_frame(render_t* render, const uint8_t* regs, uint32_t mask, float* samples, int max_samples) {
+    CHIPS_ASSERT(render && regs && samples);
+
+    sequencer_write_sid(&render->sid, regs, mask);
+    if (regs != render->sid_regs) {
+        for (int reg = 0; reg < SID_NUM_REGS; reg++) {
+            if (mask & (1u << reg)) {
+                render->sid_regs[reg] = regs[reg];
+            }
+        }
+        render->sid_mask = mask;
+    }
+
+    // distribute the SID ticks evenly over the frames, without drift
+    uint64_t n = render->num_frames++;
+    uint32_t num_ticks = (uint32_t)(((n + 1) * RENDER_TICK_HZ) / RENDER_FRAME_HZ - (n * RENDER_TICK_HZ) / RENDER_FRAME_HZ);
+
+    int num_samples = 0;
+    uint64_t pins = render->pins;
+    for (uint32_t tick = 0; tick < num_ticks; tick++) {
+        pins = m6581_tick(&render->sid, pins);
+        if ((pins & M6581_SAMPLE) && (num_samples < max_samples)) {
+            samples[num_samples++] = render->sid.sample;
+        }
+    }
+    render->pins = pins;
+    return num_samples;
+}
+
+bool render_load_patch(sequencer_t* sequencer, const char* path, sequencer_import_result_t* result) {
+    CHIPS_ASSERT(sequencer && path);
+    bool from_stdin = (0 == strcmp(path, "-"));
+    FILE* fp = from_stdin ? stdin : fopen(path, "rb");
+    if (!fp) {
+        return false;
+    }
+    size_t size = 0;
+    size_t capacity = 64 * 1024;
+    char* buffer = malloc(capacity);
+    size_t n;
+    while (buffer && (n = fread(&buffer[size], 1, capacity - size - 1, fp)) > 0) {
+        size += n;
+        if (size + 1 == capacity) {
+            capacity *= 2;
+            char* grown = realloc(buffer, capacity);
+            if (!grown) {
+                free(buffer);
+            }
+            buffer = grown;
+        }
+    }
+    if (!from_stdin) {
+        fclose(fp);
+    }
+    if (!buffer) {
+        return false;
+    }
+    buffer[size] = 0;
+    bool success;
+    if (sequencer_is_binary((const uint8_t*)buffer, (int)size)) {
+        success = sequencer_import_binary(sequencer, (const uint8_t*)buffer, (int)size);
+    }
+    else {
+        success = sequencer_import_data(sequencer, buffer, result);
+    }
+    free(buffer);
+    return success;
+}
+
+#endif
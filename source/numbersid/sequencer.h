@@ -87,6 +87,9 @@ typedef struct {
 #define MAX_VOICES      16
 #define NUM_CHANNELS    3    // SID hardware channels
 
+// The patch is everything from voices up to (not including) preview, the
+// rest is runtime state, which the engine owns (see engine.h), and the
+// preview, which only the UI uses. Keep the patch fields together.
 typedef struct {
     // time control
     bool running;
@@ -115,24 +118,93 @@ typedef struct {
 } sequencer_t;
 
 
-#define SEQUENCER_SNAPSHOT_VERSION (2)
 #define SCREENSHOT_WIDTH (400)      // TODO: how to ensure it's same as framebuffer width?
 #define SCREENSHOT_HEIGHT (300)
 #define SCREENSHOT_SIZE_BYTES (SCREENSHOT_WIDTH * SCREENSHOT_HEIGHT)
 
+
+/*
+    Binary patch format, little-endian:
+
+        header:   'N','S','P','B', version (u8), reserved (u8),
+                  payload size (u16), FNV-1a checksum of payload (u32)
+        payload:  num_voices, num_sequences, num_arrays (u8 each)
+                  array_sizes (u8 per array)
+                  sequence variables (u8 per sequence)
+                  type mask, one bit per parameter, set for a variable (LSB first)
+                  operands, one u16 per parameter (variable or number)
+
+    Parameters are in the same order as in the text format. All sections
+    have a size that follows from the counts, so a patch is decoded
+    without scanning. Max size is SEQUENCER_BINARY_MAX_SIZE bytes.
+    Unlike the text format, the (unused) number of a parameter that
+    refers to a variable is not stored.
+*/
+#define SEQUENCER_BINARY_VERSION (1)
+#define SEQUENCER_BINARY_HEADER_SIZE (12)
+#define SEQUENCER_MAX_PARAMS (MAX_VOICES*14 + NUM_CHANNELS + 4 + MAX_SEQUENCES*11 + MAX_ARRAYS*MAX_ARRAY_SIZE)
+#define SEQUENCER_BINARY_MAX_SIZE (SEQUENCER_BINARY_HEADER_SIZE + 3 + MAX_ARRAYS + MAX_SEQUENCES + (SEQUENCER_MAX_PARAMS+7)/8 + SEQUENCER_MAX_PARAMS*2)
+
+/*
+    Snapshot format, little-endian:
+
+        header:   'N','S','S','N', version (u8), reserved (u8),
+                  runtime size (u16), FNV-1a checksum of runtime (u32)
+        patch:    binary patch, see above
+        runtime:  running, muted (u8 each), frame (i32), gate states
+                  (u8, one bit per channel), number of variables (u8),
+                  values (i16 per variable), preview step, offset (i32
+                  each), follow, number of columns (u8 each), column
+                  variables (u8 per column), number of highlighters (u8),
+                  highlighters (value, modulo as i32, color as 4 f32)
+
+    The preview table itself is not stored, it follows from the patch and
+    the frame. A snapshot is a few hundred bytes instead of a copy of
+    sequencer_t, the screenshot is stored separately by the application.
+*/
+#define SEQUENCER_SNAPSHOT_VERSION (3)
+#define SEQUENCER_SNAPSHOT_HEADER_SIZE (12)
+#define SEQUENCER_SNAPSHOT_RUNTIME_MAX_SIZE (8 + MAX_VARIABLES*2 + 10 + MAX_PREVIEW_COLS + 1 + MAX_HIGHLIGHTERS*24)
+#define SEQUENCER_SNAPSHOT_MAX_SIZE (SEQUENCER_SNAPSHOT_HEADER_SIZE + SEQUENCER_BINARY_MAX_SIZE + SEQUENCER_SNAPSHOT_RUNTIME_MAX_SIZE)
+
+// result of sequencer_import_data()
 typedef struct {
-    uint32_t version;
-    sequencer_t sequencer;
-    uint8_t screenshot_data[SCREENSHOT_SIZE_BYTES];    // RGBA8 screenshot
-} sequencer_snapshot_t;
+    int end;                // offset just after the imported patch, to import the next one from a stream
+    int error_pos;          // offset of the error in the buffer
+    int error_line;         // 1-based
+    int error_column;       // 1-based
+    const char* error;      // error message, 0 on success
+} sequencer_import_result_t;
 
+#define SID_NUM_REGS (25)
+#define SID_FREQ_TABLE_SIZE (1200)      // one octave in cents
 
 // exported functions
 int16_t floor_mod(int16_t value, int16_t mod);
 void sequencer_export_data(sequencer_t* sequencer, char* buffer, int size, int words_per_line);
-bool sequencer_import_data(sequencer_t* sequencer, char* buffer);
+// import text as exported by sequencer_export_data(), result is optional
+bool sequencer_import_data(sequencer_t* sequencer, const char* buffer, sequencer_import_result_t* result);
+// returns number of bytes written, 0 if the buffer is too small
+int sequencer_export_binary(sequencer_t* sequencer, uint8_t* buffer, int size);
+// leaves the sequencer unchanged if the data is invalid
+bool sequencer_import_binary(sequencer_t* sequencer, const uint8_t* buffer, int size);
+bool sequencer_is_binary(const uint8_t* buffer, int size);
+// returns the size of the snapshot, 0 if the buffer is too small
+int sequencer_save_snapshot(sequencer_t* sequencer, uint8_t* buffer, int size);
+// leaves the sequencer unchanged if the snapshot is invalid
+bool sequencer_load_snapshot(sequencer_t* sequencer, const uint8_t* buffer, int size);
 void sequencer_update_sid(sequencer_t* sequencer, m6581_t* sid);
+// compute the SID register writes of sequencer_update_sid(), regs holds the 
+// current register values (only the control registers are read), returns a 
+// bit mask of the written registers
+uint32_t sequencer_sid_writes(sequencer_t* sequencer, uint8_t* regs);
+// write the registers in mask to the SID, e.g. from sequencer_sid_writes() or a trace
+void sequencer_write_sid(m6581_t* sid, const uint8_t* regs, uint32_t mask);
+// SID frequency register value for a semitone (0 is A4) plus pitch in cents
+uint16_t sequencer_sid_freq(int16_t semitone, int16_t pitch);
 void sequencer_update(sequencer_t* sequencer);
+void sequencer_advance(sequencer_t* sequencer);
+void sequencer_update_preview(sequencer_t* sequencer);
 
 void sequencer_update_framebuffer(sequencer_t* sequencer, uint8_t* framebuffer, chips_display_info_t info);
 
@@ -189,20 +261,150 @@ void sequencer_init(sequencer_t* sequencer) {
 }
 
 int16_t floor_mod(int16_t value, int16_t mod) {
-    int16_t absmod = abs(mod);
-    int16_t count = value / absmod;
-    if (value < 0) count = (value - absmod + 1) / absmod;
-    int16_t result = value - (count*absmod);
+    int absmod = abs(mod);
+    int result = value % absmod;
+    if (result < 0) result += absmod;
     if (mod < 0) result = absmod - result - 1;
     return result;
 }
 
-float note_freq(float base, float semitones) {
-    return base*pow(2, semitones/12);
-}
-
-uint16_t freq_to_sid_value_pal(float freq) {
-    return (uint16_t)(freq * 17.0309);
+// PAL SID frequency register values of the octave above A4 (440 Hz) in cents,
+// with 8 fractional bits: (uint32_t)(440 * 17.0309 * 2^(i/1200) * 256).
+// Precomputed, so the integer lookups give exactly the same frequencies on
+// every platform and thread, e.g. in a 6502 player.
+static const uint32_t sid_freq_table[SID_FREQ_TABLE_SIZE] = {
+    0x1d4598, 0x1d49ec, 0x1d4e42, 0x1d5297, 0x1d56ee, 0x1d5b45, 0x1d5f9c, 0x1d63f4, 0x1d684d, 0x1d6ca7,
+    0x1d7101, 0x1d755c, 0x1d79b7, 0x1d7e13, 0x1d8270, 0x1d86ce, 0x1d8b2c, 0x1d8f8a, 0x1d93ea, 0x1d984a,
+    0x1d9caa, 0x1da10c, 0x1da56e, 0x1da9d0, 0x1dae33, 0x1db297, 0x1db6fc, 0x1dbb61, 0x1dbfc7, 0x1dc42d,
+    0x1dc894, 0x1dccfc, 0x1dd165, 0x1dd5ce, 0x1dda37, 0x1ddea2, 0x1de30d, 0x1de779, 0x1debe5, 0x1df052,
+    0x1df4c0, 0x1df92e, 0x1dfd9d, 0x1e020d, 0x1e067d, 0x1e0aee, 0x1e0f5f, 0x1e13d2, 0x1e1845, 0x1e1cb8,
+    0x1e212c, 0x1e25a1, 0x1e2a17, 0x1e2e8d, 0x1e3304, 0x1e377b, 0x1e3bf4, 0x1e406c, 0x1e44e6, 0x1e4960,
+    0x1e4ddb, 0x1e5256, 0x1e56d3, 0x1e5b4f, 0x1e5fcd, 0x1e644b, 0x1e68ca, 0x1e6d49, 0x1e71c9, 0x1e764a,
+    0x1e7acc, 0x1e7f4e, 0x1e83d1, 0x1e8854, 0x1e8cd8, 0x1e915d, 0x1e95e3, 0x1e9a69, 0x1e9ef0, 0x1ea377,
+    0x1ea7ff, 0x1eac88, 0x1eb112, 0x1eb59c, 0x1eba27, 0x1ebeb2, 0x1ec33e, 0x1ec7cb, 0x1ecc59, 0x1ed0e7,
+    0x1ed576, 0x1eda05, 0x1ede96, 0x1ee326, 0x1ee7b8, 0x1eec4a, 0x1ef0dd, 0x1ef571, 0x1efa05, 0x1efe9a,
+    0x1f0330, 0x1f07c6, 0x1f0c5d, 0x1f10f5, 0x1f158d, 0x1f1a26, 0x1f1ec0, 0x1f235a, 0x1f27f5, 0x1f2c91,
+    0x1f312d, 0x1f35cb, 0x1f3a68, 0x1f3f07, 0x1f43a6, 0x1f4846, 0x1f4ce6, 0x1f5188, 0x1f562a, 0x1f5acc,
+    0x1f5f6f, 0x1f6413, 0x1f68b8, 0x1f6d5d, 0x1f7203, 0x1f76aa, 0x1f7b52, 0x1f7ffa, 0x1f84a2, 0x1f894c,
+    0x1f8df6, 0x1f92a1, 0x1f974c, 0x1f9bf9, 0x1fa0a6, 0x1fa553, 0x1faa01, 0x1faeb0, 0x1fb360, 0x1fb811,
+    0x1fbcc2, 0x1fc173, 0x1fc626, 0x1fcad9, 0x1fcf8d, 0x1fd441, 0x1fd8f7, 0x1fddad, 0x1fe263, 0x1fe71b,
+    0x1febd3, 0x1ff08b, 0x1ff545, 0x1ff9ff, 0x1ffeba, 0x200375, 0x200831, 0x200cee, 0x2011ac, 0x20166a,
+    0x201b29, 0x201fe9, 0x2024a9, 0x20296b, 0x202e2c, 0x2032ef, 0x2037b2, 0x203c76, 0x20413b, 0x204600,
+    0x204ac6, 0x204f8d, 0x205455, 0x20591d, 0x205de6, 0x2062af, 0x20677a, 0x206c45, 0x207110, 0x2075dd,
+    0x207aaa, 0x207f78, 0x208446, 0x208916, 0x208de6, 0x2092b6, 0x209788, 0x209c5a, 0x20a12d, 0x20a600,
+    0x20aad4, 0x20afa9, 0x20b47f, 0x20b956, 0x20be2d, 0x20c304, 0x20c7dd, 0x20ccb6, 0x20d190, 0x20d66b,
+    0x20db46, 0x20e023, 0x20e4ff, 0x20e9dd, 0x20eebb, 0x20f39a, 0x20f87a, 0x20fd5b, 0x21023c, 0x21071e,
+    0x210c00, 0x2110e4, 0x2115c8, 0x211aad, 0x211f92, 0x212478, 0x21295f, 0x212e47, 0x21332f, 0x213819,
+    0x213d02, 0x2141ed, 0x2146d8, 0x214bc4, 0x2150b1, 0x21559f, 0x215a8d, 0x215f7c, 0x21646c, 0x21695c,
+    0x216e4d, 0x21733f, 0x217832, 0x217d25, 0x218219, 0x21870e, 0x218c04, 0x2190fa, 0x2195f1, 0x219ae9,
+    0x219fe1, 0x21a4da, 0x21a9d4, 0x21aecf, 0x21b3ca, 0x21b8c7, 0x21bdc4, 0x21c2c1, 0x21c7c0, 0x21ccbf,
+    0x21d1bf, 0x21d6bf, 0x21dbc1, 0x21e0c3, 0x21e5c5, 0x21eac9, 0x21efcd, 0x21f4d2, 0x21f9d8, 0x21fedf,
+    0x2203e6, 0x2208ee, 0x220df7, 0x221300, 0x22180a, 0x221d15, 0x222221, 0x22272e, 0x222c3b, 0x223149,
+    0x223658, 0x223b67, 0x224077, 0x224588, 0x224a9a, 0x224fad, 0x2254c0, 0x2259d4, 0x225ee9, 0x2263fe,
+    0x226914, 0x226e2b, 0x227343, 0x22785b, 0x227d75, 0x22828f, 0x2287a9, 0x228cc5, 0x2291e1, 0x2296fe,
+    0x229c1c, 0x22a13b, 0x22a65a, 0x22ab7a, 0x22b09b, 0x22b5bc, 0x22badf, 0x22c002, 0x22c526, 0x22ca4a,
+    0x22cf70, 0x22d496, 0x22d9bd, 0x22dee4, 0x22e40d, 0x22e936, 0x22ee60, 0x22f38a, 0x22f8b6, 0x22fde2,
+    0x23030f, 0x23083d, 0x230d6b, 0x23129b, 0x2317cb, 0x231cfc, 0x23222d, 0x232760, 0x232c93, 0x2331c7,
+    0x2336fb, 0x233c31, 0x234167, 0x23469e, 0x234bd6, 0x23510e, 0x235648, 0x235b82, 0x2360bc, 0x2365f8,
+    0x236b34, 0x237072, 0x2375b0, 0x237aee, 0x23802e, 0x23856e, 0x238aaf, 0x238ff1, 0x239534, 0x239a77,
+    0x239fbb, 0x23a500, 0x23aa46, 0x23af8c, 0x23b4d3, 0x23ba1c, 0x23bf64, 0x23c4ae, 0x23c9f8, 0x23cf44,
+    0x23d490, 0x23d9dc, 0x23df2a, 0x23e478, 0x23e9c7, 0x23ef17, 0x23f468, 0x23f9b9, 0x23ff0c, 0x24045f,
+    0x2409b2, 0x240f07, 0x24145c, 0x2419b3, 0x241f0a, 0x242461, 0x2429ba, 0x242f13, 0x24346d, 0x2439c8,
+    0x243f24, 0x244481, 0x2449de, 0x244f3c, 0x24549b, 0x2459fb, 0x245f5b, 0x2464bc, 0x246a1e, 0x246f81,
+    0x2474e5, 0x247a49, 0x247faf, 0x248515, 0x248a7c, 0x248fe3, 0x24954c, 0x249ab5, 0x24a01f, 0x24a58a,
+    0x24aaf6, 0x24b062, 0x24b5cf, 0x24bb3d, 0x24c0ac, 0x24c61c, 0x24cb8c, 0x24d0fe, 0x24d670, 0x24dbe3,
+    0x24e156, 0x24e6cb, 0x24ec40, 0x24f1b6, 0x24f72d, 0x24fca5, 0x25021e, 0x250797, 0x250d11, 0x25128c,
+    0x251808, 0x251d84, 0x252302, 0x252880, 0x252dff, 0x25337f, 0x253900, 0x253e81, 0x254403, 0x254986,
+    0x254f0a, 0x25548f, 0x255a15, 0x255f9b, 0x256522, 0x256aaa, 0x257033, 0x2575bd, 0x257b47, 0x2580d2,
+    0x25865e, 0x258beb, 0x259179, 0x259708, 0x259c97, 0x25a227, 0x25a7b8, 0x25ad4a, 0x25b2dd, 0x25b870,
+    0x25be05, 0x25c39a, 0x25c930, 0x25cec7, 0x25d45e, 0x25d9f7, 0x25df90, 0x25e52a, 0x25eac5, 0x25f061,
+    0x25f5fd, 0x25fb9b, 0x260139, 0x2606d8, 0x260c78, 0x261219, 0x2617ba, 0x261d5d, 0x262300, 0x2628a4,
+    0x262e49, 0x2633ef, 0x263995, 0x263f3d, 0x2644e5, 0x264a8e, 0x265038, 0x2655e3, 0x265b8f, 0x26613b,
+    0x2666e8, 0x266c96, 0x267245, 0x2677f5, 0x267da6, 0x268357, 0x26890a, 0x268ebd, 0x269471, 0x269a26,
+    0x269fdb, 0x26a592, 0x26ab49, 0x26b102, 0x26b6bb, 0x26bc75, 0x26c22f, 0x26c7eb, 0x26cda8, 0x26d365,
+    0x26d923, 0x26dee2, 0x26e4a2, 0x26ea63, 0x26f024, 0x26f5e7, 0x26fbaa, 0x27016e, 0x270733, 0x270cf9,
+    0x2712c0, 0x271887, 0x271e50, 0x272419, 0x2729e3, 0x272fae, 0x27357a, 0x273b46, 0x274114, 0x2746e2,
+    0x274cb2, 0x275282, 0x275853, 0x275e25, 0x2763f7, 0x2769cb, 0x276f9f, 0x277575, 0x277b4b, 0x278122,
+    0x2786fa, 0x278cd2, 0x2792ac, 0x279886, 0x279e62, 0x27a43e, 0x27aa1b, 0x27aff9, 0x27b5d8, 0x27bbb7,
+    0x27c198, 0x27c779, 0x27cd5c, 0x27d33f, 0x27d923, 0x27df08, 0x27e4ed, 0x27ead4, 0x27f0bc, 0x27f6a4,
+    0x27fc8d, 0x280277, 0x280862, 0x280e4e, 0x28143b, 0x281a29, 0x282017, 0x282607, 0x282bf7, 0x2831e8,
+    0x2837da, 0x283dcd, 0x2843c1, 0x2849b5, 0x284fab, 0x2855a1, 0x285b99, 0x286191, 0x28678a, 0x286d84,
+    0x28737f, 0x28797a, 0x287f77, 0x288575, 0x288b73, 0x289172, 0x289772, 0x289d73, 0x28a375, 0x28a978,
+    0x28af7c, 0x28b580, 0x28bb86, 0x28c18c, 0x28c794, 0x28cd9c, 0x28d3a5, 0x28d9af, 0x28dfba, 0x28e5c5,
+    0x28ebd2, 0x28f1df, 0x28f7ee, 0x28fdfd, 0x29040d, 0x290a1e, 0x291030, 0x291643, 0x291c57, 0x29226c,
+    0x292881, 0x292e98, 0x2934af, 0x293ac8, 0x2940e1, 0x2946fb, 0x294d16, 0x295332, 0x29594f, 0x295f6c,
+    0x29658b, 0x296bab, 0x2971cb, 0x2977ec, 0x297e0f, 0x298432, 0x298a56, 0x29907b, 0x2996a1, 0x299cc7,
+    0x29a2ef, 0x29a918, 0x29af41, 0x29b56c, 0x29bb97, 0x29c1c3, 0x29c7f0, 0x29ce1f, 0x29d44e, 0x29da7d,
+    0x29e0ae, 0x29e6e0, 0x29ed13, 0x29f346, 0x29f97b, 0x29ffb0, 0x2a05e6, 0x2a0c1e, 0x2a1256, 0x2a188f,
+    0x2a1ec9, 0x2a2504, 0x2a2b40, 0x2a317c, 0x2a37ba, 0x2a3df9, 0x2a4438, 0x2a4a79, 0x2a50ba, 0x2a56fd,
+    0x2a5d40, 0x2a6384, 0x2a69c9, 0x2a700f, 0x2a7656, 0x2a7c9e, 0x2a82e7, 0x2a8930, 0x2a8f7b, 0x2a95c7,
+    0x2a9c13, 0x2aa261, 0x2aa8af, 0x2aaefe, 0x2ab54f, 0x2abba0, 0x2ac1f2, 0x2ac845, 0x2ace99, 0x2ad4ee,
+    0x2adb44, 0x2ae19b, 0x2ae7f2, 0x2aee4b, 0x2af4a5, 0x2afaff, 0x2b015b, 0x2b07b7, 0x2b0e15, 0x2b1473,
+    0x2b1ad2, 0x2b2132, 0x2b2793, 0x2b2df6, 0x2b3459, 0x2b3abd, 0x2b4121, 0x2b4787, 0x2b4dee, 0x2b5456,
+    0x2b5abf, 0x2b6128, 0x2b6793, 0x2b6dfe, 0x2b746b, 0x2b7ad8, 0x2b8147, 0x2b87b6, 0x2b8e27, 0x2b9498,
+    0x2b9b0a, 0x2ba17d, 0x2ba7f1, 0x2bae66, 0x2bb4dc, 0x2bbb53, 0x2bc1cb, 0x2bc844, 0x2bcebe, 0x2bd539,
+    0x2bdbb5, 0x2be231, 0x2be8af, 0x2bef2e, 0x2bf5ad, 0x2bfc2e, 0x2c02b0, 0x2c0932, 0x2c0fb6, 0x2c163a,
+    0x2c1cbf, 0x2c2346, 0x2c29cd, 0x2c3055, 0x2c36df, 0x2c3d69, 0x2c43f4, 0x2c4a80, 0x2c510d, 0x2c579b,
+    0x2c5e2a, 0x2c64ba, 0x2c6b4b, 0x2c71dd, 0x2c7870, 0x2c7f04, 0x2c8599, 0x2c8c2f, 0x2c92c6, 0x2c995e,
+    0x2c9ff6, 0x2ca690, 0x2cad2b, 0x2cb3c7, 0x2cba63, 0x2cc101, 0x2cc7a0, 0x2cce3f, 0x2cd4e0, 0x2cdb82,
+    0x2ce224, 0x2ce8c8, 0x2cef6c, 0x2cf612, 0x2cfcb8, 0x2d0360, 0x2d0a08, 0x2d10b2, 0x2d175c, 0x2d1e08,
+    0x2d24b4, 0x2d2b61, 0x2d3210, 0x2d38bf, 0x2d3f6f, 0x2d4621, 0x2d4cd3, 0x2d5387, 0x2d5a3b, 0x2d60f0,
+    0x2d67a6, 0x2d6e5e, 0x2d7516, 0x2d7bcf, 0x2d828a, 0x2d8945, 0x2d9001, 0x2d96be, 0x2d9d7d, 0x2da43c,
+    0x2daafc, 0x2db1be, 0x2db880, 0x2dbf43, 0x2dc607, 0x2dcccd, 0x2dd393, 0x2dda5a, 0x2de122, 0x2de7ec,
+    0x2deeb6, 0x2df581, 0x2dfc4d, 0x2e031b, 0x2e09e9, 0x2e10b8, 0x2e1789, 0x2e1e5a, 0x2e252c, 0x2e2c00,
+    0x2e32d4, 0x2e39a9, 0x2e4080, 0x2e4757, 0x2e4e2f, 0x2e5509, 0x2e5be3, 0x2e62bf, 0x2e699b, 0x2e7079,
+    0x2e7757, 0x2e7e37, 0x2e8517, 0x2e8bf9, 0x2e92db, 0x2e99bf, 0x2ea0a3, 0x2ea789, 0x2eae70, 0x2eb557,
+    0x2ebc40, 0x2ec329, 0x2eca14, 0x2ed100, 0x2ed7ed, 0x2ededa, 0x2ee5c9, 0x2eecb9, 0x2ef3aa, 0x2efa9c,
+    0x2f018f, 0x2f0883, 0x2f0f78, 0x2f166e, 0x2f1d65, 0x2f245d, 0x2f2b56, 0x2f3250, 0x2f394b, 0x2f4047,
+    0x2f4744, 0x2f4e43, 0x2f5542, 0x2f5c42, 0x2f6344, 0x2f6a46, 0x2f7149, 0x2f784e, 0x2f7f53, 0x2f865a,
+    0x2f8d61, 0x2f946a, 0x2f9b74, 0x2fa27e, 0x2fa98a, 0x2fb097, 0x2fb7a5, 0x2fbeb4, 0x2fc5c4, 0x2fccd4,
+    0x2fd3e6, 0x2fdafa, 0x2fe20e, 0x2fe923, 0x2ff039, 0x2ff750, 0x2ffe68, 0x300582, 0x300c9c, 0x3013b8,
+    0x301ad4, 0x3021f2, 0x302910, 0x303030, 0x303751, 0x303e72, 0x304595, 0x304cb9, 0x3053de, 0x305b04,
+    0x30622b, 0x306953, 0x30707c, 0x3077a6, 0x307ed2, 0x3085fe, 0x308d2b, 0x30945a, 0x309b89, 0x30a2ba,
+    0x30a9ec, 0x30b11e, 0x30b852, 0x30bf87, 0x30c6bd, 0x30cdf4, 0x30d52c, 0x30dc65, 0x30e39f, 0x30eada,
+    0x30f217, 0x30f954, 0x310092, 0x3107d2, 0x310f12, 0x311654, 0x311d97, 0x3124db, 0x312c20, 0x313366,
+    0x313aad, 0x3141f5, 0x31493e, 0x315088, 0x3157d3, 0x315f20, 0x31666d, 0x316dbc, 0x31750c, 0x317c5c,
+    0x3183ae, 0x318b01, 0x319255, 0x3199aa, 0x31a100, 0x31a858, 0x31afb0, 0x31b709, 0x31be64, 0x31c5c0,
+    0x31cd1c, 0x31d47a, 0x31dbd9, 0x31e339, 0x31ea9a, 0x31f1fc, 0x31f95f, 0x3200c4, 0x320829, 0x320f8f,
+    0x3216f7, 0x321e60, 0x3225ca, 0x322d34, 0x3234a0, 0x323c0d, 0x32437c, 0x324aeb, 0x32525b, 0x3259cd,
+    0x32613f, 0x3268b3, 0x327028, 0x32779e, 0x327f15, 0x32868d, 0x328e06, 0x329580, 0x329cfc, 0x32a478,
+    0x32abf6, 0x32b375, 0x32baf5, 0x32c275, 0x32c9f8, 0x32d17b, 0x32d8ff, 0x32e084, 0x32e80b, 0x32ef93,
+    0x32f71b, 0x32fea5, 0x330630, 0x330dbc, 0x331549, 0x331cd8, 0x332467, 0x332bf8, 0x333389, 0x333b1c,
+    0x3342b0, 0x334a45, 0x3351db, 0x335972, 0x33610b, 0x3368a4, 0x33703f, 0x3377db, 0x337f78, 0x338716,
+    0x338eb5, 0x339655, 0x339df7, 0x33a599, 0x33ad3d, 0x33b4e2, 0x33bc87, 0x33c42f, 0x33cbd7, 0x33d380,
+    0x33db2a, 0x33e2d6, 0x33ea83, 0x33f231, 0x33f9e0, 0x340190, 0x340941, 0x3410f3, 0x3418a7, 0x34205c,
+    0x342811, 0x342fc8, 0x343781, 0x343f3a, 0x3446f4, 0x344eb0, 0x34566c, 0x345e2a, 0x3465e9, 0x346da9,
+    0x34756a, 0x347d2d, 0x3484f0, 0x348cb5, 0x34947b, 0x349c42, 0x34a40a, 0x34abd3, 0x34b39e, 0x34bb69,
+    0x34c336, 0x34cb04, 0x34d2d3, 0x34daa3, 0x34e275, 0x34ea47, 0x34f21b, 0x34f9f0, 0x3501c6, 0x35099d,
+    0x351175, 0x35194f, 0x352129, 0x352905, 0x3530e2, 0x3538c0, 0x3540a0, 0x354880, 0x355062, 0x355845,
+    0x356028, 0x35680e, 0x356ff4, 0x3577db, 0x357fc4, 0x3587ae, 0x358f99, 0x359785, 0x359f72, 0x35a761,
+    0x35af50, 0x35b741, 0x35bf33, 0x35c726, 0x35cf1b, 0x35d710, 0x35df07, 0x35e6ff, 0x35eef8, 0x35f6f2,
+    0x35feee, 0x3606ea, 0x360ee8, 0x3616e7, 0x361ee7, 0x3626e8, 0x362eeb, 0x3636ef, 0x363ef4, 0x3646fa,
+    0x364f01, 0x365709, 0x365f13, 0x36671e, 0x366f2a, 0x367737, 0x367f45, 0x368755, 0x368f66, 0x369778,
+    0x369f8b, 0x36a79f, 0x36afb5, 0x36b7cc, 0x36bfe4, 0x36c7fd, 0x36d017, 0x36d833, 0x36e04f, 0x36e86d,
+    0x36f08c, 0x36f8ad, 0x3700ce, 0x3708f1, 0x371115, 0x37193a, 0x372161, 0x372988, 0x3731b1, 0x3739db,
+    0x374206, 0x374a32, 0x375260, 0x375a8f, 0x3762bf, 0x376af0, 0x377323, 0x377b56, 0x37838b, 0x378bc1,
+    0x3793f8, 0x379c31, 0x37a46b, 0x37aca6, 0x37b4e2, 0x37bd1f, 0x37c55e, 0x37cd9e, 0x37d5df, 0x37de21,
+    0x37e664, 0x37eea9, 0x37f6ef, 0x37ff36, 0x38077f, 0x380fc8, 0x381813, 0x38205f, 0x3828ac, 0x3830fb,
+    0x38394b, 0x38419c, 0x3849ee, 0x385241, 0x385a96, 0x3862ec, 0x386b43, 0x38739b, 0x387bf5, 0x388450,
+    0x388cac, 0x389509, 0x389d68, 0x38a5c7, 0x38ae28, 0x38b68b, 0x38beee, 0x38c753, 0x38cfb9, 0x38d820,
+    0x38e089, 0x38e8f2, 0x38f15d, 0x38f9ca, 0x390237, 0x390aa6, 0x391316, 0x391b87, 0x3923f9, 0x392c6d,
+    0x3934e2, 0x393d58, 0x3945cf, 0x394e48, 0x3956c2, 0x395f3d, 0x3967ba, 0x397037, 0x3978b6, 0x398137,
+    0x3989b8, 0x39923b, 0x399abf, 0x39a344, 0x39abcb, 0x39b452, 0x39bcdb, 0x39c566, 0x39cdf1, 0x39d67e,
+    0x39df0c, 0x39e79c, 0x39f02c, 0x39f8be, 0x3a0151, 0x3a09e6, 0x3a127b, 0x3a1b12, 0x3a23aa, 0x3a2c44,
+    0x3a34df, 0x3a3d7b, 0x3a4618, 0x3a4eb7, 0x3a5757, 0x3a5ff8, 0x3a689a, 0x3a713e, 0x3a79e3, 0x3a8289
+};
+
+uint16_t sequencer_sid_freq(int16_t semitone, int16_t pitch) {
+    int cents = semitone * 100 + pitch;
+    int octave = cents / 1200;
+    if (cents < 0) octave = (cents - 1199) / 1200;
+    int i = cents - octave * 1200;
+    uint32_t value = sid_freq_table[i];
+    // value has 8 fractional bits
+    int shift = octave - 8;
+    if (shift <= -24 || shift >= 16) return 0;
+    return (uint16_t)((shift < 0) ? (value >> -shift) : (value << shift));
 }
 
 int16_t varonum_eval(var_or_number_t* varonum, sequencer_t* sequencer) {
@@ -359,7 +561,7 @@ void update_sequence(sequence_t* sequence, sequencer_t* sequencer) {
     sequencer->values[var_index] = value;
 }
 
-float compute_freq(sequencer_t* sequencer, int v)       // voice v
+uint16_t compute_freq(sequencer_t* sequencer, int v)       // voice v
 {
     // compute freqence from  note, scale,trans,pitch
     int16_t note = varonum_eval(&sequencer->voices[v].note, sequencer);
@@ -377,29 +579,37 @@ float compute_freq(sequencer_t* sequencer, int v)       // voice v
     int16_t finger = note - (octave * fingers);
     int16_t semitone = octave * 12 + finger_notes[finger];
     semitone += transpose;
-    return note_freq(440.0, (float)semitone + (float)pitch/100);
+    return sequencer_sid_freq(semitone, pitch);
 }
 
-void sequencer_update_sid(sequencer_t* sequencer, m6581_t* sid)
+#define SID_REG_CTRL(ch)    ((ch)*7+4)
+#define SID_REG_CUTOFF_LO   (21)
+#define SID_REG_CUTOFF_HI   (22)
+#define SID_REG_RESFILT     (23)
+#define SID_REG_MODEVOL     (24)
+
+uint32_t sequencer_sid_writes(sequencer_t* sequencer, uint8_t* regs)
 {
+    uint32_t mask = 0;
     if (sequencer->muted) {
         // close all channel gates, keep all olther control bits the same
         for (int channel=0;channel<NUM_CHANNELS;++channel) {
-            uint8_t ctrl = sid->voice[channel].ctrl & ~(M6581_CTRL_GATE);
-            _m6581_set_ctrl(&sid->voice[channel], ctrl);
+            regs[SID_REG_CTRL(channel)] &= ~(M6581_CTRL_GATE);
+            mask |= 1 << SID_REG_CTRL(channel);
         }
-        return;
+        return mask;
     }
 
     int16_t channel_filter[NUM_CHANNELS] = {0,0,0};     // TODO: keep per voice filter settings for when channel has no voice assigned
 
     for (int channel=0;channel<NUM_CHANNELS;++channel){
+        uint8_t* r = &regs[channel*7];
         var_or_number_t* voice_param = &sequencer->channel_voice_params[channel];
         int16_t voice_index = varonum_eval(voice_param, sequencer)-1;
         if (voice_index < 0 || voice_index >= sequencer->num_voices) {
             // close channel gate, keep all olther control bits the same
-            uint8_t ctrl = sid->voice[channel].ctrl & ~(M6581_CTRL_GATE);
-            _m6581_set_ctrl(&sid->voice[channel], ctrl);
+            r[4] &= ~(M6581_CTRL_GATE);
+            mask |= 1 << SID_REG_CTRL(channel);
             continue;
         };
         voice_t* voice = &sequencer->voices[voice_index];
@@ -409,44 +619,80 @@ void sequencer_update_sid(sequencer_t* sequencer, m6581_t* sid)
         int16_t sync = varonum_eval(&voice->sync, sequencer);
         int16_t ring = varonum_eval(&voice->ring, sequencer);
         int16_t wave = varonum_eval(&voice->waveform, sequencer);
-        _m6581_set_ctrl(&sid->voice[channel], (gate&1) + ((sync&1)<<1) + ((ring&1)<<2 ) + ((wave&15)<<4));
+        r[4] = (gate&1) + ((sync&1)<<1) + ((ring&1)<<2 ) + ((wave&15)<<4);
         
         // freq
-        float freq = compute_freq(sequencer, voice_index);
-        int16_t sid_freq_value = freq_to_sid_value_pal(freq);
-        _m6581_set_freq_hi(&sid->voice[channel], (sid_freq_value>>8));
-        _m6581_set_freq_lo(&sid->voice[channel], (sid_freq_value&0xFF));
+        uint16_t sid_freq_value = compute_freq(sequencer, voice_index);
+        r[0] = sid_freq_value & 0xFF;
+        r[1] = sid_freq_value >> 8;
 
         // pulsewidth
         int16_t pulsewidth = varonum_eval(&voice->pulsewidth, sequencer);
-        _m6581_set_pw_lo(&sid->voice[channel], (pulsewidth&0xFF));
-        _m6581_set_pw_hi(&sid->voice[channel], (pulsewidth>>8));
+        r[2] = pulsewidth & 0xFF;
+        r[3] = pulsewidth >> 8;
 
         // envelope
         int16_t attack = varonum_eval(&voice->attack, sequencer);
         int16_t decay = varonum_eval(&voice->decay, sequencer);
         int16_t sustain = varonum_eval(&voice->sustain, sequencer);
         int16_t release = varonum_eval(&voice->release, sequencer);
-        _m6581_set_atkdec(&sid->voice[channel], ((attack&15)<<4) + (decay&15));
-        _m6581_set_susrel(&sid->voice[channel], ((sustain&15)<<4) + (release&15));
+        r[5] = ((attack&15)<<4) + (decay&15);
+        r[6] = ((sustain&15)<<4) + (release&15);
+        mask |= 0x7F << (channel*7);
 
         // save filter setting for this channel
         channel_filter[channel] = varonum_eval(&voice->filter, sequencer);
     }
 
     int16_t cutoff = varonum_eval(&sequencer->cutoff, sequencer);
-    _m6581_set_cutoff_lo(&sid->filter, (cutoff&0x7));            // bits 0-2
-    _m6581_set_cutoff_hi(&sid->filter, (cutoff>>3));             // bits 3-10
+    regs[SID_REG_CUTOFF_LO] = cutoff & 0x7;            // bits 0-2
+    regs[SID_REG_CUTOFF_HI] = cutoff >> 3;             // bits 3-10
 
     int16_t resonance = varonum_eval(&sequencer->resonance, sequencer);
+    regs[SID_REG_RESFILT] = ((resonance&15)<<4)  + (channel_filter[0]&1) + ((channel_filter[1]&1)<<1) + ((channel_filter[2]&1)<<2);
 
-    _m6581_set_resfilt(&sid->filter, 
-        ((resonance&15)<<4)  + (channel_filter[0]&1) + ((channel_filter[1]&1)<<1) + ((channel_filter[2]&1)<<2));
+    int16_t volume = varonum_eval(&sequencer->volume, sequencer);
+    int16_t filter_mode = varonum_eval(&sequencer->filter_mode, sequencer);
+    regs[SID_REG_MODEVOL] = (volume&15) + ((filter_mode&15)<<4);
 
-     int16_t volume = varonum_eval(&sequencer->volume, sequencer);
-     int16_t filter_mode = varonum_eval(&sequencer->filter_mode, sequencer);
-    _m6581_set_modevol(sid, (volume&15) + ((filter_mode&15)<<4));
-    
+    mask |= (1 << SID_REG_CUTOFF_LO) | (1 << SID_REG_CUTOFF_HI) | (1 << SID_REG_RESFILT) | (1 << SID_REG_MODEVOL);
+    return mask;
+}
+
+void sequencer_update_sid(sequencer_t* sequencer, m6581_t* sid)
+{
+    uint8_t regs[SID_NUM_REGS] = {0};
+    for (int channel=0;channel<NUM_CHANNELS;++channel) {
+        regs[SID_REG_CTRL(channel)] = sid->voice[channel].ctrl;
+    }
+    uint32_t mask = sequencer_sid_writes(sequencer, regs);
+    sequencer_write_sid(sid, regs, mask);
+}
+
+void sequencer_write_sid(m6581_t* sid, const uint8_t* regs, uint32_t mask)
+{
+    for (int reg=0;reg<SID_NUM_REGS;++reg) {
+        if (0 == (mask & (1 << reg))) continue;
+        uint8_t data = regs[reg];
+        if (reg < SID_REG_CUTOFF_LO) {
+            m6581_voice_t* voice = &sid->voice[reg / 7];
+            switch (reg % 7) {
+                case 0: _m6581_set_freq_lo(voice, data); break;
+                case 1: _m6581_set_freq_hi(voice, data); break;
+                case 2: _m6581_set_pw_lo(voice, data); break;
+                case 3: _m6581_set_pw_hi(voice, data); break;
+                case 4: _m6581_set_ctrl(voice, data); break;
+                case 5: _m6581_set_atkdec(voice, data); break;
+                case 6: _m6581_set_susrel(voice, data); break;
+            }
+        }
+        else switch (reg) {
+            case SID_REG_CUTOFF_LO: _m6581_set_cutoff_lo(&sid->filter, data); break;
+            case SID_REG_CUTOFF_HI: _m6581_set_cutoff_hi(&sid->filter, data); break;
+            case SID_REG_RESFILT: _m6581_set_resfilt(&sid->filter, data); break;
+            case SID_REG_MODEVOL: _m6581_set_modevol(sid, data); break;
+        }
+    }
 }
 
 void update_variables(sequencer_t* sequencer, int frame) {
@@ -480,7 +726,7 @@ void update_variables(sequencer_t* sequencer, int frame) {
     }
 }
 
-void update_preview(sequencer_t* sequencer)
+void sequencer_update_preview(sequencer_t* sequencer)
 {
     preview_t* preview = &sequencer->preview;
 
@@ -522,10 +768,9 @@ void update_preview(sequencer_t* sequencer)
     memcpy(sequencer->gate_states,gate_backup,sizeof(gate_backup));
 }
 
-void sequencer_update(sequencer_t* sequencer) 
+// update variables and time, without the preview (e.g. for headless rendering)
+void sequencer_advance(sequencer_t* sequencer)
 {
-    update_preview(sequencer);
-
     // update variables using frame number as input (and previous state)
     update_variables(sequencer, sequencer->frame);
         
@@ -534,6 +779,12 @@ void sequencer_update(sequencer_t* sequencer)
     }
 }
 
+void sequencer_update(sequencer_t* sequencer) 
+{
+    sequencer_update_preview(sequencer);
+    sequencer_advance(sequencer);
+}
+
 void sequencer_update_framebuffer(sequencer_t* sequencer, uint8_t* framebuffer, chips_display_info_t info) 
 {
     // TODO: what would be a good visualization of the sequencer state?
@@ -655,106 +906,332 @@ void sequencer_export_data(sequencer_t* sequencer, char* buffer, int size, int w
 }
 
 
-bool varonum_import(var_or_number_t* varonum, char* buffer, int* pos) 
+// single pass tokenizer for the comma separated list of integers
+
+typedef struct {
+    const char* buffer;
+    int pos;
+    sequencer_import_result_t* result;
+} tokenizer_t;
+
+bool tokenizer_error(tokenizer_t* tok, const char* p, const char* message)
 {
-    int argsread = sscanf(&buffer[*pos], "%hhd, %hd,", &varonum->variable, &varonum->number);
-    if (argsread != 2) return false;
-    int count=0;
-    while (buffer[*pos]!=0) {
-        if (buffer[*pos]==',') count+=1;
-        (*pos)++;
-        if (count==2) break;
+    sequencer_import_result_t* result = tok->result;
+    result->error = message;
+    result->error_pos = (int)(p - tok->buffer);
+    result->error_line = 1;
+    result->error_column = 1;
+    for (const char* c = tok->buffer; c < p; c++) {
+        if (*c == '\n') {
+            result->error_line++;
+            result->error_column = 1;
+        }
+        else {
+            result->error_column++;
+        }
     }
-    return (count==2);
+    return false;
 }
 
-
-bool var_import(char* variable, char* buffer, int* pos) 
+// read the next integer in [min, max], followed by a comma or end of text
+bool tokenizer_next(tokenizer_t* tok, int min, int max, int* value)
 {
-    int argsread = sscanf(&buffer[*pos], "%hhd,", variable);
-    if (argsread != 1) return false;
-    int count=0;
-    while (buffer[*pos]!=0) {
-        if (buffer[*pos]==',') count+=1;
-        (*pos)++;
-        if (count==1) break;
+    const char* p = &tok->buffer[tok->pos];
+    while ((*p == ' ') || (*p == '\n') || (*p == '\r') || (*p == '\t')) p++;
+    const char* start = p;
+    bool negative = false;
+    if ((*p == '-') || (*p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    if ((*p < '0') || (*p > '9')) {
+        return tokenizer_error(tok, p, (*p == 0) ? "unexpected end of data" : "number expected");
+    }
+    int v = 0;
+    while ((*p >= '0') && (*p <= '9')) {
+        if (v < 100000) v = v*10 + (*p - '0');    // saturate, anything this large is out of range anyway
+        p++;
+    }
+    if (negative) v = -v;
+    if ((v < min) || (v > max)) {
+        return tokenizer_error(tok, start, "number out of range");
     }
-    return (count==1);
+    while ((*p == ' ') || (*p == '\t')) p++;
+    if (*p == ',') {
+        p++;
+    }
+    else if ((*p != 0) && (*p != '\n') && (*p != '\r')) {
+        return tokenizer_error(tok, p, "',' expected");
+    }
+    tok->pos = (int)(p - tok->buffer);
+    *value = v;
+    return true;
 }
 
-bool import_uint8(uint8_t* variable, char* buffer, int* pos) 
+bool varonum_import(var_or_number_t* varonum, tokenizer_t* tok) 
 {
-    int argsread = sscanf(&buffer[*pos], "%hhd,", variable);
-    if (argsread != 1) return false;
-    int count=0;
-    while (buffer[*pos]!=0) {
-        if (buffer[*pos]==',') count+=1;
-        (*pos)++;
-        if (count==1) break;
-    }
-    return (count==1);
+    int variable, number;
+    if (!tokenizer_next(tok, -128, 255, &variable)) return false;
+    if (!tokenizer_next(tok, INT16_MIN, INT16_MAX, &number)) return false;
+    varonum->variable = (char)variable;
+    varonum->number = (int16_t)number;
+    return true;
 }
 
-bool sequencer_import_data(sequencer_t* sequencer, char* buffer)
+bool var_import(char* variable, tokenizer_t* tok) 
 {
-    int pos = 0;
+    int v;
+    if (!tokenizer_next(tok, -128, 255, &v)) return false;
+    *variable = (char)v;
+    return true;
+}
+
+bool import_uint8(uint8_t* variable, tokenizer_t* tok) 
+{
+    int v;
+    if (!tokenizer_next(tok, 0, 255, &v)) return false;
+    *variable = (uint8_t)v;
+    return true;
+}
 
-    if(!import_uint8(&sequencer->num_voices, buffer, &pos)) return false;
+bool sequencer_import_data(sequencer_t* sequencer, const char* buffer, sequencer_import_result_t* result)
+{
+    sequencer_import_result_t dummy_result;
+    if (!result) result = &dummy_result;
+    memset(result, 0, sizeof(sequencer_import_result_t));
+    tokenizer_t tok = { .buffer = buffer, .pos = 0, .result = result };
+    tokenizer_t* t = &tok;
+
+    if(!import_uint8(&sequencer->num_voices, t)) return false;
     if (sequencer->num_voices > MAX_VOICES) sequencer->num_voices = MAX_VOICES;
 
     for (int v=0; v<sequencer->num_voices; v++) {
         voice_t* voice = &sequencer->voices[v];
-        if(!varonum_import(&voice->gate, buffer, &pos)) return false;
-        if(!varonum_import(&voice->note, buffer, &pos)) return false;
-        if(!varonum_import(&voice->scale, buffer, &pos)) return false;
-        if(!varonum_import(&voice->transpose, buffer, &pos)) return false;
-        if(!varonum_import(&voice->pitch, buffer, &pos)) return false;
-        if(!varonum_import(&voice->waveform, buffer, &pos)) return false;
-        if(!varonum_import(&voice->pulsewidth, buffer, &pos)) return false;
-        if(!varonum_import(&voice->ring, buffer, &pos)) return false;
-        if(!varonum_import(&voice->sync, buffer, &pos)) return false;
-        if(!varonum_import(&voice->attack, buffer, &pos)) return false;
-        if(!varonum_import(&voice->decay, buffer, &pos)) return false;
-        if(!varonum_import(&voice->sustain, buffer, &pos)) return false;
-        if(!varonum_import(&voice->release, buffer, &pos)) return false;
-        if(!varonum_import(&voice->filter, buffer, &pos)) return false;
+        if(!varonum_import(&voice->gate, t)) return false;
+        if(!varonum_import(&voice->note, t)) return false;
+        if(!varonum_import(&voice->scale, t)) return false;
+        if(!varonum_import(&voice->transpose, t)) return false;
+        if(!varonum_import(&voice->pitch, t)) return false;
+        if(!varonum_import(&voice->waveform, t)) return false;
+        if(!varonum_import(&voice->pulsewidth, t)) return false;
+        if(!varonum_import(&voice->ring, t)) return false;
+        if(!varonum_import(&voice->sync, t)) return false;
+        if(!varonum_import(&voice->attack, t)) return false;
+        if(!varonum_import(&voice->decay, t)) return false;
+        if(!varonum_import(&voice->sustain, t)) return false;
+        if(!varonum_import(&voice->release, t)) return false;
+        if(!varonum_import(&voice->filter, t)) return false;
     }
 
     for (int channel=0; channel<NUM_CHANNELS; channel++) {
-        if(!varonum_import(&sequencer->channel_voice_params[channel], buffer, &pos)) return false;
+        if(!varonum_import(&sequencer->channel_voice_params[channel], t)) return false;
     }
 
-    if(!varonum_import(&sequencer->filter_mode, buffer, &pos)) return false;
-    if(!varonum_import(&sequencer->cutoff, buffer, &pos)) return false;
-    if(!varonum_import(&sequencer->resonance, buffer, &pos)) return false;
-    if(!varonum_import(&sequencer->volume, buffer, &pos)) return false;
+    if(!varonum_import(&sequencer->filter_mode, t)) return false;
+    if(!varonum_import(&sequencer->cutoff, t)) return false;
+    if(!varonum_import(&sequencer->resonance, t)) return false;
+    if(!varonum_import(&sequencer->volume, t)) return false;
 
-    if(!import_uint8(&sequencer->num_sequences, buffer, &pos)) return false;
+    if(!import_uint8(&sequencer->num_sequences, t)) return false;
     if (sequencer->num_sequences > MAX_SEQUENCES) sequencer->num_sequences = MAX_SEQUENCES;
         
     for (int s=0; s<sequencer->num_sequences; s++) {
         sequence_t* seq = &sequencer->sequences[s];
-        if(!var_import(&seq->variable, buffer, &pos)) return false;
-        if(!varonum_import(&seq->count, buffer, &pos)) return false;
-        if(!varonum_import(&seq->add1, buffer, &pos)) return false;
-        if(!varonum_import(&seq->div1, buffer, &pos)) return false;
-        if(!varonum_import(&seq->mul1, buffer, &pos)) return false;
-        if(!varonum_import(&seq->mod1, buffer, &pos)) return false;
-        if(!varonum_import(&seq->base, buffer, &pos)) return false;
-        if(!varonum_import(&seq->mod2, buffer, &pos)) return false;
-        if(!varonum_import(&seq->mul2, buffer, &pos)) return false;
-        if(!varonum_import(&seq->div2, buffer, &pos)) return false;
-        if(!varonum_import(&seq->add2, buffer, &pos)) return false;
-        if(!varonum_import(&seq->array, buffer, &pos)) return false;
-    }
-
-    if(!import_uint8(&sequencer->num_arrays, buffer, &pos)) return false;
+        if(!var_import(&seq->variable, t)) return false;
+        if(!varonum_import(&seq->count, t)) return false;
+        if(!varonum_import(&seq->add1, t)) return false;
+        if(!varonum_import(&seq->div1, t)) return false;
+        if(!varonum_import(&seq->mul1, t)) return false;
+        if(!varonum_import(&seq->mod1, t)) return false;
+        if(!varonum_import(&seq->base, t)) return false;
+        if(!varonum_import(&seq->mod2, t)) return false;
+        if(!varonum_import(&seq->mul2, t)) return false;
+        if(!varonum_import(&seq->div2, t)) return false;
+        if(!varonum_import(&seq->add2, t)) return false;
+        if(!varonum_import(&seq->array, t)) return false;
+    }
+
+    if(!import_uint8(&sequencer->num_arrays, t)) return false;
     if (sequencer->num_arrays > MAX_ARRAYS) sequencer->num_arrays = MAX_ARRAYS;
     for (int a=0; a<sequencer->num_arrays; a++) {
-        if(!import_uint8(&sequencer->array_sizes[a], buffer, &pos)) return false;
+        if(!import_uint8(&sequencer->array_sizes[a], t)) return false;
         if (sequencer->array_sizes[a] > MAX_ARRAY_SIZE) sequencer->array_sizes[a] = MAX_ARRAY_SIZE;
         for (int i=0; i<sequencer->array_sizes[a]; i++) {
-            if(!varonum_import(&sequencer->arrays[a][i], buffer, &pos)) return false;
+            if(!varonum_import(&sequencer->arrays[a][i], t)) return false;
+        }
+    }
+    result->end = tok.pos;
+    return true;
+}
+
+// ----------- binary import/export ------------
+
+// collect all var_or_number_t parameters of the patch, in export order
+int collect_params(sequencer_t* sequencer, var_or_number_t** params) 
+{
+    int n = 0;
+    for (int v=0; v<sequencer->num_voices; v++) {
+        voice_t* voice = &sequencer->voices[v];
+        params[n++] = &voice->gate;
+        params[n++] = &voice->note;
+        params[n++] = &voice->scale;
+        params[n++] = &voice->transpose;
+        params[n++] = &voice->pitch;
+        params[n++] = &voice->waveform;
+        params[n++] = &voice->pulsewidth;
+        params[n++] = &voice->ring;
+        params[n++] = &voice->sync;
+        params[n++] = &voice->attack;
+        params[n++] = &voice->decay;
+        params[n++] = &voice->sustain;
+        params[n++] = &voice->release;
+        params[n++] = &voice->filter;
+    }
+    for (int channel=0; channel<NUM_CHANNELS; channel++) {
+        params[n++] = &sequencer->channel_voice_params[channel];
+    }
+    params[n++] = &sequencer->filter_mode;
+    params[n++] = &sequencer->cutoff;
+    params[n++] = &sequencer->resonance;
+    params[n++] = &sequencer->volume;
+    for (int s=0; s<sequencer->num_sequences; s++) {
+        sequence_t* seq = &sequencer->sequences[s];
+        params[n++] = &seq->count;
+        params[n++] = &seq->add1;
+        params[n++] = &seq->div1;
+        params[n++] = &seq->mul1;
+        params[n++] = &seq->mod1;
+        params[n++] = &seq->base;
+        params[n++] = &seq->mod2;
+        params[n++] = &seq->mul2;
+        params[n++] = &seq->div2;
+        params[n++] = &seq->add2;
+        params[n++] = &seq->array;
+    }
+    for (int a=0; a<sequencer->num_arrays; a++) {
+        for (int i=0; i<sequencer->array_sizes[a]; i++) {
+            params[n++] = &sequencer->arrays[a][i];
+        }
+    }
+    assert(n <= SEQUENCER_MAX_PARAMS);
+    return n;
+}
+
+uint32_t binary_checksum(const uint8_t* data, int size)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (int i=0; i<size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+int sequencer_export_binary(sequencer_t* sequencer, uint8_t* buffer, int size)
+{
+    var_or_number_t* params[SEQUENCER_MAX_PARAMS];
+    const int num_params = collect_params(sequencer, params);
+    const int mask_size = (num_params + 7) / 8;
+    const int payload_size = 3 + sequencer->num_arrays + sequencer->num_sequences + mask_size + num_params * 2;
+    if (SEQUENCER_BINARY_HEADER_SIZE + payload_size > size) {
+        return 0;
+    }
+
+    uint8_t* p = &buffer[SEQUENCER_BINARY_HEADER_SIZE];
+    *p++ = sequencer->num_voices;
+    *p++ = sequencer->num_sequences;
+    *p++ = sequencer->num_arrays;
+    for (int a=0; a<sequencer->num_arrays; a++) {
+        *p++ = sequencer->array_sizes[a];
+    }
+    for (int s=0; s<sequencer->num_sequences; s++) {
+        *p++ = (uint8_t)sequencer->sequences[s].variable;
+    }
+    uint8_t* mask = p;
+    memset(mask, 0, mask_size);
+    p += mask_size;
+    for (int i=0; i<num_params; i++) {
+        const var_or_number_t* param = params[i];
+        uint16_t operand;
+        if (param->variable) {
+            mask[i >> 3] |= 1 << (i & 7);
+            operand = (uint8_t)param->variable;
+        }
+        else {
+            operand = (uint16_t)param->number;
+        }
+        *p++ = (uint8_t)operand;
+        *p++ = (uint8_t)(operand >> 8);
+    }
+    assert(p == &buffer[SEQUENCER_BINARY_HEADER_SIZE + payload_size]);
+
+    const uint32_t checksum = binary_checksum(&buffer[SEQUENCER_BINARY_HEADER_SIZE], payload_size);
+    const uint8_t header[SEQUENCER_BINARY_HEADER_SIZE] = {
+        'N', 'S', 'P', 'B', 
+        SEQUENCER_BINARY_VERSION, 0,
+        (uint8_t)payload_size, (uint8_t)(payload_size >> 8),
+        (uint8_t)checksum, (uint8_t)(checksum >> 8), (uint8_t)(checksum >> 16), (uint8_t)(checksum >> 24),
+    };
+    memcpy(buffer, header, sizeof(header));
+    return SEQUENCER_BINARY_HEADER_SIZE + payload_size;
+}
+
+bool sequencer_is_binary(const uint8_t* buffer, int size)
+{
+    return (size >= 4) && (buffer[0] == 'N') && (buffer[1] == 'S') && (buffer[2] == 'P') && (buffer[3] == 'B');
+}
+
+bool sequencer_import_binary(sequencer_t* sequencer, const uint8_t* buffer, int size)
+{
+    // validate header, counts, sizes and checksum before touching the sequencer
+    if (!sequencer_is_binary(buffer, size) || (size < SEQUENCER_BINARY_HEADER_SIZE + 3)) return false;
+    if (buffer[4] != SEQUENCER_BINARY_VERSION) return false;
+    const int payload_size = buffer[6] | (buffer[7] << 8);
+    const uint32_t checksum = buffer[8] | (buffer[9] << 8) | (buffer[10] << 16) | ((uint32_t)buffer[11] << 24);
+    if (SEQUENCER_BINARY_HEADER_SIZE + payload_size > size) return false;
+    const uint8_t* p = &buffer[SEQUENCER_BINARY_HEADER_SIZE];
+    if (binary_checksum(p, payload_size) != checksum) return false;
+
+    const uint8_t num_voices = p[0];
+    const uint8_t num_sequences = p[1];
+    const uint8_t num_arrays = p[2];
+    if ((num_voices > MAX_VOICES) || (num_sequences > MAX_SEQUENCES) || (num_arrays > MAX_ARRAYS)) return false;
+    if (payload_size < 3 + num_arrays + num_sequences) return false;
+    p += 3;
+    const uint8_t* array_sizes = p;
+    int num_params = num_voices * 14 + NUM_CHANNELS + 4 + num_sequences * 11;
+    for (int a=0; a<num_arrays; a++) {
+        if (array_sizes[a] > MAX_ARRAY_SIZE) return false;
+        num_params += array_sizes[a];
+    }
+    p += num_arrays;
+    const uint8_t* variables = p;
+    p += num_sequences;
+    const int mask_size = (num_params + 7) / 8;
+    if (payload_size != 3 + num_arrays + num_sequences + mask_size + num_params * 2) return false;
+    const uint8_t* mask = p;
+    const uint8_t* operands = p + mask_size;
+
+    // decode
+    sequencer->num_voices = num_voices;
+    sequencer->num_sequences = num_sequences;
+    sequencer->num_arrays = num_arrays;
+    memcpy(sequencer->array_sizes, array_sizes, num_arrays);
+    for (int s=0; s<num_sequences; s++) {
+        sequencer->sequences[s].variable = (char)variables[s];
+    }
+    var_or_number_t* params[SEQUENCER_MAX_PARAMS];
+    const int n = collect_params(sequencer, params);
+    assert(n == num_params); (void)n;
+    for (int i=0; i<num_params; i++) {
+        const uint16_t operand = operands[i*2] | (operands[i*2+1] << 8);
+        if (mask[i >> 3] & (1 << (i & 7))) {
+            params[i]->variable = (char)operand;
+            params[i]->number = 0;
+        }
+        else {
+            params[i]->variable = 0;
+            params[i]->number = (int16_t)operand;
         }
     }
     return true;
@@ -762,21 +1239,154 @@ bool sequencer_import_data(sequencer_t* sequencer, char* buffer)
 
 // ----------- snapshot -----------
 
-uint32_t sequencer_save_snapshot(sequencer_t* sys, sequencer_t* dst) {
-    CHIPS_ASSERT(sys && dst);
-    *dst = *sys;
-    return SEQUENCER_SNAPSHOT_VERSION;
+static uint8_t* snapshot_put(uint8_t* p, uint32_t value, int num_bytes) {
+    for (int i=0; i<num_bytes; i++) {
+        *p++ = (uint8_t)(value >> (8*i));
+    }
+    return p;
 }
 
-bool sequencer_load_snapshot(sequencer_t* sys, uint32_t version, sequencer_t* src) {
-    CHIPS_ASSERT(sys && src);
-    if (version != SEQUENCER_SNAPSHOT_VERSION) {
+static uint32_t snapshot_get(const uint8_t** p, int num_bytes) {
+    uint32_t value = 0;
+    for (int i=0; i<num_bytes; i++) {
+        value |= (uint32_t)(*(*p)++) << (8*i);
+    }
+    return value;
+}
+
+static uint32_t snapshot_float_bits(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static float snapshot_bits_float(uint32_t bits) {
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+int sequencer_save_snapshot(sequencer_t* sequencer, uint8_t* buffer, int size)
+{
+    CHIPS_ASSERT(sequencer && buffer);
+    if (size < SEQUENCER_SNAPSHOT_HEADER_SIZE) {
+        return 0;
+    }
+    const int patch_size = sequencer_export_binary(sequencer, &buffer[SEQUENCER_SNAPSHOT_HEADER_SIZE], size - SEQUENCER_SNAPSHOT_HEADER_SIZE);
+    if (patch_size == 0) {
+        return 0;
+    }
+    const preview_t* preview = &sequencer->preview;
+    const int num_columns = (preview->num_columns < 0) ? 0 : (preview->num_columns > MAX_PREVIEW_COLS) ? MAX_PREVIEW_COLS : preview->num_columns;
+    const int num_highlighters = (preview->num_highlighters < 0) ? 0 : (preview->num_highlighters > MAX_HIGHLIGHTERS) ? MAX_HIGHLIGHTERS : preview->num_highlighters;
+    const int runtime_size = 8 + MAX_VARIABLES*2 + 10 + num_columns + 1 + num_highlighters*24;
+    uint8_t* runtime = &buffer[SEQUENCER_SNAPSHOT_HEADER_SIZE + patch_size];
+    if (runtime + runtime_size > buffer + size) {
+        return 0;
+    }
+
+    uint8_t* p = runtime;
+    p = snapshot_put(p, sequencer->running, 1);
+    p = snapshot_put(p, sequencer->muted, 1);
+    p = snapshot_put(p, (uint32_t)sequencer->frame, 4);
+    uint8_t gates = 0;
+    for (int c=0; c<NUM_CHANNELS; c++) {
+        gates |= sequencer->gate_states[c] ? (1 << c) : 0;
+    }
+    p = snapshot_put(p, gates, 1);
+    p = snapshot_put(p, MAX_VARIABLES, 1);
+    for (int v=0; v<MAX_VARIABLES; v++) {
+        p = snapshot_put(p, (uint16_t)sequencer->values[v], 2);
+    }
+    p = snapshot_put(p, (uint32_t)preview->step, 4);
+    p = snapshot_put(p, (uint32_t)preview->offset, 4);
+    p = snapshot_put(p, preview->follow, 1);
+    p = snapshot_put(p, (uint32_t)num_columns, 1);
+    for (int c=0; c<num_columns; c++) {
+        p = snapshot_put(p, (uint8_t)preview->variables[c], 1);
+    }
+    p = snapshot_put(p, (uint32_t)num_highlighters, 1);
+    for (int h=0; h<num_highlighters; h++) {
+        const highlighter_t* hl = &preview->highlighters[h];
+        p = snapshot_put(p, (uint32_t)hl->value, 4);
+        p = snapshot_put(p, (uint32_t)hl->modulo, 4);
+        for (int i=0; i<4; i++) {
+            p = snapshot_put(p, snapshot_float_bits(hl->color[i]), 4);
+        }
+    }
+    assert(p == runtime + runtime_size);
+
+    uint8_t* h = buffer;
+    *h++ = 'N'; *h++ = 'S'; *h++ = 'S'; *h++ = 'N';
+    *h++ = SEQUENCER_SNAPSHOT_VERSION;
+    *h++ = 0;
+    h = snapshot_put(h, (uint32_t)runtime_size, 2);
+    snapshot_put(h, binary_checksum(runtime, runtime_size), 4);
+    return SEQUENCER_SNAPSHOT_HEADER_SIZE + patch_size + runtime_size;
+}
+
+bool sequencer_load_snapshot(sequencer_t* sequencer, const uint8_t* buffer, int size)
+{
+    CHIPS_ASSERT(sequencer && buffer);
+    if ((size < SEQUENCER_SNAPSHOT_HEADER_SIZE) || (0 != memcmp(buffer, "NSSN", 4)) || (buffer[4] != SEQUENCER_SNAPSHOT_VERSION)) {
+        return false;
+    }
+    const uint8_t* h = &buffer[6];
+    const int runtime_size = (int)snapshot_get(&h, 2);
+    const uint32_t checksum = snapshot_get(&h, 4);
+    const uint8_t* patch = &buffer[SEQUENCER_SNAPSHOT_HEADER_SIZE];
+    const int patch_avail = size - SEQUENCER_SNAPSHOT_HEADER_SIZE;
+    if (!sequencer_is_binary(patch, patch_avail) || (patch_avail < SEQUENCER_BINARY_HEADER_SIZE)) {
+        return false;
+    }
+    const int patch_size = SEQUENCER_BINARY_HEADER_SIZE + (patch[6] | (patch[7] << 8));
+    const uint8_t* runtime = patch + patch_size;
+    if ((patch_size + runtime_size > patch_avail) || (binary_checksum(runtime, runtime_size) != checksum)) {
         return false;
     }
+
+    // decode into a copy, the sequencer is only changed if everything is valid
     static sequencer_t im;
-    im = *src;
-    *sys = im;
-    // TODO: whno not *sys = *src?
+    sequencer_init(&im);
+    if (!sequencer_import_binary(&im, patch, patch_size)) {
+        return false;
+    }
+    const uint8_t* p = runtime;
+    const uint8_t* end = runtime + runtime_size;
+    if (end - p < 8) return false;
+    im.running = snapshot_get(&p, 1) != 0;
+    im.muted = snapshot_get(&p, 1) != 0;
+    im.frame = (int32_t)snapshot_get(&p, 4);
+    const uint8_t gates = (uint8_t)snapshot_get(&p, 1);
+    for (int c=0; c<NUM_CHANNELS; c++) {
+        im.gate_states[c] = (gates >> c) & 1;
+    }
+    const int num_values = (int)snapshot_get(&p, 1);
+    if ((num_values > MAX_VARIABLES) || (end - p < num_values*2 + 10)) return false;
+    for (int v=0; v<num_values; v++) {
+        im.values[v] = (int16_t)snapshot_get(&p, 2);
+    }
+    preview_t* preview = &im.preview;
+    preview->step = (int32_t)snapshot_get(&p, 4);
+    preview->offset = (int32_t)snapshot_get(&p, 4);
+    preview->follow = snapshot_get(&p, 1) != 0;
+    preview->num_columns = (int)snapshot_get(&p, 1);
+    if ((preview->num_columns > MAX_PREVIEW_COLS) || (end - p < preview->num_columns + 1)) return false;
+    for (int c=0; c<preview->num_columns; c++) {
+        preview->variables[c] = (char)snapshot_get(&p, 1);
+    }
+    preview->num_highlighters = (int)snapshot_get(&p, 1);
+    if ((preview->num_highlighters > MAX_HIGHLIGHTERS) || (end - p != preview->num_highlighters*24)) return false;
+    for (int i=0; i<preview->num_highlighters; i++) {
+        highlighter_t* hl = &preview->highlighters[i];
+        hl->value = (int32_t)snapshot_get(&p, 4);
+        hl->modulo = (int32_t)snapshot_get(&p, 4);
+        for (int c=0; c<4; c++) {
+            hl->color[c] = snapshot_bits_float(snapshot_get(&p, 4));
+        }
+    }
+    sequencer_update_preview(&im);
+    *sequencer = im;
     return true;
 }
 
@@ -0,0 +1,245 @@
+#pragma once
+/*
+    SID register write traces.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    Include the following headers before including sidtrace.h:
+        - chips/chips_common.h
+        - chips/m6581.h
+        - sequencer.h
+
+    A trace records the SID register writes of every sequencer frame, as
+    computed by sequencer_sid_writes(). Replaying a trace into the SID
+    (see render_replay_frame()) sounds the same as running the sequencer,
+    at a fraction of the cost, and two traces of the same patch are equal
+    byte for byte, so a trace also serves as golden reference.
+
+    Only registers that change are stored. SID registers only hold state,
+    writing the value a register already has does nothing.
+
+    Format, little-endian:
+
+        header:   'N','S','T','R', version (u8), number of registers (u8),
+                  reserved (u16), number of frames (u32)
+        events:   frame delta (varint), register mask (varint), followed
+                  by one byte per register in the mask, lowest first
+
+    There is one event per frame in which a register changed. The frame
+    delta is relative to the previous event (to frame 0 for the first
+    one). Varints hold 7 bits per byte, least significant first, the top
+    bit is set if more bytes follow.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIDTRACE_VERSION (1)
+#define SIDTRACE_HEADER_SIZE (12)
+
+typedef struct {
+    uint8_t* data;          // header and events, size bytes
+    int size;
+    int capacity;
+    uint32_t num_frames;
+    uint32_t event_frame;   // frame of the last event
+    uint32_t known;         // registers written at least once
+    uint8_t regs[SID_NUM_REGS];
+} sidtrace_t;
+
+typedef struct {
+    const uint8_t* data;
+    int size;
+    int pos;                // next event
+    uint32_t num_frames;
+    uint32_t frame;         // next frame
+    uint32_t event_frame;   // frame of the next event
+} sidtrace_player_t;
+
+// start an empty trace
+void sidtrace_init(sidtrace_t* trace);
+void sidtrace_discard(sidtrace_t* trace);
+// append the register writes of the next frame, returns false if out of memory
+bool sidtrace_record(sidtrace_t* trace, const uint8_t* regs, uint32_t mask);
+// checks the header, false if data is not a trace
+bool sidtrace_player_init(sidtrace_player_t* player, const uint8_t* data, int size);
+// register writes of the next frame, updates regs, returns the mask of changed registers
+uint32_t sidtrace_player_next(sidtrace_player_t* player, uint8_t* regs);
+bool sidtrace_player_done(const sidtrace_player_t* player);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <stdlib.h>
+#include <string.h>
+
+static bool _sidtrace_reserve(sidtrace_t* trace, int num_bytes) {
+    if (trace->size + num_bytes <= trace->capacity) {
+        return true;
+    }
+    int capacity = trace->capacity ? trace->capacity : 4096;
+    while (capacity < trace->size + num_bytes) {
+        capacity *= 2;
+    }
+    uint8_t* data = realloc(trace->data, capacity);
+    if (!data) {
+        return false;
+    }
+    trace->data = data;
+    trace->capacity = capacity;
+    return true;
+}
+
+static void _sidtrace_put_varint(sidtrace_t* trace, uint32_t value) {
+    while (value >= 0x80) {
+        trace->data[trace->size++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    trace->data[trace->size++] = (uint8_t)value;
+}
+
+static bool _sidtrace_get_varint(sidtrace_player_t* player, uint32_t* value) {
+    uint32_t result = 0;
+    for (int shift = 0; (shift < 32) && (player->pos < player->size); shift += 7) {
+        const uint8_t byte = player->data[player->pos++];
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if (0 == (byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+void sidtrace_init(sidtrace_t* trace) {
+    CHIPS_ASSERT(trace);
+    memset(trace, 0, sizeof(sidtrace_t));
+    if (!_sidtrace_reserve(trace, SIDTRACE_HEADER_SIZE)) {
+        return;
+    }
+    const uint8_t header[SIDTRACE_HEADER_SIZE] = { 'N', 'S', 'T', 'R', SIDTRACE_VERSION, SID_NUM_REGS };
+    memcpy(trace->data, header, sizeof(header));
+    trace->size = SIDTRACE_HEADER_SIZE;
+}
+
+void sidtrace_discard(sidtrace_t* trace) {
+    CHIPS_ASSERT(trace);
+    free(trace->data);
+    memset(trace, 0, sizeof(sidtrace_t));
+}
+
+bool sidtrace_record(sidtrace_t* trace, const uint8_t* regs, uint32_t mask) {
+    CHIPS_ASSERT(trace && regs);
+    if (!trace->data) {
+        return false;
+    }
+    uint32_t changed = 0;
+    for (int reg = 0; reg < SID_NUM_REGS; reg++) {
+        const uint32_t bit = 1u << reg;
+        if ((mask & bit) && (!(trace->known & bit) || (trace->regs[reg] != regs[reg]))) {
+            changed |= bit;
+        }
+    }
+    const uint32_t frame = trace->num_frames;
+    if (changed) {
+        // two varints of at most 5 bytes, one byte per register
+        if (!_sidtrace_reserve(trace, 10 + SID_NUM_REGS)) {
+            return false;
+        }
+        _sidtrace_put_varint(trace, frame - trace->event_frame);
+        _sidtrace_put_varint(trace, changed);
+        for (int reg = 0; reg < SID_NUM_REGS; reg++) {
+            if (changed & (1u << reg)) {
+                trace->data[trace->size++] = regs[reg];
+                trace->regs[reg] = regs[reg];
+            }
+        }
+        trace->known |= changed;
+        trace->event_frame = frame;
+    }
+    trace->num_frames = frame + 1;
+    for (int i = 0; i < 4; i++) {
+        trace->data[8 + i] = (uint8_t)(trace->num_frames >> (8 * i));
+    }
+    return true;
+}
+
+bool sidtrace_player_init(sidtrace_player_t* player, const uint8_t* data, int size) {
+    CHIPS_ASSERT(player && data);
+    memset(player, 0, sizeof(sidtrace_player_t));
+    if ((size < SIDTRACE_HEADER_SIZE) || (0 != memcmp(data, "NSTR", 4)) ||
+        (data[4] != SIDTRACE_VERSION) || (data[5] != SID_NUM_REGS)) {
+        return false;
+    }
+    player->data = data;
+    player->size = size;
+    player->pos = SIDTRACE_HEADER_SIZE;
+    player->num_frames = data[8] | (data[9] << 8) | (data[10] << 16) | ((uint32_t)data[11] << 24);
+    uint32_t delta = 0;
+    if (_sidtrace_get_varint(player, &delta)) {
+        player->event_frame = delta;
+    }
+    else {
+        player->pos = size;
+    }
+    return true;
+}
+
+uint32_t sidtrace_player_next(sidtrace_player_t* player, uint8_t* regs) {
+    CHIPS_ASSERT(player && regs);
+    if (sidtrace_player_done(player)) {
+        return 0;
+    }
+    const uint32_t frame = player->frame++;
+    if ((player->pos >= player->size) || (frame != player->event_frame)) {
+        return 0;
+    }
+    uint32_t mask = 0;
+    if (!_sidtrace_get_varint(player, &mask)) {
+        player->pos = player->size;
+        return 0;
+    }
+    mask &= (1u << SID_NUM_REGS) - 1;
+    int num_regs = 0;
+    for (int reg = 0; reg < SID_NUM_REGS; reg++) {
+        num_regs += (mask >> reg) & 1;
+    }
+    if (player->pos + num_regs > player->size) {
+        // truncated trace, drop the last event
+        player->pos = player->size;
+        return 0;
+    }
+    for (int reg = 0; reg < SID_NUM_REGS; reg++) {
+        if (mask & (1u << reg)) {
+            regs[reg] = player->data[player->pos++];
+        }
+    }
+    uint32_t delta = 0;
+    if (_sidtrace_get_varint(player, &delta)) {
+        player->event_frame = frame + delta;
+    }
+    else {
+        player->pos = player->size;
+    }
+    return mask;
+}
+
+bool sidtrace_player_done(const sidtrace_player_t* player) {
+    CHIPS_ASSERT(player);
+    return player->frame >= player->num_frames;
+}
+
+#endif
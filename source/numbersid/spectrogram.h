@@ -0,0 +1,140 @@
+#pragma once
+/*
+    Spectrogram helpers, shared by the FFT display and the headless renderer.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    A spectrogram column is computed from a block of fft_size audio samples
+    (oldest first): Hann window, FFT, then the magnitudes of the lower
+    part of the spectrum are mapped to 8-bit palette indices, one per
+    pixel row. Use spectrogram_palette() to turn indices into colors.
+
+    The window, twiddle factors and bit-reversal permutation are computed
+    once in spectrogram_init(), which makes a column several times cheaper
+    than C_FFT_real() for batch use. A spectrogram_t is read-only after
+    init, so one can be shared by several threads.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include "lamefft.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPECTROGRAM_MAX_FFT_SIZE FFT_MAX
+
+typedef struct {
+    int fft_size;       // must be a power of two <= SPECTROGRAM_MAX_FFT_SIZE
+    int height;         // number of pixel rows per column
+    double window[SPECTROGRAM_MAX_FFT_SIZE];
+    double cos_table[SPECTROGRAM_MAX_FFT_SIZE/2];
+    double sin_table[SPECTROGRAM_MAX_FFT_SIZE/2];
+    uint16_t bitrev[SPECTROGRAM_MAX_FFT_SIZE];
+} spectrogram_t;
+
+// fill a 256 entry RGBA8 palette for the spectrogram palette indices
+void spectrogram_palette(uint32_t* palette);
+void spectrogram_init(spectrogram_t* spec, int fft_size, int height);
+// compute one column from fft_size samples, write height pixels 'stride' bytes apart
+void spectrogram_column(const spectrogram_t* spec, const float* samples, uint8_t* pixels, int stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+
+#ifdef CHIPS_IMPL
+
+#include <math.h>
+#include <assert.h>
+
+#define SPECTROGRAM_RGBA8(r,g,b) (0xFF000000|(b<<16)|(g<<8)|(r))
+
+void spectrogram_palette(uint32_t* palette) {
+    for (int i=0;i<256;++i) {
+        int r = (i & 255);
+        int g = (i & 127) << 1;
+        int b = (i & 63) << 2;
+        palette[i] = SPECTROGRAM_RGBA8(r,g,b);
+    }
+}
+
+void spectrogram_init(spectrogram_t* spec, int fft_size, int height) {
+    assert(spec);
+    assert((fft_size > 0) && (fft_size <= SPECTROGRAM_MAX_FFT_SIZE) && ((fft_size & (fft_size-1)) == 0));
+    assert(height > 0);
+    spec->fft_size = fft_size;
+    spec->height = height;
+    // Hann window
+    for (int i=0;i<fft_size;i++) {
+        spec->window[i] = 0.5 * (1.0 - cos(2.0 * M_PI * i / (fft_size - 1)));
+    }
+    // twiddle factors
+    for (int i=0;i<fft_size/2;i++) {
+        spec->cos_table[i] = cos(2.0 * M_PI * i / fft_size);
+        spec->sin_table[i] = sin(2.0 * M_PI * i / fft_size);
+    }
+    // bit-reversal permutation
+    int bits = 0;
+    while ((1 << bits) < fft_size) bits++;
+    for (int i=0;i<fft_size;i++) {
+        int r = 0;
+        for (int b=0;b<bits;b++) {
+            if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+        }
+        spec->bitrev[i] = (uint16_t)r;
+    }
+}
+
+void spectrogram_column(const spectrogram_t* spec, const float* samples, uint8_t* pixels, int stride) {
+    const int n = spec->fft_size;
+    const int h = spec->height;
+
+    // apply window, store in bit-reversed order
+    double re[SPECTROGRAM_MAX_FFT_SIZE];
+    double im[SPECTROGRAM_MAX_FFT_SIZE];
+    for (int i=0;i<n;i++) {
+        re[spec->bitrev[i]] = samples[i] * spec->window[i];
+        im[i] = 0.0;
+    }
+
+    // iterative radix-2 FFT
+    for (int size=2;size<=n;size*=2) {
+        const int half = size / 2;
+        const int step = n / size;
+        for (int i=0;i<n;i+=size) {
+            for (int j=0;j<half;j++) {
+                const double wr = spec->cos_table[j*step];
+                const double wi = -spec->sin_table[j*step];
+                const int a = i + j;
+                const int b = a + half;
+                const double tr = wr*re[b] - wi*im[b];
+                const double ti = wr*im[b] + wi*re[b];
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+
+    // map magnitudes of the lower part of the spectrum to palette indices
+    const int f_start = 2;
+    const int f_end = n / 8;
+    for (int y=0;y<h;y++) {
+        int f = (y*(f_end-f_start))/h + f_start;
+        double magnitude = sqrt(re[f]*re[f] + im[f]*im[f]);
+        int color = 512*log(1+magnitude)/log(1+n);
+        if (color > 255) color = 255;
+        pixels[y*stride] = color;
+    }
+}
+
+#endif
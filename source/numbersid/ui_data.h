@@ -126,6 +126,7 @@ static void _ui_data_draw_state(ui_data_t* win) {
     sequencer_t* sequencer = win->sequencer;
 
     static char buffer[1024*64];
+    static sequencer_import_result_t import_result;
 
     ImGui::TextWrapped("To export data, press the Export button, then copy the text from the text area below.\n"
                       "To import data, paste the data into the text area below and press the Import button.\n" 
@@ -139,7 +140,7 @@ static void _ui_data_draw_state(ui_data_t* win) {
         memset(buffer, 0, sizeof(buffer));
     }
     if (ImGui::Button("Import")) {
-        bool result = sequencer_import_data(sequencer, buffer);
+        bool result = sequencer_import_data(sequencer, buffer, &import_result);
         if (!result) {
             ImGui::OpenPopup("Import Error");
         }
@@ -153,6 +154,7 @@ static void _ui_data_draw_state(ui_data_t* win) {
     if (ImGui::BeginPopupModal("Import Error", NULL, ImGuiWindowFlags_AlwaysAutoResize))
     {
         ImGui::Text("Error importing data.");    
+        ImGui::Text("Line %d, column %d: %s", import_result.error_line, import_result.error_column, import_result.error);
         if (ImGui::Button("OK", ImVec2(120, 0))) { ImGui::CloseCurrentPopup(); }
         ImGui::EndPopup();
     }
@@ -0,0 +1,261 @@
+#pragma once
+/*#
+    # ui_library.h
+
+    Patch library window for numbersid.
+
+    Do this:
+    ~~~C
+    #define CHIPS_UI_IMPL
+    ~~~
+    before you include this file in *one* C++ file to create the
+    implementation.
+
+    Optionally provide the following macros with your own implementation
+
+    ~~~C
+    CHIPS_ASSERT(c)
+    ~~~
+        your own assert macro (default: assert(c))
+
+    Include the following headers before the including the *declaration*:
+        - patchlib.h
+        - ui_util.h
+        - ui_settings.h
+
+    Include the following headers before including the *implementation*:
+        - imgui.h
+        - patchlib.h
+        - ui_util.h
+
+    The library is opened through open_cb when the window is first shown,
+    so an application can leave creating the library files until then.
+
+    Only the visible rows of the list are drawn, and the thumbnails are
+    requested through thumbnail_cb for those rows only, so the cost of the
+    window does not depend on the size of the library.
+
+    All strings provided to ui_library_init() must remain alive until
+    ui_library_discard() is called!
+
+    ## zlib/libpng license
+
+    Copyright (c) 2025 Rick van der Meiden
+    Copyright (c) 2018 Andre Weissflog
+
+    This software is provided 'as-is', without any express or implied warranty.
+    In no event will the authors be held liable for any damages arising from the
+    use of this software.
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+        1. The origin of this software must not be misrepresented; you must not
+        claim that you wrote the original software. If you use this software in a
+        product, an acknowledgment in the product documentation would be
+        appreciated but is not required.
+        2. Altered source versions must be plainly marked as such, and must not
+        be misrepresented as being the original software.
+        3. This notice may not be removed or altered from any source
+        distribution.
+#*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UI_LIBRARY_THUMBNAIL_WIDTH (100)
+#define UI_LIBRARY_THUMBNAIL_HEIGHT (75)
+
+// open the library on first use, returns false if it could not be opened
+typedef bool (*ui_library_open_cb)(void);
+// add the current patch under a name, returns the index of the new patch or -1
+typedef int (*ui_library_add_cb)(const char* name);
+// load a patch, returns false if it could not be loaded
+typedef bool (*ui_library_load_cb)(int index);
+// thumbnail texture of a patch, 0 if it has none or if it is not loaded yet
+typedef ui_texture_t (*ui_library_thumbnail_cb)(int index);
+
+/* setup parameters for ui_library_init()
+    NOTE: all string data must remain alive until ui_library_discard()!
+*/
+typedef struct ui_library_desc_t {
+    const char* title;          /* window title */
+    const patchlib_t* library;  /* library to show, owned by the application */
+    ui_library_open_cb open_cb;
+    ui_library_add_cb add_cb;
+    ui_library_load_cb load_cb;
+    ui_library_thumbnail_cb thumbnail_cb;
+    int x, y;                   /* initial window position */
+    int w, h;                   /* initial window size (or default size of 0) */
+    bool open;                  /* initial window open state */
+} ui_library_desc_t;
+
+typedef struct ui_library_t {
+    const char* title;
+    const patchlib_t* library;
+    ui_library_open_cb open_cb;
+    ui_library_add_cb add_cb;
+    ui_library_load_cb load_cb;
+    ui_library_thumbnail_cb thumbnail_cb;
+    float init_x, init_y;
+    float init_w, init_h;
+    bool open;
+    bool last_open;
+    bool valid;
+    char name[PATCHLIB_NAME_SIZE];  /* name for the next added patch */
+    int selected;                   /* last added or loaded patch, -1: none */
+    const char* error;              /* error of the last add or load, 0: none */
+} ui_library_t;
+
+void ui_library_init(ui_library_t* win, const ui_library_desc_t* desc);
+void ui_library_discard(ui_library_t* win);
+void ui_library_draw(ui_library_t* win);
+void ui_library_save_settings(ui_library_t* win, ui_settings_t* settings);
+void ui_library_load_settings(ui_library_t* win, const ui_settings_t* settings);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/*-- IMPLEMENTATION (include in C++ source) ----------------------------------*/
+#ifdef CHIPS_UI_IMPL
+#ifndef __cplusplus
+#error "implementation must be compiled as C++"
+#endif
+#include <string.h> /* memset */
+#include <time.h>
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
+
+void ui_library_init(ui_library_t* win, const ui_library_desc_t* desc) {
+    CHIPS_ASSERT(win && desc);
+    CHIPS_ASSERT(desc->title);
+    CHIPS_ASSERT(desc->library);
+    CHIPS_ASSERT(desc->open_cb && desc->add_cb && desc->load_cb && desc->thumbnail_cb);
+    memset(win, 0, sizeof(ui_library_t));
+    win->title = desc->title;
+    win->library = desc->library;
+    win->open_cb = desc->open_cb;
+    win->add_cb = desc->add_cb;
+    win->load_cb = desc->load_cb;
+    win->thumbnail_cb = desc->thumbnail_cb;
+    win->init_x = (float) desc->x;
+    win->init_y = (float) desc->y;
+    win->init_w = (float) ((desc->w == 0) ? 420 : desc->w);
+    win->init_h = (float) ((desc->h == 0) ? 500 : desc->h);
+    win->open = win->last_open = desc->open;
+    win->selected = -1;
+    win->valid = true;
+}
+
+void ui_library_discard(ui_library_t* win) {
+    CHIPS_ASSERT(win && win->valid);
+    win->valid = false;
+}
+
+static void _ui_library_draw_row(ui_library_t* win, int index) {
+    const patchlib_record_t* record = patchlib_record(win->library, index);
+    if (!record) {
+        return;
+    }
+    ImGui::PushID(index);
+    const ImVec2 thumbnail_size(UI_LIBRARY_THUMBNAIL_WIDTH, UI_LIBRARY_THUMBNAIL_HEIGHT);
+    const ui_texture_t thumbnail = win->thumbnail_cb(index);
+    if (thumbnail) {
+        ImGui::Image((ImTextureID)thumbnail, thumbnail_size);
+    }
+    else {
+        ImGui::Dummy(thumbnail_size);
+    }
+    ImGui::SameLine();
+    ImGui::BeginGroup();
+    if (index == win->selected) {
+        ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "%s", record->name[0] ? record->name : "(unnamed)");
+    }
+    else {
+        ImGui::Text("%s", record->name[0] ? record->name : "(unnamed)");
+    }
+    char date[32] = "";
+    const time_t t = (time_t)record->time;
+    const struct tm* tm = localtime(&t);
+    if (tm) {
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M", tm);
+    }
+    ImGui::TextDisabled("#%d  %s", index + 1, date);
+    if (ImGui::Button("Load")) {
+        win->error = win->load_cb(index) ? 0 : "Patch is damaged and was not loaded.";
+        win->selected = index;
+    }
+    ImGui::EndGroup();
+    ImGui::PopID();
+}
+
+static void _ui_library_draw_state(ui_library_t* win) {
+    ImGui::InputText("Name", win->name, sizeof(win->name));
+    ImGui::SameLine();
+    if (ImGui::Button("Add")) {
+        const int index = win->add_cb(win->name);
+        win->error = (index < 0) ? (win->library->error ? win->library->error : "Patch was not added.") : 0;
+        if (index >= 0) {
+            win->selected = index;
+            win->name[0] = 0;
+            // scroll to the new patch, it's the first row
+            ImGui::SetNextWindowScroll(ImVec2(0.0f, 0.0f));
+        }
+    }
+    const int count = patchlib_count(win->library);
+    if (win->error) {
+        ImGui::TextColored(ImVec4(1.0f, 0.25f, 0.25f, 1.0f), "%s", win->error);
+    }
+    else {
+        ImGui::Text("%d patches", count);
+    }
+    ImGui::Separator();
+
+    // newest first, only the visible rows are drawn
+    ImGui::BeginChild("##library_list", ImVec2(0, 0), false);
+    const float row_height = UI_LIBRARY_THUMBNAIL_HEIGHT + ImGui::GetStyle().ItemSpacing.y;
+    ImGuiListClipper clipper;
+    clipper.Begin(count, row_height);
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+            _ui_library_draw_row(win, count - 1 - row);
+        }
+    }
+    clipper.End();
+    ImGui::EndChild();
+}
+
+void ui_library_draw(ui_library_t* win) {
+    CHIPS_ASSERT(win && win->valid);
+    ui_util_handle_window_open_dirty(&win->open, &win->last_open);
+    if (!win->open) {
+        return;
+    }
+    ImGui::SetNextWindowPos(ImVec2(win->init_x, win->init_y), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(win->init_w, win->init_h), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin(win->title, &win->open)) {
+        if (win->open_cb()) {
+            _ui_library_draw_state(win);
+        }
+        else {
+            ImGui::TextColored(ImVec4(1.0f, 0.25f, 0.25f, 1.0f), "%s", win->library->error ? win->library->error : "Library could not be opened.");
+        }
+    }
+    ImGui::End();
+}
+
+void ui_library_save_settings(ui_library_t* win, ui_settings_t* settings) {
+    CHIPS_ASSERT(win && settings);
+    ui_settings_add(settings, win->title, win->open);
+}
+
+void ui_library_load_settings(ui_library_t* win, const ui_settings_t* settings) {
+    CHIPS_ASSERT(win && settings);
+    win->open = ui_settings_isopen(settings, win->title);
+}
+#endif /* CHIPS_UI_IMPL */
@@ -24,6 +24,7 @@
     - ui_util.h
     - ui_settings.h
     - ui_snapshot.h
+    - history.h
     - ui_m6581.h
     - ui_audio.h
     - ui_display.h
@@ -32,6 +33,8 @@
     - ui_variables.h
     - ui_preview.h
     - ui_data.h
+    - ui_library.h
+    - ui_profiler.h
     - ui_help
 
     ## zlib/libpng license
@@ -63,6 +66,20 @@ extern "C" {
 
 // reboot callback
 typedef void (*ui_numbersid_boot_cb)(sequencer_t* seq);
+// start or stop recording the audio output, returns true if recording
+typedef bool (*ui_numbersid_record_cb)(bool start);
+// write the timeline trace recorded so far
+typedef void (*ui_numbersid_trace_cb)(void);
+
+// thumbnails of the snapshot slots, all in one texture
+typedef struct {
+    ui_texture_t texture;
+    int slot_width, slot_height;        // size of a thumbnail in pixels
+    int columns, rows;                  // slot i is at column i % columns, row i / columns
+    uint32_t valid;                     // one bit per slot with a thumbnail
+} ui_numbersid_thumbnails_t;
+// called when a snapshot menu is opened for the first time, returns the thumbnails
+typedef const ui_numbersid_thumbnails_t* (*ui_numbersid_thumbnails_cb)(void);
 
 // setup params for ui_numbersid_init()
 typedef struct {
@@ -71,7 +88,11 @@ typedef struct {
     int audio_num_samples;
     float* audio_sample_buffer;
     ui_numbersid_boot_cb boot_cb;
+    ui_numbersid_record_cb record_cb;   // optional, no recording if not set
+    ui_numbersid_trace_cb trace_cb;     // optional, no trace menu item if not set
     ui_snapshot_desc_t snapshot;
+    ui_numbersid_thumbnails_cb thumbnails_cb;   // optional, no thumbnails if not set
+    ui_library_desc_t library;          // optional, no patch library if library.library is not set
     ui_display_desc_t display;
 } ui_numbersid_desc_t;
 
@@ -79,6 +100,9 @@ typedef struct {
     sequencer_t* sequencer;
     
     ui_numbersid_boot_cb boot_cb;
+    ui_numbersid_record_cb record_cb;
+    ui_numbersid_trace_cb trace_cb;
+    bool recording;
     ui_m6581_t ui_sid;
     ui_audio_t ui_audio;
     ui_timecontrol_t ui_timecontrol;
@@ -87,9 +111,16 @@ typedef struct {
     ui_arrays_t ui_arrays;
     ui_preview_t ui_preview;
     ui_data_t ui_data;
+    ui_library_t ui_library;
+    ui_profiler_t ui_profiler;
     ui_help_t ui_help;
     ui_snapshot_t snapshot;
+    void (*snapshot_save_cb)(size_t slot_index);
+    bool (*snapshot_load_cb)(size_t slot_index);
+    ui_numbersid_thumbnails_cb thumbnails_cb;
+    const ui_numbersid_thumbnails_t* thumbnails;    // 0 until a snapshot menu was opened
     ui_display_t display;
+    history_t history;                  // undo and redo of the sequencer configuration
 } ui_numbersid_t;
 
 
@@ -116,6 +147,7 @@ void ui_string_to_varonum(char* str, var_or_number_t* varonum);
 #ifndef __cplusplus
 #error "implementation must be compiled as C++"
 #endif
+#include <stdio.h> /* snprintf */
 #include <string.h> /* memset */
 #ifndef CHIPS_ASSERT
     #include <assert.h>
@@ -126,14 +158,79 @@ void ui_string_to_varonum(char* str, var_or_number_t* varonum);
 #pragma clang diagnostic ignored "-Wmissing-field-initializers"
 #endif
 
+static void _ui_numbersid_draw_thumbnail(ui_numbersid_t* ui, size_t slot) {
+    const ui_numbersid_thumbnails_t* thumbnails = ui->thumbnails;
+    if (!thumbnails || !thumbnails->texture || !(thumbnails->valid & (1u << slot))) {
+        ImGui::TextDisabled("%s", ui->snapshot.slots[slot].valid ? "(no screenshot)" : "(empty)");
+        return;
+    }
+    const float du = 1.0f / thumbnails->columns;
+    const float dv = 1.0f / thumbnails->rows;
+    const ImVec2 uv0((slot % thumbnails->columns) * du, (slot / thumbnails->columns) * dv);
+    const ImVec2 uv1(uv0.x + du, uv0.y + dv);
+    ImGui::Image((ImTextureID)thumbnails->texture, ImVec2((float)thumbnails->slot_width, (float)thumbnails->slot_height), uv0, uv1);
+}
+
+// like ui_snapshot_menus(), with the thumbnails from the shared texture
+static void _ui_numbersid_draw_snapshot_menus(ui_numbersid_t* ui) {
+    char label[32];
+    for (int load = 0; load < 2; load++) {
+        if (!ImGui::BeginMenu(load ? "Load Snapshot" : "Save Snapshot")) {
+            continue;
+        }
+        if (!ui->thumbnails && ui->thumbnails_cb) {
+            ui->thumbnails = ui->thumbnails_cb();
+        }
+        for (size_t slot = 0; slot < UI_SNAPSHOT_MAX_SLOTS; slot++) {
+            const bool valid = ui->snapshot.slots[slot].valid;
+            snprintf(label, sizeof(label), "Slot %d", (int)slot);
+            if (ImGui::MenuItem(label, 0, false, load ? valid : true)) {
+                if (load) {
+                    ui->snapshot_load_cb(slot);
+                }
+                else {
+                    ui->snapshot.slots[slot].valid = true;
+                    ui->snapshot_save_cb(slot);
+                }
+            }
+            if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+                ImGui::BeginTooltip();
+                _ui_numbersid_draw_thumbnail(ui, slot);
+                ImGui::EndTooltip();
+            }
+        }
+        ImGui::EndMenu();
+    }
+}
+
 static void _ui_numbersid_draw_menu(ui_numbersid_t* ui) {
     CHIPS_ASSERT(ui && ui->sequencer);
     if (ImGui::BeginMainMenuBar()) {
         if (ImGui::BeginMenu("System")) {
-            ui_snapshot_menus(&ui->snapshot);
+            _ui_numbersid_draw_snapshot_menus(ui);
+            if (ui->ui_library.valid) {
+                ImGui::MenuItem("Patch Library", 0, &ui->ui_library.open);
+            }
             if (ImGui::MenuItem("Reboot")) {
                 ui->boot_cb(ui->sequencer);
             }
+            if (ui->record_cb && ImGui::MenuItem("Record Audio", 0, ui->recording)) {
+                ui->recording = ui->record_cb(!ui->recording);
+            }
+            if (ui->trace_cb && ImGui::MenuItem("Save Trace")) {
+                ui->trace_cb();
+            }
+            ImGui::EndMenu();
+        }
+        if (ImGui::BeginMenu("Edit")) {
+            if (ImGui::MenuItem("Undo", "Ctrl+Z", false, history_can_undo(&ui->history))) {
+                history_undo(&ui->history, ui->sequencer);
+            }
+            if (ImGui::MenuItem("Redo", "Ctrl+Y", false, history_can_redo(&ui->history))) {
+                history_redo(&ui->history, ui->sequencer);
+            }
+            ImGui::Separator();
+            ImGui::TextDisabled("%d steps, %.1f KB", history_num_steps(&ui->history), history_num_bytes(&ui->history) / 1024.0f);
             ImGui::EndMenu();
         }
         if (ImGui::BeginMenu("Sequencer")) {
@@ -149,6 +246,7 @@ static void _ui_numbersid_draw_menu(ui_numbersid_t* ui) {
             ImGui::MenuItem("SID(MOS6581)", 0, &ui->ui_sid.open);
             ImGui::MenuItem("Audio", 0, &ui->ui_audio.open);
             ImGui::MenuItem("FFT", 0, &ui->display.open);
+            ImGui::MenuItem("Profiler", 0, &ui->ui_profiler.open);
             ImGui::EndMenu();
         }
         if (ImGui::BeginMenu("Help")) {
@@ -184,7 +282,13 @@ void ui_numbersid_init(ui_numbersid_t* ui, const ui_numbersid_desc_t* ui_desc) {
     CHIPS_ASSERT(ui_desc->boot_cb);
     ui->sequencer = ui_desc->sequencer;
     ui->boot_cb = ui_desc->boot_cb;
+    ui->record_cb = ui_desc->record_cb;
+    ui->trace_cb = ui_desc->trace_cb;
     ui_snapshot_init(&ui->snapshot, &ui_desc->snapshot);
+    ui->snapshot_save_cb = ui_desc->snapshot.save_cb;
+    ui->snapshot_load_cb = ui_desc->snapshot.load_cb;
+    ui->thumbnails_cb = ui_desc->thumbnails_cb;
+    history_init(&ui->history, ui->sequencer);
     int x = 20, y = 20, dx = 10, dy = 10;
     {
         ui_m6581_desc_t desc = {0};
@@ -272,6 +376,22 @@ void ui_numbersid_init(ui_numbersid_t* ui, const ui_numbersid_desc_t* ui_desc) {
         ui_data_init(&ui->ui_data, &desc);
     }
     x += dx; y += dy;
+    if (ui_desc->library.library) {
+        ui_library_desc_t desc = ui_desc->library;
+        desc.title = "Patch Library";
+        desc.x = x;
+        desc.y = y;
+        ui_library_init(&ui->ui_library, &desc);
+    }
+    x += dx; y += dy;
+    {
+        ui_profiler_desc_t desc = {0};
+        desc.title = "Profiler";
+        desc.x = x;
+        desc.y = y;
+        ui_profiler_init(&ui->ui_profiler, &desc);
+    }
+    x += dx; y += dy;
     {
         ui_help_desc_t desc = {0};
         desc.title = "Help";
@@ -291,12 +411,37 @@ void ui_numbersid_discard(ui_numbersid_t* ui) {
     ui_arrays_discard(&ui->ui_arrays);
     ui_preview_discard(&ui->ui_preview);
     ui_data_discard(&ui->ui_data);
+    if (ui->ui_library.valid) {
+        ui_library_discard(&ui->ui_library);
+    }
+    ui_profiler_discard(&ui->ui_profiler);
     ui_help_discard(&ui->ui_help);
     ui_audio_discard(&ui->ui_audio);
     ui_display_discard(&ui->display);
     //ui->sequencer = 0;  // TODO??
 }
 
+// Ctrl+Z undo, Ctrl+Y or Ctrl+Shift+Z redo, a completed edit becomes one undo step
+static void _ui_numbersid_update_history(ui_numbersid_t* ui) {
+    const ImGuiIO& io = ImGui::GetIO();
+    if (!io.WantTextInput && io.KeyCtrl) {
+        if (ImGui::IsKeyPressed(ImGuiKey_Z, false)) {
+            if (io.KeyShift) {
+                history_redo(&ui->history, ui->sequencer);
+            }
+            else {
+                history_undo(&ui->history, ui->sequencer);
+            }
+        }
+        else if (ImGui::IsKeyPressed(ImGuiKey_Y, false)) {
+            history_redo(&ui->history, ui->sequencer);
+        }
+    }
+    if (!ImGui::IsAnyItemActive()) {
+        history_commit(&ui->history, ui->sequencer);
+    }
+}
+
 void ui_numbersid_draw(ui_numbersid_t* ui, ui_display_frame_t* frame) {
     CHIPS_ASSERT(ui && ui->sequencer);
     _ui_numbersid_draw_menu(ui);
@@ -310,7 +455,12 @@ void ui_numbersid_draw(ui_numbersid_t* ui, ui_display_frame_t* frame) {
     ui_arrays_draw(&ui->ui_arrays);
     ui_preview_draw(&ui->ui_preview);
     ui_data_draw(&ui->ui_data);
+    if (ui->ui_library.valid) {
+        ui_library_draw(&ui->ui_library);
+    }
+    ui_profiler_draw(&ui->ui_profiler);
     ui_help_draw(&ui->ui_help);
+    _ui_numbersid_update_history(ui);
 }
 
 chips_debug_t ui_numbersid_get_debug(ui_numbersid_t* ui) {
@@ -328,6 +478,10 @@ void ui_numbersid_save_settings(ui_numbersid_t* ui, ui_settings_t* settings) {
     ui_arrays_save_settings(&ui->ui_arrays, settings);
     ui_preview_save_settings(&ui->ui_preview, settings);
     ui_data_save_settings(&ui->ui_data, settings);
+    if (ui->ui_library.valid) {
+        ui_library_save_settings(&ui->ui_library, settings);
+    }
+    ui_profiler_save_settings(&ui->ui_profiler, settings);
     ui_help_save_settings(&ui->ui_help, settings);
     ui_audio_save_settings(&ui->ui_audio, settings);
     ui_display_save_settings(&ui->display, settings);
@@ -342,6 +496,10 @@ void ui_numbersid_load_settings(ui_numbersid_t* ui, const ui_settings_t* setting
     ui_arrays_load_settings(&ui->ui_arrays, settings);
     ui_preview_load_settings(&ui->ui_preview, settings);
     ui_data_load_settings(&ui->ui_data, settings);
+    if (ui->ui_library.valid) {
+        ui_library_load_settings(&ui->ui_library, settings);
+    }
+    ui_profiler_load_settings(&ui->ui_profiler, settings);
     ui_help_load_settings(&ui->ui_help, settings);
     ui_audio_load_settings(&ui->ui_audio, settings);
     ui_display_load_settings(&ui->display, settings);
@@ -0,0 +1,205 @@
+#pragma once
+/*#
+    # ui_profiler.h
+
+    Profiler window for numbersid, shows the buckets of prof.h.
+
+    Do this:
+    ~~~C
+    #define CHIPS_UI_IMPL
+    ~~~
+    before you include this file in *one* C++ file to create the
+    implementation.
+
+    Optionally provide the following macros with your own implementation
+
+    ~~~C
+    CHIPS_ASSERT(c)
+    ~~~
+        your own assert macro (default: assert(c))
+
+    Include the following headers before the including the *declaration*:
+        - prof.h
+        - ui_util.h
+        - ui_settings.h
+
+    Include the following headers before including the *implementation*:
+        - imgui.h
+        - prof.h
+        - ui_util.h
+
+    The table has one row per bucket with the average and maximum of the
+    last PROF_STATS_SIZE values, and the percentiles over the whole window
+    of PROF_WINDOW_SIZE values. Click a row to show its recent values and
+    its histogram.
+
+    All strings provided to ui_profiler_init() must remain alive until
+    ui_profiler_discard() is called!
+
+    ## zlib/libpng license
+
+    Copyright (c) 2025 Rick van der Meiden
+    Copyright (c) 2018 Andre Weissflog
+
+    This software is provided 'as-is', without any express or implied warranty.
+    In no event will the authors be held liable for any damages arising from the
+    use of this software.
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+        1. The origin of this software must not be misrepresented; you must not
+        claim that you wrote the original software. If you use this software in a
+        product, an acknowledgment in the product documentation would be
+        appreciated but is not required.
+        2. Altered source versions must be plainly marked as such, and must not
+        be misrepresented as being the original software.
+        3. This notice may not be removed or altered from any source
+        distribution.
+#*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* setup parameters for ui_profiler_init()
+    NOTE: all string data must remain alive until ui_profiler_discard()!
+*/
+typedef struct ui_profiler_desc_t {
+    const char* title;          /* window title */
+    int x, y;                   /* initial window position */
+    int w, h;                   /* initial window size (or default size of 0) */
+    bool open;                  /* initial window open state */
+} ui_profiler_desc_t;
+
+typedef struct ui_profiler_t {
+    const char* title;
+    float init_x, init_y;
+    float init_w, init_h;
+    bool open;
+    bool last_open;
+    bool valid;
+    prof_bucket_type_t selected;    /* bucket shown in the plots */
+} ui_profiler_t;
+
+void ui_profiler_init(ui_profiler_t* win, const ui_profiler_desc_t* desc);
+void ui_profiler_discard(ui_profiler_t* win);
+void ui_profiler_draw(ui_profiler_t* win);
+void ui_profiler_save_settings(ui_profiler_t* win, ui_settings_t* settings);
+void ui_profiler_load_settings(ui_profiler_t* win, const ui_settings_t* settings);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/*-- IMPLEMENTATION (include in C++ source) ----------------------------------*/
+#ifdef CHIPS_UI_IMPL
+#ifndef __cplusplus
+#error "implementation must be compiled as C++"
+#endif
+#include <string.h> /* memset */
+#include <stdio.h>  /* snprintf */
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
+
+void ui_profiler_init(ui_profiler_t* win, const ui_profiler_desc_t* desc) {
+    CHIPS_ASSERT(win && desc);
+    CHIPS_ASSERT(desc->title);
+    memset(win, 0, sizeof(ui_profiler_t));
+    win->title = desc->title;
+    win->init_x = (float) desc->x;
+    win->init_y = (float) desc->y;
+    win->init_w = (float) ((desc->w == 0) ? 460 : desc->w);
+    win->init_h = (float) ((desc->h == 0) ? 420 : desc->h);
+    win->open = win->last_open = desc->open;
+    win->selected = PROF_EMU;
+    win->valid = true;
+}
+
+void ui_profiler_discard(ui_profiler_t* win) {
+    CHIPS_ASSERT(win && win->valid);
+    win->valid = false;
+}
+
+static float _ui_profiler_value(void* data, int index) {
+    return prof_value(*(prof_bucket_type_t*)data, index);
+}
+
+static float _ui_profiler_histogram_value(void* data, int index) {
+    return (float)prof_histogram(*(prof_bucket_type_t*)data)[index];
+}
+
+static void _ui_profiler_draw_table(ui_profiler_t* win) {
+    const ImGuiTableFlags flags = ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingStretchProp;
+    if (!ImGui::BeginTable("##profiler_table", 6, flags)) {
+        return;
+    }
+    ImGui::TableSetupColumn("ms", ImGuiTableColumnFlags_WidthStretch, 1.6f);
+    ImGui::TableSetupColumn("avg");
+    ImGui::TableSetupColumn("p50");
+    ImGui::TableSetupColumn("p95");
+    ImGui::TableSetupColumn("p99");
+    ImGui::TableSetupColumn("max");
+    ImGui::TableHeadersRow();
+    for (int i = 0; i < PROF_NUM_BUCKET_TYPES; i++) {
+        const prof_bucket_type_t type = (prof_bucket_type_t)i;
+        const prof_stats_t stats = prof_stats(type);
+        const prof_percentiles_t pct = prof_percentiles(type);
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        if (ImGui::Selectable(prof_name(type), win->selected == type, ImGuiSelectableFlags_SpanAllColumns)) {
+            win->selected = type;
+        }
+        ImGui::TableNextColumn(); ImGui::Text("%.3f", stats.avg_val);
+        ImGui::TableNextColumn(); ImGui::Text("%.3f", pct.p50);
+        ImGui::TableNextColumn(); ImGui::Text("%.3f", pct.p95);
+        ImGui::TableNextColumn(); ImGui::Text("%.3f", pct.p99);
+        ImGui::TableNextColumn(); ImGui::Text("%.3f", pct.max_val);
+    }
+    ImGui::EndTable();
+}
+
+static void _ui_profiler_draw_plots(ui_profiler_t* win) {
+    const prof_percentiles_t pct = prof_percentiles(win->selected);
+    const float width = ImGui::GetContentRegionAvail().x;
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "%s, %d values", prof_name(win->selected), pct.count);
+    ImGui::PlotLines("##values", _ui_profiler_value, &win->selected, pct.count, 0, overlay, 0.0f, pct.max_val, ImVec2(width, 80));
+    // only the bins up to the maximum, the upper ones are empty
+    int num_bins = 1;
+    while ((num_bins < PROF_HISTOGRAM_BINS) && (prof_histogram_bin_limit(num_bins - 1) < pct.max_val)) {
+        num_bins++;
+    }
+    ImGui::PlotHistogram("##histogram", _ui_profiler_histogram_value, &win->selected, num_bins, 0, 0, 0.0f, FLT_MAX, ImVec2(width, 80));
+    ImGui::TextDisabled("histogram up to %.3fms, %d bins per doubling", prof_histogram_bin_limit(num_bins - 1), PROF_HISTOGRAM_BINS_PER_OCTAVE);
+}
+
+void ui_profiler_draw(ui_profiler_t* win) {
+    CHIPS_ASSERT(win && win->valid);
+    ui_util_handle_window_open_dirty(&win->open, &win->last_open);
+    if (!win->open) {
+        return;
+    }
+    ImGui::SetNextWindowPos(ImVec2(win->init_x, win->init_y), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(win->init_w, win->init_h), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin(win->title, &win->open)) {
+        _ui_profiler_draw_table(win);
+        ImGui::Separator();
+        _ui_profiler_draw_plots(win);
+    }
+    ImGui::End();
+}
+
+void ui_profiler_save_settings(ui_profiler_t* win, ui_settings_t* settings) {
+    CHIPS_ASSERT(win && settings);
+    ui_settings_add(settings, win->title, win->open);
+}
+
+void ui_profiler_load_settings(ui_profiler_t* win, const ui_settings_t* settings) {
+    CHIPS_ASSERT(win && settings);
+    win->open = ui_settings_isopen(settings, win->title);
+}
+#endif /* CHIPS_UI_IMPL */